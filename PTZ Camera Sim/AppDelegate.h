@@ -11,6 +11,7 @@
 @interface AppDelegate : NSObject <NSApplicationDelegate, NSOpenSavePanelDelegate>
 {
     dispatch_queue_t socketQueue;    
+    dispatch_queue_t filterQueue;
 }
 
 @property (strong) PTZCamera *camera;
@@ -5,9 +5,19 @@
 //  Created by Lee Ann Rucker on 12/12/22.
 //
 
-#import <Quartz/Quartz.h>
 #import "AppDelegate.h"
 #import "camera_handler.h"
+#import "PTZImageBuffer.h"
+#import "ptz_effects.h"
+#import "ptz_pyramid.h"
+#import "ptz_scene.h"
+#import "ptz_tiles.h"
+#import "ptz_snapshot.h"
+#import "ptz_stream.h"
+#import "ptz_jpeg.h"
+#import "ptz_osd.h"
+#import "ptz_af.h"
+#import "ptz_3a.h"
 
 #define PORT 5678
 
@@ -16,7 +26,33 @@
 // and https://www.maketecheasier.com/setup-local-web-server-all-platforms/#web-server-macos
 static NSString *PTZLocalhostImageFile = @"/Library/WebServer/Documents/snapshot.jpg";
 
-static AppDelegate *selfType;
+static int PTZSnapshotRender(const ptz_camera_state *state, ptz_image *frame, void *context);
+static int PTZSnapshotEncode(const ptz_image *frame, uint8_t **data, size_t *size, void *context);
+static int PTZStreamRender(const ptz_camera_state *state, ptz_image *frame, const ptz_image *previous, void *context);
+static int PTZStreamEncode(const ptz_image *frame, uint8_t **data, size_t *size, void *context);
+static void PTZHandleHTTPRequest(const ptz_http_request *request, ptz_http_response *response, void *context);
+
+// Everything one thread needs to render camera frames without main: the pyramid they sample is read-only,
+// and the tiles have their own lock.
+typedef struct PTZFrameRenderer {
+    ptz_renderer renderer;
+    ptz_color_lut lut;          // _colorLut belongs to the filter queue.
+    ptz_osd osd;                // The menu as snapshots and streams show it; osdMenuView is only for the window.
+    ptz_image viewFrame;        // The viewport from _sceneTiles or _pyramid, before effects.
+} PTZFrameRenderer;
+
+static void PTZFrameRendererInit(PTZFrameRenderer *frameRenderer) {
+    ptz_renderer_init(&frameRenderer->renderer);
+    ptz_color_lut_init(&frameRenderer->lut);
+    ptz_osd_init(&frameRenderer->osd);
+    frameRenderer->viewFrame = (ptz_image){ 0 };
+}
+
+static void PTZFrameRendererDestroy(PTZFrameRenderer *frameRenderer) {
+    ptz_renderer_destroy(&frameRenderer->renderer);
+    ptz_osd_free(&frameRenderer->osd);
+    ptz_image_free(&frameRenderer->viewFrame);
+}
 
 @interface NSAttributedString (PTZAdditions)
 + (id)attributedStringWithString: (NSString *)string;
@@ -33,13 +69,46 @@ static AppDelegate *selfType;
 
 @end
 
-@interface AppDelegate ()
+@interface AppDelegate () {
+    ptz_renderer _renderer;
+    ptz_scene *_scene;          // From the process's registry; other instances share its pixels through the mapped cache.
+    const ptz_pyramid *_pyramid; // baseImage at every resolution, before effects: _scene's, or empty if it wouldn't load.
+    ptz_image _sourceFrame;     // What imageView shows; its image shares these pixels.
+    ptz_image _filteredFrame;   // Back buffer for the filter queue.
+    ptz_image _snapshotFrame;
+    ptz_tiles _sceneTiles;      // Optional tiled scene for snapshots; levelCount is 0 when there isn't one.
+    pthread_mutex_t _sceneTilesLock;    // Its cache is shared by the snapshot and stream renders.
+    PTZFrameRenderer _snapshotRenderer; // HTTP connection threads and Take Snapshot share it,
+    pthread_mutex_t _snapshotLock;      // one at a time.
+    ptz_af _autofocus;
+    ptz_af_probe _autofocusProbe;
+    ptz_image _statsFrame;      // What auto exposure and white balance measure.
+    ptz_renderer *_effectsRenderers; // One per strip, so the strips can run in parallel.
+    int _effectsStripCount;
+    int _filterLevel;           // Pyramid level of the most recently requested effects render.
+    int _filterBlurRadius;      // And its focus blur at sensor resolution, which also depends on zoom and tilt.
+    ptz_color_lut _colorLut;    // Only touched on main, while no filter is in progress.
+    ptz_jpeg_tables _snapshotJpeg;      // Read-only after launch, so the HTTP threads share them.
+    ptz_jpeg_tables _streamJpeg;
+    ptz_jpeg_buffer _snapshotJpegBuffer;
+    ptz_snapshot_service _snapshotService;
+    ptz_stream _stream;
+    PTZFrameRenderer _streamRenderer;       // Only the stream's render thread uses these.
+    ptz_image _streamViewFrame;             // The last stream frame before effects, which the next one scrolls from.
+    ptz_scroll_position _streamPosition;    // Where _streamViewFrame came from, when
+    BOOL _streamScrollValid;                // it's safe to scroll: untiled, no menu, and
+    int _streamLevel;                       // rendered from this pyramid level.
+    ptz_http_server _httpServer;
+    BOOL _streamRunning, _httpServerRunning;
+}
 
 @property (strong) IBOutlet NSWindow *window;
 @property (strong) IBOutlet NSTextView *console;
 @property (strong) NSFileHandle* pipeReadHandle;
 @property (strong) NSPipe *pipe;
 @property (copy) NSImage *baseImage;
+@property NSTimer *autofocusTimer;  // Only while a search is running.
+@property NSTimer *autoExposureTimer;
 @property BOOL filterInProgress, needsFilter;
 
 @end
@@ -74,33 +143,176 @@ static AppDelegate *selfType;
 }
 
 - (void)applicationDidFinishLaunching:(NSNotification *)aNotification {
-    NSArray *paths = @[@"camera.zoom", @"camera.pan", @"camera.tilt", @"camera.autofocus", @"camera.focus", @"camera.colorTempIndex", @"camera.wbMode", @"camera.bwMode", @"camera.flipH", @"camera.flipV"];
-    // Insert code here to initialize your application
-    for (NSString *path in paths) {
-        [self addObserver:self
-               forKeyPath:path
-                  options:0
-                  context:&selfType];
-    }
     //  We don't want to zoom all the way out on the image itself, because then there's no room to pan/tilt.
     self.scrollView.minMagnification = 1.1;
     self.scrollView.maxMagnification = 25;
     self.baseImage = self.imageView.image;
+    ptz_renderer_init(&_renderer);
+    [self acquireScene];
+    [self openSceneTiles];
+    // Level 0 has the most strips, so this covers every level.
+    _effectsStripCount = ptz_effects_strip_count(&_pyramid->levels[0]);
+    _effectsRenderers = calloc(_effectsStripCount, sizeof(ptz_renderer));
+    for (int i = 0; i < _effectsStripCount; i++) {
+        ptz_renderer_init(&_effectsRenderers[i]);
+    }
+    ptz_color_lut_init(&_colorLut);
+    PTZFrameRendererInit(&_snapshotRenderer);
+    pthread_mutex_init(&_snapshotLock, NULL);
+    PTZFrameRendererInit(&_streamRenderer);
+    pthread_mutex_init(&_sceneTilesLock, NULL);
+    ptz_af_probe_init(&_autofocusProbe);
+    filterQueue = dispatch_queue_create("filterQueue", NULL);
     self.camera = [PTZCamera new];
+    __weak typeof(self) weakSelf = self;
+    [self.camera addStateObserver:^(const ptz_state_delta *delta) {
+        [weakSelf cameraStateDidChange:delta];
+    }];
     [self updateZoomFactor];
+    [self applyImageFilters];
+    [self startAutofocus];
+    [self startAutoExposure];
+    [self startHTTPServer];
 
     [self configConsoleRedirect];
     socketQueue = dispatch_queue_create("socketQueue", NULL);
+    // Controllers on this host can set VISCASharedMemory to a shm name ("/ptz-visca") to skip TCP (jr_shm.h).
+    NSString *sharedMemory = [[NSUserDefaults standardUserDefaults] stringForKey:@"VISCASharedMemory"];
+    NSArray<PTZCamera *> *cameras = [self daisyChainCameras];
     dispatch_async(socketQueue, ^{
         int result;
         do {
-            result = handle_camera(self.camera);
+            if (sharedMemory != nil) {
+                result = handle_camera_shared_memory(cameras, sharedMemory.fileSystemRepresentation);
+            } else {
+                result = handle_camera(cameras);
+            }
         } while (result == 0);
         printf("handle_camera failed, result = %d. Make sure there's not another instance running", result);
     });
 
 }
 
+// DaisyChainCameras (2-7) puts that many cameras behind the one connection, like a rack on an RS-422 bridge.
+// The first is the one in the window; the others have no view, but move, answer inquiries and keep their own presets.
+- (NSArray<PTZCamera *> *)daisyChainCameras {
+    NSInteger count = MIN(MAX([[NSUserDefaults standardUserDefaults] integerForKey:@"DaisyChainCameras"], 1), CAMERA_CHAIN_MAX);
+    NSMutableArray<PTZCamera *> *cameras = [NSMutableArray arrayWithObject:self.camera];
+    for (NSInteger i = 2; i <= count; i++) {
+        [cameras addObject:[[PTZCamera alloc] initWithScenesKey:[NSString stringWithFormat:@"Scenes-%ld", (long)i]]];
+    }
+    return cameras;
+}
+
+- (NSString *)pyramidCachePath:(uint64_t)key {
+    NSURL *caches = [[NSFileManager defaultManager] URLForDirectory:NSCachesDirectory inDomain:NSUserDomainMask appropriateForURL:nil create:YES error:NULL];
+    if (caches == nil) {
+        return nil;
+    }
+    NSString *name = [NSString stringWithFormat:@"pyramid-%016llx.mip", (unsigned long long)key];
+    return [caches.path stringByAppendingPathComponent:name];
+}
+
+// Warm starts map the cached pyramid and never decode the JPEG. The first run decodes, builds, and saves it for the next one.
+static int PTZLoadScene(ptz_pyramid *pyramid, uint64_t key, void *context) {
+    AppDelegate *delegate = (__bridge AppDelegate *)context;
+    NSString *path = (key != 0) ? [delegate pyramidCachePath:key] : nil;
+    if (path != nil && ptz_pyramid_map(pyramid, path.fileSystemRepresentation, key) == 0) {
+        return 0;
+    }
+    ptz_image base = { 0 };
+    BOOL built = PTZImageBufferDecode(delegate.baseImage, &base) && ptz_pyramid_build(pyramid, &base) == 0;
+    ptz_image_free(&base);
+    if (built && path != nil && ptz_pyramid_write(pyramid, path.fileSystemRepresentation, key) < 0) {
+        [delegate logMessage:@"Could not save the image cache"];
+    }
+    return built ? 0 : -1;
+}
+
+- (void)acquireScene {
+    static const ptz_pyramid noPyramid;
+    _scene = ptz_scene_acquire(ptz_scene_registry_shared(), PTZImageBufferSourceKey(self.baseImage),
+                               PTZLoadScene, (__bridge void *)self);
+    if (_scene == NULL) {
+        [self logError:@"Could not decode camera image"];
+    }
+    _pyramid = (_scene != NULL) ? &_scene->pyramid : &noPyramid;
+}
+
+// Venues can point SceneTiles at a tile container (ptz_tiles.h) for a panorama too big to load as an image.
+- (void)openSceneTiles {
+    NSString *path = [[NSUserDefaults standardUserDefaults] stringForKey:@"SceneTiles"];
+    if (path == nil) {
+        return;
+    }
+    if (ptz_tiles_open(&_sceneTiles, path.fileSystemRepresentation, PTZ_TILE_CACHE_DEFAULT) < 0) {
+        [self logError:[NSString stringWithFormat:@"Could not open scene tiles %@", path]];
+        return;
+    }
+    ptz_tiles_set_decoder(&_sceneTiles, PTZImageBufferDecodeTile, NULL);
+}
+
+// The window flips the whole scene and then pans across it, so a flipped camera panned left shows the mirror
+// image of what's on the right. Sampling the mirrored viewport and letting the effects flip it matches the window.
+static ptz_camera_state PTZSampledState(const ptz_camera_state *state) {
+    ptz_camera_state sampled = *state;
+    if (state->flipH) {
+        sampled.pan = -sampled.pan;
+    }
+    if (state->flipV) {
+        sampled.tilt = -sampled.tilt;
+    }
+    return sampled;
+}
+
+// `view` is what the camera sees for `state`, before effects, from a scene `width` x `height`.
+// The focus blur is in scene pixels, so it's scaled to the view's.
+- (int)applyEffects:(const ptz_camera_state *)state to:(const ptz_image *)view sceneWidth:(int)width height:(int)height
+               into:(ptz_image *)frame with:(PTZFrameRenderer *)frameRenderer {
+    ptz_viewport viewport;
+    ptz_viewport_for_state(state, width, height, view->width, view->height, &viewport);
+    ptz_effects effects;
+    ptz_effects_for_state(state, &frameRenderer->lut, &effects);
+    ptz_effects_scale(&effects, view->width / viewport.width);
+    return ptz_render_effects(&frameRenderer->renderer, view, &effects, frame);
+}
+
+// Only reads the tiles under the viewport, then applies the effects at snapshot size rather than to the whole scene.
+- (int)renderTiledSnapshot:(const ptz_camera_state *)state into:(ptz_image *)frame with:(PTZFrameRenderer *)frameRenderer {
+    ptz_camera_state sampled = PTZSampledState(state);
+    ptz_image *view = &frameRenderer->viewFrame;
+    if (ptz_image_alloc(view, frame->width, frame->height) < 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&_sceneTilesLock);
+    int result = ptz_render_tiled_frame(&frameRenderer->renderer, &_sceneTiles, &sampled, view);
+    pthread_mutex_unlock(&_sceneTilesLock);
+    if (result < 0) {
+        return -1;
+    }
+    return [self applyEffects:state to:view sceneWidth:_sceneTiles.levels[0].width height:_sceneTiles.levels[0].height
+                         into:frame with:frameRenderer];
+}
+
+// Samples the pyramid level that matches the snapshot size, not the one the window is showing, and applies
+// the effects at that size: a 1080p snapshot of a wide shot still gets full detail, and a thumbnail stays cheap.
+- (int)renderPyramidSnapshot:(const ptz_camera_state *)state into:(ptz_image *)frame with:(PTZFrameRenderer *)frameRenderer {
+    ptz_camera_state sampled = PTZSampledState(state);
+    ptz_image *view = &frameRenderer->viewFrame;
+    if (   ptz_image_alloc(view, frame->width, frame->height) < 0
+        || ptz_render_pyramid_frame(&frameRenderer->renderer, _pyramid, &sampled, view) < 0) {
+        return -1;
+    }
+    return [self applyEffects:state to:view sceneWidth:_pyramid->levels[0].width height:_pyramid->levels[0].height
+                         into:frame with:frameRenderer];
+}
+
+// The smallest pyramid level that still has a pixel for every screen pixel at the current magnification.
+- (int)displayLevel {
+    CGFloat scale = self.scrollView.magnification * self.window.backingScaleFactor;
+    return ptz_pyramid_level_for_width(_pyramid, (int)ceil(NSWidth(self.imageView.bounds) * scale));
+}
+
 - (NSPoint)scrollPoint {
     NSPoint point = NSZeroPoint;
     NSSize docSize = self.scrollView.documentView.bounds.size;
@@ -114,46 +326,193 @@ static AppDelegate *selfType;
     return point;
 }
 
-- (NSImage *)menuImage:(NSRect)bounds {
-    NSSize imgSize = bounds.size;
-    
-    NSBitmapImageRep *bir = [self.osdMenuView bitmapImageRepForCachingDisplayInRect:bounds];
-    [bir setSize:imgSize];
-    [self.osdMenuView cacheDisplayInRect:bounds toBitmapImageRep:bir];
-    
-    NSImage* image = [[NSImage alloc] initWithSize:imgSize];
-    [image addRepresentation:bir];
-    return image;
+// What the camera sees for `state`, with the OSD menu over it, into `frame` at whatever size it already has.
+// Any thread, as long as no other is using `frameRenderer`: everything else it touches is read-only or locked.
+- (BOOL)renderSnapshot:(const ptz_camera_state *)state into:(ptz_image *)frame with:(PTZFrameRenderer *)frameRenderer {
+    int result = (_sceneTiles.levelCount > 0) ? [self renderTiledSnapshot:state into:frame with:frameRenderer]
+                                              : [self renderPyramidSnapshot:state into:frame with:frameRenderer];
+    if (result < 0) {
+        return NO;
+    }
+    if (state->menuVisible) {
+        // ipAddress is atomic, and only changes when a controller connects.
+        NSString *address = [self.camera valueForKey:@"ipAddress"] ?: @"";
+        ptz_osd_menu(&frameRenderer->osd, state, address.UTF8String);
+        return ptz_osd_draw(&frameRenderer->osd, frame, 0.5f) == 0;
+    }
+    return YES;
+}
+
+// Real cameras hunt for focus after the view changes, and controllers wait for that to settle;
+// CAM_FocusPosInq sees the lens move as the search runs.
+- (void)startAutofocus {
+    if (!self.camera.autofocus) {
+        return;
+    }
+    ptz_af_start(&_autofocus, (uint32_t)self.camera.focus);
+    if (self.autofocusTimer == nil) {
+        __weak typeof(self) weakSelf = self;
+        self.autofocusTimer = [NSTimer scheduledTimerWithTimeInterval:1.0 / PTZ_AF_TICKS_PER_SECOND repeats:YES block:^(NSTimer * _Nonnull timer) {
+            [weakSelf autofocusTick];
+        }];
+    }
+}
+
+- (void)stopAutofocus {
+    _autofocus.searching = 0;
+    [self.autofocusTimer invalidate];
+    self.autofocusTimer = nil;
 }
 
-// snapshot.jpg resolution options: 1920x1080 960x600 480x300
+- (void)autofocusTick {
+    ptz_camera_state state = self.camera.cameraState;
+    if (!state.autofocus || !_autofocus.searching) {
+        [self stopAutofocus];
+        return;
+    }
+    float score = ptz_af_measure(&_autofocusProbe, _pyramid, &state, (uint32_t)_autofocus.position);
+    if (score < 0) {
+        [self logError:@"Autofocus could not measure the image"];
+        [self stopAutofocus];
+        return;
+    }
+    uint32_t focus = ptz_af_step(&_autofocus, score);
+    if (focus != state.focus) {
+        [self.camera focusDirect:focus];
+    }
+    if (!_autofocus.searching) {
+        [self stopAutofocus];
+    }
+}
+
+// Auto exposure and white balance run all the time, like a real camera's; once they've settled nothing changes.
+- (void)startAutoExposure {
+    __weak typeof(self) weakSelf = self;
+    self.autoExposureTimer = [NSTimer scheduledTimerWithTimeInterval:1.0 / PTZ_3A_TICKS_PER_SECOND repeats:YES block:^(NSTimer * _Nonnull timer) {
+        [weakSelf autoExposureTick];
+    }];
+}
+
+- (void)autoExposureTick {
+    ptz_camera_state state = self.camera.cameraState;
+    if (!ptz_3a_is_active(&state) || _pyramid->levelCount == 0) {
+        return;
+    }
+    if (   ptz_image_alloc(&_statsFrame, PTZ_3A_FRAME_WIDTH, PTZ_3A_FRAME_HEIGHT) < 0
+        || ptz_render_pyramid_frame(&_renderer, _pyramid, &state, &_statsFrame) < 0) {
+        return;
+    }
+    ptz_3a_stats stats;
+    ptz_3a_stats_compute(&_statsFrame, &stats);
+    ptz_3a_settings settings;
+    uint32_t changed = ptz_3a_update(&stats, &state, &settings);
+    // Through the camera's setters, so the inquiries report them and the picture follows.
+    if (changed & PTZ_STATE_IRIS) {
+        [self.camera safeSetNumber:settings.iris forKey:@"iris"];
+    }
+    if (changed & PTZ_STATE_SHUTTER) {
+        [self.camera safeSetNumber:settings.shutter forKey:@"shutter"];
+    }
+    if (changed & PTZ_STATE_RGAIN) {
+        [self.camera safeSetNumber:settings.rGain forKey:@"rGain"];
+    }
+    if (changed & PTZ_STATE_BGAIN) {
+        [self.camera safeSetNumber:settings.bGain forKey:@"bGain"];
+    }
+}
+
+// Stream frames usually differ from the one before by a small pan or tilt, so when nothing else has changed
+// the overlap is copied from the last frame and only the edges are rendered. That's done before effects, from the
+// pyramid level that matches the stream size, so the copy is of what the blur and color would start from.
+// `previous` being NULL means the stream is starting over. Runs on the stream's render thread.
+- (BOOL)renderStreamFrame:(const ptz_camera_state *)state into:(ptz_image *)frame previous:(const ptz_image *)previous {
+    PTZFrameRenderer *frameRenderer = &_streamRenderer;
+    if (_sceneTiles.levelCount > 0 || state->menuVisible) {
+        _streamScrollValid = NO;
+        return [self renderSnapshot:state into:frame with:frameRenderer];
+    }
+    ptz_camera_state sampled = PTZSampledState(state);
+    ptz_viewport viewport;
+    int level = ptz_pyramid_viewport_for_state(_pyramid, &sampled, frame->width, frame->height, &viewport);
+    if (level < 0 || ptz_image_alloc(&_streamViewFrame, frame->width, frame->height) < 0) {
+        _streamScrollValid = NO;
+        return NO;
+    }
+    BOOL canScroll = previous != NULL && _streamScrollValid && _streamLevel == level;
+    if (ptz_render_scroll(&frameRenderer->renderer, &_pyramid->levels[level], &viewport, canScroll ? &_streamViewFrame : NULL,
+                          &_streamPosition, &_streamViewFrame) < 0) {
+        _streamScrollValid = NO;
+        return NO;
+    }
+    _streamScrollValid = YES;
+    _streamLevel = level;
+    return [self applyEffects:state to:&_streamViewFrame sceneWidth:_pyramid->levels[0].width
+                       height:_pyramid->levels[0].height into:frame with:frameRenderer] == 0;
+}
+
+// snapshot.jpg is served on demand by the HTTP server, at the resolutions real cameras offer,
+// and stream.mjpg is live video for as long as someone is watching. Only to this Mac, unless HTTPAllInterfaces
+// is set for monitors and controllers elsewhere on the network.
+- (void)startHTTPServer {
+    ptz_jpeg_tables_init(&_snapshotJpeg, PTZ_JPEG_QUALITY_SNAPSHOT);
+    // Every frame of the stream is encoded, so it trades a little quality for time and bandwidth.
+    ptz_jpeg_tables_init(&_streamJpeg, PTZ_JPEG_QUALITY_STREAM);
+    ptz_snapshot_service_init(&_snapshotService, PTZSnapshotRender, PTZSnapshotEncode, (__bridge void *)self);
+    ptz_camera_state state = self.camera.cameraState;
+    ptz_snapshot_service_set_state(&_snapshotService, &state);
+    if (ptz_stream_start(&_stream, PTZ_STREAM_WIDTH, PTZ_STREAM_HEIGHT, PTZ_STREAM_FPS,
+                         PTZStreamRender, PTZStreamEncode, (__bridge void *)self) < 0) {
+        [self logError:@"Could not start the video stream"];
+    } else {
+        _streamRunning = YES;
+        ptz_stream_set_state(&_stream, &state);
+        [self openStreamSink];
+    }
+    BOOL allInterfaces = [[NSUserDefaults standardUserDefaults] boolForKey:@"HTTPAllInterfaces"];
+    if (ptz_http_server_start(&_httpServer, PTZ_HTTP_PORT, allInterfaces ? PTZ_HTTP_BIND_ANY : PTZ_HTTP_BIND_LOOPBACK,
+                              PTZHandleHTTPRequest, (__bridge void *)self) == 0) {
+        _httpServerRunning = YES;
+        [self logInfo:[NSString stringWithFormat:@"Serving http://localhost:%d/snapshot.jpg and /stream.mjpg%@",
+                       PTZ_HTTP_PORT, allInterfaces ? @", on every interface" : @""]];
+    } else {
+        [self logError:[NSString stringWithFormat:@"Could not start the snapshot server on port %d", PTZ_HTTP_PORT]];
+    }
+}
+
+// Raw frames for ffmpeg, if the StreamSink default names a FIFO or "unix:/path/to/socket".
+// StreamSinkFormat "rgba" sends bare RGBA frames instead of Y4M.
+- (void)openStreamSink {
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    NSString *path = [defaults stringForKey:@"StreamSink"];
+    if (path == nil) {
+        return;
+    }
+    ptz_stream_format format = [[defaults stringForKey:@"StreamSinkFormat"] isEqualToString:@"rgba"] ? PTZ_STREAM_RGBA : PTZ_STREAM_Y4M;
+    if (ptz_stream_open_sink(&_stream, path.fileSystemRepresentation, format) < 0) {
+        [self logError:[NSString stringWithFormat:@"Could not open stream sink %@", path]];
+    } else {
+        [self logInfo:[NSString stringWithFormat:@"Streaming raw frames to %@", path]];
+    }
+}
+
+// The Take Snapshot menu item still writes a view-sized snapshot.jpg to the local web server, for setups that use it.
 - (void)writeCameraSnapshot {
-    NSImage *camImage = self.imageView.image;
-    NSSize docSize = self.scrollView.documentView.bounds.size;
     NSSize snapshotSize = self.scrollView.contentSize;
-    NSSize imgSize = camImage.size;
-    NSRect visRect = self.scrollView.documentVisibleRect;
-    // The scaling to make the image shrink to fit, separate from magnification, which visRect has already dealt with.
-    CGFloat xScale = imgSize.width / docSize.width;
-    CGFloat yScale = imgSize.height / docSize.height;
-
-    visRect.origin = NSMakePoint(visRect.origin.x * xScale, visRect.origin.y * yScale);
-    visRect.size = NSMakeSize(visRect.size.width * xScale, visRect.size.height * yScale);
-    visRect = NSIntegralRect(visRect);
-    NSImage *image = [[NSImage alloc] initWithSize:snapshotSize];
-    [image lockFocus];
-    NSRect dest = { NSZeroPoint, snapshotSize };
-    [camImage drawInRect:dest fromRect:visRect operation:NSCompositingOperationCopy fraction:1];
-    if (self.camera.menuVisible) {
-        NSImage *menuImage = [self menuImage:dest];
-        [menuImage drawInRect:dest fromRect:dest operation:NSCompositingOperationSourceOver fraction:0.5];
-    }
-    [image unlockFocus];
-
-    NSData *imageData = [image TIFFRepresentation];
-    NSBitmapImageRep *imageRep = [NSBitmapImageRep imageRepWithData:imageData];
-    NSDictionary *imageProps = [NSDictionary dictionaryWithObject:[NSNumber numberWithFloat:1.0] forKey:NSImageCompressionFactor];
-    imageData = [imageRep representationUsingType:NSBitmapImageFileTypeJPEG properties:imageProps];
+    ptz_camera_state state = self.camera.cameraState;
+    pthread_mutex_lock(&_snapshotLock);
+    BOOL rendered =    ptz_image_alloc(&_snapshotFrame, (int)snapshotSize.width, (int)snapshotSize.height) == 0
+                    && [self renderSnapshot:&state into:&_snapshotFrame with:&_snapshotRenderer];
+    pthread_mutex_unlock(&_snapshotLock);
+    if (!rendered) {
+        [self logError:@"Snapshot render failed"];
+        return;
+    }
+    if (ptz_jpeg_encode(&_snapshotJpeg, &_snapshotFrame, &_snapshotJpegBuffer) < 0) {
+        [self logError:@"Snapshot encode failed"];
+        return;
+    }
+    // A copy: the sandbox panel may hang on to it, and the buffer is reused next time.
+    NSData *imageData = [NSData dataWithBytes:_snapshotJpegBuffer.data length:_snapshotJpegBuffer.size];
 #if 0
     // Debugging, only works with sandbox disabled.
     BOOL result = [imageData writeToFile:PTZLocalhostImageFile atomically:NO];
@@ -268,69 +627,72 @@ static AppDelegate *selfType;
 }
 
 // To simulate focus vs autofocus, we blur the image.
+// Latest wins: while a render is in flight we just note that the camera changed again,
+// and the completion starts one more render with whatever the state is by then.
 - (void)applyImageFilters {
+    // No scene, nothing to filter; and no level 0 to scale the blur by.
+    if (_pyramid->levelCount == 0) {
+        return;
+    }
     if (self.filterInProgress) {
         self.needsFilter = YES;
         return;
     }
-    BOOL useFocusFilter = self.camera.autofocus == NO && self.camera.focusPixelRadius > 1;
-    BOOL useTempFilter = self.camera.wbMode == WB_MODE_COLOR;
-    BOOL mirrorX = self.camera.flipH;
-    BOOL mirrorY = self.camera.flipV;
-    BOOL useFlipFilter = mirrorX || mirrorY;
-    BOOL useBlackWhiteFilter = self.camera.bwMode;
-    if (!useFocusFilter && !useTempFilter && !useFlipFilter && !useBlackWhiteFilter) {
+    self.filterInProgress = YES;
+    self.needsFilter = NO;
+    ptz_camera_state state = self.camera.cameraState;
+    ptz_effects effects;
+    ptz_effects_for_state(&state, &_colorLut, &effects);
+    _filterBlurRadius = effects.blurRadius;
+    // Wide shots only need a fraction of the sensor, so filter the level the view will actually show.
+    int level = [self displayLevel];
+    _filterLevel = level;
+    ptz_effects_scale(&effects, (float)_pyramid->levels[level].width / _pyramid->levels[0].width);
+    NSSize size = self.baseImage.size;
+    dispatch_async(filterQueue, ^{
+        NSImage *image = [self renderEffects:effects level:level size:size];
         dispatch_async(dispatch_get_main_queue(), ^{
-            self.imageView.image = [self.baseImage copy];
+            if (image != nil) {
+                // The old image goes away with the old front buffer.
+                ptz_image frame = self->_sourceFrame;
+                self->_sourceFrame = self->_filteredFrame;
+                self->_filteredFrame = frame;
+                self.imageView.image = image;
+            } else {
+                [self logError:@"Image effects failed"];
+            }
+            self.filterInProgress = NO;
+            if (self.needsFilter) {
+                [self applyImageFilters];
+            }
         });
-        return;
-    }
-    
-    self.filterInProgress = YES;
-    CIContext *context = [CIContext contextWithOptions:nil];
-    CIImage *inputImage = [CIImage imageWithData:[self.baseImage TIFFRepresentation]];
-
-    if (useFocusFilter) {
-        CIFilter *blurFilter = [CIFilter filterWithName:@"CIGaussianBlur"];
-        [blurFilter setDefaults];
-        [blurFilter setValue:inputImage forKey:@"inputImage"];
-        CGFloat blurLevel = self.camera.focusPixelRadius;
-        [blurFilter setValue:[NSNumber numberWithFloat:blurLevel] forKey:@"inputRadius"];
-        inputImage = [blurFilter valueForKey:@"outputImage"];
-    }
-    if (useTempFilter) {
-        // Tweak it; the image is already warm. Camera range is 2500-8000, filter range is 0-13000
-        NSInteger colorTemp = self.camera.colorTemp+3000;
-
-        CIFilter *tempFilter = [CIFilter filterWithName:@"CITemperatureAndTint"];
-        [tempFilter setDefaults];
-        [tempFilter setValue:inputImage forKey:@"inputImage"];
-        [tempFilter setValue:[CIVector vectorWithX:colorTemp Y:0] forKey:@"inputTargetNeutral"];
-        inputImage = [tempFilter valueForKey:@"outputImage"];
-    }
-    if (useFlipFilter) {
-        inputImage = [inputImage imageByApplyingTransform:CGAffineTransformMakeScale(mirrorX?-1:1, mirrorY?-1:1)];
-        inputImage = [inputImage imageByApplyingTransform:CGAffineTransformMakeTranslation(mirrorX?self.imageView.image.size.width:0, mirrorY?self.imageView.image.size.height:0)];
-    }
-    // CIColorMonochrome for CAM_PictureEffect B&W
-    if (useBlackWhiteFilter) {
-        CIFilter *tempFilter = [CIFilter filterWithName:@"CIColorMonochrome"];
-        [tempFilter setDefaults];
-        [tempFilter setValue:inputImage forKey:@"inputImage"];
-        [tempFilter setValue:[CIColor grayColor] forKey:@"inputColor"];
-        inputImage = [tempFilter valueForKey:@"outputImage"];
-    }
-    CGImageRef cgImage = [context createCGImage:inputImage fromRect:inputImage.extent];
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.imageView.image = [[NSImage alloc] initWithCGImage:cgImage size:self.baseImage.size];
     });
+}
 
-    // Create an NSImage with the same size as the original; extent is not the same.
-    self.filterInProgress = NO;
-    // TODO: This is totally comp 101 level of request consolidation.
-    if (self.needsFilter) {
-        [self performSelector:_cmd withObject:nil afterDelay:0];
+// Runs on filterQueue. Renders one pyramid level into the back buffer and wraps it, without copying,
+// in an image the same size as baseImage; AppKit scales it like any other low resolution rep.
+- (NSImage *)renderEffects:(ptz_effects)effects level:(int)level size:(NSSize)size {
+    if (_effectsRenderers == NULL || level >= _pyramid->levelCount) {
+        return nil;
+    }
+    const ptz_image *src = &_pyramid->levels[level];
+    ptz_image *dst = &_filteredFrame;
+    if (ptz_image_alloc(dst, src->width, src->height) < 0) {
+        return nil;
+    }
+    ptz_renderer *renderers = _effectsRenderers;
+    __block BOOL failed = NO;
+    dispatch_apply(ptz_effects_strip_count(src), DISPATCH_APPLY_AUTO, ^(size_t strip) {
+        if (ptz_render_effects_strip(&renderers[strip], src, &effects, dst, (int)strip) < 0) {
+            failed = YES;
+        }
+    });
+    if (failed) {
+        return nil;
     }
+    NSImage *image = [[NSImage alloc] initWithSize:size];
+    [image addRepresentation:PTZImageBufferBitmapRep(dst)];
+    return image;
 }
 
 - (BOOL)validateUserInterfaceItem:(NSMenuItem *)menuItem {
@@ -388,8 +750,45 @@ static AppDelegate *selfType;
     [self.console scrollRangeToVisible:range];
 }
 
+// Nothing they run waits on main, so they're stopped right here.
+- (void)stopServers {
+    // The stream first: its MJPEG clients are on the server's connection threads.
+    if (_streamRunning) {
+        ptz_stream_stop(&_stream);
+        _streamRunning = NO;
+    }
+    if (_httpServerRunning) {
+        ptz_http_server_stop(&_httpServer);
+        _httpServerRunning = NO;
+    }
+}
+
 - (void)applicationWillTerminate:(NSNotification *)aNotification {
-    // Insert code here to tear down your application
+    // Nothing else on main touches the buffers once the timers are gone.
+    [self.autofocusTimer invalidate];
+    [self.autoExposureTimer invalidate];
+    [self stopServers];
+    // And the filter queue may be partway through rendering into _filteredFrame.
+    dispatch_sync(filterQueue, ^{});
+    ptz_snapshot_service_destroy(&_snapshotService);
+    ptz_renderer_destroy(&_renderer);
+    for (int i = 0; i < _effectsStripCount; i++) {
+        ptz_renderer_destroy(&_effectsRenderers[i]);
+    }
+    free(_effectsRenderers);
+    ptz_scene_release(_scene);
+    ptz_image_free(&_sourceFrame);
+    ptz_image_free(&_filteredFrame);
+    ptz_image_free(&_snapshotFrame);
+    ptz_jpeg_buffer_free(&_snapshotJpegBuffer);
+    ptz_image_free(&_streamViewFrame);
+    ptz_tiles_close(&_sceneTiles);
+    pthread_mutex_destroy(&_sceneTilesLock);
+    PTZFrameRendererDestroy(&_snapshotRenderer);
+    pthread_mutex_destroy(&_snapshotLock);
+    PTZFrameRendererDestroy(&_streamRenderer);
+    ptz_af_probe_destroy(&_autofocusProbe);
+    ptz_image_free(&_statsFrame);
 }
 
 
@@ -397,29 +796,76 @@ static AppDelegate *selfType;
     return YES;
 }
 
-- (void)observeValueForKeyPath: (NSString *)keyPath    // IN
-                      ofObject: (id)object             // IN
-                        change: (NSDictionary *)change // IN
-                       context: (void *)context        // IN
-{
-   if (context != &selfType) {
-      [super observeValueForKeyPath:keyPath
-                           ofObject:object
-                             change:change
-                            context:context];
-   } else if ([keyPath isEqualToString:@"camera.zoom"]) {
-      [self updateZoomFactor];
-   } else if (   [keyPath isEqualToString:@"camera.autofocus"]
-              || [keyPath isEqualToString:@"camera.focus"]
-              || [keyPath isEqualToString:@"camera.colorTempIndex"]
-              || [keyPath isEqualToString:@"camera.wbMode"]
-              || [keyPath isEqualToString:@"camera.bwMode"]
-              || [keyPath isEqualToString:@"camera.flipH"]
-              || [keyPath isEqualToString:@"camera.flipV"]) {
-      [self applyImageFilters];
-   } else { // pan, tilt.
-      [self updateScrollPosition];
-   }
+// One call per engine tick, no matter how many properties the tick wrote.
+- (void)cameraStateDidChange:(const ptz_state_delta *)delta {
+    uint32_t dirty = delta->dirty;
+    BOOL needsEffects = (dirty & PTZ_STATE_EFFECTS_MASK) != 0;
+    if (dirty & (PTZ_STATE_ZOOM | PTZ_STATE_TILT)) {
+        // The subject's distance moved, so the blur may have too.
+        ptz_effects effects;
+        ptz_effects_for_state(&delta->state, NULL, &effects);
+        needsEffects = needsEffects || effects.blurRadius != _filterBlurRadius;
+    }
+    if (delta->state.autofocus && (dirty & (PTZ_STATE_VIEWPORT_MASK | PTZ_STATE_AUTOFOCUS))) {
+        [self startAutofocus];
+    }
+    if (dirty & PTZ_STATE_ZOOM) {
+        [self updateZoomFactor]; // Also updates the scroll position.
+        needsEffects = needsEffects || [self displayLevel] != _filterLevel;
+    } else if (dirty & (PTZ_STATE_PAN | PTZ_STATE_TILT)) {
+        [self updateScrollPosition];
+    }
+    if (needsEffects) {
+        [self applyImageFilters];
+    }
+    // Just a copy; snapshots are only rendered and encoded when someone asks for one.
+    ptz_snapshot_service_set_state(&_snapshotService, &delta->state);
+    ptz_stream_set_state(&_stream, &delta->state);
+}
+
+// C callbacks for the HTTP server and stream. Inside the @implementation so they can reach the ivars.
+// Snapshots render right on the connection's thread; a busy main thread doesn't slow them down.
+static int PTZSnapshotRender(const ptz_camera_state *state, ptz_image *frame, void *context) {
+    AppDelegate *delegate = (__bridge AppDelegate *)context;
+    pthread_mutex_lock(&delegate->_snapshotLock);
+    BOOL rendered = [delegate renderSnapshot:state into:frame with:&delegate->_snapshotRenderer];
+    pthread_mutex_unlock(&delegate->_snapshotLock);
+    return rendered ? 0 : -1;
+}
+
+// And stream frames on the stream's render thread, from the copy of the state it was given.
+static int PTZStreamRender(const ptz_camera_state *state, ptz_image *frame, const ptz_image *previous, void *context) {
+    AppDelegate *delegate = (__bridge AppDelegate *)context;
+    return [delegate renderStreamFrame:state into:frame previous:previous] ? 0 : -1;
+}
+
+// Encoded frames outlive the call, cached or queued for clients, so each gets its own buffer.
+static int PTZEncodeJPEG(const ptz_jpeg_tables *tables, const ptz_image *frame, uint8_t **data, size_t *size) {
+    ptz_jpeg_buffer buffer = { 0 };
+    if (ptz_jpeg_encode(tables, frame, &buffer) < 0) {
+        ptz_jpeg_buffer_free(&buffer);
+        return -1;
+    }
+    *data = buffer.data;
+    *size = buffer.size;
+    return 0;
+}
+
+static int PTZSnapshotEncode(const ptz_image *frame, uint8_t **data, size_t *size, void *context) {
+    AppDelegate *delegate = (__bridge AppDelegate *)context;
+    return PTZEncodeJPEG(&delegate->_snapshotJpeg, frame, data, size);
+}
+
+static int PTZStreamEncode(const ptz_image *frame, uint8_t **data, size_t *size, void *context) {
+    AppDelegate *delegate = (__bridge AppDelegate *)context;
+    return PTZEncodeJPEG(&delegate->_streamJpeg, frame, data, size);
+}
+
+// Each handler leaves requests for paths it doesn't serve alone.
+static void PTZHandleHTTPRequest(const ptz_http_request *request, ptz_http_response *response, void *context) {
+    AppDelegate *delegate = (__bridge AppDelegate *)context;
+    ptz_snapshot_handle_request(request, response, &delegate->_snapshotService);
+    ptz_stream_handle_request(request, response, &delegate->_stream);
 }
 
 @end
@@ -7,19 +7,29 @@
 
 #import <Foundation/Foundation.h>
 #import "jr_socket.h"
+#import "ptz_state.h"
+#import "ptz_profile.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
-#define FOCUS_MAX 0x100
-#define WB_MODE_COLOR 0x20
+#define FOCUS_MAX PTZ_FOCUS_MAX
+#define WB_MODE_COLOR PTZ_WB_MODE_COLOR
+
+// Called on main with at most one coalesced delta per engine tick.
+typedef void (^PTZStateObserver)(const ptz_state_delta *delta);
 
 @interface PTZCamera : NSObject
 
+// Presets are saved in user defaults under this key; "Scenes" unless it was created with another.
+- (instancetype)initWithScenesKey:(NSString *)scenesKey;
+@property (readonly, copy) NSString *scenesKey;
+
 // Protect from writes that aren't on main.
 @property (readonly) NSInteger tilt;
 @property (readonly) NSInteger pan;
 @property (readonly) NSUInteger zoom;
 @property (readonly) BOOL menuVisible;
+@property (readonly) NSUInteger menuItem;
 @property (readonly) BOOL autofocus;
 @property (readonly) NSUInteger focus;
 @property (readonly) NSUInteger presetSpeed;
@@ -50,6 +60,21 @@ NS_ASSUME_NONNULL_BEGIN
 @property (readonly) CGFloat focusPixelRadius;
 @property (readonly) NSUInteger colorTemp;
 
+// Timing, speeds and quirks, from the ptz_profile named by the "<scenesKey>-Profile" default, or else "CameraProfile":
+// a built-in name or a file path. "sim" if neither is set.
+@property (readonly, copy) NSString *profileName;
+@property (readonly) uint32_t quirks;   // PTZ_QUIRK_*
+// Samples of the profile's delays, in nanoseconds. Thread-safe.
+- (uint64_t)ackDelayForMessage:(int)messageType;
+- (uint64_t)completionDelayForMessage:(int)messageType;
+
+// Snapshot of all the observable values, for consumers that don't speak KVO.
+@property (readonly) ptz_camera_state cameraState;
+
+// State change feed. Returns a token for removeStateObserver:, or -1 if there are too many observers.
+- (NSInteger)addStateObserver:(PTZStateObserver)observer;
+- (void)removeStateObserver:(NSInteger)token;
+
 // Keep alive
 - (void)pingCamera:(jr_socket)clientSocket;
 
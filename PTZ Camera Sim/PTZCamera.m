@@ -10,16 +10,19 @@
 #import "PTZCamera.h"
 #import "AppDelegate.h"
 #import "jr_visca.h"
+#import "ptz_color.h"
 
-#define RANGE_MAX 0x200
+#define RANGE_MAX PTZ_RANGE_MAX
 #define RND_MASK 0xFF
-#define ZOOM_MAX 0x100
-#define PT_MAX 0x100
-#define PT_MIN -0x100
-#define RANGE_SHIFT (0x100)
+#define ZOOM_MAX PTZ_ZOOM_MAX
+#define PT_MAX PTZ_PT_MAX
+#define PT_MIN PTZ_PT_MIN
+#define RANGE_SHIFT PTZ_RANGE_SHIFT
 
 #define SPEED_MAX 24
 
+static void *PTZStateContext = &PTZStateContext;
+
 
 @interface NSDictionary (PTZ_Sim_Extras)
 - (NSInteger)sim_numberForKey:(NSString *)key ifNil:(NSInteger)value;
@@ -44,7 +47,22 @@
 @end
 
 
-@interface PTZCamera ()
+// The latest Pan_TiltDrive. The drive loop reads it every step, so a new one takes over at once.
+typedef struct PTZDrive {
+    NSUInteger panSpeed;
+    NSUInteger tiltSpeed;
+    NSInteger panDirection;
+    NSInteger tiltDirection;
+} PTZDrive;
+
+@interface PTZCamera () {
+    ptz_state_feed _stateFeed;
+    // Under @synchronized(self), with pantiltMoving and zoomMoving, which say a loop is running on _recallQueue.
+    PTZDrive _drive;
+    NSInteger _zoomStep;        // Zoom per step; positive is tele, 0 stops.
+    ptz_profile _profile;
+    uint64_t _profileRng;       // Under @synchronized(self).
+}
 @property (readwrite) NSInteger tilt;
 @property (readwrite) NSInteger pan;
 @property (readwrite) NSUInteger zoom;
@@ -60,6 +78,7 @@
 @property NSUInteger panSpeed;
 @property NSUInteger zoomSpeed;
 @property BOOL menuVisible;
+@property NSUInteger menuItem;
 @property BOOL autofocus;
 @property NSString *ipAddress;
 
@@ -112,8 +131,13 @@
 }
 
 - (instancetype)init {
+    return [self initWithScenesKey:@"Scenes"];
+}
+
+- (instancetype)initWithScenesKey:(NSString *)scenesKey {
     self = [super init];
     if (self) {
+        _scenesKey = [scenesKey copy];
         _pan = 0;//[[self class] randomPT];
         _tilt = 0;//[[self class] randomPT];
         _zoom = 0;
@@ -124,15 +148,173 @@
         _autofocus = YES;
         _presetSpeed = SPEED_MAX; // Real camera default
         _colorTempIndex = 0x37;
+        // A real camera's power-on picture settings, which the inquiries report until a controller changes them.
+        _rGain = PTZ_RGAIN_DEFAULT;
+        _bGain = PTZ_BGAIN_DEFAULT;
+        _colorgain = PTZ_COLOR_GAIN_DEFAULT;
+        _hue = PTZ_HUE_DEFAULT;
+        _brightness = PTZ_BRIGHTNESS_DEFAULT;
+        _contrast = PTZ_CONTRAST_DEFAULT;
+        _aperture = PTZ_APERTURE_DEFAULT;
+        _iris = PTZ_IRIS_DEFAULT;
+        _shutter = PTZ_SHUTTER_DEFAULT;
+        _brightPos = PTZ_BRIGHT_DEFAULT;
         _recallQueue = dispatch_queue_create("recallQueue", NULL);
-        NSDictionary *defaultScenes = [[NSUserDefaults standardUserDefaults] dictionaryForKey:@"Scenes"];
+        NSDictionary *defaultScenes = [[NSUserDefaults standardUserDefaults] dictionaryForKey:_scenesKey];
         if (defaultScenes) {
             _scenes = [NSMutableDictionary dictionaryWithDictionary:defaultScenes];
         }
+        [self loadProfile];
+        ptz_state_feed_init(&_stateFeed);
+        for (NSString *key in [[self class] stateKeyBits]) {
+            [self addObserver:self forKeyPath:key options:0 context:PTZStateContext];
+        }
     }
     return self;
 }
 
+- (void)dealloc {
+    for (NSString *key in [[self class] stateKeyBits]) {
+        [self removeObserver:self forKeyPath:key context:PTZStateContext];
+    }
+    for (NSInteger i = 0; i < PTZ_STATE_MAX_SUBSCRIBERS; i++) {
+        void *context = ptz_state_feed_unsubscribe(&_stateFeed, (int)i);
+        if (context) {
+            CFBridgingRelease(context);
+        }
+    }
+}
+
+#pragma mark profile
+
+- (void)loadProfile {
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    NSString *name = [defaults stringForKey:[_scenesKey stringByAppendingString:@"-Profile"]] ?: [defaults stringForKey:@"CameraProfile"];
+    if (ptz_profile_find(&_profile, name.fileSystemRepresentation) < 0) {
+        fprintf(stderr, "Couldn't load camera profile %s, using sim\n", name.UTF8String);
+        ptz_profile_builtin(&_profile, "sim");
+    }
+    _profileRng = ptz_profile_rng(&_profile);
+    fprintf(stdout, "%s: camera profile %s\n", _scenesKey.UTF8String, _profile.name);
+}
+
+- (NSString *)profileName {
+    return @(_profile.name);
+}
+
+- (uint32_t)quirks {
+    return _profile.quirks;
+}
+
+- (uint64_t)ackDelayForMessage:(int)messageType {
+    @synchronized (self) {
+        return ptz_profile_ack_ns(&_profile, messageType, &_profileRng);
+    }
+}
+
+- (uint64_t)completionDelayForMessage:(int)messageType {
+    @synchronized (self) {
+        return ptz_profile_completion_ns(&_profile, messageType, &_profileRng);
+    }
+}
+
+// One step of a move: pan, tilt and zoom loops all advance this often.
+- (void)sleepStep {
+    uint64_t ns = _profile.stepMs * NSEC_PER_MSEC;
+    nanosleep((const struct timespec[]){{(time_t)(ns / NSEC_PER_SEC), (long)(ns % NSEC_PER_SEC)}}, NULL);
+}
+
+// Position units a step at VISCA `speed`, from the profile's speed tables.
+- (NSInteger)panStep:(NSUInteger)speed {
+    return ptz_profile_pan_step(&_profile, (int)speed, _profile.stepMs * NSEC_PER_MSEC);
+}
+
+- (NSInteger)tiltStep:(NSUInteger)speed {
+    return ptz_profile_tilt_step(&_profile, (int)speed, _profile.stepMs * NSEC_PER_MSEC);
+}
+
+#pragma mark state feed
+
+// Stored properties that feed the state delta. Derived ones (pictureEffectMode, flipHOnOff...) are covered by their backing BOOLs.
++ (NSDictionary *)stateKeyBits {
+    static NSDictionary *keyBits;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        keyBits = @{@"pan":@(PTZ_STATE_PAN), @"tilt":@(PTZ_STATE_TILT), @"zoom":@(PTZ_STATE_ZOOM),
+                    @"focus":@(PTZ_STATE_FOCUS), @"autofocus":@(PTZ_STATE_AUTOFOCUS), @"menuVisible":@(PTZ_STATE_MENU_VISIBLE),
+                    @"wbMode":@(PTZ_STATE_WB_MODE), @"colorTempIndex":@(PTZ_STATE_COLOR_TEMP), @"bwMode":@(PTZ_STATE_BW_MODE),
+                    @"flipH":@(PTZ_STATE_FLIP_H), @"flipV":@(PTZ_STATE_FLIP_V), @"presetSpeed":@(PTZ_STATE_PRESET_SPEED),
+                    @"aeMode":@(PTZ_STATE_AE_MODE), @"aperture":@(PTZ_STATE_APERTURE), @"shutter":@(PTZ_STATE_SHUTTER),
+                    @"iris":@(PTZ_STATE_IRIS), @"brightPos":@(PTZ_STATE_BRIGHT_POS), @"brightness":@(PTZ_STATE_BRIGHTNESS),
+                    @"contrast":@(PTZ_STATE_CONTRAST), @"rGain":@(PTZ_STATE_RGAIN), @"bGain":@(PTZ_STATE_BGAIN),
+                    @"colorgain":@(PTZ_STATE_COLOR_GAIN), @"hue":@(PTZ_STATE_HUE), @"awbSens":@(PTZ_STATE_AWB_SENS),
+                    @"menuItem":@(PTZ_STATE_MENU_ITEM)};
+    });
+    return keyBits;
+}
+
+static void PTZStateObserverTrampoline(const ptz_state_delta *delta, void *context) {
+    PTZStateObserver observer = (__bridge PTZStateObserver)context;
+    observer(delta);
+}
+
+- (NSInteger)addStateObserver:(PTZStateObserver)observer {
+    void *context = (__bridge_retained void *)[observer copy];
+    int token = ptz_state_feed_subscribe(&_stateFeed, PTZStateObserverTrampoline, context);
+    if (token < 0) {
+        CFBridgingRelease(context);
+    }
+    return token;
+}
+
+- (void)removeStateObserver:(NSInteger)token {
+    void *context = ptz_state_feed_unsubscribe(&_stateFeed, (int)token);
+    if (context) {
+        CFBridgingRelease(context);
+    }
+}
+
+- (ptz_camera_state)cameraState {
+    ptz_camera_state state = {
+        .pan = (int32_t)_pan, .tilt = (int32_t)_tilt, .zoom = (uint32_t)_zoom, .focus = (uint32_t)_focus,
+        .autofocus = _autofocus, .menuVisible = _menuVisible, .bwMode = _bwMode, .flipH = _flipH, .flipV = _flipV,
+        .wbMode = (uint32_t)_wbMode, .colorTempIndex = (uint32_t)_colorTempIndex, .presetSpeed = (uint32_t)_presetSpeed,
+        .aeMode = (uint32_t)_aeMode, .aperture = (uint32_t)_aperture, .shutter = (uint32_t)_shutter, .iris = (uint32_t)_iris,
+        .brightPos = (uint32_t)_brightPos, .brightness = (uint32_t)_brightness, .contrast = (uint32_t)_contrast,
+        .rGain = (uint32_t)_rGain, .bGain = (uint32_t)_bGain, .colorgain = (uint32_t)_colorgain, .hue = (uint32_t)_hue,
+        .awbSens = (uint32_t)_awbSens, .menuItem = (uint32_t)_menuItem
+    };
+    return state;
+}
+
+// Every write in a motion tick happens inside one main-queue block, so the publish we queue here runs after the whole tick.
+- (void)markStateDirty:(uint32_t)dirty {
+    if (![NSThread isMainThread]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self markStateDirty:dirty];
+        });
+        return;
+    }
+    if (ptz_state_feed_mark(&_stateFeed, dirty)) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            ptz_camera_state state = self.cameraState;
+            ptz_state_feed_publish(&self->_stateFeed, &state);
+        });
+    }
+}
+
+- (void)observeValueForKeyPath:(NSString *)keyPath
+                      ofObject:(id)object
+                        change:(NSDictionary *)change
+                       context:(void *)context
+{
+    if (context != PTZStateContext) {
+        [super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
+        return;
+    }
+    [self markStateDirty:(uint32_t)[[[self class] stateKeyBits][keyPath] unsignedIntValue]];
+}
+
 - (void)setSocketFD:(int)socketFD {
     dispatch_async(dispatch_get_main_queue(), ^{
         self.ipAddress = [self localHostFromSocket4:socketFD];
@@ -249,7 +431,7 @@
 
 - (void)writeScenesToDefaults {
     if (self.scenes != nil) {
-        [[NSUserDefaults standardUserDefaults] setObject:self.scenes forKey:@"Scenes"];
+        [[NSUserDefaults standardUserDefaults] setObject:self.scenes forKey:self.scenesKey];
     }
 }
 
@@ -269,8 +451,9 @@
 }
 
 // PTZOptics cameras don't return "Completion" if there's no scene to recall. This may be a bug but strictRecallMode will let us find a workaround.
+// It's PTZ_QUIRK_STRICT_RECALL in the profile; the StrictRecallMode default still turns it on for any profile.
 - (BOOL)strictRecallMode {
-    return [[NSUserDefaults standardUserDefaults] boolForKey:@"StrictRecallMode"];
+    return (_profile.quirks & PTZ_QUIRK_STRICT_RECALL) || [[NSUserDefaults standardUserDefaults] boolForKey:@"StrictRecallMode"];
 }
 
 - (NSDictionary *)getRecallAtIndex:(NSInteger)index {
@@ -310,48 +493,65 @@
 - (void)absoluteZoom:(NSUInteger)newZoom {
     dispatch_async(dispatch_get_main_queue(), ^{
         self.zoom = MAX(0, MIN(newZoom, ZOOM_MAX));
-        [(AppDelegate *)[NSApp delegate] writeCameraSnapshot];
     });
 }
 
-- (void)startZoomIn:(NSUInteger)delta {
-    if (self.zoomMoving) {
-        return;
+// Zoom drives replace each other: the running loop reads the step each time, so only the latest counts.
+- (void)startZoomStep:(NSInteger)step {
+    @synchronized (self) {
+        _zoomStep = step;
+        if (self.zoomMoving || step == 0) {
+            return;
+        }
+        self.zoomMoving = YES;
     }
-    self.zoomMoving = YES;
     dispatch_async(_recallQueue, ^{
-        while (self.zoomMoving && self.zoom < ZOOM_MAX) {
-            nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
-            dispatch_sync(dispatch_get_main_queue(), ^{
-                [self zoomIn:delta];
-                [(AppDelegate *)[NSApp delegate] writeCameraSnapshot];
-            });
-        }
-        self.zoomMoving = NO;
+        [self runZoom];
     });
 }
 
-- (void)startZoomOut:(NSUInteger)delta {
-    if (self.zoomMoving) {
-        return;
-    }
-    self.zoomMoving = YES;
-    dispatch_async(_recallQueue, ^{
-        while (self.zoomMoving && self.zoom > 0) {
-            nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
-            dispatch_async(dispatch_get_main_queue(), ^{
-                [self zoomOut:delta];
-                [(AppDelegate *)[NSApp delegate] writeCameraSnapshot];
-            });
+// On _recallQueue: steps zoom every profile step until it's stopped or reaches the end it's heading for.
+- (void)runZoom {
+    for (;;) {
+        [self sleepStep];
+        NSInteger step;
+        @synchronized (self) {
+            step = _zoomStep;
+            if (step == 0) {
+                self.zoomMoving = NO;
+                return;
+            }
         }
-        self.zoomMoving = NO;
-    });
+        __block BOOL atEnd;
+        dispatch_sync(dispatch_get_main_queue(), ^{
+            if (step > 0) {
+                [self zoomIn:step];
+                atEnd = self.zoom >= ZOOM_MAX;
+            } else {
+                [self zoomOut:-step];
+                atEnd = self.zoom == 0;
+            }
+        });
+        @synchronized (self) {
+            // Unless it was turned around while we were at it.
+            if (atEnd && _zoomStep == step) {
+                self.zoomMoving = NO;
+                return;
+            }
+        }
+    }
+}
+
+- (void)startZoomIn:(NSUInteger)delta {
+    [self startZoomStep:(NSInteger)delta];
+}
+
+- (void)startZoomOut:(NSUInteger)delta {
+    [self startZoomStep:-(NSInteger)delta];
 }
 
 - (void)zoomStop {
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.zoomMoving = NO;
-    });
+    [self startZoomStep:0];
 }
 
 - (void)safeSetNumber:(NSInteger)value forKey:(NSString *)key {
@@ -365,7 +565,10 @@
 }
 
 - (NSUInteger)pictureEffectMode {
-    return self.bwMode ? JR_VISCA_PICTURE_FX_MODE_BW : JR_VISCA_PICTURE_FX_MODE_OFF_REPLY;
+    if (self.bwMode) {
+        return JR_VISCA_PICTURE_FX_MODE_BW;
+    }
+    return (_profile.quirks & PTZ_QUIRK_FX_OFF_REPLY) ? JR_VISCA_PICTURE_FX_MODE_OFF_REPLY : JR_VISCA_PICTURE_FX_MODE_OFF;
 }
 
 - (void)setFlipHOnOff:(NSUInteger)flip {
@@ -405,7 +608,6 @@
 - (void)toggleMenu {
     dispatch_async(dispatch_get_main_queue(), ^{
         self.menuVisible = !self.menuVisible;
-        [(AppDelegate *)[NSApp delegate] writeCameraSnapshot];
     });
 }
 
@@ -437,19 +639,31 @@
             break;
     }
 
+    // Up and down do move the cursor, though; it's drawn on the OSD in snapshots and streams.
     switch (tiltDirection) {
         case JR_VISCA_TILT_DIRECTION_DOWN:
             fprintf(stdout, "  Menu Down\n");
+            dispatch_async(dispatch_get_main_queue(), ^{
+                self.menuItem = (self.menuItem + 1) % PTZ_MENU_ITEMS;
+            });
             break;
         case JR_VISCA_TILT_DIRECTION_UP:
             fprintf(stdout, "  Menu Up\n");
+            dispatch_async(dispatch_get_main_queue(), ^{
+                self.menuItem = (self.menuItem + PTZ_MENU_ITEMS - 1) % PTZ_MENU_ITEMS;
+            });
             break;
         case JR_VISCA_TILT_DIRECTION_STOP:
             break;
     }
 }
 
-// Start moving and keep on until "stop".
+static BOOL PTZDriveStopped(PTZDrive drive) {
+    return drive.panDirection == JR_VISCA_PAN_DIRECTION_STOP && drive.tiltDirection == JR_VISCA_TILT_DIRECTION_STOP;
+}
+
+// Start moving and keep on until "stop". A drive while already moving just changes speed and direction,
+// so the latest stick position always wins, however fast they come.
 - (void)startPanSpeed:(NSUInteger)panS tiltSpeed:(NSUInteger)tiltS panDirection:(NSInteger)panDirection tiltDirection:(NSInteger)tiltDirection onDone:(dispatch_block_t)doneBlock {
     if (doneBlock) {
         doneBlock();
@@ -458,95 +672,119 @@
         [self navigateMenuPanDirection:panDirection tiltDirection:tiltDirection];
         return;
     }
-    if (self.pantiltMoving) {
-        if (panDirection == JR_VISCA_PAN_DIRECTION_STOP && tiltDirection == JR_VISCA_TILT_DIRECTION_STOP) {
-            self.pantiltMoving = NO;
+    @synchronized (self) {
+        _drive = (PTZDrive){ panS, tiltS, panDirection, tiltDirection };
+        if (self.pantiltMoving || PTZDriveStopped(_drive)) {
+            return;
         }
-        return;
+        self.pantiltMoving = YES;
     }
     dispatch_async(_recallQueue, ^{
-        NSInteger pan = self.pan;
-        NSInteger tilt = self.tilt;
-        self.pantiltMoving = YES;
-        BOOL moving = YES;
-        while (self.pantiltMoving && moving) {
-            nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
-            switch (panDirection) {
-                case JR_VISCA_PAN_DIRECTION_LEFT:
-                    pan -= panS;
-                    break;
-                case JR_VISCA_PAN_DIRECTION_RIGHT:
-                    pan += panS;
-                    break;
-                case JR_VISCA_PAN_DIRECTION_STOP:
-                    break;
+        [self runDrive];
+    });
+}
+
+// On _recallQueue: steps pan and tilt every profile step by the latest drive, until it says stop or runs into the limits.
+- (void)runDrive {
+    NSInteger pan = self.pan;
+    NSInteger tilt = self.tilt;
+    for (;;) {
+        [self sleepStep];
+        PTZDrive drive;
+        @synchronized (self) {
+            drive = _drive;
+            if (PTZDriveStopped(drive)) {
+                self.pantiltMoving = NO;
+                return;
+            }
+        }
+        switch (drive.panDirection) {
+            case JR_VISCA_PAN_DIRECTION_LEFT:
+                pan -= [self panStep:drive.panSpeed];
+                break;
+            case JR_VISCA_PAN_DIRECTION_RIGHT:
+                pan += [self panStep:drive.panSpeed];
+                break;
+            case JR_VISCA_PAN_DIRECTION_STOP:
+                break;
+        }
+
+        switch (drive.tiltDirection) {
+            case JR_VISCA_TILT_DIRECTION_DOWN:
+                tilt -= [self tiltStep:drive.tiltSpeed];
+                break;
+            case JR_VISCA_TILT_DIRECTION_UP:
+                tilt += [self tiltStep:drive.tiltSpeed];
+                break;
+            case JR_VISCA_TILT_DIRECTION_STOP:
+                break;
+        }
+        pan = MAX(PT_MIN, MIN(pan, PT_MAX));
+        tilt = MAX(PT_MIN, MIN(tilt, PT_MAX));
+        dispatch_sync(dispatch_get_main_queue(), ^{
+            if (drive.panDirection != JR_VISCA_PAN_DIRECTION_STOP) {
+                self.pan = pan;
             }
-            
-            switch (tiltDirection) {
-                case JR_VISCA_TILT_DIRECTION_DOWN:
-                    tilt -= tiltS;
-                    break;
-                case JR_VISCA_TILT_DIRECTION_UP:
-                    tilt += tiltS;
-                    break;
-                case JR_VISCA_TILT_DIRECTION_STOP:
-                    break;
+            if (drive.tiltDirection != JR_VISCA_TILT_DIRECTION_STOP) {
+                self.tilt = tilt;
             }
-            dispatch_sync(dispatch_get_main_queue(), ^{
-                if (panDirection != JR_VISCA_PAN_DIRECTION_STOP) {
-                    self.pan = MAX(PT_MIN, MIN(pan, PT_MAX));
-                }
-                if (tiltDirection != JR_VISCA_TILT_DIRECTION_STOP) {
-                    self.tilt = MAX(PT_MIN, MIN(tilt, PT_MAX));
-                }
-                [(AppDelegate *)[NSApp delegate] writeCameraSnapshot];
-                fprintf(stdout, "pan %ld, tilt %ld\n", (long)self.pan, (long)self.tilt);
-            });
-            if (tiltS == 0) {
-                moving = labs(pan) < PT_MAX;
-            } else if (panS == 0) {
-                moving = labs(tilt) < PT_MAX;
-            } else {
-                moving = labs(pan) < PT_MAX && labs(tilt) < PT_MAX;
+            fprintf(stdout, "pan %ld, tilt %ld\n", (long)self.pan, (long)self.tilt);
+        });
+        BOOL moving;
+        if (drive.tiltSpeed == 0) {
+            moving = labs(pan) < PT_MAX;
+        } else if (drive.panSpeed == 0) {
+            moving = labs(tilt) < PT_MAX;
+        } else {
+            moving = labs(pan) < PT_MAX && labs(tilt) < PT_MAX;
+        }
+        @synchronized (self) {
+            // A new drive may be heading back out of the limit it just hit.
+            if (!moving && memcmp(&drive, &_drive, sizeof(drive)) == 0) {
+                self.pantiltMoving = NO;
+                return;
             }
         }
-        self.pantiltMoving = NO;
-    });
+    }
 }
 // relative looks like absolute but with deltaPan and deltaTilt
 - (void)relativePanSpeed:(NSUInteger)panS tiltSpeed:(NSUInteger)tiltS pan:(NSInteger)deltaPan tilt:(NSInteger)deltaTilt onDone:(dispatch_block_t)doneBlock {
     dispatch_sync(dispatch_get_main_queue(), ^{
         self.pan += deltaPan;
         self.tilt += deltaTilt;
-        [(AppDelegate *)[NSApp delegate] writeCameraSnapshot];
     });
+    if (doneBlock) {
+        doneBlock();
+    }
 }
 
 - (void)absolutePanSpeed:(NSUInteger)panS tiltSpeed:(NSUInteger)tiltS pan:(NSInteger)targetPan tilt:(NSInteger)targetTilt onDone:(dispatch_block_t)doneBlock {
     panS = MAX(1, MIN(panS, 0x18));
     tiltS = MAX(1, MIN(tiltS, 0x14));
     fprintf(stdout, "pan %ld -> %ld at %lu, tilt %ld -> %ld at %lu\n", (long)self.pan, (long)targetPan, (unsigned long)panS, (long)self.tilt, (long)targetTilt, (unsigned long)tiltS);
+    NSInteger panStep = [self panStep:panS];
+    NSInteger tiltStep = [self tiltStep:tiltS];
     dispatch_async(_recallQueue, ^{
         self.commandRunning = YES;
         do {
             dispatch_sync(dispatch_get_main_queue(), ^{
-                nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
+                [self sleepStep];
                 NSInteger dPan = targetPan - self.pan;
                 NSInteger dTilt = targetTilt - self.tilt;
 
-                if (labs(dPan) <= panS) {
+                if (labs(dPan) <= panStep) {
                     self.pan = targetPan;
                 } else if (dPan > 0) {
-                    self.pan += panS;
+                    self.pan += panStep;
                 } else {
-                    self.pan -= panS;
+                    self.pan -= panStep;
                 }
-                if (labs(dTilt) <= tiltS) {
+                if (labs(dTilt) <= tiltStep) {
                     self.tilt = targetTilt;
                 } else if (dTilt > 0) {
-                    self.tilt += tiltS;
+                    self.tilt += tiltStep;
                 } else {
-                    self.tilt -= tiltS;
+                    self.tilt -= tiltStep;
                 }
                // fprintf(stdout, "recall tilt %ld pan %ld", self.tilt, self.pan);
             });
@@ -583,25 +821,26 @@
 
 - (void)cameraReset:(dispatch_block_t)doneBlock {
     __block NSInteger targetPan = 0, targetTilt = 0;
+    NSInteger panStep = [self panStep:SPEED_MAX];
+    NSInteger tiltStep = [self tiltStep:SPEED_MAX];
     dispatch_block_t block = ^{
-        nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
+        [self sleepStep];
         NSInteger dPan = targetPan - self.pan;
         NSInteger dTilt = targetTilt - self.tilt;
-        NSUInteger speed = SPEED_MAX;
 
-        if (labs(dPan) <= speed) {
+        if (labs(dPan) <= panStep) {
             self.pan = targetPan;
         } else if (dPan > 0) {
-            self.pan += speed;
+            self.pan += panStep;
         } else {
-            self.pan -= speed;
+            self.pan -= panStep;
         }
-        if (labs(dTilt) <= speed) {
+        if (labs(dTilt) <= tiltStep) {
             self.tilt = targetTilt;
         } else if (dTilt > 0) {
-            self.tilt += speed;
+            self.tilt += tiltStep;
         } else {
-            self.tilt -= speed;
+            self.tilt -= tiltStep;
         }
        // fprintf(stdout, "recall tilt %ld pan %ld", self.tilt, self.pan);
     };
@@ -681,28 +920,30 @@
     NSInteger targetTilt = [scene[@"tilt"] integerValue];
     NSInteger targetZoom = [scene[@"zoom"] integerValue];
 
+    NSInteger panStep = [self panStep:speed];
+    NSInteger tiltStep = [self tiltStep:speed];
     dispatch_async(_recallQueue, ^{
         self.commandRunning = YES;
         do {
             dispatch_sync(dispatch_get_main_queue(), ^{
-                nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
+                [self sleepStep];
                 NSInteger dPan = targetPan - self.pan;
                 NSInteger dTilt = targetTilt - self.tilt;
                 NSInteger dZoom = targetZoom - self.zoom;
 
-                if (labs(dPan) <= speed) {
+                if (labs(dPan) <= panStep) {
                     self.pan = targetPan;
                 } else if (dPan > 0) {
-                    self.pan += speed;
+                    self.pan += panStep;
                 } else {
-                    self.pan -= speed;
+                    self.pan -= panStep;
                 }
-                if (labs(dTilt) <= speed) {
+                if (labs(dTilt) <= tiltStep) {
                     self.tilt = targetTilt;
                 } else if (dTilt > 0) {
-                    self.tilt += speed;
+                    self.tilt += tiltStep;
                 } else {
-                    self.tilt -= speed;
+                    self.tilt -= tiltStep;
                 }
                 if (labs(dZoom) <= speed) {
                     self.zoom = targetZoom;
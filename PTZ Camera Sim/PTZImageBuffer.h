@@ -0,0 +1,26 @@
+//
+//  PTZImageBuffer.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "ptz_render.h"
+#import "ptz_tiles.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Decodes `image` into sRGB RGBA. Returns NO if there's no bitmap to be had or the allocation failed.
+BOOL PTZImageBufferDecode(NSImage *image, ptz_image *buffer);
+
+// Cache key for the encoded pixels behind `image`, or 0 if there's no way to identify them without decoding.
+uint64_t PTZImageBufferSourceKey(NSImage *image);
+
+// ptz_tile_decoder for PTZ_TILE_FORMAT_JPEG containers, using ImageIO. `context` is unused.
+int PTZImageBufferDecodeTile(const uint8_t *data, size_t size, ptz_image *tile, void * _Nullable context);
+
+// Wraps `buffer` without copying; the buffer has to outlive the rep.
+NSBitmapImageRep * _Nullable PTZImageBufferBitmapRep(const ptz_image *buffer);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,96 @@
+//
+//  PTZImageBuffer.m
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#import <ImageIO/ImageIO.h>
+#import "PTZImageBuffer.h"
+#import "ptz_pyramid.h"
+
+static CGContextRef PTZImageBufferCreateContext(ptz_image *buffer, int width, int height) {
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    // Bitmap contexts store the top row first, which is what ptz_image wants.
+    CGContextRef context = CGBitmapContextCreate(buffer->pixels, width, height, 8, buffer->stride, colorSpace,
+                                                 kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+    CGColorSpaceRelease(colorSpace);
+    return context;
+}
+
+// Draws `cgImage` into `buffer`, which is already allocated at `width` x `height`.
+static BOOL PTZImageBufferDraw(CGImageRef cgImage, ptz_image *buffer, int width, int height) {
+    CGContextRef context = PTZImageBufferCreateContext(buffer, width, height);
+    if (context == NULL) {
+        return NO;
+    }
+    CGContextSetBlendMode(context, kCGBlendModeCopy);
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), cgImage);
+    CGContextRelease(context);
+    return YES;
+}
+
+BOOL PTZImageBufferDecode(NSImage *image, ptz_image *buffer) {
+    CGImageRef cgImage = [image CGImageForProposedRect:NULL context:nil hints:nil];
+    if (cgImage == NULL) {
+        return NO;
+    }
+    int width = (int)CGImageGetWidth(cgImage);
+    int height = (int)CGImageGetHeight(cgImage);
+    if (ptz_image_alloc(buffer, width, height) < 0) {
+        return NO;
+    }
+    return PTZImageBufferDraw(cgImage, buffer, width, height);
+}
+
+int PTZImageBufferDecodeTile(const uint8_t *data, size_t size, ptz_image *tile, void *context) {
+    CFDataRef tileData = CFDataCreateWithBytesNoCopy(kCFAllocatorDefault, data, (CFIndex)size, kCFAllocatorNull);
+    CGImageSourceRef source = CGImageSourceCreateWithData(tileData, NULL);
+    CFRelease(tileData);
+    if (source == NULL) {
+        return -1;
+    }
+    CGImageRef cgImage = CGImageSourceCreateImageAtIndex(source, 0, NULL);
+    CFRelease(source);
+    if (cgImage == NULL) {
+        return -1;
+    }
+    BOOL result = NO;
+    // Edge tiles are padded to full size when they're written, so anything else isn't ours.
+    if ((int)CGImageGetWidth(cgImage) == tile->width && (int)CGImageGetHeight(cgImage) == tile->height) {
+        result = PTZImageBufferDraw(cgImage, tile, tile->width, tile->height);
+    }
+    CGImageRelease(cgImage);
+    return result ? 0 : -1;
+}
+
+uint64_t PTZImageBufferSourceKey(NSImage *image) {
+    // Asset catalog images don't keep their encoded bytes around, so key on the compiled catalog they came from, plus the name.
+    NSString *name = image.name;
+    NSURL *url = [[NSBundle mainBundle] URLForResource:@"Assets" withExtension:@"car"];
+    if (name == nil || url == nil) {
+        return 0;
+    }
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:NULL];
+    if (data == nil) {
+        return 0;
+    }
+    const char *utf8 = name.UTF8String;
+    uint64_t key = ptz_pyramid_hash(utf8, strlen(utf8), 0);
+    return ptz_pyramid_hash(data.bytes, data.length, key);
+}
+
+NSBitmapImageRep *PTZImageBufferBitmapRep(const ptz_image *buffer) {
+    unsigned char *planes[1] = { buffer->pixels };
+    NSBitmapImageRep *rep = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:planes
+                                                                     pixelsWide:buffer->width
+                                                                     pixelsHigh:buffer->height
+                                                                  bitsPerSample:8
+                                                                samplesPerPixel:4
+                                                                       hasAlpha:YES
+                                                                       isPlanar:NO
+                                                                 colorSpaceName:NSDeviceRGBColorSpace
+                                                                    bytesPerRow:buffer->stride
+                                                                   bitsPerPixel:32];
+    return [rep bitmapImageRepByRetaggingWithColorSpace:[NSColorSpace sRGBColorSpace]];
+}
@@ -8,8 +8,24 @@
 #ifndef camera_handler_h
 #define camera_handler_h
 
+#import <Foundation/Foundation.h>
+
 @class PTZCamera;
 
-int handle_camera(PTZCamera *camera);
+// Cameras one connection can address, like a serial daisy chain: VISCA addresses 1-7.
+#define CAMERA_CHAIN_MAX 7
+
+/**
+ * Serves one controller connection for `cameras`. With one camera it's a VISCA over IP camera that answers to
+ * any address; with more, frames go to the camera at their receiver address, or to all of them for broadcasts,
+ * and Address Set renumbers the chain.
+ */
+int handle_camera(NSArray<PTZCamera *> *cameras);
+
+/**
+ * Like handle_camera, but for a controller on this host connecting through the shared memory segment `name`
+ * (see jr_shm.h) instead of TCP.
+ */
+int handle_camera_shared_memory(NSArray<PTZCamera *> *cameras, const char *name);
 
 #endif /* camera_handler_h */
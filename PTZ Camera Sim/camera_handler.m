@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "jr_socket.h"
+#include "jr_shm.h"
 
 #include "jr_hex_print.h"
 #include "jr_visca.h"
@@ -7,17 +8,37 @@
 #include <stdlib.h>
 #include <dispatch/dispatch.h>
 #include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "PTZCamera.h"
+#include "ptz_notify.h"
+#include "ptz_coalesce.h"
 
 #define IP_CAMERA_NUMBER 1
+#define BROADCAST_ADDRESS 8
 
-void sendMessage(int messageType, union jr_viscaMessageParameters parameters, jr_socket socket) {
+// Where a reply goes: the connection, and the address of the camera in the chain that's answering.
+// Address 0 sends nothing; that's a camera acting on a broadcast, which it doesn't answer.
+// A Completion waits `completionDelay` nanoseconds, from the camera's profile, in `pending`.
+typedef struct visca_reply {
+    jr_socket socket;
+    uint8_t address;
+    uint64_t completionDelay;
+    dispatch_group_t pending;
+} visca_reply;
+
+static pthread_mutex_t sendLock = PTHREAD_MUTEX_INITIALIZER;
+
+void sendMessage(int messageType, union jr_viscaMessageParameters parameters, visca_reply reply) {
     uint8_t resultData[18];
     /* First byte of Address Set (Camera Num) and IPClear(Broadcast) is 0x88
      X = 1 to 7: Address of the unit (Locked to “X = 1” for VISCA over IP)
      Y = 9 to F: Address of the unit +8 (Locked to “Y = 9” for VISCA over IP)
      */
-    uint8_t sender = (messageType == JR_VISCA_MESSAGE_CAMERA_NUMBER) ? 0 : IP_CAMERA_NUMBER;
+    if (reply.address == 0 && messageType != JR_VISCA_MESSAGE_CAMERA_NUMBER) {
+        return;
+    }
+    uint8_t sender = (messageType == JR_VISCA_MESSAGE_CAMERA_NUMBER) ? 0 : reply.address;
     uint8_t receiver = (messageType == JR_VISCA_MESSAGE_CAMERA_NUMBER) ? 8 : 0;
     int dataLength = jr_viscaEncodeMessage(resultData, sizeof(resultData), messageType, parameters, sender, receiver);
     if (dataLength < 0) {
@@ -30,41 +51,150 @@ void sendMessage(int messageType, union jr_viscaMessageParameters parameters, jr
      printf("\n");
 #endif
 
-    if (jr_socket_send(socket, (char*)resultData, dataLength) == -1) {
+    if (messageType == JR_VISCA_MESSAGE_COMPLETION && reply.completionDelay && reply.pending) {
+        NSData *data = [NSData dataWithBytes:resultData length:dataLength];
+        jr_socket socket = reply.socket;
+        dispatch_group_t pending = reply.pending;
+        dispatch_group_enter(pending);
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)reply.completionDelay),
+                       dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            pthread_mutex_lock(&sendLock);
+            if (jr_socket_send(socket, (char *)data.bytes, (int)data.length) == -1) {
+                fprintf(stderr, "error sending response\n");
+            }
+            pthread_mutex_unlock(&sendLock);
+            dispatch_group_leave(pending);
+        });
+        return;
+    }
+
+    // Replies come from both command lanes and from the main queue, and a shared memory ring has one writer.
+    pthread_mutex_lock(&sendLock);
+    int result = jr_socket_send(reply.socket, (char*)resultData, dataLength);
+    pthread_mutex_unlock(&sendLock);
+    if (result == -1) {
         fprintf(stderr, "error sending response\n");
         return;
     }
 }
 
-void sendAckCompletion(uint8_t socketNumber, jr_socket socket) {
+void sendAckCompletion(uint8_t socketNumber, visca_reply reply) {
     union jr_viscaMessageParameters parameters;
     parameters.ackCompletionParameters.socketNumber = socketNumber;
-    sendMessage(JR_VISCA_MESSAGE_ACK, parameters, socket);
-    sendMessage(JR_VISCA_MESSAGE_COMPLETION, parameters, socket);
+    sendMessage(JR_VISCA_MESSAGE_ACK, parameters, reply);
+    sendMessage(JR_VISCA_MESSAGE_COMPLETION, parameters, reply);
 }
 
-void sendAck(uint8_t socketNumber, jr_socket socket) {
+void sendAck(uint8_t socketNumber, visca_reply reply) {
     union jr_viscaMessageParameters parameters;
     parameters.ackCompletionParameters.socketNumber = socketNumber;
-    sendMessage(JR_VISCA_MESSAGE_ACK, parameters, socket);
+    sendMessage(JR_VISCA_MESSAGE_ACK, parameters, reply);
 }
 
-void sendCompletion(uint8_t socketNumber, jr_socket socket) {
+void sendCompletion(uint8_t socketNumber, visca_reply reply) {
     union jr_viscaMessageParameters parameters;
     parameters.ackCompletionParameters.socketNumber = socketNumber;
-    sendMessage(JR_VISCA_MESSAGE_COMPLETION, parameters, socket);
+    sendMessage(JR_VISCA_MESSAGE_COMPLETION, parameters, reply);
 }
 
-void sendErrorReply(uint8_t socketNumber, jr_socket socket, uint8_t errorType) {
+void sendErrorReply(uint8_t socketNumber, visca_reply reply, uint8_t errorType) {
     union jr_viscaMessageParameters parameters;
     parameters.errorReplyParameters.socketNumber = socketNumber;
     parameters.errorReplyParameters.errorType = errorType;
-    sendMessage(JR_VISCA_MESSAGE_ERROR_REPLY, parameters, socket);
+    sendMessage(JR_VISCA_MESSAGE_ERROR_REPLY, parameters, reply);
+}
+
+// Pushes position notifications for one camera to one connection once it subscribes.
+// Main queue only, which is where state observers are called.
+@interface PTZPositionNotifier : NSObject
+- (instancetype)initWithCamera:(PTZCamera *)camera reply:(visca_reply)reply rate:(int)rate;
+- (void)stop;
+@end
+
+@implementation PTZPositionNotifier {
+    PTZCamera *_camera;
+    visca_reply _reply;
+    ptz_notify _notify;
+    NSInteger _observer;
+    BOOL _flushScheduled;
+}
+
+- (instancetype)initWithCamera:(PTZCamera *)camera reply:(visca_reply)reply rate:(int)rate {
+    self = [super init];
+    if (self) {
+        _camera = camera;
+        _reply = reply;
+        ptz_notify_subscribe(&_notify, rate);
+        __weak PTZPositionNotifier *weakSelf = self;
+        _observer = [camera addStateObserver:^(const ptz_state_delta *delta) {
+            if (delta->dirty & (PTZ_STATE_PAN | PTZ_STATE_TILT | PTZ_STATE_ZOOM | PTZ_STATE_FOCUS)) {
+                [weakSelf update:&delta->state];
+            }
+        }];
+        ptz_camera_state state = camera.cameraState;
+        [self update:&state];
+    }
+    return self;
+}
+
+- (void)update:(const ptz_camera_state *)state {
+    int32_t position[PTZ_FLEET_AXES] = { state->pan, state->tilt, (int32_t)state->zoom, (int32_t)state->focus };
+    ptz_notify_update(&_notify, position);
+    [self flush];
+}
+
+// Sends what's due now; anything held back by the rate goes out when it allows, unless something newer replaces it first.
+- (void)flush {
+    if (!ptz_notify_active(&_notify)) {
+        return;
+    }
+    uint64_t now = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    uint32_t groups = ptz_notify_take(&_notify, now);
+    union jr_viscaMessageParameters parameters;
+    if (groups & PTZ_NOTIFY_PAN_TILT) {
+        parameters.panTiltPositionInqResponseParameters.panPosition = _notify.latest[PTZ_FLEET_PAN];
+        parameters.panTiltPositionInqResponseParameters.tiltPosition = _notify.latest[PTZ_FLEET_TILT];
+        sendMessage(JR_VISCA_MESSAGE_PAN_TILT_NOTIFY, parameters, _reply);
+    }
+    if (groups & PTZ_NOTIFY_LENS) {
+        parameters.lensNotifyParameters.zoomPosition = _notify.latest[PTZ_FLEET_ZOOM];
+        parameters.lensNotifyParameters.focusPosition = _notify.latest[PTZ_FLEET_FOCUS];
+        sendMessage(JR_VISCA_MESSAGE_LENS_NOTIFY, parameters, _reply);
+    }
+    uint64_t next = ptz_notify_next(&_notify);
+    if (next != UINT64_MAX && !_flushScheduled) {
+        _flushScheduled = YES;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(next - now)), dispatch_get_main_queue(), ^{
+            self->_flushScheduled = NO;
+            [self flush];
+        });
+    }
+}
+
+- (void)stop {
+    if (_observer >= 0) {
+        [_camera removeStateObserver:_observer];
+        _observer = -1;
+    }
+    ptz_notify_subscribe(&_notify, 0);
+}
+
+@end
+
+// Starts, restarts or stops notifications for the camera in `slot`. Waits for the main queue, so once it
+// returns after a stop nothing more goes out on the connection.
+static void subscribe_notifications(PTZCamera *camera, visca_reply reply, int rate, PTZPositionNotifier *__strong *slot) {
+    dispatch_sync(dispatch_get_main_queue(), ^{
+        [*slot stop];
+        *slot = rate ? [[PTZPositionNotifier alloc] initWithCamera:camera reply:reply rate:rate] : nil;
+    });
 }
 
 #define SET_CAM_VALUE(_key, _value) [camera safeSetNumber:(_value) forKey:(_key)]
 
-int handle_camera(PTZCamera *camera) {
+static void handle_connection(NSArray<PTZCamera *> *cameras, jr_socket clientSocket);
+
+int handle_camera(NSArray<PTZCamera *> *cameras) {
     jr_server_socket serverSocket;
 
     if (jr_socket_setupServerSocket(5678, &serverSocket) == -1) {
@@ -78,10 +208,675 @@ int handle_camera(PTZCamera *camera) {
         return -2;
     }
     
-    [camera pingCamera:clientSocket];
+    [cameras.firstObject pingCamera:clientSocket];
 
-    [camera setSocketFD:serverSocket._serverSocket];
+    [cameras.firstObject setSocketFD:serverSocket._serverSocket];
     
+    handle_connection(cameras, clientSocket);
+    jr_socket_closeServerSocket(serverSocket);
+    return 0;
+}
+
+int handle_camera_shared_memory(NSArray<PTZCamera *> *cameras, const char *name) {
+    jr_shm_server server;
+
+    if (jr_shm_setupServer(name, &server) == -1) {
+        fprintf(stderr, "Setup failed\n");
+        return -1;
+    }
+
+    jr_socket clientSocket;
+    if (jr_shm_accept(server, &clientSocket) == -1) {
+        fprintf(stderr, "Accept failed");
+        jr_shm_closeServer(server);
+        return -2;
+    }
+
+    [cameras.firstObject pingCamera:clientSocket];
+
+    handle_connection(cameras, clientSocket);
+    jr_shm_closeServer(server);
+    return 0;
+}
+
+static void handle_message(PTZCamera *camera, visca_reply reply, int messageType, union jr_viscaMessageParameters messageParameters,
+                           char *frame, int frameLength, PTZPositionNotifier *__strong *notifier) {
+    union jr_viscaMessageParameters response;
+    switch (messageType)
+    {
+        case JR_VISCA_MESSAGE_NOTIFY_SUBSCRIBE: {
+            int rate = messageParameters.int16Parameters.int16Value;
+            fprintf(stdout, "Notify subscribe %d/s\n", rate);
+            if (reply.address) {
+                subscribe_notifications(camera, reply, rate, notifier);
+            }
+            sendAckCompletion(1, reply);
+            break;
+        }
+        case JR_VISCA_MESSAGE_PAN_TILT_POSITION_INQ: {
+            fprintf(stdout, "CAM_PanTiltPosInq\n");
+            response.panTiltPositionInqResponseParameters.panPosition = camera.pan;
+            response.panTiltPositionInqResponseParameters.tiltPosition = camera.tilt;
+            sendMessage(JR_VISCA_MESSAGE_PAN_TILT_POSITION_INQ_RESPONSE, response, reply);
+            break;
+        }
+        case JR_VISCA_MESSAGE_ZOOM_POSITION_INQ:
+            fprintf(stdout, "CAM_ZoomPosInq\n");
+            response.int16Parameters.int16Value = camera.zoom;
+            sendMessage(JR_VISCA_MESSAGE_ZOOM_POSITION_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_FOCUS_AUTOMATIC:
+            fprintf(stdout, "CAM_Focus Automatic\n");
+            [camera focusAutomatic];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_FOCUS_MANUAL:
+            fprintf(stdout, "CAM_Focus Manual\n");
+            [camera focusManual];
+            response.ackCompletionParameters.socketNumber = 1;
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_FOCUS_AF_MODE_INQ:
+            fprintf(stdout, "CAM_FocusAFModeInq\n");
+            response.oneByteParameters.byteValue = camera.autofocus ? JR_VISCA_AF_MODE_AUTO : JR_VISCA_AF_MODE_MANUAL;
+            sendMessage(JR_VISCA_MESSAGE_FOCUS_AF_MODE_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_FOCUS_VALUE_INQ:
+            fprintf(stdout, "CAM_FocusPosInq\n");
+            response.int16Parameters.int16Value = camera.focus;
+            sendMessage(JR_VISCA_MESSAGE_FOCUS_VALUE_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_BRIGHTNESS:
+            SET_CAM_VALUE(@"brightness", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_Brightness 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+       case JR_VISCA_MESSAGE_BRIGHTNESS_INQ:
+            fprintf(stdout, "CAM_BrightnessInq\n");
+            response.int16Parameters.int16Value = camera.brightness;
+            sendMessage(JR_VISCA_MESSAGE_BRIGHTNESS_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_CONTRAST:
+            SET_CAM_VALUE(@"contrast", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_Contrast 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_CONTRAST_INQ:
+            fprintf(stdout, "CAM_ContrastInq\n");
+            response.int16Parameters.int16Value = camera.contrast;
+            sendMessage(JR_VISCA_MESSAGE_CONTRAST_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_ZOOM_DIRECT:
+            fprintf(stdout, "CAM_Zoom Direct 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            [camera absoluteZoom:messageParameters.int16Parameters.int16Value];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_ZOOM_STOP:
+            fprintf(stdout, "CAM_Zoom Stop\n");
+            [camera zoomStop];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_ZOOM_TELE_STANDARD:
+            fprintf(stdout, "CAM_Zoom Tele(in) Standard\n");
+            [camera startZoomIn:1];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_ZOOM_WIDE_STANDARD:
+            fprintf(stdout, "CAM_Zoom Wide(out) Standard\n");
+            [camera startZoomOut:1];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_FOCUS_FAR_VARIABLE:
+            fprintf(stdout, "CAM_Focus Far 0x%hx\n", messageParameters.oneByteParameters.byteValue);
+            [camera relativeFocusFar:messageParameters.oneByteParameters.byteValue];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_FOCUS_NEAR_VARIABLE:
+            fprintf(stdout, "CAM_Focus Near 0x%hx\n", messageParameters.oneByteParameters.byteValue);
+            [camera relativeFocusNear:messageParameters.oneByteParameters.byteValue];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_FOCUS_STOP:
+            fprintf(stdout, "CAM_Focus Stop\n");
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_FOCUS_FAR_STANDARD:
+            fprintf(stdout, "CAM_Focus Far Standard\n");
+            [camera relativeFocusFar:1];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_FOCUS_NEAR_STANDARD:
+            fprintf(stdout, "CAM_Focus Near Standard\n");
+            [camera relativeFocusNear:1];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_ZOOM_TELE_VARIABLE:
+            fprintf(stdout, "CAM_Zoom Tele(in) 0x%hx\n", messageParameters.oneByteParameters.byteValue);
+            [camera startZoomIn:messageParameters.oneByteParameters.byteValue];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_ZOOM_WIDE_VARIABLE:
+            fprintf(stdout, "CAM_Zoom Wide(out) 0x%hx\n", messageParameters.oneByteParameters.byteValue);
+            [camera startZoomOut:messageParameters.oneByteParameters.byteValue];
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_PAN_TILT_DRIVE: {
+            fprintf(stdout, "Pan_TiltDrive: pan 0x%hx tilt 0x%hx", messageParameters.panTiltDriveParameters.panSpeed,
+                    messageParameters.panTiltDriveParameters.tiltSpeed);
+            switch (messageParameters.panTiltDriveParameters.panDirection) {
+                case JR_VISCA_PAN_DIRECTION_LEFT:
+                    fprintf(stdout, "left %d ", messageParameters.panTiltDriveParameters.panSpeed);
+                    break;
+                case JR_VISCA_PAN_DIRECTION_RIGHT:
+                    fprintf(stdout, "right  %d ", messageParameters.panTiltDriveParameters.panSpeed);
+                    break;
+                case JR_VISCA_PAN_DIRECTION_STOP:
+                    fprintf(stdout, "pan-stop ");
+                    break;
+            }
+            
+            switch (messageParameters.panTiltDriveParameters.tiltDirection) {
+                case JR_VISCA_TILT_DIRECTION_DOWN:
+                    fprintf(stdout, "down %d ", messageParameters.panTiltDriveParameters.tiltSpeed);
+                    break;
+                case JR_VISCA_TILT_DIRECTION_UP:
+                    fprintf(stdout, "up %d ", messageParameters.panTiltDriveParameters.tiltSpeed);
+                    break;
+                case JR_VISCA_TILT_DIRECTION_STOP:
+                    fprintf(stdout, "tilt-stop ");
+                    break;
+            }
+            fprintf(stdout, "\n");
+            sendAck(1, reply);
+            [camera startPanSpeed:messageParameters.panTiltDriveParameters.panSpeed
+                           tiltSpeed:messageParameters.panTiltDriveParameters.tiltSpeed
+                        panDirection:messageParameters.panTiltDriveParameters.panDirection
+                       tiltDirection:messageParameters.panTiltDriveParameters.tiltDirection
+                              onDone:^{sendCompletion(1, reply);}];
+            }
+            break;
+        case JR_VISCA_MESSAGE_CAMERA_NUMBER:
+            fprintf(stdout, "Camera Number Inq\n");
+            // The reply carries the next free address, for whatever is after us in the chain.
+            response.cameraNumberParameters.cameraNum = IP_CAMERA_NUMBER + 1;
+            sendMessage(JR_VISCA_MESSAGE_CAMERA_NUMBER, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_MEMORY:
+            if ((camera.quirks & PTZ_QUIRK_PRESET_95_MENU) && messageParameters.memoryParameters.memory == 95) {
+                // PTZOptics cameras: This is toggle menu. No really. That's what the doc says, that's how real cameras work. Hidden in the support website, it mentions that presets 90-99 are reserved.
+                // See JR_VISCA_MESSAGE_SONY_MENU_MODE
+                fprintf(stdout, "CAM_OSD Open/Close\n");
+                [camera toggleMenu];
+                sendAckCompletion(1, reply);
+                break;
+            }
+            switch (messageParameters.memoryParameters.mode) {
+                case JR_VISCA_MEMORY_MODE_SET:
+                    fprintf(stdout, "CAM_Memory Set %d ", messageParameters.memoryParameters.memory);
+                    sendAck(1, reply);
+                    [camera cameraSetAtIndex:messageParameters.memoryParameters.memory
+                                 onDone:^{sendCompletion(1, reply);}];
+                   break;
+                case JR_VISCA_MEMORY_MODE_RESET:
+                    fprintf(stdout, "CAM_Memory Reset %d ", messageParameters.memoryParameters.memory);
+                    sendAckCompletion(1, reply);
+                    break;
+                case JR_VISCA_MEMORY_MODE_RECALL:
+                    fprintf(stdout, "CAM_Memory Recall %d ", messageParameters.memoryParameters.memory);
+                    sendAck(1, reply);
+                    [camera recallAtIndex:messageParameters.memoryParameters.memory
+                                   onDone:^{sendCompletion(1, reply);}];
+                    break;
+            }
+            fprintf(stdout, "\n");
+            break;
+        case JR_VISCA_MESSAGE_CLEAR:
+            fprintf(stdout, "IF_Clear\n");
+            sendCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_MOTION_SYNC:
+            fprintf(stdout, "CAM_PTZMotionSync\n");
+            sendCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_HOME:
+            fprintf(stdout, "Pan_TiltDrive Home\n");
+            sendAck(1, reply);
+            [camera cameraHome:^{sendCompletion(1, reply);}];
+            break;
+        case JR_VISCA_MESSAGE_RESET:
+            fprintf(stdout, "Pan_TiltDrive Reset\n");
+            sendAck(1, reply);
+            [camera cameraReset:^{sendCompletion(1, reply);}];
+            break;
+        case JR_VISCA_MESSAGE_CANCEL:
+            fprintf(stdout, "Cancel\n");
+            sendAck(1, reply);
+            [camera cameraCancel:^{sendErrorReply(1, reply, JR_VISCA_ERROR_CANCELLED);}];
+            break;
+        case JR_VISCA_MESSAGE_MENU_ENTER:
+            fprintf(stdout, "CAM_OSD Enter\n");
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_MENU_RETURN:
+            fprintf(stdout, "CAM_OSD Return\n");
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_MENU_MODE_INQ:
+            fprintf(stdout, "SYS_MenuModeInq\n");
+            response.oneByteParameters.byteValue = BOOL_TO_ONOFF(camera.menuVisible);
+            sendMessage(JR_VISCA_MESSAGE_MENU_MODE_RESPONSE, response, reply);
+            break;
+            break;
+        case JR_VISCA_MESSAGE_PRESET_RECALL_SPEED:
+            SET_CAM_VALUE(@"presetSpeed", messageParameters.oneByteParameters   .byteValue);
+            hex_print(frame, frameLength);
+            fprintf(stdout, "Preset Recall Speed %hhu\n", messageParameters.oneByteParameters   .byteValue);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_ABSOLUTE_PAN_TILT:
+            sendAck(1, reply);
+            [camera absolutePanSpeed:messageParameters.absolutePanTiltPositionParameters.panSpeed
+                        tiltSpeed:messageParameters.absolutePanTiltPositionParameters.tiltSpeed
+                              pan:messageParameters.absolutePanTiltPositionParameters.panPosition
+                             tilt:messageParameters.absolutePanTiltPositionParameters.tiltPosition
+                           onDone:^{sendCompletion(1, reply);}];
+            hex_print(frame, frameLength);
+            fprintf(stdout, "Pan_TiltDrive AbsolutePosition\n");
+            break;
+        case JR_VISCA_MESSAGE_RELATIVE_PAN_TILT:
+            sendAck(1, reply);
+            [camera relativePanSpeed:messageParameters.absolutePanTiltPositionParameters.panSpeed
+                        tiltSpeed:messageParameters.absolutePanTiltPositionParameters.tiltSpeed
+                              pan:messageParameters.absolutePanTiltPositionParameters.panPosition
+                             tilt:messageParameters.absolutePanTiltPositionParameters.tiltPosition
+                           onDone:^{sendCompletion(1, reply);}];
+            hex_print(frame, frameLength);
+            fprintf(stdout, "Pan_TiltDrive RelativePosition\n");
+            break;
+        case JR_VISCA_MESSAGE_WB_MODE:
+            SET_CAM_VALUE(@"wbMode", messageParameters.oneByteParameters.byteValue);
+                fprintf(stdout, "CAM_WB %lu\n", (unsigned long)messageParameters.oneByteParameters.byteValue);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_WB_MODE_INQ:
+            fprintf(stdout, "CAM_WBModeInq\n");
+            response.oneByteParameters.byteValue = camera.wbMode;
+            sendMessage(JR_VISCA_MESSAGE_WB_MODE_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_COLOR_TEMP_DIRECT:
+            SET_CAM_VALUE(@"colorTempIndex", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_ColorTemp Direct 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_COLOR_TEMP_INQ:
+            fprintf(stdout, "CAM_ColorTempInq\n");
+            response.oneByteParameters.byteValue = camera.colorTempIndex;
+            sendMessage(JR_VISCA_MESSAGE_COLOR_TEMP_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_PICTURE_EFFECT:
+            SET_CAM_VALUE(@"pictureEffectMode", messageParameters.oneByteParameters.byteValue);
+            fprintf(stdout, "CAM_PictureEffect %lu\n", (unsigned long)messageParameters.oneByteParameters.byteValue);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_PICTURE_EFFECT_INQ:
+            fprintf(stdout, "CAM_PictureEffectModeInq\n");
+            response.oneByteParameters.byteValue = camera.pictureEffectMode;
+            sendMessage(JR_VISCA_MESSAGE_PICTURE_EFFECT_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_LR_REVERSE:
+            SET_CAM_VALUE(@"flipHOnOff", messageParameters.oneByteParameters.byteValue);
+            fprintf(stdout, "CAM_LR_Reverse %lu\n", (unsigned long)messageParameters.oneByteParameters.byteValue);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_LR_REVERSE_INQ:
+            fprintf(stdout, "CAM_LR_ReverseInq\n");
+            response.oneByteParameters.byteValue = camera.flipHOnOff;
+            sendMessage(JR_VISCA_MESSAGE_LR_REVERSE_RESPONSE, response, reply);
+            break;
+
+        case JR_VISCA_MESSAGE_PICTURE_FLIP:
+            SET_CAM_VALUE(@"flipVOnOff", messageParameters.oneByteParameters.byteValue);
+            fprintf(stdout, "CAM_PictureFlip %lu\n", (unsigned long)messageParameters.oneByteParameters.byteValue);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_PICTURE_FLIP_INQ:
+            fprintf(stdout, "CAM_PictureFlipInq\n");
+            response.oneByteParameters.byteValue = camera.flipVOnOff;
+            sendMessage(JR_VISCA_MESSAGE_PICTURE_FLIP_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_APERTURE_VALUE:
+            SET_CAM_VALUE(@"aperture", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_Aperture 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_APERTURE_VALUE_INQ:
+             fprintf(stdout, "CAM_ApertureInq \n");
+             response.int16Parameters.int16Value = camera.aperture;
+             sendMessage(JR_VISCA_MESSAGE_APERTURE_VALUE_RESPONSE, response, reply);
+             break;
+        case JR_VISCA_MESSAGE_BGAIN_VALUE:
+            SET_CAM_VALUE(@"bGain", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_BGain 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_BGAIN_VALUE_INQ:
+            fprintf(stdout, "CAM_BGainInq\n");
+            response.int16Parameters.int16Value = camera.bGain;
+            sendMessage(JR_VISCA_MESSAGE_BGAIN_VALUE_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_RGAIN_VALUE:
+            SET_CAM_VALUE(@"rGain", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_RGain 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_RGAIN_VALUE_INQ:
+            fprintf(stdout, "CAM_RGainInq\n");
+            response.int16Parameters.int16Value = camera.rGain;
+            sendMessage(JR_VISCA_MESSAGE_RGAIN_VALUE_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_COLOR_GAIN_DIRECT:
+            SET_CAM_VALUE(@"colorgain", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_ColorGain 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_COLOR_GAIN_INQ:
+            fprintf(stdout, "CAM_ColorGainInq\n");
+            response.int16Parameters.int16Value = camera.colorgain;
+            sendMessage(JR_VISCA_MESSAGE_COLOR_GAIN_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_COLOR_HUE_DIRECT:
+            SET_CAM_VALUE(@"hue", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_ColorHue 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_COLOR_HUE_INQ:
+            fprintf(stdout, "CAM_ColorHueInq\n");
+            response.int16Parameters.int16Value = camera.hue;
+            sendMessage(JR_VISCA_MESSAGE_COLOR_HUE_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_AWB_SENS:
+            fprintf(stdout, "CAM_AWBSensitivity %d\n",  messageParameters.oneByteParameters.byteValue);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_AWB_SENS_INQ:
+            fprintf(stdout, "CAM_AWBSensitivityInq\n");
+            response.oneByteParameters.byteValue = camera.awbSens;
+            sendMessage(JR_VISCA_MESSAGE_AWB_SENS_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_AE_MODE:
+            SET_CAM_VALUE(@"aeMode", messageParameters.oneByteParameters.byteValue);
+                fprintf(stdout, "CAM_AE %lu\n", (unsigned long)messageParameters.oneByteParameters.byteValue);
+            sendAckCompletion(1, reply);
+            break;
+       case JR_VISCA_MESSAGE_AE_MODE_INQ:
+            fprintf(stdout, "CAM_AEModeInq\n");
+            response.oneByteParameters.byteValue = camera.aeMode;
+            sendMessage(JR_VISCA_MESSAGE_AE_MODE_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_SHUTTER_VALUE:
+            SET_CAM_VALUE(@"shutter", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_Shutter 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+       case JR_VISCA_MESSAGE_SHUTTER_POS_INQ:
+            response.int16Parameters.int16Value = camera.shutter;
+            fprintf(stdout, "CAM_ShutterPosInq\n");
+            sendMessage(JR_VISCA_MESSAGE_SHUTTER_POS_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_IRIS_VALUE:
+            SET_CAM_VALUE(@"iris", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_Iris 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_IRIS_POS_INQ:
+            fprintf(stdout, "CAM_IrisPosInq\n");
+            response.int16Parameters.int16Value = camera.iris;
+            sendMessage(JR_VISCA_MESSAGE_IRIS_POS_RESPONSE, response, reply);
+            break;
+        case JR_VISCA_MESSAGE_BRIGHT_DIRECT:
+            SET_CAM_VALUE(@"brightPos", messageParameters.int16Parameters.int16Value);
+            fprintf(stdout, "CAM_Bright Direct 0x%hx\n", messageParameters.int16Parameters.int16Value);
+            sendAckCompletion(1, reply);
+            break;
+        case JR_VISCA_MESSAGE_BRIGHT_POS_INQ:
+             fprintf(stdout, "CAM_BrightPosInq\n");
+             response.int16Parameters.int16Value = camera.brightPos;
+             sendMessage(JR_VISCA_MESSAGE_BRIGHT_POS_RESPONSE, response, reply);
+             break;
+
+        default:
+            {
+            BOOL unknown = messageType < 0;
+            fprintf(stdout, "%s: (0x%X) ", (unknown ? "unknown" : "unhandled"), messageType);
+            hex_print(frame, frameLength);
+#if 0
+            fprintf(stdout, " ErrorReply\n");
+            sendAck(1, reply);
+            [camera cameraCancel:^{sendErrorReply(1, reply, unknown ? JR_VISCA_ERROR_SYNTAX : JR_VISCA_ERROR_NOT_EXECUTABLE);}];
+#else
+            fprintf(stdout, " Ignored\n");
+            sendAckCompletion(1, reply);
+#endif
+            }
+            break;
+    }
+}
+
+// A decoded frame, waiting in a receive batch and then in a lane. `bytes` is the raw frame, for logging.
+typedef struct visca_frame {
+    int messageType;
+    union jr_viscaMessageParameters parameters;
+    uint8_t receiver;
+    BOOL superseded;
+    int length;
+    char bytes[JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH];
+} visca_frame;
+
+// The shortest frame is 3 bytes, 8x 2z FF, so this is every frame a full receive buffer can hold.
+#define VISCA_BATCH_MAX (1024 / 3)
+
+// Of the drives in one batch for the same camera only the newest is carried out; see ptz_coalesce.h.
+static void coalesce_drives(visca_frame *batch, int count, BOOL menuVisible, BOOL oneCamera) {
+    ptz_coalesce coalesce;
+    ptz_coalesce_init(&coalesce, menuVisible, oneCamera);
+    for (int i = count - 1; i >= 0; i--) {
+        batch[i].superseded = ptz_coalesce_superseded(&coalesce, batch[i].messageType, batch[i].receiver);
+    }
+}
+
+// Runs on the frame's lane, so the camera's ACK delay holds up the frames behind it, as it would on a real one.
+static void deliver(PTZCamera *camera, visca_reply reply, const visca_frame *frame, PTZPositionNotifier *__strong *notifier) {
+    uint64_t ackDelay = [camera ackDelayForMessage:frame->messageType];
+    if (ackDelay) {
+        nanosleep((const struct timespec[]){{(time_t)(ackDelay / NSEC_PER_SEC), (long)(ackDelay % NSEC_PER_SEC)}}, NULL);
+    }
+    reply.completionDelay = [camera completionDelayForMessage:frame->messageType];
+    if (frame->superseded) {
+        sendAckCompletion(1, reply);
+        return;
+    }
+    handle_message(camera, reply, frame->messageType, frame->parameters, (char *)frame->bytes, frame->length, notifier);
+}
+
+/*
+ * Commands run on two serial queues per connection, so the socket thread only decodes and routes.
+ * Stops, Cancel and IF_Clear go in the express lane; everything else, inquiries and moves included, goes in the
+ * normal lane. However many inquiries a client floods us with, or however long a command waits on the main
+ * queue, a Stop only ever waits behind other Stops.
+ */
+typedef enum visca_lane_id {
+    VISCA_LANE_EXPRESS,
+    VISCA_LANE_NORMAL,
+    VISCA_LANES
+} visca_lane_id;
+
+typedef struct visca_lane {
+    const char *name;
+    int limit;                  // Frames waiting or running; past this they get ERROR_BUFFER_FULL.
+    dispatch_queue_t queue;
+    atomic_int depth;
+    atomic_ullong run;
+    atomic_ullong rejected;
+    atomic_ullong overtaken;    // Moves and drives a later Stop or Cancel got to first.
+} visca_lane;
+
+// What an express frame stops, and what a normal frame would start.
+#define VISCA_MOTION_PAN_TILT_DRIVE (1u << 0)
+#define VISCA_MOTION_ZOOM_DRIVE (1u << 1)
+#define VISCA_MOTION_MOVE (1u << 2)
+#define VISCA_MOTION_ALL (VISCA_MOTION_PAN_TILT_DRIVE | VISCA_MOTION_ZOOM_DRIVE | VISCA_MOTION_MOVE)
+#define VISCA_MOTIONS 3
+
+typedef struct visca_connection {
+    visca_lane lanes[VISCA_LANES];
+    dispatch_group_t pending;   // Completions waiting out their delay.
+    // Per chain camera and VISCA_MOTION_ bit, bumped as an express frame is routed. A normal frame that was
+    // routed before the bump was overtaken by it, and is answered as stopped instead of being run.
+    atomic_uint stops[CAMERA_CHAIN_MAX][VISCA_MOTIONS];
+} visca_connection;
+
+static BOOL drive_stops_both(const visca_frame *frame) {
+    return frame->parameters.panTiltDriveParameters.panDirection == JR_VISCA_PAN_DIRECTION_STOP
+        && frame->parameters.panTiltDriveParameters.tiltDirection == JR_VISCA_TILT_DIRECTION_STOP;
+}
+
+// VISCA_MOTION_ bits for what an express frame stops, or 0 if it goes in the normal lane.
+static uint32_t express_stops(const visca_frame *frame) {
+    switch (frame->messageType) {
+        case JR_VISCA_MESSAGE_CANCEL:
+        case JR_VISCA_MESSAGE_CLEAR:
+            return VISCA_MOTION_ALL;
+        case JR_VISCA_MESSAGE_ZOOM_STOP:
+            return VISCA_MOTION_ZOOM_DRIVE;
+        case JR_VISCA_MESSAGE_PAN_TILT_DRIVE:
+            return drive_stops_both(frame) ? VISCA_MOTION_PAN_TILT_DRIVE : 0;
+        default:
+            return 0;
+    }
+}
+
+// The VISCA_MOTION_ bit for what a normal frame starts, or 0 if it doesn't move anything.
+static uint32_t frame_motion(const visca_frame *frame) {
+    switch (frame->messageType) {
+        case JR_VISCA_MESSAGE_PAN_TILT_DRIVE:
+            return VISCA_MOTION_PAN_TILT_DRIVE;
+        case JR_VISCA_MESSAGE_ZOOM_TELE_STANDARD:
+        case JR_VISCA_MESSAGE_ZOOM_WIDE_STANDARD:
+        case JR_VISCA_MESSAGE_ZOOM_TELE_VARIABLE:
+        case JR_VISCA_MESSAGE_ZOOM_WIDE_VARIABLE:
+            return VISCA_MOTION_ZOOM_DRIVE;
+        case JR_VISCA_MESSAGE_ABSOLUTE_PAN_TILT:
+        case JR_VISCA_MESSAGE_RELATIVE_PAN_TILT:
+        case JR_VISCA_MESSAGE_HOME:
+        case JR_VISCA_MESSAGE_RESET:
+        case JR_VISCA_MESSAGE_ZOOM_DIRECT:
+            return VISCA_MOTION_MOVE;
+        case JR_VISCA_MESSAGE_MEMORY:
+            return frame->parameters.memoryParameters.mode == JR_VISCA_MEMORY_MODE_RECALL ? VISCA_MOTION_MOVE : 0;
+        default:
+            return 0;
+    }
+}
+
+static int motion_index(uint32_t motion) {
+    return motion == VISCA_MOTION_PAN_TILT_DRIVE ? 0 : motion == VISCA_MOTION_ZOOM_DRIVE ? 1 : 2;
+}
+
+static void start_lane(visca_lane *lane, const char *name, int limit) {
+    lane->name = name;
+    lane->limit = limit;
+    lane->queue = dispatch_queue_create(name, DISPATCH_QUEUE_SERIAL);
+    atomic_init(&lane->depth, 0);
+    atomic_init(&lane->run, 0);
+    atomic_init(&lane->rejected, 0);
+    atomic_init(&lane->overtaken, 0);
+}
+
+static void start_lanes(visca_connection *connection) {
+    start_lane(&connection->lanes[VISCA_LANE_EXPRESS], "express", 16);
+    start_lane(&connection->lanes[VISCA_LANE_NORMAL], "normal", 64);
+    connection->pending = dispatch_group_create();
+    for (int i = 0; i < CAMERA_CHAIN_MAX; i++) {
+        for (int m = 0; m < VISCA_MOTIONS; m++) {
+            atomic_init(&connection->stops[i][m], 0);
+        }
+    }
+}
+
+// Waits for whatever is still queued, and for delayed Completions, so nothing runs once the connection has gone.
+static void stop_lanes(visca_connection *connection) {
+    for (int l = 0; l < VISCA_LANES; l++) {
+        visca_lane *lane = &connection->lanes[l];
+        dispatch_sync(lane->queue, ^{});
+        fprintf(stdout, "%s lane: %llu run, %llu rejected, %llu overtaken\n", lane->name,
+                (unsigned long long)atomic_load(&lane->run), (unsigned long long)atomic_load(&lane->rejected),
+                (unsigned long long)atomic_load(&lane->overtaken));
+        lane->queue = nil;
+    }
+    dispatch_group_wait(connection->pending, DISPATCH_TIME_FOREVER);
+    connection->pending = nil;
+}
+
+// Puts `frame` in its lane for the camera at `index` in the chain.
+static void enqueue(visca_connection *connection, int index, PTZCamera *camera, visca_reply reply, const visca_frame *frame,
+                    PTZPositionNotifier *__strong *notifier) {
+    uint32_t stops = express_stops(frame);
+    visca_lane *lane = &connection->lanes[stops ? VISCA_LANE_EXPRESS : VISCA_LANE_NORMAL];
+    reply.pending = connection->pending;
+    if (atomic_fetch_add(&lane->depth, 1) >= lane->limit) {
+        atomic_fetch_sub(&lane->depth, 1);
+        atomic_fetch_add(&lane->rejected, 1);
+        sendErrorReply(1, reply, JR_VISCA_ERROR_BUFFER_FULL);
+        return;
+    }
+    visca_frame copy = *frame;
+    if (stops) {
+        for (uint32_t m = 0; m < VISCA_MOTIONS; m++) {
+            if (stops & (1u << m)) {
+                atomic_fetch_add(&connection->stops[index][m], 1);
+            }
+        }
+        dispatch_async(lane->queue, ^{
+            deliver(camera, reply, &copy, notifier);
+            atomic_fetch_add(&lane->run, 1);
+            atomic_fetch_sub(&lane->depth, 1);
+        });
+        return;
+    }
+    uint32_t motion = frame_motion(frame);
+    // Cancel and IF_Clear bump all of them, so this is the only count a frame has to watch.
+    uint32_t seen = motion ? atomic_load(&connection->stops[index][motion_index(motion)]) : 0;
+    dispatch_async(lane->queue, ^{
+        if (motion && atomic_load(&connection->stops[index][motion_index(motion)]) != seen) {
+            // A drive has nothing left to do and says so; a move was cancelled before it started.
+            sendAck(1, reply);
+            if (motion == VISCA_MOTION_MOVE) {
+                sendErrorReply(1, reply, JR_VISCA_ERROR_CANCELLED);
+            } else {
+                sendCompletion(1, reply);
+            }
+            atomic_fetch_add(&lane->overtaken, 1);
+        } else {
+            deliver(camera, reply, &copy, notifier);
+            atomic_fetch_add(&lane->run, 1);
+        }
+        atomic_fetch_sub(&lane->depth, 1);
+    });
+}
+
+static void handle_connection(NSArray<PTZCamera *> *cameras, jr_socket clientSocket) {
+    // Until an Address Set says otherwise, the chain is numbered from 1.
+    PTZCamera *chain[CAMERA_CHAIN_MAX];
+    uint8_t addresses[CAMERA_CHAIN_MAX];
+    PTZPositionNotifier *notifiers[CAMERA_CHAIN_MAX] = { nil };
+    visca_connection connection;
+    start_lanes(&connection);
+    int chainLength = (int)MIN(cameras.count, CAMERA_CHAIN_MAX);
+    for (int i = 0; i < chainLength; i++) {
+        chain[i] = cameras[i];
+        addresses[i] = i + 1;
+    }
+
     fprintf(stdout, "ready\n");
     
     int count = 0;
@@ -89,453 +884,92 @@ int handle_camera(PTZCamera *camera) {
     
     ssize_t latestCount;
     while ((latestCount = jr_socket_receive(clientSocket, buffer + count, 1024 - count)) > 0) {
-        [camera pingCamera:clientSocket];
+        [chain[0] pingCamera:clientSocket];
         count += latestCount;
         // printf("recv: ");
         // hex_print(buffer, count);
         // printf("\n");
-        int consumed;
-        do {
-            int messageType;
-            union jr_viscaMessageParameters messageParameters;
+        // Decode everything that's arrived before acting on any of it, so drives can be coalesced.
+        visca_frame batch[VISCA_BATCH_MAX];
+        int batchCount = 0;
+        int offset = 0;
+        int consumed = 0;
+        while (batchCount < VISCA_BATCH_MAX) {
+            visca_frame *frame = &batch[batchCount];
             uint8_t sender;
-            uint8_t receiver;
-            consumed = jr_viscaDecodeMessage((uint8_t*)buffer, count, &messageType, &messageParameters, &sender, &receiver);
-            if (consumed < 0) {
-                fprintf(stderr, "error, bailing\n");
-                goto bailTCPLoop;
+            consumed = jr_viscaDecodeMessage((uint8_t*)buffer + offset, count - offset, &frame->messageType, &frame->parameters,
+                                             &sender, &frame->receiver);
+            if (consumed <= 0) {
+                break;
             }
-            
-            if (consumed) {
-                // printf("found %d-byte frame: ", consumed);
-                
+            frame->length = consumed;
+            frame->superseded = NO;
+            memcpy(frame->bytes, buffer + offset, MIN(consumed, (int)sizeof(frame->bytes)));
+            offset += consumed;
+            batchCount++;
+        }
+        BOOL menuVisible = NO;
+        for (int i = 0; i < chainLength; i++) {
+            menuVisible = menuVisible || chain[i].menuVisible;
+        }
+        coalesce_drives(batch, batchCount, menuVisible, chainLength == 1);
+
+        for (int f = 0; f < batchCount; f++) {
+            visca_frame *frame = &batch[f];
+            if (frame->messageType == JR_VISCA_MESSAGE_CAMERA_NUMBER && chainLength > 1) {
+                // Address Set: numbers the chain from the one it was sent, and the last camera passes on the next.
+                uint8_t next = frame->parameters.cameraNumberParameters.cameraNum;
+                fprintf(stdout, "Address Set %d\n", next);
+                for (int i = 0; i < chainLength; i++) {
+                    addresses[i] = (next >= 1 && next <= 7) ? next++ : 0;
+                }
                 union jr_viscaMessageParameters response;
-                switch (messageType)
-                {
-                    case JR_VISCA_MESSAGE_PAN_TILT_POSITION_INQ: {
-                        fprintf(stdout, "CAM_PanTiltPosInq\n");
-                        response.panTiltPositionInqResponseParameters.panPosition = camera.pan;
-                        response.panTiltPositionInqResponseParameters.tiltPosition = camera.tilt;
-                        sendMessage(JR_VISCA_MESSAGE_PAN_TILT_POSITION_INQ_RESPONSE, response, clientSocket);
-                        break;
-                    }
-                    case JR_VISCA_MESSAGE_ZOOM_POSITION_INQ:
-                        fprintf(stdout, "CAM_ZoomPosInq\n");
-                        response.int16Parameters.int16Value = camera.zoom;
-                        sendMessage(JR_VISCA_MESSAGE_ZOOM_POSITION_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_FOCUS_AUTOMATIC:
-                        fprintf(stdout, "CAM_Focus Automatic\n");
-                        [camera focusAutomatic];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_FOCUS_MANUAL:
-                        fprintf(stdout, "CAM_Focus Manual\n");
-                        [camera focusManual];
-                        response.ackCompletionParameters.socketNumber = 1;
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_FOCUS_AF_MODE_INQ:
-                        fprintf(stdout, "CAM_FocusAFModeInq\n");
-                        response.oneByteParameters.byteValue = camera.autofocus ? JR_VISCA_AF_MODE_AUTO : JR_VISCA_AF_MODE_MANUAL;
-                        sendMessage(JR_VISCA_MESSAGE_FOCUS_AF_MODE_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_FOCUS_VALUE_INQ:
-                        fprintf(stdout, "CAM_FocusPosInq\n");
-                        response.int16Parameters.int16Value = camera.focus;
-                        sendMessage(JR_VISCA_MESSAGE_FOCUS_VALUE_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_BRIGHTNESS:
-                        SET_CAM_VALUE(@"brightness", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_Brightness 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                   case JR_VISCA_MESSAGE_BRIGHTNESS_INQ:
-                        fprintf(stdout, "CAM_BrightnessInq\n");
-                        response.int16Parameters.int16Value = camera.brightness;
-                        sendMessage(JR_VISCA_MESSAGE_BRIGHTNESS_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_CONTRAST:
-                        SET_CAM_VALUE(@"contrast", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_Contrast 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_CONTRAST_INQ:
-                        fprintf(stdout, "CAM_ContrastInq\n");
-                        response.int16Parameters.int16Value = camera.contrast;
-                        sendMessage(JR_VISCA_MESSAGE_CONTRAST_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_ZOOM_DIRECT:
-                        fprintf(stdout, "CAM_Zoom Direct 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        [camera absoluteZoom:messageParameters.int16Parameters.int16Value];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_ZOOM_STOP:
-                        fprintf(stdout, "CAM_Zoom Stop\n");
-                        [camera zoomStop];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_ZOOM_TELE_STANDARD:
-                        fprintf(stdout, "CAM_Zoom Tele(in) Standard\n");
-                        [camera startZoomIn:1];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_ZOOM_WIDE_STANDARD:
-                        fprintf(stdout, "CAM_Zoom Wide(out) Standard\n");
-                        [camera startZoomOut:1];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_FOCUS_FAR_VARIABLE:
-                        fprintf(stdout, "CAM_Focus Far 0x%hx\n", messageParameters.oneByteParameters.byteValue);
-                        [camera relativeFocusFar:messageParameters.oneByteParameters.byteValue];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_FOCUS_NEAR_VARIABLE:
-                        fprintf(stdout, "CAM_Focus Near 0x%hx\n", messageParameters.oneByteParameters.byteValue);
-                        [camera relativeFocusNear:messageParameters.oneByteParameters.byteValue];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_FOCUS_STOP:
-                        fprintf(stdout, "CAM_Focus Stop\n");
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_FOCUS_FAR_STANDARD:
-                        fprintf(stdout, "CAM_Focus Far Standard\n");
-                        [camera relativeFocusFar:1];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_FOCUS_NEAR_STANDARD:
-                        fprintf(stdout, "CAM_Focus Near Standard\n");
-                        [camera relativeFocusNear:1];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_ZOOM_TELE_VARIABLE:
-                        fprintf(stdout, "CAM_Zoom Tele(in) 0x%hx\n", messageParameters.oneByteParameters.byteValue);
-                        [camera startZoomIn:messageParameters.oneByteParameters.byteValue];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_ZOOM_WIDE_VARIABLE:
-                        fprintf(stdout, "CAM_Zoom Wide(out) 0x%hx\n", messageParameters.oneByteParameters.byteValue);
-                        [camera startZoomOut:messageParameters.oneByteParameters.byteValue];
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_PAN_TILT_DRIVE: {
-                        fprintf(stdout, "Pan_TiltDrive: pan 0x%hx tilt 0x%hx", messageParameters.panTiltDriveParameters.panSpeed,
-                                messageParameters.panTiltDriveParameters.tiltSpeed);
-                        switch (messageParameters.panTiltDriveParameters.panDirection) {
-                            case JR_VISCA_PAN_DIRECTION_LEFT:
-                                fprintf(stdout, "left %d ", messageParameters.panTiltDriveParameters.panSpeed);
-                                break;
-                            case JR_VISCA_PAN_DIRECTION_RIGHT:
-                                fprintf(stdout, "right  %d ", messageParameters.panTiltDriveParameters.panSpeed);
-                                break;
-                            case JR_VISCA_PAN_DIRECTION_STOP:
-                                fprintf(stdout, "pan-stop ");
-                                break;
-                        }
-                        
-                        switch (messageParameters.panTiltDriveParameters.tiltDirection) {
-                            case JR_VISCA_TILT_DIRECTION_DOWN:
-                                fprintf(stdout, "down %d ", messageParameters.panTiltDriveParameters.tiltSpeed);
-                                break;
-                            case JR_VISCA_TILT_DIRECTION_UP:
-                                fprintf(stdout, "up %d ", messageParameters.panTiltDriveParameters.tiltSpeed);
-                                break;
-                            case JR_VISCA_TILT_DIRECTION_STOP:
-                                fprintf(stdout, "tilt-stop ");
-                                break;
-                        }
-                        fprintf(stdout, "\n");
-                        sendAck(1, clientSocket);
-                        [camera startPanSpeed:messageParameters.panTiltDriveParameters.panSpeed
-                                       tiltSpeed:messageParameters.panTiltDriveParameters.tiltSpeed
-                                    panDirection:messageParameters.panTiltDriveParameters.panDirection
-                                   tiltDirection:messageParameters.panTiltDriveParameters.tiltDirection
-                                          onDone:^{sendCompletion(1, clientSocket);}];
-                        }
-                        break;
-                    case JR_VISCA_MESSAGE_CAMERA_NUMBER:
-                        fprintf(stdout, "Camera Number Inq\n");
-                        response.cameraNumberParameters.cameraNum = IP_CAMERA_NUMBER;
-                        sendMessage(JR_VISCA_MESSAGE_CAMERA_NUMBER, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_MEMORY:
-                        if (messageParameters.memoryParameters.memory == 95) {
-                            // PTZOptics cameras: This is toggle menu. No really. That's what the doc says, that's how real cameras work. Hidden in the support website, it mentions that presets 90-99 are reserved.
-                            // See JR_VISCA_MESSAGE_SONY_MENU_MODE
-                            fprintf(stdout, "CAM_OSD Open/Close\n");
-                            [camera toggleMenu];
-                            sendAckCompletion(1, clientSocket);
-                            break;
-                        }
-                        switch (messageParameters.memoryParameters.mode) {
-                            case JR_VISCA_MEMORY_MODE_SET:
-                                fprintf(stdout, "CAM_Memory Set %d ", messageParameters.memoryParameters.memory);
-                                sendAck(1, clientSocket);
-                                [camera cameraSetAtIndex:messageParameters.memoryParameters.memory
-                                             onDone:^{sendCompletion(1, clientSocket);}];
-                               break;
-                            case JR_VISCA_MEMORY_MODE_RESET:
-                                fprintf(stdout, "CAM_Memory Reset %d ", messageParameters.memoryParameters.memory);
-                                sendAckCompletion(1, clientSocket);
-                                break;
-                            case JR_VISCA_MEMORY_MODE_RECALL:
-                                fprintf(stdout, "CAM_Memory Recall %d ", messageParameters.memoryParameters.memory);
-                                sendAck(1, clientSocket);
-                                [camera recallAtIndex:messageParameters.memoryParameters.memory
-                                               onDone:^{sendCompletion(1, clientSocket);}];
-                                break;
-                        }
-                        fprintf(stdout, "\n");
-                        break;
-                    case JR_VISCA_MESSAGE_CLEAR:
-                        fprintf(stdout, "IF_Clear\n");
-                        sendCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_MOTION_SYNC:
-                        fprintf(stdout, "CAM_PTZMotionSync\n");
-                        sendCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_HOME:
-                        fprintf(stdout, "Pan_TiltDrive Home\n");
-                        sendAck(1, clientSocket);
-                        [camera cameraHome:^{sendAckCompletion(1, clientSocket);}];
-                        sendCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_RESET:
-                        fprintf(stdout, "Pan_TiltDrive Reset\n");
-                        sendAck(1, clientSocket);
-                        [camera cameraReset:^{sendCompletion(1, clientSocket);}];
-                        break;
-                    case JR_VISCA_MESSAGE_CANCEL:
-                        fprintf(stdout, "Cancel\n");
-                        sendAck(1, clientSocket);
-                        [camera cameraCancel:^{sendErrorReply(1, clientSocket, JR_VISCA_ERROR_CANCELLED);}];
-                        break;
-                    case JR_VISCA_MESSAGE_MENU_ENTER:
-                        fprintf(stdout, "CAM_OSD Enter\n");
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_MENU_RETURN:
-                        fprintf(stdout, "CAM_OSD Return\n");
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_MENU_MODE_INQ:
-                        fprintf(stdout, "SYS_MenuModeInq\n");
-                        response.oneByteParameters.byteValue = BOOL_TO_ONOFF(camera.menuVisible);
-                        sendMessage(JR_VISCA_MESSAGE_MENU_MODE_RESPONSE, response, clientSocket);
-                        break;
-                        break;
-                    case JR_VISCA_MESSAGE_PRESET_RECALL_SPEED:
-                        SET_CAM_VALUE(@"presetSpeed", messageParameters.oneByteParameters   .byteValue);
-                        hex_print(buffer, consumed);
-                        fprintf(stdout, "Preset Recall Speed %hhu\n", messageParameters.oneByteParameters   .byteValue);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_ABSOLUTE_PAN_TILT:
-                        sendAck(1, clientSocket);
-                        [camera absolutePanSpeed:messageParameters.absolutePanTiltPositionParameters.panSpeed
-                                    tiltSpeed:messageParameters.absolutePanTiltPositionParameters.tiltSpeed
-                                          pan:messageParameters.absolutePanTiltPositionParameters.panPosition
-                                         tilt:messageParameters.absolutePanTiltPositionParameters.tiltPosition
-                                       onDone:^{sendCompletion(1, clientSocket);}];
-                        hex_print(buffer, consumed);
-                        fprintf(stdout, "Pan_TiltDrive AbsolutePosition\n");
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_RELATIVE_PAN_TILT:
-                        sendAck(1, clientSocket);
-                        [camera relativePanSpeed:messageParameters.absolutePanTiltPositionParameters.panSpeed
-                                    tiltSpeed:messageParameters.absolutePanTiltPositionParameters.tiltSpeed
-                                          pan:messageParameters.absolutePanTiltPositionParameters.panPosition
-                                         tilt:messageParameters.absolutePanTiltPositionParameters.tiltPosition
-                                       onDone:^{sendCompletion(1, clientSocket);}];
-                        hex_print(buffer, consumed);
-                        fprintf(stdout, "Pan_TiltDrive RelativePosition\n");
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_WB_MODE:
-                        SET_CAM_VALUE(@"wbMode", messageParameters.oneByteParameters.byteValue);
-                            fprintf(stdout, "CAM_WB %lu\n", (unsigned long)messageParameters.oneByteParameters.byteValue);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_WB_MODE_INQ:
-                        fprintf(stdout, "CAM_WBModeInq\n");
-                        response.oneByteParameters.byteValue = camera.wbMode;
-                        sendMessage(JR_VISCA_MESSAGE_WB_MODE_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_COLOR_TEMP_DIRECT:
-                        SET_CAM_VALUE(@"colorTempIndex", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_ColorTemp Direct 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_COLOR_TEMP_INQ:
-                        fprintf(stdout, "CAM_ColorTempInq\n");
-                        response.oneByteParameters.byteValue = camera.colorTempIndex;
-                        sendMessage(JR_VISCA_MESSAGE_COLOR_TEMP_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_PICTURE_EFFECT:
-                        SET_CAM_VALUE(@"pictureEffectMode", messageParameters.oneByteParameters.byteValue);
-                        fprintf(stdout, "CAM_PictureEffect %lu\n", (unsigned long)messageParameters.oneByteParameters.byteValue);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_PICTURE_EFFECT_INQ:
-                        fprintf(stdout, "CAM_PictureEffectModeInq\n");
-                        response.oneByteParameters.byteValue = camera.pictureEffectMode;
-                        sendMessage(JR_VISCA_MESSAGE_PICTURE_EFFECT_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_LR_REVERSE:
-                        SET_CAM_VALUE(@"flipHOnOff", messageParameters.oneByteParameters.byteValue);
-                        fprintf(stdout, "CAM_LR_Reverse %lu\n", (unsigned long)messageParameters.oneByteParameters.byteValue);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_LR_REVERSE_INQ:
-                        fprintf(stdout, "CAM_LR_ReverseInq\n");
-                        response.oneByteParameters.byteValue = camera.flipHOnOff;
-                        sendMessage(JR_VISCA_MESSAGE_LR_REVERSE_RESPONSE, response, clientSocket);
-                        break;
-
-                    case JR_VISCA_MESSAGE_PICTURE_FLIP:
-                        SET_CAM_VALUE(@"flipVOnOff", messageParameters.oneByteParameters.byteValue);
-                        fprintf(stdout, "CAM_PictureFlip %lu\n", (unsigned long)messageParameters.oneByteParameters.byteValue);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_PICTURE_FLIP_INQ:
-                        fprintf(stdout, "CAM_PictureFlipInq\n");
-                        response.oneByteParameters.byteValue = camera.flipVOnOff;
-                        sendMessage(JR_VISCA_MESSAGE_PICTURE_FLIP_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_APERTURE_VALUE:
-                        SET_CAM_VALUE(@"aperture", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_Aperture 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_APERTURE_VALUE_INQ:
-                         fprintf(stdout, "CAM_ApertureInq \n");
-                         response.int16Parameters.int16Value = camera.aperture;
-                         sendMessage(JR_VISCA_MESSAGE_APERTURE_VALUE_RESPONSE, response, clientSocket);
-                         break;
-                    case JR_VISCA_MESSAGE_BGAIN_VALUE:
-                        SET_CAM_VALUE(@"bGain", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_BGain 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_BGAIN_VALUE_INQ:
-                        fprintf(stdout, "CAM_BGainInq\n");
-                        response.int16Parameters.int16Value = camera.bGain;
-                        sendMessage(JR_VISCA_MESSAGE_BGAIN_VALUE_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_RGAIN_VALUE:
-                        SET_CAM_VALUE(@"rGain", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_RGain 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_RGAIN_VALUE_INQ:
-                        fprintf(stdout, "CAM_RGainInq\n");
-                        response.int16Parameters.int16Value = camera.rGain;
-                        sendMessage(JR_VISCA_MESSAGE_RGAIN_VALUE_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_COLOR_GAIN_DIRECT:
-                        SET_CAM_VALUE(@"colorgain", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_ColorGain 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_COLOR_GAIN_INQ:
-                        fprintf(stdout, "CAM_ColorGainInq\n");
-                        response.int16Parameters.int16Value = camera.colorgain;
-                        sendMessage(JR_VISCA_MESSAGE_COLOR_GAIN_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_COLOR_HUE_DIRECT:
-                        SET_CAM_VALUE(@"hue", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_ColorHue 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_COLOR_HUE_INQ:
-                        fprintf(stdout, "CAM_ColorHueInq\n");
-                        response.int16Parameters.int16Value = camera.hue;
-                        sendMessage(JR_VISCA_MESSAGE_COLOR_HUE_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_AWB_SENS:
-                        fprintf(stdout, "CAM_AWBSensitivity %d\n",  messageParameters.oneByteParameters.byteValue);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_AWB_SENS_INQ:
-                        fprintf(stdout, "CAM_AWBSensitivityInq\n");
-                        response.oneByteParameters.byteValue = camera.awbSens;
-                        sendMessage(JR_VISCA_MESSAGE_AWB_SENS_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_AE_MODE:
-                        SET_CAM_VALUE(@"aeMode", messageParameters.oneByteParameters.byteValue);
-                            fprintf(stdout, "CAM_AE %lu\n", (unsigned long)messageParameters.oneByteParameters.byteValue);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                   case JR_VISCA_MESSAGE_AE_MODE_INQ:
-                        fprintf(stdout, "CAM_AEModeInq\n");
-                        response.oneByteParameters.byteValue = camera.aeMode;
-                        sendMessage(JR_VISCA_MESSAGE_AE_MODE_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_SHUTTER_VALUE:
-                        SET_CAM_VALUE(@"shutter", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_Shutter 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                   case JR_VISCA_MESSAGE_SHUTTER_POS_INQ:
-                        response.int16Parameters.int16Value = camera.shutter;
-                        fprintf(stdout, "CAM_ShutterPosInq\n");
-                        sendMessage(JR_VISCA_MESSAGE_SHUTTER_POS_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_IRIS_VALUE:
-                        SET_CAM_VALUE(@"iris", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_Iris 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_IRIS_POS_INQ:
-                        fprintf(stdout, "CAM_IrisPosInq\n");
-                        response.int16Parameters.int16Value = camera.iris;
-                        sendMessage(JR_VISCA_MESSAGE_IRIS_POS_RESPONSE, response, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_BRIGHT_DIRECT:
-                        SET_CAM_VALUE(@"brightPos", messageParameters.int16Parameters.int16Value);
-                        fprintf(stdout, "CAM_Bright Direct 0x%hx\n", messageParameters.int16Parameters.int16Value);
-                        sendAckCompletion(1, clientSocket);
-                        break;
-                    case JR_VISCA_MESSAGE_BRIGHT_POS_INQ:
-                         fprintf(stdout, "CAM_BrightPosInq\n");
-                         response.int16Parameters.int16Value = camera.brightPos;
-                         sendMessage(JR_VISCA_MESSAGE_BRIGHT_POS_RESPONSE, response, clientSocket);
-                         break;
-
-                    default:
-                        {
-                        BOOL unknown = messageType < 0;
-                        fprintf(stdout, "%s: (0x%X) ", (unknown ? "unknown" : "unhandled"), messageType);
-                        hex_print(buffer, consumed);
-#if 0
-                        fprintf(stdout, " ErrorReply\n");
-                        sendAck(1, clientSocket);
-                        [camera cameraCancel:^{sendErrorReply(1, clientSocket, unknown ? JR_VISCA_ERROR_SYNTAX : JR_VISCA_ERROR_NOT_EXECUTABLE);}];
-#else
-                        fprintf(stdout, " Ignored\n");
-                        sendAckCompletion(1, clientSocket);
-#endif
-                        }
-                        break;
+                response.cameraNumberParameters.cameraNum = next;
+                sendMessage(JR_VISCA_MESSAGE_CAMERA_NUMBER, response, (visca_reply){ clientSocket, 0 });
+            } else if (chainLength == 1) {
+                // VISCA over IP: one camera, which answers to any address as IP_CAMERA_NUMBER.
+                enqueue(&connection, 0, chain[0], (visca_reply){ clientSocket, IP_CAMERA_NUMBER }, frame, &notifiers[0]);
+            } else if (frame->receiver == BROADCAST_ADDRESS) {
+                // Every camera acts on it and none of them answers; it comes back around the chain instead.
+                for (int i = 0; i < chainLength; i++) {
+                    enqueue(&connection, i, chain[i], (visca_reply){ clientSocket, 0 }, frame, &notifiers[i]);
+                }
+                pthread_mutex_lock(&sendLock);
+                jr_socket_send(clientSocket, frame->bytes, frame->length);
+                pthread_mutex_unlock(&sendLock);
+            } else {
+                int i = 0;
+                while (i < chainLength && (addresses[i] == 0 || addresses[i] != frame->receiver)) {
+                    i++;
+                }
+                if (i < chainLength) {
+                    enqueue(&connection, i, chain[i], (visca_reply){ clientSocket, addresses[i] }, frame, &notifiers[i]);
+                } else {
+                    fprintf(stdout, "No camera at address %d\n", frame->receiver);
                 }
-                
-                count -= consumed;
-                // Crappy naive buffer management-- move remaining bytes up to buffer[0].
-                // Maybe later we'll replace this with a circular buffer or something.
-                // For now I just want it to work.
-                memmove(buffer, buffer + consumed, count);
             }
-        } while (consumed);
+        }
+        if (consumed < 0) {
+            fprintf(stderr, "error, bailing\n");
+            goto bailTCPLoop;
+        }
+
+        count -= offset;
+        // Crappy naive buffer management-- move remaining bytes up to buffer[0].
+        // Maybe later we'll replace this with a circular buffer or something.
+        // For now I just want it to work.
+        memmove(buffer, buffer + offset, count);
     }
 bailTCPLoop:
     
     fprintf(stdout, "Connection spun down, closing socket.\n");
-    
+
+    stop_lanes(&connection);
+    for (int i = 0; i < chainLength; i++) {
+        if (notifiers[i]) {
+            subscribe_notifications(chain[i], (visca_reply){ clientSocket, 0 }, 0, &notifiers[i]);
+        }
+    }
     jr_socket_closeSocket(clientSocket);
-    jr_socket_closeServerSocket(serverSocket);
-    return 0;
 }
 
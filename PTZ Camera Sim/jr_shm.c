@@ -0,0 +1,289 @@
+//
+//  jr_shm.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "jr_shm.h"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define JR_SHM_MAGIC 0x4A52534Du    // "JRSM"
+// Polls of the ring before going to sleep. A few microseconds; long enough to catch a reply from a
+// controller that's actively waiting for it. Only with a second CPU for that controller to be running on.
+#define JR_SHM_SPINS 2000
+
+enum {
+    JR_SHM_SERVER = 0,
+    JR_SHM_CLIENT = 1,
+};
+
+// Each field a producer or consumer writes gets its own cache line.
+typedef struct _jr_shm_ring {
+    _Alignas(64) _Atomic uint32_t head;     // Written by the producer.
+    _Alignas(64) _Atomic uint32_t tail;     // Written by the consumer.
+    _Alignas(64) _Atomic uint32_t signal;   // Futex word: bumped on every head, tail or closed change.
+    _Atomic uint32_t waiters;
+    _Alignas(64) uint8_t data[JR_SHM_RING_SIZE];
+} jr_shm_ring;
+
+struct _jr_shm_segment {
+    uint32_t magic;
+    _Atomic uint32_t connected;
+    _Atomic uint32_t closed[2];             // By side.
+    jr_shm_ring rings[2];                   // rings[side] carries what `side` sends.
+};
+
+typedef struct _jr_shm_segment jr_shm_segment;
+
+static void jr_shm_wake(jr_shm_ring *ring) {
+    atomic_fetch_add(&ring->signal, 1);
+#if defined(__linux__)
+    if (atomic_load(&ring->waiters) != 0) {
+        syscall(SYS_futex, &ring->signal, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+    }
+#endif
+}
+
+// Waits until `ready` returns nonzero; every change it can depend on is followed by jr_shm_wake on `ring`.
+static void jr_shm_wait(jr_shm_ring *ring, int (*ready)(jr_shm_segment *, int), jr_shm_segment *segment, int side) {
+    static atomic_int cpuSpins = -1;
+    int spins = atomic_load_explicit(&cpuSpins, memory_order_relaxed);
+    if (spins < 0) {
+        spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? JR_SHM_SPINS : 0;
+        atomic_store_explicit(&cpuSpins, spins, memory_order_relaxed);
+    }
+    for (int spin = 0; spin < spins; spin++) {
+        if (ready(segment, side)) {
+            return;
+        }
+    }
+    atomic_fetch_add(&ring->waiters, 1);
+    for (;;) {
+        uint32_t signal = atomic_load(&ring->signal);
+        if (ready(segment, side)) {
+            break;
+        }
+#if defined(__linux__)
+        syscall(SYS_futex, &ring->signal, FUTEX_WAIT, signal, NULL, NULL, 0);
+#else
+        // No futex here, so poll.
+        struct timespec delay = { 0, 20000 };
+        while (atomic_load(&ring->signal) == signal) {
+            nanosleep(&delay, NULL);
+        }
+#endif
+    }
+    atomic_fetch_sub(&ring->waiters, 1);
+}
+
+static int jr_shm_closedEither(jr_shm_segment *segment) {
+    return atomic_load(&segment->closed[JR_SHM_SERVER]) || atomic_load(&segment->closed[JR_SHM_CLIENT]);
+}
+
+static int jr_shm_canReceive(jr_shm_segment *segment, int side) {
+    jr_shm_ring *ring = &segment->rings[!side];
+    return atomic_load_explicit(&ring->head, memory_order_acquire) != atomic_load_explicit(&ring->tail, memory_order_relaxed)
+        || jr_shm_closedEither(segment);
+}
+
+static int jr_shm_canSend(jr_shm_segment *segment, int side) {
+    jr_shm_ring *ring = &segment->rings[side];
+    uint32_t used = atomic_load_explicit(&ring->head, memory_order_relaxed) - atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return used < JR_SHM_RING_SIZE || jr_shm_closedEither(segment);
+}
+
+static int jr_shm_isConnected(jr_shm_segment *segment, int side) {
+    (void)side;
+    return atomic_load(&segment->connected) || atomic_load(&segment->closed[JR_SHM_SERVER]);
+}
+
+static jr_shm_segment *jr_shm_map(int fd) {
+    void *mapping = mmap(NULL, sizeof(jr_shm_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    return mapping;
+}
+
+int jr_shm_setupServer(const char *name, jr_shm_server *server) {
+    memset(server, 0, sizeof(*server));
+    server->_fd = -1;
+    if (name != NULL) {
+        if (strlen(name) >= sizeof(server->_name)) {
+            fprintf(stderr, "jr_shm: name too long\n");
+            return -1;
+        }
+        shm_unlink(name);
+        server->_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (server->_fd < 0) {
+            perror("shm_open");
+            return -1;
+        }
+        strcpy(server->_name, name);
+    } else {
+#if defined(__linux__)
+        server->_fd = memfd_create("jr_shm", MFD_CLOEXEC);
+        if (server->_fd < 0) {
+            perror("memfd_create");
+            return -1;
+        }
+#else
+        fprintf(stderr, "jr_shm: anonymous segments need memfd_create; use a name\n");
+        return -1;
+#endif
+    }
+    // The new pages are zero, which is an empty ring in both directions.
+    if (ftruncate(server->_fd, sizeof(jr_shm_segment)) < 0) {
+        perror("ftruncate");
+        jr_shm_closeServer(*server);
+        return -1;
+    }
+    server->_segment = jr_shm_map(server->_fd);
+    if (server->_segment == NULL) {
+        jr_shm_closeServer(*server);
+        return -1;
+    }
+    server->_segment->magic = JR_SHM_MAGIC;
+    return 0;
+}
+
+int jr_shm_serverFD(jr_shm_server server) {
+    return server._fd;
+}
+
+int jr_shm_accept(jr_shm_server server, jr_socket *socket) {
+    jr_shm_segment *segment = server._segment;
+    // The controller announces itself on the ring it would receive on.
+    jr_shm_wait(&segment->rings[JR_SHM_SERVER], jr_shm_isConnected, segment, JR_SHM_SERVER);
+    if (!atomic_load(&segment->connected)) {
+        return -1;
+    }
+    socket->_socket = JR_SHM_SERVER;
+    socket->_shm = segment;
+    return 0;
+}
+
+int jr_shm_connect(const char *name, int fd, jr_socket *socket) {
+    int ownFD = -1;
+    if (name != NULL) {
+        fd = ownFD = shm_open(name, O_RDWR, 0);
+        if (fd < 0) {
+            perror("shm_open");
+            return -1;
+        }
+    }
+    struct stat info;
+    jr_shm_segment *segment = NULL;
+    if (fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(jr_shm_segment)) {
+        fprintf(stderr, "jr_shm: not a VISCA segment\n");
+    } else {
+        segment = jr_shm_map(fd);
+    }
+    if (ownFD >= 0) {
+        close(ownFD);
+    }
+    if (segment == NULL) {
+        return -1;
+    }
+    uint32_t expected = 0;
+    if (segment->magic != JR_SHM_MAGIC || !atomic_compare_exchange_strong(&segment->connected, &expected, 1)) {
+        fprintf(stderr, "jr_shm: segment is not waiting for a controller\n");
+        munmap(segment, sizeof(jr_shm_segment));
+        return -1;
+    }
+    jr_shm_wake(&segment->rings[JR_SHM_SERVER]);
+    socket->_socket = JR_SHM_CLIENT;
+    socket->_shm = segment;
+    return 0;
+}
+
+void jr_shm_closeServer(jr_shm_server server) {
+    if (server._segment != NULL) {
+        munmap(server._segment, sizeof(jr_shm_segment));
+    }
+    if (server._fd >= 0) {
+        close(server._fd);
+    }
+    if (server._name[0] != '\0') {
+        shm_unlink(server._name);
+    }
+}
+
+int jr_shm_receive(jr_socket socket, char *buffer, int buffer_size) {
+    jr_shm_segment *segment = socket._shm;
+    int side = socket._socket;
+    jr_shm_ring *ring = &segment->rings[!side];
+    jr_shm_wait(ring, jr_shm_canReceive, segment, side);
+
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t available = atomic_load_explicit(&ring->head, memory_order_acquire) - tail;
+    if (available == 0) {
+        return 0;   // Closed, and everything sent before that has been read.
+    }
+    uint32_t count = available < (uint32_t)buffer_size ? available : (uint32_t)buffer_size;
+    uint32_t offset = tail & (JR_SHM_RING_SIZE - 1);
+    uint32_t first = count < JR_SHM_RING_SIZE - offset ? count : JR_SHM_RING_SIZE - offset;
+    memcpy(buffer, ring->data + offset, first);
+    memcpy(buffer + first, ring->data, count - first);
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+    jr_shm_wake(ring);
+    return (int)count;
+}
+
+int jr_shm_send(jr_socket socket, char *buffer, int buffer_size) {
+    jr_shm_segment *segment = socket._shm;
+    int side = socket._socket;
+    jr_shm_ring *ring = &segment->rings[side];
+    while (buffer_size) {
+        jr_shm_wait(ring, jr_shm_canSend, segment, side);
+        if (jr_shm_closedEither(segment)) {
+            errno = EPIPE;
+            perror("send");
+            return -1;
+        }
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint32_t space = JR_SHM_RING_SIZE - (head - atomic_load_explicit(&ring->tail, memory_order_acquire));
+        uint32_t count = space < (uint32_t)buffer_size ? space : (uint32_t)buffer_size;
+        uint32_t offset = head & (JR_SHM_RING_SIZE - 1);
+        uint32_t first = count < JR_SHM_RING_SIZE - offset ? count : JR_SHM_RING_SIZE - offset;
+        memcpy(ring->data + offset, buffer, first);
+        memcpy(ring->data, buffer + first, count - first);
+        atomic_store_explicit(&ring->head, head + count, memory_order_release);
+        jr_shm_wake(ring);
+        buffer += count;
+        buffer_size -= (int)count;
+    }
+    return 0;
+}
+
+// Like shutdown(): the other end's receive returns 0 and its sends fail. The server's mapping stays until
+// jr_shm_closeServer, since this can be called from another thread while a receive is waiting.
+void jr_shm_closeSocket(jr_socket socket) {
+    jr_shm_segment *segment = socket._shm;
+    atomic_store(&segment->closed[socket._socket], 1);
+    jr_shm_wake(&segment->rings[JR_SHM_SERVER]);
+    jr_shm_wake(&segment->rings[JR_SHM_CLIENT]);
+    if (socket._socket == JR_SHM_CLIENT) {
+        munmap(segment, sizeof(jr_shm_segment));
+    }
+}
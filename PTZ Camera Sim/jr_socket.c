@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "jr_socket.h"
+#include "jr_shm.h"
 
 int jr_socket_setupServerSocket(int port, jr_server_socket *serverSocket) {
     serverSocket->_serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -65,6 +66,7 @@ int jr_socket_setupServerSocket(int port, jr_server_socket *serverSocket) {
 
 int jr_socket_accept(jr_server_socket serverSocket, jr_socket *socket) {
     socket->_socket = accept(serverSocket._serverSocket, NULL, NULL);
+    socket->_shm = NULL;
 
     if (socket->_socket == -1) {
         perror("accept");
@@ -75,6 +77,9 @@ int jr_socket_accept(jr_server_socket serverSocket, jr_socket *socket) {
 }
 
 int jr_socket_receive(jr_socket socket, char* buffer, int buffer_size) {
+    if (socket._shm != NULL) {
+        return jr_shm_receive(socket, buffer, buffer_size);
+    }
     int result = (int)recv(socket._socket, buffer, buffer_size, 0);
     if (result == -1) {
         perror("recv");
@@ -85,6 +90,9 @@ int jr_socket_receive(jr_socket socket, char* buffer, int buffer_size) {
 }
 
 int jr_socket_send(jr_socket socket, char* buffer, int buffer_size) {
+    if (socket._shm != NULL) {
+        return jr_shm_send(socket, buffer, buffer_size);
+    }
     while (buffer_size) {
         int result = (int)send(socket._socket, buffer, buffer_size, 0);
         if (result == -1) {
@@ -97,6 +105,10 @@ int jr_socket_send(jr_socket socket, char* buffer, int buffer_size) {
 }
 
 void jr_socket_closeSocket(jr_socket socket) {
+    if (socket._shm != NULL) {
+        jr_shm_closeSocket(socket);
+        return;
+    }
     close(socket._socket);
 }
 
@@ -22,6 +22,7 @@
 
 typedef struct _jr_socket {
     int _socket;
+    struct _jr_shm_segment *_shm;   // Set for a shared memory connection (jr_shm.h); then _socket is its side.
 } jr_socket;
 
 typedef struct _jr_server_socket {
@@ -168,6 +168,27 @@ void jr_visca_handlePanTiltPositionInqResponseParameters(jr_viscaFrame* frame, u
     }
 }
 
+// Notifications [y0] 07 7F 0n [3]0p 0p 0p 0p [7]0q 0q 0q 0q FF
+void jr_visca_handlePanTiltNotifyParameters(jr_viscaFrame* frame, union jr_viscaMessageParameters *messageParameters, bool isDecodingFrame) {
+    if (isDecodingFrame) {
+        messageParameters->panTiltPositionInqResponseParameters.panPosition = _jr_viscaRead16FromBuffer(frame->data + 3);
+        messageParameters->panTiltPositionInqResponseParameters.tiltPosition = _jr_viscaRead16FromBuffer(frame->data + 7);
+    } else {
+        _jr_viscaWrite16ToBuffer(messageParameters->panTiltPositionInqResponseParameters.panPosition, frame->data + 3);
+        _jr_viscaWrite16ToBuffer(messageParameters->panTiltPositionInqResponseParameters.tiltPosition, frame->data + 7);
+    }
+}
+
+void jr_visca_handleLensNotifyParameters(jr_viscaFrame* frame, union jr_viscaMessageParameters *messageParameters, bool isDecodingFrame) {
+    if (isDecodingFrame) {
+        messageParameters->lensNotifyParameters.zoomPosition = _jr_viscaRead16FromBuffer(frame->data + 3);
+        messageParameters->lensNotifyParameters.focusPosition = _jr_viscaRead16FromBuffer(frame->data + 7);
+    } else {
+        _jr_viscaWrite16ToBuffer(messageParameters->lensNotifyParameters.zoomPosition, frame->data + 3);
+        _jr_viscaWrite16ToBuffer(messageParameters->lensNotifyParameters.focusPosition, frame->data + 7);
+    }
+}
+
 // AbsolutePosition [81] 01 06 02 [3]VV [4]WW [5]0Y 0Y 0Y 0Y [9]0Z 0Z 0Z 0Z FF
 // VV: Pan speed 0x01 (low speed) to 0x18 (high speed)
 // WW: Tilt speed 0x01 (low speed) to 0x14 (high speed)
@@ -175,8 +196,8 @@ void jr_visca_handlePanTiltPositionInqResponseParameters(jr_viscaFrame* frame, u
 // ZZZZ: Tilt Position
 void jr_visca_handleAbsolutePanTiltPositionParameters(jr_viscaFrame* frame, union jr_viscaMessageParameters *messageParameters, bool isDecodingFrame) {
     if (isDecodingFrame) {
-        messageParameters->absolutePanTiltPositionParameters.panSpeed = frame->data[3] & 0xf;
-        messageParameters->absolutePanTiltPositionParameters.tiltSpeed = frame->data[4] & 0xf;
+        messageParameters->absolutePanTiltPositionParameters.panSpeed = frame->data[3];
+        messageParameters->absolutePanTiltPositionParameters.tiltSpeed = frame->data[4];
         messageParameters->absolutePanTiltPositionParameters.panPosition = _jr_viscaRead16FromBuffer(frame->data + 5);
         messageParameters->absolutePanTiltPositionParameters.tiltPosition = _jr_viscaRead16FromBuffer(frame->data + 9);
     } else {
@@ -220,6 +241,7 @@ void jr_visca_handleMemoryParameters(jr_viscaFrame* frame, union jr_viscaMessage
         messageParameters->memoryParameters.memory = frame->data[4] & 0xff;
         messageParameters->memoryParameters.mode = frame->data[3] & 0xff;
     } else {
+        frame->data[3] = messageParameters->memoryParameters.mode;
         frame->data[4] = messageParameters->memoryParameters.memory;
     }
 }
@@ -486,8 +508,8 @@ jr_viscaMessageDefinition definitions[] = {
         &jr_visca_handlePanTiltDriveParameters
     },
     {
-        {0x30, 0x01},
-        {0xff, 0xff},
+        {0x30, 0x00},
+        {0xff, 0xf0},
         2,
         JR_VISCA_MESSAGE_CAMERA_NUMBER,
         &jr_visca_handleCameraNumberParameters
@@ -538,7 +560,7 @@ jr_viscaMessageDefinition definitions[] = {
         {0xf0},
         1,
         JR_VISCA_MESSAGE_CANCEL,
-        NULL
+        &jr_visca_handleAckCompletionParameters
     },
     SYSCMD_SUBCOMMAND_SET(0x06, 0x05, JR_VISCA_MESSAGE_MENU_ENTER),
     SYSCMD_SUBCOMMAND_SET(0x06, 0x04, JR_VISCA_MESSAGE_MENU_RETURN),
@@ -630,6 +652,37 @@ jr_viscaMessageDefinition definitions[] = {
     // xx is 00=high 01=normal 02=low
     MESSAGE_ONE_BYTE_VALUE_SET(0xA9, JR_VISCA_MESSAGE_AWB_SENS),
     MESSAGE_INQ(0xA9, JR_VISCA_MESSAGE_AWB_SENS_INQ),
+    // Position notifications, see JR_VISCA_MESSAGE_NOTIFY_SUBSCRIBE.
+    // Subscribe 8x 01 7F 01 0p 0q FF
+    {
+        {0x01, 0x7F, 0x01, 0x00, 0x00},
+        {0xff, 0xff, 0xff, 0xf0, 0xf0},
+        5,
+        JR_VISCA_MESSAGE_NOTIFY_SUBSCRIBE,
+        &jr_visca_handlePQCommandParameters
+    },
+    {   // 07 7F 01        0Y 0Y 0Y 0Y              0Z 0Z 0Z 0Z
+        {0x07, 0x7F, 0x01, 0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00},
+        {0xff, 0xff, 0xff, 0xf0, 0xf0, 0xf0, 0xf0,  0xf0, 0xf0, 0xf0, 0xf0},
+        11,
+        JR_VISCA_MESSAGE_PAN_TILT_NOTIFY,
+        &jr_visca_handlePanTiltNotifyParameters
+    },
+    {   // 07 7F 02        0Z 0Z 0Z 0Z              0F 0F 0F 0F
+        {0x07, 0x7F, 0x02, 0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00},
+        {0xff, 0xff, 0xff, 0xf0, 0xf0, 0xf0, 0xf0,  0xf0, 0xf0, 0xf0, 0xf0},
+        11,
+        JR_VISCA_MESSAGE_LENS_NOTIFY,
+        &jr_visca_handleLensNotifyParameters
+    },
+    // Error: y0 6z ee FF, z the socket and ee the JR_VISCA_ERROR_* code.
+    {
+        {0x60, 0x00},
+        {0xf0, 0x00},
+        2,
+        JR_VISCA_MESSAGE_ERROR_REPLY,
+        &jr_visca_handleErrorReplyParameters
+    },
     { {}, {}, 0, 0, NULL} // Final definition must have `signatureLength` == 0.
 };
 
@@ -67,6 +67,14 @@
 #define JR_VISCA_MESSAGE_MOTION_SYNC 32
 #define JR_VISCA_MESSAGE_RELATIVE_PAN_TILT 33
 
+// Simulator extension, not in any camera's manual: position pushed on change instead of polled.
+// Subscribe 8x 01 7F 01 0p 0q FF, pq the most notifications a second, 00 to stop.
+// The camera then sends y0 07 7F 01 ... FF with pan and tilt, and y0 07 7F 02 ... FF with zoom and focus,
+// whenever they change. A controller that never subscribes never sees either.
+#define JR_VISCA_MESSAGE_NOTIFY_SUBSCRIBE 34
+#define JR_VISCA_MESSAGE_PAN_TILT_NOTIFY 35
+#define JR_VISCA_MESSAGE_LENS_NOTIFY 36
+
 // Number convention for sys commands [81 01 06] and inqs [81 90 06]
 // Set: 0x6yy, where yy is the cmd ID
 // Set: 0x6yyz, z is the subcommand ID
@@ -203,6 +211,12 @@ struct jr_viscaPanTiltPositionInqResponseParameters {
     int16_t tiltPosition;
 };
 
+// Lens notification y0 07 7F 02 0z 0z 0z 0z 0f 0f 0f 0f FF
+struct jr_viscaLensNotifyParameters {
+    int16_t zoomPosition;
+    int16_t focusPosition;
+};
+
 // AbsolutePosition 81 01 06 02 VV WW 0Y 0Y 0Y 0Y 0Z 0Z 0Z 0Z FF
 // VV: Pan speed 0x01 (low speed) to 0x18 (high speed)
 // WW: Tilt speed 0x01 (low speed) to 0x14 (high speed)
@@ -231,7 +245,7 @@ struct jr_viscaErrorReplyParameters {
 };
 
 struct jr_viscaCameraNumberParameters {
-    // 1-7
+    // 1-7 in the Address Set; in the reply, the next free address after the chain, 2-8.
     uint8_t cameraNum;
 };
 
@@ -305,6 +319,7 @@ union jr_viscaMessageParameters
     struct jr_viscaOneByteParameters oneByteParameters;
     struct jr_viscaInt16Parameters int16Parameters;
     struct jr_viscaErrorReplyParameters errorReplyParameters;
+    struct jr_viscaLensNotifyParameters lensNotifyParameters;
 };
 
 /**
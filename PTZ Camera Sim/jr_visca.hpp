@@ -0,0 +1,487 @@
+//
+//  jr_visca.hpp
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The VISCA messages from jr_visca.h as C++20 types. Each message is a struct of its parameters plus a
+//  constexpr signature, mask and field layout, and encode/decode are templates over those descriptions, so a
+//  message whose type is known at compile time encodes to a few stores and decodes with no table scan, union
+//  or function pointer. `messages` lists every type in the same order as the C definitions table, so dispatch
+//  picks the same message the C decoder would for any frame.
+//
+//  Wire compatible with jr_visca.c: the same messages, the same fields, the same bytes. jr_visca_codec_tests
+//  holds every C definition to that.
+//
+
+#ifndef JR_VISCA_HPP
+#define JR_VISCA_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <tuple>
+
+#include "jr_visca.h"
+
+namespace jr_visca {
+
+// Bytes between the header and the terminator; the most jr_viscaDataToFrame accepts.
+inline constexpr std::size_t max_body_length = JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH - 2;
+
+inline constexpr uint8_t broadcast_address = 8;
+
+template <std::size_t N>
+struct signature {
+    static_assert(N >= 1 && N <= max_body_length);
+    std::array<uint8_t, N> bytes;
+    std::array<uint8_t, N> mask;    // Bits that identify the message; the rest carry parameters.
+    static constexpr std::size_t size = N;
+};
+
+template <std::size_t N>
+signature(const uint8_t (&)[N], const uint8_t (&)[N]) -> signature<N>;
+
+#pragma mark Fields
+
+// A whole byte.
+template <auto Member, std::size_t Offset>
+struct byte_field {
+    template <class M> static constexpr void decode(M &m, const uint8_t *body) { m.*Member = body[Offset]; }
+    template <class M> static constexpr void encode(const M &m, uint8_t *body) { body[Offset] = uint8_t(m.*Member); }
+};
+
+// The low nibble of a byte whose high nibble is part of the signature.
+template <auto Member, std::size_t Offset>
+struct nibble_field {
+    template <class M> static constexpr void decode(M &m, const uint8_t *body) { m.*Member = body[Offset] & 0x0f; }
+    template <class M> static constexpr void encode(const M &m, uint8_t *body) { body[Offset] |= uint8_t(m.*Member) & 0x0f; }
+};
+
+// 0p 0q: 8 bits, a nibble a byte.
+template <auto Member, std::size_t Offset>
+struct pq_field {
+    template <class M> static constexpr void decode(M &m, const uint8_t *body) {
+        m.*Member = uint8_t(((body[Offset] & 0x0f) << 4) | (body[Offset + 1] & 0x0f));
+    }
+    template <class M> static constexpr void encode(const M &m, uint8_t *body) {
+        auto value = uint8_t(m.*Member);
+        body[Offset] |= value >> 4;
+        body[Offset + 1] |= value & 0x0f;
+    }
+};
+
+// 0p 0q 0r 0s: 16 bits, a nibble a byte.
+template <auto Member, std::size_t Offset>
+struct pqrs_field {
+    template <class M> static constexpr void decode(M &m, const uint8_t *body) {
+        m.*Member = int16_t(((body[Offset] & 0x0f) << 12) | ((body[Offset + 1] & 0x0f) << 8)
+                          | ((body[Offset + 2] & 0x0f) << 4) | (body[Offset + 3] & 0x0f));
+    }
+    template <class M> static constexpr void encode(const M &m, uint8_t *body) {
+        auto value = uint16_t(m.*Member);
+        body[Offset] |= (value >> 12) & 0x0f;
+        body[Offset + 1] |= (value >> 8) & 0x0f;
+        body[Offset + 2] |= (value >> 4) & 0x0f;
+        body[Offset + 3] |= value & 0x0f;
+    }
+};
+
+#pragma mark Messages
+
+// Shapes shared by many messages. Id keeps each instantiation a distinct type.
+
+// No parameters: inquiries and fixed commands.
+template <int Id, signature Sig>
+struct fixed_message {
+    static constexpr int id = Id;
+    static constexpr auto sig = Sig;
+    static constexpr auto fields() { return std::tuple<>{}; }
+};
+
+template <int Id, uint8_t Category, uint8_t Command>
+using inquiry = fixed_message<Id, signature<3>{{0x09, Category, Command}, {0xff, 0xff, 0xff}}>;
+
+template <int Id, uint8_t Category, uint8_t Command>
+using command = fixed_message<Id, signature<3>{{0x01, Category, Command}, {0xff, 0xff, 0xff}}>;
+
+template <int Id, uint8_t Category, uint8_t Command, uint8_t Subcommand>
+using subcommand = fixed_message<Id, signature<4>{{0x01, Category, Command, Subcommand}, {0xff, 0xff, 0xff, 0xff}}>;
+
+// 8x 01 cc cmd xx FF
+template <int Id, uint8_t Category, uint8_t Command>
+struct byte_command {
+    static constexpr int id = Id;
+    static constexpr signature<4> sig{{0x01, Category, Command, 0x00}, {0xff, 0xff, 0xff, 0x00}};
+    uint8_t value;
+    static constexpr auto fields() { return std::tuple<byte_field<&byte_command::value, 3>>{}; }
+};
+
+// 8x 01 04 cmd Sp FF, where S is the subcommand (0 for a plain 0p).
+template <int Id, uint8_t Command, uint8_t Subcommand>
+struct nibble_command {
+    static constexpr int id = Id;
+    static constexpr signature<4> sig{{0x01, 0x04, Command, Subcommand}, {0xff, 0xff, 0xff, 0xf0}};
+    uint8_t value;
+    static constexpr auto fields() { return std::tuple<nibble_field<&nibble_command::value, 3>>{}; }
+};
+
+// 8x 01 04 cmd 0p 0q FF
+template <int Id, uint8_t Command>
+struct pq_command {
+    static constexpr int id = Id;
+    static constexpr signature<5> sig{{0x01, 0x04, Command, 0x00, 0x00}, {0xff, 0xff, 0xff, 0xf0, 0xf0}};
+    uint8_t value;
+    static constexpr auto fields() { return std::tuple<pq_field<&pq_command::value, 3>>{}; }
+};
+
+// 8x 01 04 cmd 0p 0q 0r 0s FF
+template <int Id, uint8_t Command>
+struct pqrs_command {
+    static constexpr int id = Id;
+    static constexpr signature<7> sig{{0x01, 0x04, Command, 0x00, 0x00, 0x00, 0x00}, {0xff, 0xff, 0xff, 0xf0, 0xf0, 0xf0, 0xf0}};
+    int16_t value;
+    static constexpr auto fields() { return std::tuple<pqrs_field<&pqrs_command::value, 3>>{}; }
+};
+
+// 81 01 06 02|03 VV WW 0Y 0Y 0Y 0Y 0Z 0Z 0Z 0Z FF
+template <int Id, uint8_t Command>
+struct pan_tilt_position {
+    static constexpr int id = Id;
+    static constexpr signature<13> sig{{0x01, 0x06, Command, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+                                       {0xff, 0xff, 0xff, 0x00, 0x00, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0}};
+    uint8_t panSpeed;       // 0x01-0x18
+    uint8_t tiltSpeed;      // 0x01-0x14
+    int16_t panPosition;
+    int16_t tiltPosition;
+    static constexpr auto fields() {
+        return std::tuple<byte_field<&pan_tilt_position::panSpeed, 3>, byte_field<&pan_tilt_position::tiltSpeed, 4>,
+                          pqrs_field<&pan_tilt_position::panPosition, 5>, pqrs_field<&pan_tilt_position::tiltPosition, 9>>{};
+    }
+};
+
+// y0 50 ... FF replies.
+struct one_byte_response {
+    static constexpr int id = JR_VISCA_MESSAGE_ONE_BYTE_RESPONSE;
+    static constexpr signature<2> sig{{0x50, 0x00}, {0xff, 0x00}};
+    uint8_t value;
+    static constexpr auto fields() { return std::tuple<byte_field<&one_byte_response::value, 1>>{}; }
+};
+
+struct p_response {
+    static constexpr int id = JR_VISCA_MESSAGE_P_RESPONSE;
+    static constexpr signature<2> sig{{0x50, 0x00}, {0xff, 0xf0}};
+    uint8_t value;
+    static constexpr auto fields() { return std::tuple<nibble_field<&p_response::value, 1>>{}; }
+};
+
+struct pqrs_response {
+    static constexpr int id = JR_VISCA_MESSAGE_PQRS_INQ_RESPONSE;
+    static constexpr signature<5> sig{{0x50, 0x00, 0x00, 0x00, 0x00}, {0xff, 0xf0, 0xf0, 0xf0, 0xf0}};
+    int16_t value;
+    static constexpr auto fields() { return std::tuple<pqrs_field<&pqrs_response::value, 1>>{}; }
+};
+
+struct pq_response {
+    static constexpr int id = JR_VISCA_MESSAGE_PQ_INQ_RESPONSE;
+    static constexpr signature<3> sig{{0x50, 0x00, 0x00}, {0xff, 0xf0, 0xf0}};
+    uint8_t value;
+    static constexpr auto fields() { return std::tuple<pq_field<&pq_response::value, 1>>{}; }
+};
+
+struct pan_tilt_position_response {
+    static constexpr int id = JR_VISCA_MESSAGE_PAN_TILT_POSITION_INQ_RESPONSE;
+    static constexpr signature<9> sig{{0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+                                      {0xff, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0}};
+    int16_t panPosition;
+    int16_t tiltPosition;
+    static constexpr auto fields() {
+        return std::tuple<pqrs_field<&pan_tilt_position_response::panPosition, 1>,
+                          pqrs_field<&pan_tilt_position_response::tiltPosition, 5>>{};
+    }
+};
+
+// y0 4z FF and y0 5z FF, z the socket.
+template <int Id, uint8_t Reply>
+struct socket_reply {
+    static constexpr int id = Id;
+    static constexpr signature<1> sig{{Reply}, {0xf0}};
+    uint8_t socketNumber;
+    static constexpr auto fields() { return std::tuple<nibble_field<&socket_reply::socketNumber, 0>>{}; }
+};
+
+using ack = socket_reply<JR_VISCA_MESSAGE_ACK, 0x40>;
+using completion = socket_reply<JR_VISCA_MESSAGE_COMPLETION, 0x50>;
+
+// y0 6z ee FF
+struct error_reply {
+    static constexpr int id = JR_VISCA_MESSAGE_ERROR_REPLY;
+    static constexpr signature<2> sig{{0x60, 0x00}, {0xf0, 0x00}};
+    uint8_t socketNumber;
+    uint8_t errorType;      // JR_VISCA_ERROR_*
+    static constexpr auto fields() {
+        return std::tuple<nibble_field<&error_reply::socketNumber, 0>, byte_field<&error_reply::errorType, 1>>{};
+    }
+};
+
+// 8x 01 06 01 VV WW 0p 0q FF
+struct pan_tilt_drive {
+    static constexpr int id = JR_VISCA_MESSAGE_PAN_TILT_DRIVE;
+    static constexpr signature<7> sig{{0x01, 0x06, 0x01, 0x00, 0x00, 0x00, 0x00}, {0xff, 0xff, 0xff, 0xe0, 0xe0, 0xf0, 0xf0}};
+    uint8_t panSpeed;       // 0x01-0x18
+    uint8_t tiltSpeed;      // 0x01-0x14
+    uint8_t panDirection;   // JR_VISCA_PAN_DIRECTION_*
+    uint8_t tiltDirection;  // JR_VISCA_TILT_DIRECTION_*
+    static constexpr auto fields() {
+        return std::tuple<byte_field<&pan_tilt_drive::panSpeed, 3>, byte_field<&pan_tilt_drive::tiltSpeed, 4>,
+                          byte_field<&pan_tilt_drive::panDirection, 5>, byte_field<&pan_tilt_drive::tiltDirection, 6>>{};
+    }
+};
+
+// Address Set: 88 30 0p FF, both ways.
+struct camera_number {
+    static constexpr int id = JR_VISCA_MESSAGE_CAMERA_NUMBER;
+    static constexpr signature<2> sig{{0x30, 0x00}, {0xff, 0xf0}};
+    uint8_t cameraNum;
+    static constexpr auto fields() { return std::tuple<nibble_field<&camera_number::cameraNum, 1>>{}; }
+};
+
+// 8x 01 04 3F mm pp FF
+struct memory {
+    static constexpr int id = JR_VISCA_MESSAGE_MEMORY;
+    static constexpr signature<5> sig{{0x01, 0x04, 0x3f, 0x00, 0x00}, {0xff, 0xff, 0xff, 0x00, 0x00}};
+    uint8_t memory;         // Preset
+    uint8_t mode;           // JR_VISCA_MEMORY_MODE_*
+    static constexpr auto fields() {
+        return std::tuple<byte_field<&memory::mode, 3>, byte_field<&memory::memory, 4>>{};
+    }
+};
+
+// 8x 01 7F 01 0p 0q FF; see JR_VISCA_MESSAGE_NOTIFY_SUBSCRIBE.
+struct notify_subscribe {
+    static constexpr int id = JR_VISCA_MESSAGE_NOTIFY_SUBSCRIBE;
+    static constexpr signature<5> sig{{0x01, 0x7f, 0x01, 0x00, 0x00}, {0xff, 0xff, 0xff, 0xf0, 0xf0}};
+    uint8_t rate;           // Notifications a second at most; 0 stops them.
+    static constexpr auto fields() { return std::tuple<pq_field<&notify_subscribe::rate, 3>>{}; }
+};
+
+// y0 07 7F 0n 0p 0p 0p 0p 0q 0q 0q 0q FF
+template <int Id, uint8_t Group>
+struct notification {
+    static constexpr int id = Id;
+    static constexpr signature<11> sig{{0x07, 0x7f, Group, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+                                       {0xff, 0xff, 0xff, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0}};
+    int16_t first;          // Pan, or zoom.
+    int16_t second;         // Tilt, or focus.
+    static constexpr auto fields() {
+        return std::tuple<pqrs_field<&notification::first, 3>, pqrs_field<&notification::second, 7>>{};
+    }
+};
+
+// 8x 2z FF
+struct cancel {
+    static constexpr int id = JR_VISCA_MESSAGE_CANCEL;
+    static constexpr signature<1> sig{{0x20}, {0xf0}};
+    uint8_t socketNumber;
+    static constexpr auto fields() { return std::tuple<nibble_field<&cancel::socketNumber, 0>>{}; }
+};
+
+using pan_tilt_position_inq = inquiry<JR_VISCA_MESSAGE_PAN_TILT_POSITION_INQ, 0x06, 0x12>;
+using zoom_stop = subcommand<JR_VISCA_MESSAGE_ZOOM_STOP, 0x04, 0x07, 0x00>;
+using zoom_tele_standard = subcommand<JR_VISCA_MESSAGE_ZOOM_TELE_STANDARD, 0x04, 0x07, 0x02>;
+using zoom_wide_standard = subcommand<JR_VISCA_MESSAGE_ZOOM_WIDE_STANDARD, 0x04, 0x07, 0x03>;
+using zoom_tele_variable = nibble_command<JR_VISCA_MESSAGE_ZOOM_TELE_VARIABLE, 0x07, 0x20>;
+using zoom_wide_variable = nibble_command<JR_VISCA_MESSAGE_ZOOM_WIDE_VARIABLE, 0x07, 0x30>;
+using focus_stop = subcommand<JR_VISCA_MESSAGE_FOCUS_STOP, 0x04, 0x08, 0x00>;
+using focus_far_standard = subcommand<JR_VISCA_MESSAGE_FOCUS_FAR_STANDARD, 0x04, 0x08, 0x02>;
+using focus_near_standard = subcommand<JR_VISCA_MESSAGE_FOCUS_NEAR_STANDARD, 0x04, 0x08, 0x03>;
+using focus_far_variable = nibble_command<JR_VISCA_MESSAGE_FOCUS_FAR_VARIABLE, 0x08, 0x20>;
+using focus_near_variable = nibble_command<JR_VISCA_MESSAGE_FOCUS_NEAR_VARIABLE, 0x08, 0x30>;
+using clear = command<JR_VISCA_MESSAGE_CLEAR, 0x00, 0x01>;
+// 81 0A 11 13 xx FF; the C decoder doesn't read xx either.
+using motion_sync = fixed_message<JR_VISCA_MESSAGE_MOTION_SYNC, signature<4>{{0x0a, 0x11, 0x13, 0x00}, {0xff, 0xff, 0xff, 0x00}}>;
+using preset_recall_speed = byte_command<JR_VISCA_MESSAGE_PRESET_RECALL_SPEED, 0x06, 0x01>;
+using absolute_pan_tilt = pan_tilt_position<JR_VISCA_MESSAGE_ABSOLUTE_PAN_TILT, 0x02>;
+using relative_pan_tilt = pan_tilt_position<JR_VISCA_MESSAGE_RELATIVE_PAN_TILT, 0x03>;
+using home = command<JR_VISCA_MESSAGE_HOME, 0x06, 0x04>;
+using reset = command<JR_VISCA_MESSAGE_RESET, 0x06, 0x05>;
+using menu_enter = subcommand<JR_VISCA_MESSAGE_MENU_ENTER, 0x06, 0x06, 0x05>;
+using menu_return = subcommand<JR_VISCA_MESSAGE_MENU_RETURN, 0x06, 0x06, 0x04>;
+using sony_menu_mode = byte_command<JR_VISCA_MESSAGE_SONY_MENU_MODE, 0x06, 0x06>;
+using sony_menu_enter = fixed_message<JR_VISCA_MESSAGE_SONY_MENU_ENTER,
+                                      signature<6>{{0x01, 0x7e, 0x01, 0x02, 0x00, 0x01}, {0xff, 0xff, 0xff, 0xff, 0xff, 0xff}}>;
+using menu_mode_inq = inquiry<JR_VISCA_MESSAGE_MENU_MODE_INQ, 0x06, 0x06>;
+using bright_direct = pqrs_command<JR_VISCA_MESSAGE_BRIGHT_DIRECT, 0x0d>;
+using bright_pos_inq = inquiry<JR_VISCA_MESSAGE_BRIGHT_POS_INQ, 0x04, 0x4d>;
+using color_temp_direct = pq_command<JR_VISCA_MESSAGE_COLOR_TEMP_DIRECT, 0x20>;
+using color_temp_inq = inquiry<JR_VISCA_MESSAGE_COLOR_TEMP_INQ, 0x04, 0x20>;
+using flicker_mode = byte_command<JR_VISCA_MESSAGE_FLICKER_MODE, 0x04, 0x23>;
+using flicker_mode_inq = inquiry<JR_VISCA_MESSAGE_FLICKER_MODE_INQ, 0x04, 0x55>;
+using gain_limit = nibble_command<JR_VISCA_MESSAGE_GAIN_LIMIT, 0x2c, 0x00>;
+using gain_limit_inq = inquiry<JR_VISCA_MESSAGE_GAIN_LIMIT_INQ, 0x04, 0x2c>;
+using wb_mode = byte_command<JR_VISCA_MESSAGE_WB_MODE, 0x04, 0x35>;
+using wb_mode_inq = inquiry<JR_VISCA_MESSAGE_WB_MODE_INQ, 0x04, 0x35>;
+using focus_automatic = subcommand<JR_VISCA_MESSAGE_FOCUS_AUTOMATIC, 0x04, 0x38, 0x02>;
+using focus_manual = subcommand<JR_VISCA_MESSAGE_FOCUS_MANUAL, 0x04, 0x38, 0x03>;
+using focus_af_mode_inq = inquiry<JR_VISCA_MESSAGE_FOCUS_AF_MODE_INQ, 0x04, 0x38>;
+using ae_mode = byte_command<JR_VISCA_MESSAGE_AE_MODE, 0x04, 0x39>;
+using ae_mode_inq = inquiry<JR_VISCA_MESSAGE_AE_MODE_INQ, 0x04, 0x39>;
+using aperture_value = pqrs_command<JR_VISCA_MESSAGE_APERTURE_VALUE, 0x42>;
+using aperture_value_inq = inquiry<JR_VISCA_MESSAGE_APERTURE_VALUE_INQ, 0x04, 0x42>;
+using rgain_value = pqrs_command<JR_VISCA_MESSAGE_RGAIN_VALUE, 0x43>;
+using rgain_value_inq = inquiry<JR_VISCA_MESSAGE_RGAIN_VALUE_INQ, 0x04, 0x43>;
+using bgain_value = pqrs_command<JR_VISCA_MESSAGE_BGAIN_VALUE, 0x44>;
+using bgain_value_inq = inquiry<JR_VISCA_MESSAGE_BGAIN_VALUE_INQ, 0x04, 0x44>;
+using zoom_direct = pqrs_command<JR_VISCA_MESSAGE_ZOOM_DIRECT, 0x47>;
+using zoom_position_inq = inquiry<JR_VISCA_MESSAGE_ZOOM_POSITION_INQ, 0x04, 0x47>;
+using focus_value = pqrs_command<JR_VISCA_MESSAGE_FOCUS_VALUE, 0x48>;
+using focus_value_inq = inquiry<JR_VISCA_MESSAGE_FOCUS_VALUE_INQ, 0x04, 0x48>;
+using color_gain_direct = pqrs_command<JR_VISCA_MESSAGE_COLOR_GAIN_DIRECT, 0x49>;
+using color_gain_inq = inquiry<JR_VISCA_MESSAGE_COLOR_GAIN_INQ, 0x04, 0x49>;
+using shutter_value = pqrs_command<JR_VISCA_MESSAGE_SHUTTER_VALUE, 0x4a>;
+using shutter_pos_inq = inquiry<JR_VISCA_MESSAGE_SHUTTER_POS_INQ, 0x04, 0x4a>;
+using iris_value = pqrs_command<JR_VISCA_MESSAGE_IRIS_VALUE, 0x4b>;
+using iris_pos_inq = inquiry<JR_VISCA_MESSAGE_IRIS_POS_INQ, 0x04, 0x4b>;
+using color_hue_direct = pqrs_command<JR_VISCA_MESSAGE_COLOR_HUE_DIRECT, 0x4f>;
+using color_hue_inq = inquiry<JR_VISCA_MESSAGE_COLOR_HUE_INQ, 0x04, 0x4f>;
+using lr_reverse = byte_command<JR_VISCA_MESSAGE_LR_REVERSE, 0x04, 0x61>;
+using lr_reverse_inq = inquiry<JR_VISCA_MESSAGE_LR_REVERSE_INQ, 0x04, 0x61>;
+using picture_effect = byte_command<JR_VISCA_MESSAGE_PICTURE_EFFECT, 0x04, 0x63>;
+using picture_effect_inq = inquiry<JR_VISCA_MESSAGE_PICTURE_EFFECT_INQ, 0x04, 0x63>;
+using picture_flip = byte_command<JR_VISCA_MESSAGE_PICTURE_FLIP, 0x04, 0x66>;
+using picture_flip_inq = inquiry<JR_VISCA_MESSAGE_PICTURE_FLIP_INQ, 0x04, 0x66>;
+using brightness = pqrs_command<JR_VISCA_MESSAGE_BRIGHTNESS, 0xa1>;
+using brightness_inq = inquiry<JR_VISCA_MESSAGE_BRIGHTNESS_INQ, 0x04, 0xa1>;
+using contrast = pqrs_command<JR_VISCA_MESSAGE_CONTRAST, 0xa2>;
+using contrast_inq = inquiry<JR_VISCA_MESSAGE_CONTRAST_INQ, 0x04, 0xa2>;
+using awb_sens = byte_command<JR_VISCA_MESSAGE_AWB_SENS, 0x04, 0xa9>;
+using awb_sens_inq = inquiry<JR_VISCA_MESSAGE_AWB_SENS_INQ, 0x04, 0xa9>;
+using pan_tilt_notify = notification<JR_VISCA_MESSAGE_PAN_TILT_NOTIFY, 0x01>;
+using lens_notify = notification<JR_VISCA_MESSAGE_LENS_NOTIFY, 0x02>;
+
+#pragma mark Codec
+
+template <class M>
+inline constexpr std::size_t encoded_size = M::sig.size + 2;
+
+/**
+ * Whether `body`, the bytes between header and terminator, is an M.
+ */
+template <class M>
+constexpr bool matches(std::span<const uint8_t> body) {
+    if (body.size() != M::sig.size) {
+        return false;
+    }
+    for (std::size_t i = 0; i < M::sig.size; i++) {
+        if ((body[i] & M::sig.mask[i]) != M::sig.bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Only for a body that matches.
+template <class M>
+constexpr M decode_body(std::span<const uint8_t> body) {
+    M message{};
+    std::apply([&](auto... field) { (field.decode(message, body.data()), ...); }, M::fields());
+    return message;
+}
+
+template <class M>
+constexpr std::optional<M> decode(std::span<const uint8_t> body) {
+    if (!matches<M>(body)) {
+        return std::nullopt;
+    }
+    return decode_body<M>(body);
+}
+
+/**
+ * Writes the whole frame: header, body and terminator. Returns its size, or -1 if `out` is too short or an
+ * address is out of range. Like jr_viscaFrameToData, `receiver` may be the broadcast address.
+ */
+template <class M>
+constexpr int encode(const M &message, uint8_t sender, uint8_t receiver, std::span<uint8_t> out) {
+    if (out.size() < encoded_size<M> || sender > 7 || receiver > 0x0f) {
+        return -1;
+    }
+    out[0] = uint8_t(0x80 | (sender << 4) | receiver);
+    for (std::size_t i = 0; i < M::sig.size; i++) {
+        out[1 + i] = M::sig.bytes[i];
+    }
+    std::apply([&](auto... field) { (field.encode(message, out.data() + 1), ...); }, M::fields());
+    out[encoded_size<M> - 1] = 0xff;
+    return int(encoded_size<M>);
+}
+
+template <class M>
+constexpr std::array<uint8_t, encoded_size<M>> encode(const M &message, uint8_t sender, uint8_t receiver) {
+    std::array<uint8_t, encoded_size<M>> out{};
+    encode(message, sender, receiver, std::span<uint8_t>(out));
+    return out;
+}
+
+struct frame {
+    uint8_t sender;
+    uint8_t receiver;
+    std::span<const uint8_t> body;
+};
+
+/**
+ * Finds the first frame in `data`, like jr_viscaDataToFrame. Returns the bytes it took up, 0 if the frame
+ * isn't all there yet, or -1 if the data is corrupt.
+ */
+constexpr int split_frame(std::span<const uint8_t> data, frame &result) {
+    std::size_t terminator = 0;
+    while (terminator < data.size() && data[terminator] != 0xff) {
+        terminator++;
+    }
+    if (terminator == data.size()) {
+        return 0;
+    }
+    if (terminator > max_body_length - 1 || terminator == 0) {
+        return -1;
+    }
+    result.sender = (data[0] >> 4) & 0x7;
+    result.receiver = data[0] & 0x0f;
+    result.body = data.subspan(1, terminator - 1);
+    return int(terminator + 1);
+}
+
+template <class... Messages>
+struct message_list {
+    /**
+     * Calls `handler` with the first of Messages that `body` matches, decoded, and returns its id;
+     * or returns -1 without calling it. Every call is direct, so `handler` inlines.
+     */
+    template <class Handler>
+    static constexpr int dispatch(std::span<const uint8_t> body, Handler &&handler) {
+        int id = -1;
+        (void)((matches<Messages>(body) && (handler(decode_body<Messages>(body)), id = Messages::id, true)) || ...);
+        return id;
+    }
+};
+
+// Every message, in jr_visca.c's order, which decides between signatures that overlap.
+using messages = message_list<
+    one_byte_response, p_response, pqrs_response, pq_response,
+    pan_tilt_position_inq, pan_tilt_position_response, ack, completion,
+    zoom_stop, zoom_tele_standard, zoom_wide_standard, zoom_tele_variable, zoom_wide_variable,
+    focus_stop, focus_far_standard, focus_near_standard, focus_far_variable, focus_near_variable,
+    pan_tilt_drive, camera_number, memory, clear, motion_sync, preset_recall_speed,
+    absolute_pan_tilt, relative_pan_tilt, home, reset, cancel,
+    menu_enter, menu_return, sony_menu_mode, sony_menu_enter, menu_mode_inq,
+    bright_direct, bright_pos_inq, color_temp_direct, color_temp_inq, flicker_mode, flicker_mode_inq,
+    gain_limit, gain_limit_inq, wb_mode, wb_mode_inq, focus_automatic, focus_manual, focus_af_mode_inq,
+    ae_mode, ae_mode_inq, aperture_value, aperture_value_inq, rgain_value, rgain_value_inq,
+    bgain_value, bgain_value_inq, zoom_direct, zoom_position_inq, focus_value, focus_value_inq,
+    color_gain_direct, color_gain_inq, shutter_value, shutter_pos_inq, iris_value, iris_pos_inq,
+    color_hue_direct, color_hue_inq, lr_reverse, lr_reverse_inq, picture_effect, picture_effect_inq,
+    picture_flip, picture_flip_inq, brightness, brightness_inq, contrast, contrast_inq, awb_sens, awb_sens_inq,
+    notify_subscribe, pan_tilt_notify, lens_notify, error_reply>;
+
+} // namespace jr_visca
+
+#endif
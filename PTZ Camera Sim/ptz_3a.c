@@ -0,0 +1,152 @@
+//
+//  ptz_3a.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_3a.h"
+#include "ptz_color.h"
+#include "ptz_simd.h"
+
+#include <math.h>
+#include <string.h>
+
+// Limits of the controls, from the VISCA ranges.
+#define PTZ_3A_IRIS_MAX 0x11
+#define PTZ_3A_SHUTTER_MAX 0x15
+#define PTZ_3A_GAIN_MAX 0xFF
+
+// Stats runs: 8 pixels, then skip 8; every PTZ_3A_ROW_STEP rows.
+#define PTZ_3A_RUN 8
+#define PTZ_3A_ROW_STEP 4
+
+void ptz_3a_stats_compute(const ptz_image *image, ptz_3a_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    uint64_t sums[3] = { 0 };
+    for (int y = PTZ_3A_ROW_STEP / 2; y < image->height; y += PTZ_3A_ROW_STEP) {
+        const uint8_t *row = ptz_image_row(image, y);
+        // Squares stand in for linear light (gamma 2 instead of 2.2); at most 255^2 * (width / 16) per lane per row.
+        ptz_i32x8 r2 = { 0 }, g2 = { 0 }, b2 = { 0 };
+        for (int x = 0; x + PTZ_3A_RUN <= image->width; x += PTZ_3A_RUN * 2) {
+            ptz_i32x8 v;
+            memcpy(&v, row + x * 4, sizeof(v));
+            ptz_i32x8 r = v & 0xff;
+            ptz_i32x8 g = (v >> 8) & 0xff;
+            ptz_i32x8 b = (v >> 16) & 0xff;
+            r2 += r * r;
+            g2 += g * g;
+            b2 += b * b;
+            ptz_i32x8 luma = (r * 77 + g * 150 + b * 29 + 128) >> 8;
+            for (int i = 0; i < PTZ_3A_RUN; i++) {
+                stats->histogram[luma[i] >> 2]++;
+            }
+            stats->count += PTZ_3A_RUN;
+        }
+        for (int i = 0; i < 8; i++) {
+            sums[0] += (uint32_t)r2[i];
+            sums[1] += (uint32_t)g2[i];
+            sums[2] += (uint32_t)b2[i];
+        }
+    }
+    if (stats->count == 0) {
+        return;
+    }
+    for (int c = 0; c < 3; c++) {
+        stats->mean[c] = (float)((double)sums[c] / stats->count / (255.0 * 255.0));
+    }
+    stats->luma = 0.299f * stats->mean[0] + 0.587f * stats->mean[1] + 0.114f * stats->mean[2];
+}
+
+static int ptz_3a_ae_is_auto(uint32_t aeMode) {
+    return aeMode == PTZ_AE_MODE_FULL_AUTO || aeMode == PTZ_AE_MODE_SHUTTER_PRIORITY || aeMode == PTZ_AE_MODE_IRIS_PRIORITY;
+}
+
+int ptz_3a_is_active(const ptz_camera_state *state) {
+    return ptz_3a_ae_is_auto(state->aeMode) || state->wbMode == PTZ_WB_MODE_AUTO;
+}
+
+static inline float ptz_3a_iris_stops(float iris) {
+    return (iris - PTZ_IRIS_DEFAULT) * 0.5f;
+}
+
+static inline float ptz_3a_shutter_stops(float shutter) {
+    return (PTZ_SHUTTER_DEFAULT - shutter) / 3.0f;
+}
+
+static inline uint32_t ptz_3a_clamp(float value, uint32_t max) {
+    long v = lroundf(value);
+    return (uint32_t)(v < 0 ? 0 : v > (long)max ? (long)max : v);
+}
+
+// Exposure that puts the mean at the target, held back if it would blow out the brightest 2% of the picture.
+static float ptz_3a_desired_stops(const ptz_3a_stats *stats) {
+    float stops = log2f(PTZ_3A_TARGET_LUMA / fmaxf(stats->luma, 1.0f / 4096));
+    uint32_t highlights = stats->count / 50;
+    uint32_t seen = 0;
+    int bin = PTZ_3A_HISTOGRAM_BINS - 1;
+    for (; bin > 0; bin--) {
+        seen += stats->histogram[bin];
+        if (seen > highlights) {
+            break;
+        }
+    }
+    float bright = (bin * 4 + 2) / 255.0f;
+    float headroom = log2f(1.0f / fmaxf(bright * bright, 1.0f / 4096));
+    return fminf(stops, fmaxf(headroom, 0));
+}
+
+static void ptz_3a_expose(const ptz_3a_stats *stats, const ptz_camera_state *state, ptz_3a_settings *settings) {
+    float current = ptz_3a_iris_stops(state->iris) + ptz_3a_shutter_stops(state->shutter);
+    float desired = ptz_3a_desired_stops(stats);
+    float next = current + (desired - current) * PTZ_3A_SPEED;
+    // The controls move in steps; make sure a small error still gets at least one, or it never closes.
+    if (fabsf(desired - current) >= 0.5f && fabsf(next - current) < 0.5f) {
+        next = current + (desired > current ? 0.5f : -0.5f);
+    }
+    switch (state->aeMode) {
+        case PTZ_AE_MODE_SHUTTER_PRIORITY:
+            settings->iris = ptz_3a_clamp(PTZ_IRIS_DEFAULT + 2 * (next - ptz_3a_shutter_stops(state->shutter)), PTZ_3A_IRIS_MAX);
+            break;
+        case PTZ_AE_MODE_IRIS_PRIORITY:
+            settings->shutter = ptz_3a_clamp(PTZ_SHUTTER_DEFAULT - 3 * (next - ptz_3a_iris_stops(state->iris)), PTZ_3A_SHUTTER_MAX);
+            break;
+        default:
+            // Full auto opens and closes the iris first and only touches the shutter once that runs out.
+            settings->iris = ptz_3a_clamp(PTZ_IRIS_DEFAULT + 2 * next, PTZ_3A_IRIS_MAX);
+            settings->shutter = ptz_3a_clamp(PTZ_SHUTTER_DEFAULT - 3 * (next - ptz_3a_iris_stops(settings->iris)),
+                                             PTZ_3A_SHUTTER_MAX);
+            break;
+    }
+}
+
+static uint32_t ptz_3a_balance_gain(uint32_t gain, float reference, float channel) {
+    float desired = (float)PTZ_RGAIN_DEFAULT * reference / fmaxf(channel, 1.0f / 4096);
+    float next = gain + (desired - gain) * PTZ_3A_SPEED;
+    if (fabsf(desired - gain) >= 1 && fabsf(next - gain) < 1) {
+        next = gain + (desired > gain ? 1 : -1);
+    }
+    return ptz_3a_clamp(next, PTZ_3A_GAIN_MAX);
+}
+
+uint32_t ptz_3a_update(const ptz_3a_stats *stats, const ptz_camera_state *state, ptz_3a_settings *settings) {
+    settings->iris = state->iris;
+    settings->shutter = state->shutter;
+    settings->rGain = state->rGain;
+    settings->bGain = state->bGain;
+    if (stats->count == 0) {
+        return 0;
+    }
+    if (ptz_3a_ae_is_auto(state->aeMode)) {
+        ptz_3a_expose(stats, state, settings);
+    }
+    if (state->wbMode == PTZ_WB_MODE_AUTO) {
+        // Gray world: whatever the average color is, it's meant to be gray.
+        settings->rGain = ptz_3a_balance_gain(state->rGain, stats->mean[1], stats->mean[0]);
+        settings->bGain = ptz_3a_balance_gain(state->bGain, stats->mean[1], stats->mean[2]);
+    }
+    return (settings->iris != state->iris ? PTZ_STATE_IRIS : 0)
+         | (settings->shutter != state->shutter ? PTZ_STATE_SHUTTER : 0)
+         | (settings->rGain != state->rGain ? PTZ_STATE_RGAIN : 0)
+         | (settings->bGain != state->bGain ? PTZ_STATE_BGAIN : 0);
+}
@@ -0,0 +1,65 @@
+//
+//  ptz_3a.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Auto exposure and auto white balance. Statistics come from a small render of the view before any
+//  color processing; the control loop then nudges iris, shutter and the R/B gains a little each tick,
+//  so the picture adapts over about a second the way a real camera's does when it pans into the light.
+//
+
+#ifndef ptz_3a_h
+#define ptz_3a_h
+
+#include <stdint.h>
+#include "ptz_render.h"
+#include "ptz_state.h"
+
+// Size of the frame the statistics are taken from, and how often.
+#define PTZ_3A_FRAME_WIDTH 256
+#define PTZ_3A_FRAME_HEIGHT 144
+#define PTZ_3A_TICKS_PER_SECOND 10
+
+// Mean linear luma auto exposure aims for: the classic 18% gray.
+#define PTZ_3A_TARGET_LUMA 0.18f
+// Fraction of the remaining error each tick closes.
+#define PTZ_3A_SPEED 0.25f
+
+#define PTZ_3A_HISTOGRAM_BINS 64
+
+typedef struct ptz_3a_stats {
+    uint32_t histogram[PTZ_3A_HISTOGRAM_BINS];  // sRGB luma, four levels a bin.
+    uint32_t count;
+    float mean[3];          // Linear R, G and B, 0...1, for gray-world white balance.
+    float luma;             // Linear luma, 0...1.
+} ptz_3a_stats;
+
+/**
+ * Statistics for `image` from a grid of 8-pixel runs, every other run on every fourth row.
+ */
+void ptz_3a_stats_compute(const ptz_image *image, ptz_3a_stats *stats);
+
+/**
+ * The settings the automatic modes control.
+ */
+typedef struct ptz_3a_settings {
+    uint32_t iris;
+    uint32_t shutter;
+    uint32_t rGain;
+    uint32_t bGain;
+} ptz_3a_settings;
+
+/**
+ * One tick of the control loop: where each automatic setting should move next, given the scene as `stats`
+ * measured it and the camera's current `state`. Settings the current modes leave to the operator come back
+ * unchanged. Returns the PTZ_STATE_ bits of the settings that changed.
+ */
+uint32_t ptz_3a_update(const ptz_3a_stats *stats, const ptz_camera_state *state, ptz_3a_settings *settings);
+
+/**
+ * Whether `state` has any automatic mode for ptz_3a_update to run.
+ */
+int ptz_3a_is_active(const ptz_camera_state *state);
+
+#endif /* ptz_3a_h */
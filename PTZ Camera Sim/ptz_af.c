@@ -0,0 +1,170 @@
+//
+//  ptz_af.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_af.h"
+#include "ptz_effects.h"
+#include "ptz_simd.h"
+
+#include <string.h>
+
+uint32_t ptz_af_subject_focus(const ptz_camera_state *state) {
+    int focus = 0x30 + (int)state->zoom * 0x90 / PTZ_ZOOM_MAX + state->tilt * 0x18 / PTZ_PT_MAX;
+    return (uint32_t)(focus < 0 ? 0 : focus > PTZ_FOCUS_MAX ? PTZ_FOCUS_MAX : focus);
+}
+
+// Green from eight RGBA pixels, one per 32-bit lane.
+static inline ptz_i32x8 ptz_af_green(const uint8_t *p) {
+    ptz_i32x8 v;
+    memcpy(&v, p, sizeof(v));
+    return (v >> 8) & 0xff;
+}
+
+float ptz_af_sharpness(const ptz_image *image, int left, int top, int width, int height) {
+    if (width < 2 || height < 2) {
+        return 0;
+    }
+    uint64_t sum = 0;
+    for (int y = top; y < top + height - 1; y++) {
+        const uint8_t *row = ptz_image_row(image, y) + left * 4;
+        const uint8_t *below = ptz_image_row(image, y + 1) + left * 4;
+        // At most 2 * 255^2 per lane per step, so a lane can't overflow within a row of any sensible width.
+        ptz_i32x8 acc = { 0 };
+        int x = 0;
+        for (; x + 9 <= width; x += 8) {
+            ptz_i32x8 g = ptz_af_green(row + x * 4);
+            ptz_i32x8 dx = ptz_af_green(row + x * 4 + 4) - g;
+            ptz_i32x8 dy = ptz_af_green(below + x * 4) - g;
+            acc += dx * dx + dy * dy;
+        }
+        for (int i = 0; i < 8; i++) {
+            sum += (uint32_t)acc[i];
+        }
+        for (; x < width - 1; x++) {
+            int g = row[x * 4 + 1];
+            int dx = row[x * 4 + 5] - g;
+            int dy = below[x * 4 + 1] - g;
+            sum += (uint64_t)(dx * dx + dy * dy);
+        }
+    }
+    return (float)((double)sum / ((double)(width - 1) * (height - 1)));
+}
+
+void ptz_af_probe_init(ptz_af_probe *probe) {
+    memset(probe, 0, sizeof(*probe));
+    ptz_renderer_init(&probe->renderer);
+}
+
+void ptz_af_probe_destroy(ptz_af_probe *probe) {
+    ptz_renderer_destroy(&probe->renderer);
+    ptz_image_free(&probe->view);
+    ptz_image_free(&probe->defocused);
+}
+
+float ptz_af_measure(ptz_af_probe *probe, const ptz_pyramid *pyramid, const ptz_camera_state *state, uint32_t focus) {
+    if (pyramid->levelCount == 0 || ptz_image_alloc(&probe->view, PTZ_AF_PROBE_WIDTH, PTZ_AF_PROBE_HEIGHT) < 0) {
+        return -1;
+    }
+    // Like a real AF sensor, it looks at full resolution: the middle of the view, no more than a probe's worth
+    // of sensor pixels, so even the slight blur of a wide shot shows up.
+    const ptz_image *sensor = &pyramid->levels[0];
+    ptz_viewport viewport;
+    ptz_viewport_for_state(state, sensor->width, sensor->height, PTZ_AF_PROBE_WIDTH * 3, PTZ_AF_PROBE_HEIGHT * 3, &viewport);
+    float scale = viewport.width / 3 > PTZ_AF_PROBE_WIDTH ? 1 : viewport.width / 3 / PTZ_AF_PROBE_WIDTH;
+    ptz_viewport probeViewport = { viewport.x + (viewport.width - PTZ_AF_PROBE_WIDTH * scale) / 2,
+                                   viewport.y + (viewport.height - PTZ_AF_PROBE_HEIGHT * scale) / 2,
+                                   PTZ_AF_PROBE_WIDTH * scale, PTZ_AF_PROBE_HEIGHT * scale };
+    if (ptz_render_viewport(&probe->renderer, sensor, &probeViewport, &probe->view) < 0) {
+        return -1;
+    }
+
+    // Same blur the effects pass would apply at this focus, scaled from sensor pixels to probe pixels.
+    ptz_camera_state lens = *state;
+    lens.focus = focus;
+    ptz_effects effects;
+    ptz_effects_for_state(&lens, NULL, &effects);
+    effects.flipH = effects.flipV = 0;
+    ptz_effects_scale(&effects, 1 / scale);
+    const ptz_image *measured = &probe->view;
+    if (effects.blurRadius > 0) {
+        if (ptz_render_effects(&probe->renderer, &probe->view, &effects, &probe->defocused) < 0) {
+            return -1;
+        }
+        measured = &probe->defocused;
+    }
+    return ptz_af_sharpness(measured, 0, 0, measured->width, measured->height);
+}
+
+void ptz_af_start(ptz_af *af, uint32_t focus) {
+    af->searching = 1;
+    af->scanning = 1;
+    af->reversed = 0;
+    af->origin = (int)focus;
+    af->position = (int)focus;
+    // Whichever way the last search went; the subject usually moves the same way again.
+    af->direction = af->direction < 0 ? -1 : 1;
+    af->step = PTZ_AF_STEP;
+    af->best = (int)focus;
+    af->bestScore = -1;
+    af->ticks = 0;
+}
+
+static int ptz_af_in_range(int focus) {
+    return focus >= 0 && focus <= PTZ_FOCUS_MAX;
+}
+
+uint32_t ptz_af_step(ptz_af *af, float score) {
+    if (!af->searching) {
+        return (uint32_t)af->position;
+    }
+    int improved = score > af->bestScore * 1.001f;
+    if (improved) {
+        af->best = af->position;
+        af->bestScore = score;
+    }
+    // Halving counts as falling off a peak only if there was something there to fall from.
+    int fell = !improved && af->bestScore >= PTZ_AF_FLAT_SCORE && score < af->bestScore * 0.5f;
+    int next;
+    if (af->scanning && fell && af->best == af->origin && !af->reversed) {
+        // Worse from the first step: the subject is the other way.
+        af->reversed = 1;
+        af->direction = -af->direction;
+        next = af->origin + af->direction * af->step;
+    } else if (af->scanning && fell) {
+        // Fell off a peak: go back and narrow in on it.
+        af->scanning = 0;
+        af->direction = -af->direction;
+        af->step /= 2;
+        next = af->best + af->direction * af->step;
+    } else if (af->scanning) {
+        // Far out of focus everything looks equally soft, so the scan can't be steered by small changes.
+        next = af->position + af->direction * af->step;
+        if (!ptz_af_in_range(next) && !af->reversed) {
+            af->reversed = 1;
+            af->direction = -af->direction;
+            next = af->origin + af->direction * af->step;
+        }
+        if (!ptz_af_in_range(next)) {
+            // Swept everything; the best we saw is as good as it gets.
+            af->scanning = 0;
+            af->step /= 2;
+            next = af->best + af->direction * af->step;
+        }
+    } else if (improved) {
+        next = af->best + af->direction * af->step;
+    } else {
+        af->direction = -af->direction;
+        af->step /= 2;
+        next = af->best + af->direction * af->step;
+    }
+    next = next < 0 ? 0 : next > PTZ_FOCUS_MAX ? PTZ_FOCUS_MAX : next;
+    if (af->step == 0 || ++af->ticks >= PTZ_AF_MAX_TICKS) {
+        af->searching = 0;
+        next = af->best;
+    }
+    af->position = next;
+    return (uint32_t)next;
+}
@@ -0,0 +1,89 @@
+//
+//  ptz_af.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Contrast-detection autofocus. Each tick the camera renders a small probe of the middle of the view at the
+//  current focus, scores its sharpness, and a hill climb picks where to move the lens next, so focus hunts
+//  and settles over a few hundred milliseconds the way real cameras do.
+//
+
+#ifndef ptz_af_h
+#define ptz_af_h
+
+#include <stdint.h>
+#include "ptz_render.h"
+#include "ptz_pyramid.h"
+
+// The probe is the middle of the view at sensor resolution, or the middle third when zoomed in closer than that.
+#define PTZ_AF_PROBE_WIDTH 128
+#define PTZ_AF_PROBE_HEIGHT 72
+#define PTZ_AF_TICKS_PER_SECOND 30
+
+// Focus move per tick while sweeping; narrowing in halves it at every reversal.
+#define PTZ_AF_STEP 16
+// Scores below this are a featureless blur, where differences are just noise; the sweep doesn't stop for them.
+#define PTZ_AF_FLAT_SCORE 1.0f
+// Give up and take the best position so far after this many ticks.
+#define PTZ_AF_MAX_TICKS 60
+
+/**
+ * Focus position at which the subject in the middle of the view is sharp. The sim has no depth map, so this is
+ * a made-up but smooth function of the view: zoomed in is farther away, and tilting down finds nearer ground.
+ */
+uint32_t ptz_af_subject_focus(const ptz_camera_state *state);
+
+/**
+ * Gradient energy of the green channel over a rectangle of `image`: the mean of dx^2 + dy^2.
+ * Higher is sharper; only comparable between images of the same scene.
+ */
+float ptz_af_sharpness(const ptz_image *image, int left, int top, int width, int height);
+
+/**
+ * Scratch space for ptz_af_measure. One per thread.
+ */
+typedef struct ptz_af_probe {
+    ptz_renderer renderer;
+    ptz_image view;
+    ptz_image defocused;
+} ptz_af_probe;
+
+void ptz_af_probe_init(ptz_af_probe *probe);
+void ptz_af_probe_destroy(ptz_af_probe *probe);
+
+/**
+ * Sharpness the camera would see for `state` with the lens at `focus`, measured on a probe rendered from
+ * `pyramid` (before effects) and defocused the way ptz_effects would. Returns -1 on allocation failure.
+ */
+float ptz_af_measure(ptz_af_probe *probe, const ptz_pyramid *pyramid, const ptz_camera_state *state, uint32_t focus);
+
+/**
+ * One search. Plain values, so a fleet of cameras can keep theirs in an array.
+ */
+typedef struct ptz_af {
+    int searching;
+    int scanning;       // Sweeping at full steps until the score falls off a peak, then narrowing in.
+    int reversed;       // The sweep hit an end stop and went back the other way from `origin`.
+    int origin;
+    int position;       // Where the lens is now; the next score is for this position.
+    int direction;      // +1 or -1.
+    int step;
+    int best;
+    float bestScore;
+    int ticks;
+} ptz_af;
+
+/**
+ * Starts a search from the lens's current `focus`. Restarting a search in progress is fine;
+ * zero `af` before its first search.
+ */
+void ptz_af_start(ptz_af *af, uint32_t focus);
+
+/**
+ * Takes the sharpness at af->position and returns where the lens goes next. Once `searching` drops to 0
+ * the return value is the final position.
+ */
+uint32_t ptz_af_step(ptz_af *af, float score);
+
+#endif /* ptz_af_h */
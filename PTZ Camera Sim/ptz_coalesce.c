@@ -0,0 +1,45 @@
+//
+//  ptz_coalesce.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_coalesce.h"
+#include "jr_visca.h"
+
+int ptz_drive_group(int messageType) {
+    switch (messageType) {
+        case JR_VISCA_MESSAGE_PAN_TILT_DRIVE:
+            return PTZ_DRIVE_GROUP_PAN_TILT;
+        case JR_VISCA_MESSAGE_ZOOM_STOP:
+        case JR_VISCA_MESSAGE_ZOOM_TELE_STANDARD:
+        case JR_VISCA_MESSAGE_ZOOM_WIDE_STANDARD:
+        case JR_VISCA_MESSAGE_ZOOM_TELE_VARIABLE:
+        case JR_VISCA_MESSAGE_ZOOM_WIDE_VARIABLE:
+            return PTZ_DRIVE_GROUP_ZOOM;
+        default:
+            return 0;
+    }
+}
+
+void ptz_coalesce_init(ptz_coalesce *coalesce, int menuVisible, int oneCamera) {
+    coalesce->seen = 0;
+    coalesce->menuVisible = menuVisible;
+    coalesce->oneCamera = oneCamera;
+}
+
+int ptz_coalesce_superseded(ptz_coalesce *coalesce, int messageType, uint8_t receiver) {
+    if (messageType == JR_VISCA_MESSAGE_CAMERA_NUMBER) {
+        coalesce->seen = 0;
+        return 0;
+    }
+    int group = ptz_drive_group(messageType);
+    if (group == 0 || (group == PTZ_DRIVE_GROUP_PAN_TILT && coalesce->menuVisible)) {
+        return 0;
+    }
+    uint32_t bit = 1u << ((group - 1) * 16 + (coalesce->oneCamera ? 0 : (receiver & 0x0f)));
+    int superseded = (coalesce->seen & bit) != 0;
+    coalesce->seen |= bit;
+    return superseded;
+}
@@ -0,0 +1,44 @@
+//
+//  ptz_coalesce.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Which drives in a receive batch can be skipped. Joysticks send drives at 50-100 Hz, faster than the camera
+//  steps, so of the drives in one batch for the same camera only the newest is carried out; the ones it replaces
+//  are superseded, and just get their ACK and Completion in turn. camera_handler and ptzd's engine both use it.
+//
+
+#ifndef ptz_coalesce_h
+#define ptz_coalesce_h
+
+#include <stdint.h>
+
+#define PTZ_DRIVE_GROUP_PAN_TILT 1
+#define PTZ_DRIVE_GROUP_ZOOM 2
+
+/**
+ * The group of commands `messageType` belongs to that replace whatever the last one in their group set going,
+ * rather than adding to it, or 0 if it's not a drive.
+ */
+int ptz_drive_group(int messageType);
+
+typedef struct ptz_coalesce {
+    uint32_t seen;          // A bit per group and receiver address.
+    int menuVisible;
+    int oneCamera;
+} ptz_coalesce;
+
+/**
+ * Starts on a batch. With the menu up each Pan_TiltDrive is a step through it, and every one counts.
+ * With `oneCamera` every frame is for the same camera, whatever address it was sent to.
+ */
+void ptz_coalesce_init(ptz_coalesce *coalesce, int menuVisible, int oneCamera);
+
+/**
+ * Call for each frame in the batch, newest first. Returns 1 if a newer drive replaces it.
+ * An Address Set renumbers the chain, so nothing on either side of one is matched up.
+ */
+int ptz_coalesce_superseded(ptz_coalesce *coalesce, int messageType, uint8_t receiver);
+
+#endif /* ptz_coalesce_h */
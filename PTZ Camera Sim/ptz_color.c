@@ -0,0 +1,219 @@
+//
+//  ptz_color.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_color.h"
+
+#include <string.h>
+#include <math.h>
+
+// Don't let a bad combination of settings turn the picture completely black or white.
+#define PTZ_MAX_EXPOSURE_STOPS 4.0f
+
+void ptz_color_params_for_state(const ptz_camera_state *state, ptz_color_params *params) {
+    memset(params, 0, sizeof(*params));
+    params->wbMode = state->wbMode;
+    params->colorTempIndex = state->colorTempIndex;
+    params->rGain = state->rGain;
+    params->bGain = state->bGain;
+    params->colorgain = state->colorgain;
+    params->hue = state->hue;
+    params->brightness = state->brightness;
+    params->contrast = state->contrast;
+    params->aperture = state->aperture;
+    params->aeMode = state->aeMode;
+    params->iris = state->iris;
+    params->shutter = state->shutter;
+    params->brightPos = state->brightPos;
+    params->bwMode = state->bwMode;
+}
+
+float ptz_color_exposure_stops(const ptz_color_params *params) {
+    float stops = 0;
+    switch (params->aeMode) {
+        case PTZ_AE_MODE_BRIGHT:
+            stops = ((float)params->brightPos - PTZ_BRIGHT_DEFAULT) * 0.25f;
+            break;
+        default:
+            // Manual, or wherever ptz_3a has driven them in the automatic modes.
+            stops = ((float)params->iris - PTZ_IRIS_DEFAULT) * 0.5f
+                  + ((float)PTZ_SHUTTER_DEFAULT - params->shutter) / 3.0f;
+            break;
+    }
+    return fminf(fmaxf(stops, -PTZ_MAX_EXPOSURE_STOPS), PTZ_MAX_EXPOSURE_STOPS);
+}
+
+// Tanner Helland's fit of the blackbody curve, scaled to 0..1.
+static void ptz_kelvin_to_rgb(float kelvin, float rgb[3]) {
+    float t = kelvin / 100.0f;
+    float r, g, b;
+    if (t <= 66) {
+        r = 255;
+        g = 99.4708025861f * logf(t) - 161.1195681661f;
+    } else {
+        r = 329.698727446f * powf(t - 60, -0.1332047592f);
+        g = 288.1221695283f * powf(t - 60, -0.0755148492f);
+    }
+    if (t >= 66) {
+        b = 255;
+    } else if (t <= 19) {
+        b = 0;
+    } else {
+        b = 138.5177312231f * logf(t - 10) - 305.0447927307f;
+    }
+    rgb[0] = fminf(fmaxf(r, 1), 255) / 255.0f;
+    rgb[1] = fminf(fmaxf(g, 1), 255) / 255.0f;
+    rgb[2] = fminf(fmaxf(b, 1), 255) / 255.0f;
+}
+
+// Gains that correct for light of `kelvin`, keeping the overall brightness.
+static void ptz_kelvin_gains(float kelvin, float gains[3]) {
+    float light[3], neutral[3];
+    ptz_kelvin_to_rgb(kelvin, light);
+    ptz_kelvin_to_rgb(6500.0f, neutral);
+    for (int c = 0; c < 3; c++) {
+        gains[c] = neutral[c] / light[c];
+    }
+    float luma = 0.299f * gains[0] + 0.587f * gains[1] + 0.114f * gains[2];
+    for (int c = 0; c < 3; c++) {
+        gains[c] /= luma;
+    }
+}
+
+static void ptz_white_balance_gains(const ptz_color_params *params, float gains[3]) {
+    gains[0] = gains[1] = gains[2] = 1.0f;
+    // The source image is already warm, so the temperatures are shifted up 3000K to land near neutral.
+    switch (params->wbMode) {
+        case PTZ_WB_MODE_COLOR:
+            // PTZ: 0x00: 2500K ~ 0x37: 8000K
+            ptz_kelvin_gains(params->colorTempIndex * 100.0f + 2500.0f + 3000.0f, gains);
+            break;
+        case PTZ_WB_MODE_INDOOR:
+            ptz_kelvin_gains(3200.0f + 3000.0f, gains);
+            break;
+        case PTZ_WB_MODE_OUTDOOR:
+            ptz_kelvin_gains(5800.0f + 3000.0f, gains);
+            break;
+        case PTZ_WB_MODE_AUTO:
+            // ptz_3a keeps the gains where the scene needs them.
+        case PTZ_WB_MODE_MANUAL:
+            gains[0] = (float)params->rGain / PTZ_RGAIN_DEFAULT;
+            gains[2] = (float)params->bGain / PTZ_BGAIN_DEFAULT;
+            break;
+        default:
+            // One push: the scene is already balanced.
+            break;
+    }
+}
+
+static inline float ptz_srgb_to_linear(float c) {
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static inline float ptz_linear_to_srgb(float c) {
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static inline float ptz_clamp01(float v) {
+    return fminf(fmaxf(v, 0), 1);
+}
+
+/**
+ * Everything the LUT does, for one color, in the order a camera's processing chain would:
+ * white balance and exposure on linear light, then the tone controls, then saturation and hue, then B&W.
+ */
+typedef struct ptz_color_model {
+    float gains[3];         // White balance times exposure, linear.
+    float brightness;       // Offset, -0.25...0.25.
+    float contrast;         // Slope around mid gray.
+    float aperture;         // Mid-tone S-curve strength, -0.2...0.2.
+    float saturation;
+    float hueCos, hueSin;
+    int monochrome;
+} ptz_color_model;
+
+static void ptz_color_model_init(ptz_color_model *model, const ptz_color_params *params) {
+    float wb[3];
+    ptz_white_balance_gains(params, wb);
+    float exposure = exp2f(ptz_color_exposure_stops(params));
+    for (int c = 0; c < 3; c++) {
+        model->gains[c] = wb[c] * exposure;
+    }
+    model->brightness = ((float)params->brightness - PTZ_BRIGHTNESS_DEFAULT) / 7.0f * 0.25f;
+    model->contrast = 1.0f + ((float)params->contrast - PTZ_CONTRAST_DEFAULT) / 7.0f * 0.5f;
+    // Aperture is really edge enhancement, which a per-pixel table can't do. Mid-tone contrast reads as "crisper" instead.
+    model->aperture = ((float)params->aperture - PTZ_APERTURE_DEFAULT) / 8.0f * 0.2f;
+    model->saturation = 0.6f + 0.1f * (float)params->colorgain;
+    float degrees = ((float)params->hue - PTZ_HUE_DEFAULT) * 2.0f;
+    model->hueCos = cosf(degrees * (float)M_PI / 180.0f);
+    model->hueSin = sinf(degrees * (float)M_PI / 180.0f);
+    model->monochrome = params->bwMode != 0;
+}
+
+static void ptz_color_model_apply(const ptz_color_model *model, const float in[3], float out[3]) {
+    float rgb[3];
+    for (int c = 0; c < 3; c++) {
+        float v = ptz_linear_to_srgb(ptz_clamp01(ptz_srgb_to_linear(in[c]) * model->gains[c]));
+        v += model->brightness;
+        v = (v - 0.5f) * model->contrast + 0.5f;
+        v = ptz_clamp01(v);
+        float s = v * v * (3.0f - 2.0f * v);
+        rgb[c] = v + (s - v) * model->aperture;
+    }
+    float y = 0.299f * rgb[0] + 0.587f * rgb[1] + 0.114f * rgb[2];
+    if (model->monochrome) {
+        out[0] = out[1] = out[2] = ptz_clamp01(y);
+        return;
+    }
+    // Hue rotation and saturation in YIQ, which keeps luma where it is.
+    float i = 0.596f * rgb[0] - 0.274f * rgb[1] - 0.322f * rgb[2];
+    float q = 0.211f * rgb[0] - 0.523f * rgb[1] + 0.312f * rgb[2];
+    float i2 = (i * model->hueCos - q * model->hueSin) * model->saturation;
+    float q2 = (i * model->hueSin + q * model->hueCos) * model->saturation;
+    out[0] = ptz_clamp01(y + 0.956f * i2 + 0.621f * q2);
+    out[1] = ptz_clamp01(y - 0.272f * i2 - 0.647f * q2);
+    out[2] = ptz_clamp01(y - 1.106f * i2 + 1.703f * q2);
+}
+
+static int ptz_color_params_are_neutral(const ptz_color_params *params) {
+    float wb[3];
+    ptz_white_balance_gains(params, wb);
+    return wb[0] == 1.0f && wb[1] == 1.0f && wb[2] == 1.0f
+        && ptz_color_exposure_stops(params) == 0
+        && params->brightness == PTZ_BRIGHTNESS_DEFAULT && params->contrast == PTZ_CONTRAST_DEFAULT
+        && params->aperture == PTZ_APERTURE_DEFAULT && params->colorgain == PTZ_COLOR_GAIN_DEFAULT
+        && params->hue == PTZ_HUE_DEFAULT && !params->bwMode;
+}
+
+void ptz_color_lut_init(ptz_color_lut *lut) {
+    memset(lut, 0, sizeof(*lut));
+}
+
+int ptz_color_lut_update(ptz_color_lut *lut, const ptz_color_params *params) {
+    if (lut->valid && memcmp(&lut->params, params, sizeof(*params)) == 0) {
+        return 0;
+    }
+    lut->params = *params;
+    lut->valid = 1;
+    lut->identity = ptz_color_params_are_neutral(params);
+
+    ptz_color_model model;
+    ptz_color_model_init(&model, params);
+    ptz_f32x4 *entry = lut->table;
+    for (int r = 0; r < PTZ_LUT_SIZE; r++) {
+        for (int g = 0; g < PTZ_LUT_SIZE; g++) {
+            for (int b = 0; b < PTZ_LUT_SIZE; b++, entry++) {
+                const float in[3] = {
+                    (float)r / (PTZ_LUT_SIZE - 1), (float)g / (PTZ_LUT_SIZE - 1), (float)b / (PTZ_LUT_SIZE - 1)
+                };
+                float out[3];
+                ptz_color_model_apply(&model, in, out);
+                *entry = (ptz_f32x4){ out[0] * 255.0f, out[1] * 255.0f, out[2] * 255.0f, 0 };
+            }
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,120 @@
+//
+//  ptz_color.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Camera "painting": every VISCA color and exposure setting folded into one 3D LUT.
+//
+
+#ifndef ptz_color_h
+#define ptz_color_h
+
+#include <stdint.h>
+#include "ptz_state.h"
+#include "ptz_simd.h"
+
+// CAM_WB modes. PTZ_WB_MODE_COLOR (color temperature) is in ptz_state.h.
+#define PTZ_WB_MODE_AUTO 0x00
+#define PTZ_WB_MODE_INDOOR 0x01
+#define PTZ_WB_MODE_OUTDOOR 0x02
+#define PTZ_WB_MODE_ONE_PUSH 0x03
+#define PTZ_WB_MODE_MANUAL 0x05
+
+// CAM_AE modes.
+#define PTZ_AE_MODE_FULL_AUTO 0x00
+#define PTZ_AE_MODE_MANUAL 0x03
+#define PTZ_AE_MODE_SHUTTER_PRIORITY 0x0A
+#define PTZ_AE_MODE_IRIS_PRIORITY 0x0B
+#define PTZ_AE_MODE_BRIGHT 0x0D
+
+// Power-on values, which are also the neutral point of each control.
+#define PTZ_RGAIN_DEFAULT 0x80
+#define PTZ_BGAIN_DEFAULT 0x80
+#define PTZ_COLOR_GAIN_DEFAULT 0x04     // 0x0-0xE: 60%-200% saturation, 0x4 is 100%
+#define PTZ_HUE_DEFAULT 0x07            // 0x0-0xE: -14...+14 degrees
+#define PTZ_BRIGHTNESS_DEFAULT 0x07     // 0x0-0xE
+#define PTZ_CONTRAST_DEFAULT 0x07       // 0x0-0xE
+#define PTZ_APERTURE_DEFAULT 0x08       // 0x0-0xF
+#define PTZ_IRIS_DEFAULT 0x0D           // F2.8; 0x00 closed ... 0x11 F1.6, about half a stop a step
+#define PTZ_SHUTTER_DEFAULT 0x0A        // 0x00 slowest ... 0x15 fastest, about a third of a stop a step
+#define PTZ_BRIGHT_DEFAULT 0x0F         // 0x00-0x1F, about a quarter stop a step
+
+// Lattice points per axis. 17 is the usual size: 16 even steps of 16 levels, small enough to stay in L2.
+#define PTZ_LUT_SIZE 17
+
+/**
+ * The part of ptz_camera_state that affects color. Only these are compared when deciding to rebuild the LUT.
+ */
+typedef struct ptz_color_params {
+    uint32_t wbMode;
+    uint32_t colorTempIndex;
+    uint32_t rGain;
+    uint32_t bGain;
+    uint32_t colorgain;
+    uint32_t hue;
+    uint32_t brightness;
+    uint32_t contrast;
+    uint32_t aperture;
+    uint32_t aeMode;
+    uint32_t iris;
+    uint32_t shutter;
+    uint32_t brightPos;
+    uint32_t bwMode;
+} ptz_color_params;
+
+void ptz_color_params_for_state(const ptz_camera_state *state, ptz_color_params *params);
+
+/**
+ * Exposure offset in stops for the AE mode: iris and shutter, which ptz_3a drives in the automatic modes,
+ * or the bright position.
+ */
+float ptz_color_exposure_stops(const ptz_color_params *params);
+
+typedef struct ptz_color_lut {
+    ptz_color_params params;    // What `table` was built from.
+    int valid;
+    int identity;               // Every setting is neutral; callers can skip the lookup.
+    // RGB output (0-255, alpha lane unused) at each lattice point, blue fastest.
+    ptz_f32x4 table[PTZ_LUT_SIZE * PTZ_LUT_SIZE * PTZ_LUT_SIZE];
+} ptz_color_lut;
+
+void ptz_color_lut_init(ptz_color_lut *lut);
+
+/**
+ * Rebuilds the table if `params` differ from what it was built from.
+ * Returns 1 if it rebuilt, 0 if the table was already current.
+ */
+int ptz_color_lut_update(ptz_color_lut *lut, const ptz_color_params *params);
+
+/**
+ * Trilinear lookup of one pixel. `rgba` is 0-255 per channel; alpha passes through.
+ * Each lattice entry is one vector, so the eight corner fetches are plain loads and the blends work on all channels at once.
+ */
+static inline ptz_f32x4 ptz_color_lut_sample(const ptz_color_lut *lut, ptz_f32x4 rgba) {
+    const float step = (PTZ_LUT_SIZE - 1) / 255.0f;
+    ptz_f32x4 pos = rgba * step;
+    ptz_i32x4 cell = PTZ_CONVERT(pos, ptz_i32x4);
+    // 255 lands exactly on the last lattice point; use the cell below it with a weight of 1.
+    ptz_i32x4 top = (ptz_i32x4){ 0 } + (PTZ_LUT_SIZE - 2);
+    ptz_i32x4 over = cell > top;
+    cell = (cell & ~over) | (top & over);
+    ptz_f32x4 f = pos - PTZ_CONVERT(cell, ptz_f32x4);
+
+    const int sR = PTZ_LUT_SIZE * PTZ_LUT_SIZE, sG = PTZ_LUT_SIZE;
+    const ptz_f32x4 *c = lut->table + cell[0] * sR + cell[1] * sG + cell[2];
+    ptz_f32x4 fr = (ptz_f32x4){ 0 } + f[0];
+    ptz_f32x4 fg = (ptz_f32x4){ 0 } + f[1];
+    ptz_f32x4 fb = (ptz_f32x4){ 0 } + f[2];
+    ptz_f32x4 c00 = c[0] + (c[1] - c[0]) * fb;
+    ptz_f32x4 c01 = c[sG] + (c[sG + 1] - c[sG]) * fb;
+    ptz_f32x4 c10 = c[sR] + (c[sR + 1] - c[sR]) * fb;
+    ptz_f32x4 c11 = c[sR + sG] + (c[sR + sG + 1] - c[sR + sG]) * fb;
+    ptz_f32x4 c0 = c00 + (c01 - c00) * fg;
+    ptz_f32x4 c1 = c10 + (c11 - c10) * fg;
+    ptz_f32x4 out = c0 + (c1 - c0) * fr;
+    out[3] = rgba[3];
+    return out;
+}
+
+#endif /* ptz_color_h */
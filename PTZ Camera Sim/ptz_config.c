@@ -0,0 +1,174 @@
+//
+//  ptz_config.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_config.h"
+#include "ptz_profile.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+void ptz_config_defaults(ptz_config *config) {
+    memset(config, 0, sizeof(*config));
+    config->cameras = 1;
+    config->port = 5678;
+    config->tickMs = 100;
+    config->telemetryMB = 64;
+}
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+static int parse_int(const char *value, long min, long max, long *result) {
+    char *end;
+    errno = 0;
+    long parsed = strtol(value, &end, 0);
+    if (end == value || *end != '\0' || errno || parsed < min || parsed > max) {
+        return -1;
+    }
+    *result = parsed;
+    return 0;
+}
+
+// Built-in names stay as they are; a relative path is taken from the config file's directory.
+static int resolve_profile(char *profile, const char *directory, int directoryLength, const char *value) {
+    ptz_profile builtin;
+    int length;
+    if (*value == '\0' || *value == '/' || directoryLength == 0 || ptz_profile_builtin(&builtin, value) == 0) {
+        length = snprintf(profile, PTZ_CONFIG_PATH, "%s", value);
+    } else {
+        length = snprintf(profile, PTZ_CONFIG_PATH, "%.*s%s", directoryLength, directory, value);
+    }
+    return (length < PTZ_CONFIG_PATH) ? 0 : -1;
+}
+
+static int parse_line(ptz_config *config, const char *path, int directoryLength, const char *key, const char *value) {
+    long number;
+    if (strcasecmp(key, "cameras") == 0) {
+        if (parse_int(value, 1, PTZ_CONFIG_CAMERAS, &number) < 0) {
+            return -1;
+        }
+        config->cameras = (int)number;
+    } else if (strcasecmp(key, "port") == 0) {
+        if (parse_int(value, 0, 65535, &number) < 0) {
+            return -1;
+        }
+        config->port = (int)number;
+    } else if (strcasecmp(key, "tick_ms") == 0) {
+        if (parse_int(value, 1, 10000, &number) < 0) {
+            return -1;
+        }
+        config->tickMs = (uint32_t)number;
+    } else if (strcasecmp(key, "notify_rate") == 0) {
+        if (parse_int(value, 0, 1000, &number) < 0) {
+            return -1;
+        }
+        config->notifyRate = (int)number;
+    } else if (strcasecmp(key, "telemetry") == 0) {
+        int length = snprintf(config->telemetry, sizeof(config->telemetry), "%s", value);
+        return (length < (int)sizeof(config->telemetry)) ? 0 : -1;
+    } else if (strcasecmp(key, "telemetry_mb") == 0) {
+        if (parse_int(value, 1, 1 << 20, &number) < 0) {
+            return -1;
+        }
+        config->telemetryMB = (uint32_t)number;
+    } else if (strcasecmp(key, "profile") == 0) {
+        return resolve_profile(config->profile, path, directoryLength, value);
+    } else if (strncasecmp(key, "profile.", 8) == 0) {
+        if (parse_int(key + 8, 0, PTZ_CONFIG_CAMERAS - 1, &number) < 0) {
+            return -1;
+        }
+        ptz_config_override *override = NULL;
+        for (int i = 0; i < config->overrideCount; i++) {
+            if (config->overrides[i].camera == number) {
+                override = &config->overrides[i];
+            }
+        }
+        if (!override) {
+            if (config->overrideCount == PTZ_CONFIG_OVERRIDES) {
+                return -1;
+            }
+            override = &config->overrides[config->overrideCount++];
+            override->camera = (int)number;
+        }
+        return resolve_profile(override->profile, path, directoryLength, value);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int ptz_config_load(ptz_config *config, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    const char *slash = strrchr(path, '/');
+    int directoryLength = slash ? (int)(slash - path + 1) : 0;
+
+    char line[512];
+    int lineNumber = 0;
+    int result = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char *text = trim(line);
+        if (*text == '\0') {
+            continue;
+        }
+        char *equals = strchr(text, '=');
+        if (!equals) {
+            fprintf(stderr, "%s:%d: expected key = value\n", path, lineNumber);
+            result = -1;
+            break;
+        }
+        *equals = '\0';
+        char *key = trim(text);
+        char *value = trim(equals + 1);
+        if (parse_line(config, path, directoryLength, key, value) < 0) {
+            fprintf(stderr, "%s:%d: bad %s\n", path, lineNumber, key);
+            result = -1;
+            break;
+        }
+    }
+    fclose(file);
+    if (result == 0 && config->port && config->port + config->cameras - 1 > 65535) {
+        fprintf(stderr, "%s: %d cameras from port %d run out of ports\n", path, config->cameras, config->port);
+        result = -1;
+    }
+    for (int i = 0; result == 0 && i < config->overrideCount; i++) {
+        if (config->overrides[i].camera >= config->cameras) {
+            fprintf(stderr, "%s: profile.%d is past the last camera\n", path, config->overrides[i].camera);
+            result = -1;
+        }
+    }
+    return result;
+}
+
+const char *ptz_config_profile(const ptz_config *config, int camera) {
+    for (int i = 0; i < config->overrideCount; i++) {
+        if (config->overrides[i].camera == camera) {
+            return config->overrides[i].profile;
+        }
+    }
+    return config->profile;
+}
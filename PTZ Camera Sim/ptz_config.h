@@ -0,0 +1,64 @@
+//
+//  ptz_config.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  How ptzd, the headless simulator, is set up: how many cameras, where they listen, and what they're like.
+//  A file like this, in the same form as a profile (ptz_profile.h):
+//
+//      # Sixteen cameras for the controller CI
+//      cameras = 16                    # 1-PTZ_CONFIG_CAMERAS.
+//      port = 5678                     # The first camera's VISCA port; the rest follow on. 0 picks free ones.
+//      tick_ms = 100                   # How often moves advance.
+//      notify_rate = 0                 # Position notifications a second to every controller; 0 for none.
+//      profile = sony                  # Every camera's, built in or a file, relative to this one.
+//      profile.3 = bench/srg300.profile  # Or one camera's, counting from 0.
+//      telemetry = ptzd.telemetry      # Where to record every move (ptz_telemetry.h); none if it's not set.
+//      telemetry_mb = 64               # How big that can get before it starts over the oldest.
+//
+
+#ifndef ptz_config_h
+#define ptz_config_h
+
+#include <stdint.h>
+
+#define PTZ_CONFIG_CAMERAS 4096
+#define PTZ_CONFIG_OVERRIDES 64
+#define PTZ_CONFIG_PATH 256
+
+typedef struct ptz_config_override {
+    int camera;
+    char profile[PTZ_CONFIG_PATH];
+} ptz_config_override;
+
+typedef struct ptz_config {
+    int cameras;
+    int port;
+    uint32_t tickMs;
+    int notifyRate;
+    char profile[PTZ_CONFIG_PATH];      // A built-in name, or a path; "" is "sim".
+    char telemetry[PTZ_CONFIG_PATH];    // From the working directory, like any file a program writes.
+    uint32_t telemetryMB;
+    int overrideCount;
+    ptz_config_override overrides[PTZ_CONFIG_OVERRIDES];
+} ptz_config;
+
+/**
+ * One "sim" camera on 5678, the port the app listens on, ticking every 100ms, with no telemetry.
+ */
+void ptz_config_defaults(ptz_config *config);
+
+/**
+ * Reads a config file, in the format above, over the defaults. Profile paths come back relative to the
+ * working directory rather than to the file.
+ * Returns 0, or -1 after saying what was wrong with it on stderr.
+ */
+int ptz_config_load(ptz_config *config, const char *path);
+
+/**
+ * The profile `camera` should load: its own, or everyone's.
+ */
+const char *ptz_config_profile(const ptz_config *config, int camera);
+
+#endif /* ptz_config_h */
@@ -0,0 +1,316 @@
+//
+//  ptz_effects.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_effects.h"
+#include "ptz_af.h"
+#include "ptz_simd.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Columns per strip. Wide enough to stream well, small enough that the ring of filtered rows stays in L2.
+#define PTZ_EFFECTS_STRIP 1024
+
+void ptz_effects_for_state(const ptz_camera_state *state, ptz_color_lut *lut, ptz_effects *effects) {
+    memset(effects, 0, sizeof(*effects));
+    // How far the lens is from the subject, on the same 0-20 scale as PTZCamera focusPixelRadius, treated as a Gaussian sigma.
+    // A box of width w has variance (w*w - 1) / 12; a box is also closer to what a defocused lens does.
+    int defocus = abs((int)state->focus - (int)ptz_af_subject_focus(state));
+    float sigma = (float)defocus / PTZ_FOCUS_MAX * 20.0f;
+    if (sigma > 1) {
+        int radius = (int)lroundf((sqrtf(12.0f * sigma * sigma + 1.0f) - 1.0f) / 2.0f);
+        effects->blurRadius = radius > PTZ_EFFECTS_MAX_BLUR ? PTZ_EFFECTS_MAX_BLUR : radius;
+    }
+    if (lut != NULL) {
+        ptz_color_params params;
+        ptz_color_params_for_state(state, &params);
+        ptz_color_lut_update(lut, &params);
+        effects->lut = lut->identity ? NULL : lut;
+    }
+    effects->flipH = state->flipH != 0;
+    effects->flipV = state->flipV != 0;
+}
+
+void ptz_effects_scale(ptz_effects *effects, float scale) {
+    if (effects->blurRadius > 0) {
+        int radius = (int)lroundf(effects->blurRadius * scale);
+        effects->blurRadius = radius > PTZ_EFFECTS_MAX_BLUR ? PTZ_EFFECTS_MAX_BLUR : radius;
+    }
+}
+
+int ptz_effects_is_identity(const ptz_effects *effects) {
+    return effects->blurRadius == 0 && !effects->flipH && !effects->flipV && effects->lut == NULL;
+}
+
+// Color LUT for two pixels widened to 16 bits.
+static inline ptz_u16x8 ptz_effects_color(ptz_u16x8 v, const ptz_color_lut *lut) {
+    if (lut == NULL) {
+        return v;
+    }
+    ptz_f32x4 a = ptz_color_lut_sample(lut, PTZ_CONVERT(PTZ_SHUFFLE(v, v, 0, 1, 2, 3), ptz_f32x4)) + 0.5f;
+    ptz_f32x4 b = ptz_color_lut_sample(lut, PTZ_CONVERT(PTZ_SHUFFLE(v, v, 4, 5, 6, 7), ptz_f32x4)) + 0.5f;
+    return PTZ_CONVERT(PTZ_SHUFFLE(a, b, 0, 1, 2, 3, 4, 5, 6, 7), ptz_u16x8);
+}
+
+// Four pixels at a time, narrowed back to bytes and, for a horizontal flip, reversed.
+static inline ptz_u8x16 ptz_effects_finish(ptz_u16x8 lo, ptz_u16x8 hi, const ptz_color_lut *lut, int flipH) {
+    ptz_u8x8 a = PTZ_CONVERT(ptz_effects_color(lo, lut), ptz_u8x8);
+    ptz_u8x8 b = PTZ_CONVERT(ptz_effects_color(hi, lut), ptz_u8x8);
+    if (flipH) {
+        return PTZ_SHUFFLE(a, b, 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    }
+    return PTZ_SHUFFLE(a, b, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+}
+
+// Where output pixels x...x+3 of a row go. Mirroring is only a matter of where we store.
+static inline uint8_t *ptz_effects_dest(uint8_t *row, int width, int x, int flipH) {
+    return row + (flipH ? (width - 4 - x) : x) * 4;
+}
+
+// Rounded sum / window for eight 16-bit sums, where `scale` is 65536 / window.
+static inline ptz_u16x8 ptz_box_divide(ptz_u16x8 sum, ptz_u32x4 scale) {
+    ptz_u32x4 lo = (PTZ_CONVERT(PTZ_SHUFFLE(sum, sum, 0, 1, 2, 3), ptz_u32x4) * scale + 0x8000) >> 16;
+    ptz_u32x4 hi = (PTZ_CONVERT(PTZ_SHUFFLE(sum, sum, 4, 5, 6, 7), ptz_u32x4) * scale + 0x8000) >> 16;
+    return PTZ_CONVERT(PTZ_SHUFFLE(lo, hi, 0, 1, 2, 3, 4, 5, 6, 7), ptz_u16x8);
+}
+
+static inline ptz_u16x8 ptz_widen_lo(ptz_u8x16 v) {
+    return PTZ_CONVERT(PTZ_SHUFFLE(v, v, 0, 1, 2, 3, 4, 5, 6, 7), ptz_u16x8);
+}
+
+static inline ptz_u16x8 ptz_widen_hi(ptz_u8x16 v) {
+    return PTZ_CONVERT(PTZ_SHUFFLE(v, v, 8, 9, 10, 11, 12, 13, 14, 15), ptz_u16x8);
+}
+
+static inline ptz_u8x16 ptz_narrow(ptz_u16x8 lo, ptz_u16x8 hi) {
+    ptz_u8x8 a = PTZ_CONVERT(lo, ptz_u8x8);
+    ptz_u8x8 b = PTZ_CONVERT(hi, ptz_u8x8);
+    return PTZ_SHUFFLE(a, b, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+}
+
+// No blur: one read and one write per pixel.
+static void ptz_effects_sharp_strip(const ptz_image *src, const ptz_effects *effects, ptz_image *dst, int x0, int count) {
+    const int width = src->width;
+    const ptz_color_lut *lut = effects->lut;
+    const int flipH = effects->flipH;
+    for (int y = 0; y < src->height; y++) {
+        const uint8_t *in = ptz_image_row(src, y);
+        uint8_t *out = ptz_image_row(dst, effects->flipV ? src->height - 1 - y : y);
+        int x = x0;
+        for (; x + 4 <= x0 + count; x += 4) {
+            ptz_u8x16 px = ptz_load_u8x16(in + x * 4);
+            ptz_store_u8x16(ptz_effects_dest(out, width, x, flipH),
+                            ptz_effects_finish(ptz_widen_lo(px), ptz_widen_hi(px), lut, flipH));
+        }
+        for (; x < x0 + count; x++) {
+            ptz_u16x4 px = ptz_load_pixel16(in + x * 4);
+            ptz_u16x8 v = PTZ_SHUFFLE(px, px, 0, 1, 2, 3, 0, 1, 2, 3);
+            ptz_u8x16 o = ptz_effects_finish(v, v, lut, 0);
+            memcpy(out + (flipH ? width - 1 - x : x) * 4, &o, 4);
+        }
+    }
+}
+
+/**
+ * Horizontal box average of source row `y` over columns [x0, x0 + count), edges replicated, into `out` as RGBA bytes.
+ * `sums` is scratch for one row of 16-bit sums.
+ */
+static void ptz_box_row(const ptz_image *src, int y, int x0, int count, int radius, ptz_u32x4 scale, uint16_t *sums, uint8_t *out) {
+    const uint8_t *row = ptz_image_row(src, y);
+    const int last = src->width - 1;
+    ptz_u16x4 sum = { 0 };
+    for (int k = -radius; k <= radius; k++) {
+        int x = x0 + k;
+        x = x < 0 ? 0 : (x > last ? last : x);
+        sum += ptz_load_pixel16(row + x * 4);
+    }
+    memcpy(sums, &sum, sizeof(sum));
+    int i = 1;
+    // Left edge, the clamp-free middle, then the right edge.
+    for (; i < count && x0 + i - radius - 1 < 0; i++) {
+        int add = x0 + i + radius;
+        sum += ptz_load_pixel16(row + (add > last ? last : add) * 4) - ptz_load_pixel16(row);
+        memcpy(sums + i * 4, &sum, sizeof(sum));
+    }
+    const uint8_t *add = row + (x0 + i + radius) * 4;
+    const uint8_t *sub = row + (x0 + i - radius - 1) * 4;
+    int end = last - radius - x0 + 1;
+    end = end < count ? end : count;
+    // Four pixels per step: prefix-sum the entering-minus-leaving differences in registers,
+    // so the serial dependency is one add per four pixels instead of one per pixel.
+    // Wraparound in the subtractions is fine; the true sums always fit in 16 bits.
+    const ptz_u16x8 zero = { 0 };
+    ptz_u16x8 running = PTZ_SHUFFLE(sum, sum, 0, 1, 2, 3, 0, 1, 2, 3);
+    for (; i + 4 <= end; i += 4, add += 16, sub += 16) {
+        ptz_u8x16 a = ptz_load_u8x16(add);
+        ptz_u8x16 b = ptz_load_u8x16(sub);
+        ptz_u16x8 lo = ptz_widen_lo(a) - ptz_widen_lo(b);
+        ptz_u16x8 hi = ptz_widen_hi(a) - ptz_widen_hi(b);
+        lo += PTZ_SHUFFLE(zero, lo, 0, 1, 2, 3, 8, 9, 10, 11);
+        hi += PTZ_SHUFFLE(zero, hi, 0, 1, 2, 3, 8, 9, 10, 11);
+        hi += PTZ_SHUFFLE(lo, lo, 4, 5, 6, 7, 4, 5, 6, 7);
+        lo += running;
+        hi += running;
+        memcpy(sums + i * 4, &lo, sizeof(lo));
+        memcpy(sums + i * 4 + 8, &hi, sizeof(hi));
+        running = PTZ_SHUFFLE(hi, hi, 4, 5, 6, 7, 4, 5, 6, 7);
+    }
+    sum = PTZ_SHUFFLE(running, running, 0, 1, 2, 3);
+    for (; i < end; i++, add += 4, sub += 4) {
+        sum += ptz_load_pixel16(add) - ptz_load_pixel16(sub);
+        memcpy(sums + i * 4, &sum, sizeof(sum));
+    }
+    for (; i < count; i++) {
+        int s = x0 + i - radius - 1;
+        sum += ptz_load_pixel16(row + last * 4) - ptz_load_pixel16(row + (s < 0 ? 0 : s) * 4);
+        memcpy(sums + i * 4, &sum, sizeof(sum));
+    }
+
+    // Back to bytes, so the vertical sums fit in 16 bits too. The extra rounding is at most half a level.
+    // `sums` and `out` are padded to a multiple of four pixels.
+    for (i = 0; i < count; i += 4) {
+        ptz_u16x8 lo, hi;
+        memcpy(&lo, sums + i * 4, sizeof(lo));
+        memcpy(&hi, sums + i * 4 + 8, sizeof(hi));
+        ptz_store_u8x16(out + i * 4, ptz_narrow(ptz_box_divide(lo, scale), ptz_box_divide(hi, scale)));
+    }
+}
+
+static void ptz_effects_blur_strip(ptz_renderer *renderer, const ptz_image *src, const ptz_effects *effects, ptz_image *dst,
+                                   int x0, int count) {
+    const int radius = effects->blurRadius;
+    const int ringRows = 2 * radius + 2;
+    const int last = src->height - 1;
+    const ptz_color_lut *lut = effects->lut;
+    const int flipH = effects->flipH;
+    // Rows are padded to whole 4-pixel groups.
+    const size_t ringStride = (size_t)((count + 3) & ~3) * 4;
+    uint8_t *ring = renderer->blurRows;
+    uint16_t *sums = renderer->blurSums;
+    uint16_t *rowSums = renderer->blurSums + PTZ_EFFECTS_STRIP * 4;
+    const ptz_u32x4 scale = (ptz_u32x4){ 0 } + (uint32_t)lroundf(65536.0f / (2 * radius + 1));
+
+#define RING_ROW(_y) (ring + (size_t)((_y) % ringRows) * ringStride)
+
+    // Prime with rows -radius...radius, the ones above the top replicating row 0.
+    int computed = radius < last ? radius : last;
+    for (int y = 0; y <= computed; y++) {
+        ptz_box_row(src, y, x0, count, radius, scale, rowSums, RING_ROW(y));
+    }
+    for (size_t i = 0; i < ringStride; i += 16) {
+        ptz_u8x16 v = ptz_load_u8x16(RING_ROW(0) + i);
+        ptz_u16x8 lo = ptz_widen_lo(v) * (uint16_t)(radius + 1);
+        ptz_u16x8 hi = ptz_widen_hi(v) * (uint16_t)(radius + 1);
+        for (int k = 1; k <= radius; k++) {
+            v = ptz_load_u8x16(RING_ROW(k < last ? k : last) + i);
+            lo += ptz_widen_lo(v);
+            hi += ptz_widen_hi(v);
+        }
+        memcpy(sums + i, &lo, sizeof(lo));
+        memcpy(sums + i + 8, &hi, sizeof(hi));
+    }
+
+    for (int y = 0; y <= last; y++) {
+        // The rows entering and leaving the window for the next output row.
+        int add = y + radius + 1;
+        add = add < last ? add : last;
+        int sub = y - radius;
+        sub = sub > 0 ? sub : 0;
+        if (add > computed) {
+            ptz_box_row(src, add, x0, count, radius, scale, rowSums, RING_ROW(add));
+            computed = add;
+        }
+        const uint8_t *addRow = RING_ROW(add);
+        const uint8_t *subRow = RING_ROW(sub);
+        uint8_t *out = ptz_image_row(dst, effects->flipV ? last - y : y);
+        // Emit this row and slide the window in the same sweep.
+        int i = 0;
+        for (; i < count; i += 4) {
+            ptz_u16x8 lo, hi;
+            memcpy(&lo, sums + i * 4, sizeof(lo));
+            memcpy(&hi, sums + i * 4 + 8, sizeof(hi));
+            ptz_u8x16 v = ptz_effects_finish(ptz_box_divide(lo, scale), ptz_box_divide(hi, scale), lut, flipH);
+            if (i + 4 <= count) {
+                ptz_store_u8x16(ptz_effects_dest(out, src->width, x0 + i, flipH), v);
+            } else {
+                // Ragged last group at the right edge of the image.
+                uint8_t pixels[16];
+                ptz_store_u8x16(pixels, v);
+                for (int k = 0; i + k < count; k++) {
+                    int x = x0 + i + k;
+                    memcpy(out + (flipH ? src->width - 1 - x : x) * 4, pixels + (flipH ? 3 - k : k) * 4, 4);
+                }
+            }
+            ptz_u8x16 a = ptz_load_u8x16(addRow + i * 4);
+            ptz_u8x16 b = ptz_load_u8x16(subRow + i * 4);
+            lo += ptz_widen_lo(a) - ptz_widen_lo(b);
+            hi += ptz_widen_hi(a) - ptz_widen_hi(b);
+            memcpy(sums + i * 4, &lo, sizeof(lo));
+            memcpy(sums + i * 4 + 8, &hi, sizeof(hi));
+        }
+    }
+#undef RING_ROW
+}
+
+int ptz_effects_strip_count(const ptz_image *src) {
+    return (src->width + PTZ_EFFECTS_STRIP - 1) / PTZ_EFFECTS_STRIP;
+}
+
+int ptz_render_effects_strip(ptz_renderer *renderer, const ptz_image *src, const ptz_effects *effects, ptz_image *dst, int strip) {
+    const int x0 = strip * PTZ_EFFECTS_STRIP;
+    if (x0 < 0 || x0 >= src->width || src == dst || dst->width != src->width || dst->height != src->height) {
+        return -1;
+    }
+    const int count = src->width - x0 < PTZ_EFFECTS_STRIP ? src->width - x0 : PTZ_EFFECTS_STRIP;
+    if (effects->blurRadius <= 0) {
+        ptz_effects_sharp_strip(src, effects, dst, x0, count);
+        return 0;
+    }
+    if (effects->blurRadius > PTZ_EFFECTS_MAX_BLUR) {
+        return -1;
+    }
+    const size_t ringBytes = (size_t)(2 * effects->blurRadius + 2) * PTZ_EFFECTS_STRIP * 4;
+    if (ringBytes > renderer->blurCapacity) {
+        uint8_t *rows = realloc(renderer->blurRows, ringBytes);
+        if (rows == NULL) {
+            return -1;
+        }
+        renderer->blurRows = rows;
+        renderer->blurCapacity = ringBytes;
+    }
+    if (renderer->blurSums == NULL) {
+        // Vertical sums, then one row of horizontal sums.
+        renderer->blurSums = malloc(sizeof(uint16_t) * PTZ_EFFECTS_STRIP * 4 * 2);
+        if (renderer->blurSums == NULL) {
+            return -1;
+        }
+    }
+    ptz_effects_blur_strip(renderer, src, effects, dst, x0, count);
+    return 0;
+}
+
+int ptz_render_effects(ptz_renderer *renderer, const ptz_image *src, const ptz_effects *effects, ptz_image *dst) {
+    if (src->width < 1 || src->height < 1 || src == dst) {
+        return -1;
+    }
+    if (ptz_image_alloc(dst, src->width, src->height) < 0) {
+        return -1;
+    }
+    if (effects->blurRadius <= 0) {
+        // Nothing to gain from strips without the blur, and whole rows stream better.
+        ptz_effects_sharp_strip(src, effects, dst, 0, src->width);
+        return 0;
+    }
+    int strips = ptz_effects_strip_count(src);
+    for (int strip = 0; strip < strips; strip++) {
+        if (ptz_render_effects_strip(renderer, src, effects, dst, strip) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
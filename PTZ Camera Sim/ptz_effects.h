@@ -0,0 +1,55 @@
+//
+//  ptz_effects.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Whole-picture effects: defocus blur, the color LUT and mirroring, fused into one pass.
+//
+
+#ifndef ptz_effects_h
+#define ptz_effects_h
+
+#include "ptz_render.h"
+#include "ptz_color.h"
+
+// Radius 127 keeps the horizontal box sums in 16 bits.
+#define PTZ_EFFECTS_MAX_BLUR 127
+
+typedef struct ptz_effects {
+    int blurRadius;         // Box radius in pixels; 0 for a sharp image.
+    uint8_t flipH;
+    uint8_t flipV;
+    const ptz_color_lut *lut;   // NULL when every color setting is neutral.
+} ptz_effects;
+
+/**
+ * Effects for the camera's current settings, for an image at sensor (source image) resolution.
+ * Focus blur grows with the distance between the lens and ptz_af_subject_focus; in autofocus that's
+ * whatever the search hasn't closed yet. `lut` is brought up to date with the color settings and referenced
+ * from `effects`, so it must not change while a render is using it; pass NULL to leave color alone.
+ */
+void ptz_effects_for_state(const ptz_camera_state *state, ptz_color_lut *lut, ptz_effects *effects);
+
+/**
+ * Adjusts sensor-resolution effects for an image `scale` times the size of the sensor, such as a pyramid level.
+ */
+void ptz_effects_scale(ptz_effects *effects, float scale);
+
+int ptz_effects_is_identity(const ptz_effects *effects);
+
+/**
+ * Applies `effects` to all of `src` in a single traversal and writes the result to `dst`, which is (re)allocated to match.
+ * `dst` must not be `src`. The blur is a separable box filter run in vertical strips with running sums,
+ * so the cost doesn't depend on the radius. Returns 0 on success, -1 on allocation failure.
+ */
+int ptz_render_effects(ptz_renderer *renderer, const ptz_image *src, const ptz_effects *effects, ptz_image *dst);
+
+/**
+ * The same work split into independent vertical strips, so callers can spread it over cores.
+ * Each concurrent call needs its own renderer, and `dst` must already be allocated at the size of `src`.
+ */
+int ptz_effects_strip_count(const ptz_image *src);
+int ptz_render_effects_strip(ptz_renderer *renderer, const ptz_image *src, const ptz_effects *effects, ptz_image *dst, int strip);
+
+#endif /* ptz_effects_h */
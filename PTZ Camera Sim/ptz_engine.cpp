@@ -0,0 +1,1121 @@
+//
+//  ptz_engine.cpp
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_engine.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include "ptz_coalesce.h"
+}
+
+namespace ptz {
+
+// VISCA maximums, and what home, reset and recall move at. The session's profile turns them into distances.
+static constexpr int32_t pan_speed_max = 0x18;
+static constexpr int32_t tilt_speed_max = 0x14;
+static constexpr int32_t preset_speed_default = 0x18;
+
+#pragma mark frame_pool
+
+frame_pool::~frame_pool() {
+    if (live_) {
+        fprintf(stderr, "frame_pool: destroyed with %zu frames live\n", live_);
+    }
+    while (slabs_) {
+        slab *next = slabs_->next;
+        free(slabs_);
+        slabs_ = next;
+    }
+}
+
+void *frame_pool::allocate(std::size_t size) noexcept {
+    std::size_t total = size + sizeof(header);
+    std::size_t sizeClass = (total - 1) / granule;
+    header *h;
+    if (sizeClass >= classes) {
+        h = static_cast<header *>(malloc(total));
+        if (!h) {
+            return nullptr;
+        }
+    } else {
+        if (!free_[sizeClass]) {
+            std::size_t blockSize = (sizeClass + 1) * granule;
+            std::size_t count = slabBlocks_[sizeClass] ? std::min(2 * slabBlocks_[sizeClass], max_slab_blocks) : first_slab_blocks;
+            slab *s = static_cast<slab *>(malloc(sizeof(slab) + count * blockSize));
+            if (!s) {
+                return nullptr;
+            }
+            slabBlocks_[sizeClass] = count;
+            s->next = slabs_;
+            slabs_ = s;
+            char *blocks = reinterpret_cast<char *>(s + 1);
+            for (std::size_t i = count; i-- > 0;) {
+                block *b = reinterpret_cast<block *>(blocks + i * blockSize);
+                b->next = free_[sizeClass];
+                free_[sizeClass] = b;
+            }
+        }
+        block *b = free_[sizeClass];
+        free_[sizeClass] = b->next;
+        h = reinterpret_cast<header *>(b);
+    }
+    h->pool = this;
+    live_++;
+    return h + 1;
+}
+
+void frame_pool::release(void *frame, std::size_t size) noexcept {
+    header *h = static_cast<header *>(frame) - 1;
+    frame_pool *pool = h->pool;
+    std::size_t sizeClass = (size + sizeof(header) - 1) / granule;
+    pool->live_--;
+    if (sizeClass >= classes) {
+        free(h);
+        return;
+    }
+    block *b = reinterpret_cast<block *>(h);
+    b->next = pool->free_[sizeClass];
+    pool->free_[sizeClass] = b;
+}
+
+#pragma mark engine
+
+engine::engine(ptz_fleet *fleet, clock::duration tick)
+    : fleet_(fleet), tick_(tick), nextTick_(clock::now() + tick), presetSpeed_(fleet->count, preset_speed_default),
+      pictures_(fleet->count) {
+    arrivals_.prev = arrivals_.next = &arrivals_;
+}
+
+bool engine::still(int camera) const {
+    for (int axis = 0; axis < PTZ_FLEET_AXES; axis++) {
+        if (fleet_->position[axis][camera] != fleet_->target[axis][camera]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool engine::moving() const {
+    if (arrivals_.next != &arrivals_) {
+        return true;
+    }
+    for (int chunk = 0; chunk < fleet_->chunks; chunk++) {
+        if (fleet_->active[chunk]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void engine::link_arrival(waiter *w) {
+    w->prev = arrivals_.prev;
+    w->next = &arrivals_;
+    arrivals_.prev->next = w;
+    arrivals_.prev = w;
+    waiting_++;
+}
+
+void engine::unlink_arrival(waiter *w) {
+    w->prev->next = w->next;
+    w->next->prev = w->prev;
+    w->prev = w->next = nullptr;
+    waiting_--;
+}
+
+void engine::sift_up(std::size_t index) {
+    waiter *w = timers_[index];
+    while (index > 0) {
+        std::size_t parent = (index - 1) / 2;
+        if (timers_[parent]->deadline <= w->deadline) {
+            break;
+        }
+        timers_[index] = timers_[parent];
+        timers_[index]->heapIndex = index;
+        index = parent;
+    }
+    timers_[index] = w;
+    w->heapIndex = index;
+}
+
+void engine::sift_down(std::size_t index) {
+    waiter *w = timers_[index];
+    std::size_t count = timers_.size();
+    for (;;) {
+        std::size_t child = 2 * index + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && timers_[child + 1]->deadline < timers_[child]->deadline) {
+            child++;
+        }
+        if (w->deadline <= timers_[child]->deadline) {
+            break;
+        }
+        timers_[index] = timers_[child];
+        timers_[index]->heapIndex = index;
+        index = child;
+    }
+    timers_[index] = w;
+    w->heapIndex = index;
+}
+
+void engine::push_timer(waiter *w) {
+    timers_.push_back(w);
+    sift_up(timers_.size() - 1);
+    waiting_++;
+}
+
+void engine::remove_timer(std::size_t index) {
+    waiter *last = timers_.back();
+    timers_.pop_back();
+    waiting_--;
+    if (index < timers_.size()) {
+        timers_[index] = last;
+        last->heapIndex = index;
+        sift_up(index);
+        sift_down(last->heapIndex);
+    }
+}
+
+void engine::make_ready(waiter *w) {
+    w->next = nullptr;
+    if (readyTail_) {
+        readyTail_->next = w;
+    } else {
+        readyHead_ = w;
+    }
+    readyTail_ = w;
+}
+
+void engine::arrival_awaiter::await_suspend(std::coroutine_handle<command::promise_type> handle) noexcept {
+    waiter_.handle = handle;
+    waiter_.promise = &handle.promise();
+    engine_.link_arrival(&waiter_);
+}
+
+void engine::sleep_awaiter::await_suspend(std::coroutine_handle<command::promise_type> handle) noexcept {
+    waiter_.handle = handle;
+    waiter_.promise = &handle.promise();
+    engine_.push_timer(&waiter_);
+}
+
+int engine::cancel(int camera) {
+    for (int axis = 0; axis < PTZ_FLEET_AXES; axis++) {
+        ptz_fleet_stop(fleet_, camera, (ptz_fleet_axis)axis);
+    }
+    int cancelled = 0;
+    for (waiter *w = arrivals_.next; w != &arrivals_;) {
+        waiter *next = w->next;
+        if (w->camera == camera) {
+            unlink_arrival(w);
+            w->cancelled = true;
+            make_ready(w);
+            cancelled++;
+        }
+        w = next;
+    }
+    std::size_t kept = 0;
+    for (waiter *w : timers_) {
+        if (w->camera == camera) {
+            w->cancelled = true;
+            make_ready(w);
+            cancelled++;
+            waiting_--;
+        } else {
+            w->heapIndex = kept;
+            timers_[kept++] = w;
+        }
+    }
+    if (kept != timers_.size()) {
+        timers_.resize(kept);
+        for (std::size_t i = kept / 2; i-- > 0;) {
+            sift_down(i);
+        }
+    }
+    return cancelled;
+}
+
+void engine::run(clock::time_point now) {
+    while (!timers_.empty() && timers_.front()->deadline <= now) {
+        waiter *w = timers_.front();
+        remove_timer(0);
+        make_ready(w);
+    }
+    if (now >= nextTick_) {
+        if (moving()) {
+            ptz_fleet_tick(fleet_);
+            if (telemetry_) {
+                record_tick(now);
+            }
+            for (waiter *w = arrivals_.next; w != &arrivals_;) {
+                waiter *next = w->next;
+                if (still(w->camera)) {
+                    unlink_arrival(w);
+                    make_ready(w);
+                }
+                w = next;
+            }
+            nextTick_ += tick_;
+            if (nextTick_ <= now) {
+                // Fell behind: drop the ticks we missed rather than run them all at once.
+                nextTick_ = now + tick_;
+            }
+        } else {
+            // The first step of the next move is a whole tick after it starts.
+            nextTick_ = now + tick_;
+        }
+    }
+    // Commands resumed here may finish others, through cancel; they join the end of the queue.
+    while (readyHead_) {
+        waiter *w = readyHead_;
+        readyHead_ = w->next;
+        if (!readyHead_) {
+            readyTail_ = nullptr;
+        }
+        // What it sends are replies to it. The waiter is gone once it's resumed.
+        session &owner = w->promise->owner;
+        owner.current_ = w->promise;
+        w->handle.resume();
+        owner.current_ = nullptr;
+    }
+    for (session *s : subscribers_) {
+        s->send_notifications(now);
+    }
+    for (std::size_t i = 0; i < delayed_.size();) {
+        session *s = delayed_[i];
+        s->flush_delayed(now);
+        if (s->delayed_.empty()) {
+            delayed_[i] = delayed_.back();
+            delayed_.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+clock::time_point engine::next_wakeup() const {
+    clock::time_point wakeup = clock::time_point::max();
+    if (readyHead_) {
+        return clock::time_point::min();
+    }
+    if (!timers_.empty()) {
+        wakeup = timers_.front()->deadline;
+    }
+    if (moving()) {
+        wakeup = std::min(wakeup, nextTick_);
+    }
+    for (const session *s : subscribers_) {
+        wakeup = std::min(wakeup, s->next_notification());
+    }
+    for (const session *s : delayed_) {
+        wakeup = std::min(wakeup, s->delayed_.front().due);
+    }
+    return wakeup;
+}
+
+static uint32_t preset_key(int camera, uint8_t index) {
+    return ((uint32_t)camera << 8) | index;
+}
+
+const preset *engine::find_preset(int camera, uint8_t index) const {
+    auto found = presets_.find(preset_key(camera, index));
+    return found == presets_.end() ? nullptr : &found->second;
+}
+
+void engine::set_preset(int camera, uint8_t index, const preset &value) {
+    presets_[preset_key(camera, index)] = value;
+}
+
+void engine::clear_preset(int camera, uint8_t index) {
+    presets_.erase(preset_key(camera, index));
+}
+
+void engine::add_subscriber(session *s) {
+    if (std::find(subscribers_.begin(), subscribers_.end(), s) == subscribers_.end()) {
+        subscribers_.push_back(s);
+    }
+}
+
+void engine::remove_subscriber(session *s) {
+    subscribers_.erase(std::remove(subscribers_.begin(), subscribers_.end(), s), subscribers_.end());
+}
+
+void engine::set_telemetry(ptz_telemetry_recorder *telemetry) {
+    telemetry_ = telemetry;
+    commands_.assign(telemetry ? fleet_->count : 0, telemetry_command{0, PTZ_TELEMETRY_NO_SLOT});
+}
+
+void engine::note_command(int camera, int messageType, int slot) {
+    if (telemetry_) {
+        commands_[camera] = {messageType, slot};
+    }
+}
+
+// Only what moved: a camera standing still is where its last row left it.
+void engine::record_tick(clock::time_point now) {
+    std::size_t count = (std::size_t)fleet_->changedCount;
+    ptz_telemetry_row *rows = count ? ptz_telemetry_recorder_reserve(telemetry_, count) : nullptr;
+    if (!rows) {
+        return;
+    }
+    uint64_t time = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+    for (std::size_t i = 0; i < count; i++) {
+        int camera = (int)fleet_->changed[i];
+        ptz_telemetry_row &row = rows[i];
+        row.time = time;
+        row.camera = camera;
+        row.pan = fleet_->position[PTZ_FLEET_PAN][camera];
+        row.tilt = fleet_->position[PTZ_FLEET_TILT][camera];
+        row.zoom = fleet_->position[PTZ_FLEET_ZOOM][camera];
+        row.focus = fleet_->position[PTZ_FLEET_FOCUS][camera];
+        row.command = commands_[camera].command;
+        row.slot = commands_[camera].slot;
+    }
+    ptz_telemetry_recorder_commit(telemetry_, count);
+}
+
+void engine::add_delayed(session *s) {
+    if (std::find(delayed_.begin(), delayed_.end(), s) == delayed_.end()) {
+        delayed_.push_back(s);
+    }
+}
+
+void engine::remove_delayed(session *s) {
+    delayed_.erase(std::remove(delayed_.begin(), delayed_.end(), s), delayed_.end());
+}
+
+#pragma mark session
+
+static const ptz_profile &sim_profile() {
+    static const ptz_profile profile = [] {
+        ptz_profile p;
+        ptz_profile_builtin(&p, "sim");
+        return p;
+    }();
+    return profile;
+}
+
+session::session(engine &e, const registry &handlers, jr_socket socket, int camera, uint8_t address)
+    : engine_(e), handlers_(handlers), socket_(socket), camera_(camera), address_(address), profile_(&sim_profile()),
+      rng_(ptz_profile_rng(profile_)) {
+}
+
+session::~session() {
+    closing_ = true;
+    engine_.remove_subscriber(this);
+    engine_.remove_delayed(this);
+    // Commands end when they're cancelled, so this takes one round unless a handler waits again after a cancel.
+    for (int tries = 0; inFlight_ && tries < 16; tries++) {
+        engine_.cancel(camera_);
+        engine_.run(clock::now());
+    }
+    if (inFlight_) {
+        fprintf(stderr, "session: %zu commands still running at close\n", inFlight_);
+        abort();
+    }
+}
+
+void session::set_profile(const ptz_profile &profile) {
+    profile_ = &profile;
+    rng_ = ptz_profile_rng(profile_);
+}
+
+int32_t session::pan_step(int speed) const {
+    auto tick = std::chrono::duration_cast<std::chrono::nanoseconds>(engine_.tick());
+    return ptz_profile_pan_step(profile_, speed, (uint64_t)tick.count());
+}
+
+int32_t session::tilt_step(int speed) const {
+    auto tick = std::chrono::duration_cast<std::chrono::nanoseconds>(engine_.tick());
+    return ptz_profile_tilt_step(profile_, speed, (uint64_t)tick.count());
+}
+
+// Called as each command starts; it runs until its first co_await before anything else can.
+void session::start_command(command::promise_type &promise, int messageType) {
+    current_ = &promise;
+    if (moves_) {
+        engine_.note_command(camera_, messageType);
+    }
+    std::chrono::nanoseconds ack(ptz_profile_ack_ns(profile_, messageType, &rng_));
+    std::chrono::nanoseconds completion(ptz_profile_completion_ns(profile_, messageType, &rng_));
+    promise.answerAt = ack.count() ? clock::now() + std::chrono::duration_cast<clock::duration>(ack) : clock::time_point::min();
+    promise.completionDelay = std::chrono::duration_cast<clock::duration>(completion);
+}
+
+// Sends outside of any command, like notifications and the replies receive makes itself, go right away.
+clock::time_point session::reply_time(int messageType) const {
+    if (!current_) {
+        return clock::time_point::min();
+    }
+    if (messageType != JR_VISCA_MESSAGE_COMPLETION || current_->completionDelay == clock::duration::zero()) {
+        return current_->answerAt;
+    }
+    return std::max(clock::now(), current_->answerAt) + current_->completionDelay;
+}
+
+void session::send_data(const uint8_t *data, int length, clock::time_point due) {
+    if (closing_) {
+        return;
+    }
+    if (due != clock::time_point::min() || !delayed_.empty()) {
+        clock::time_point now = clock::now();
+        flush_delayed(now);
+        if (due > now) {
+            delayed_send later{due, length, {}};
+            memcpy(later.data, data, length);
+            auto after = std::upper_bound(delayed_.begin(), delayed_.end(), due,
+                                          [](clock::time_point t, const delayed_send &d) { return t < d.due; });
+            delayed_.insert(after, later);
+            engine_.add_delayed(this);
+            return;
+        }
+    }
+    write_data(data, length);
+}
+
+void session::write_data(const uint8_t *data, int length) {
+    if (jr_socket_send(socket_, (char *)data, length) == -1) {
+        fprintf(stderr, "error sending response\n");
+    }
+}
+
+void session::flush_delayed(clock::time_point now) {
+    std::size_t sent = 0;
+    while (sent < delayed_.size() && delayed_[sent].due <= now) {
+        write_data(delayed_[sent].data, delayed_[sent].length);
+        sent++;
+    }
+    delayed_.erase(delayed_.begin(), delayed_.begin() + sent);
+}
+
+// ptz_notify times are nanoseconds on the engine's clock.
+static uint64_t notify_time(clock::time_point t) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+void session::subscribe(int rate) {
+    ptz_notify_subscribe(&notify_, rate);
+    if (rate) {
+        engine_.add_subscriber(this);
+    } else {
+        engine_.remove_subscriber(this);
+    }
+}
+
+void session::update_notify(ptz_notify &notify) const {
+    int32_t current[PTZ_FLEET_AXES];
+    for (int axis = 0; axis < PTZ_FLEET_AXES; axis++) {
+        current[axis] = ptz_fleet_position(fleet(), camera_, (ptz_fleet_axis)axis);
+    }
+    ptz_notify_update(&notify, current);
+}
+
+void session::send_notifications(clock::time_point now) {
+    update_notify(notify_);
+    uint32_t groups = ptz_notify_take(&notify_, notify_time(now));
+    const int32_t *latest = notify_.latest;
+    if (groups & PTZ_NOTIFY_PAN_TILT) {
+        send(jr_visca::pan_tilt_notify{(int16_t)latest[PTZ_FLEET_PAN], (int16_t)latest[PTZ_FLEET_TILT]});
+    }
+    if (groups & PTZ_NOTIFY_LENS) {
+        send(jr_visca::lens_notify{(int16_t)latest[PTZ_FLEET_ZOOM], (int16_t)latest[PTZ_FLEET_FOCUS]});
+    }
+}
+
+clock::time_point session::next_notification() const {
+    // Positions may have moved since the last run, by a command or a tick; look at them as they are now.
+    ptz_notify notify = notify_;
+    update_notify(notify);
+    uint64_t next = ptz_notify_next(&notify);
+    if (next == UINT64_MAX) {
+        return clock::time_point::max();
+    }
+    return clock::time_point(std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(next)));
+}
+
+// The JR_VISCA_MESSAGE_ of a frame, as far as coalescing goes: the drives and Address Set, and 0 for anything else.
+static int coalesced_type(std::span<const uint8_t> body) {
+    using namespace jr_visca;
+    if (matches<pan_tilt_drive>(body)) {
+        return pan_tilt_drive::id;
+    }
+    if (matches<zoom_stop>(body)) {
+        return zoom_stop::id;
+    }
+    if (matches<zoom_tele_standard>(body)) {
+        return zoom_tele_standard::id;
+    }
+    if (matches<zoom_wide_standard>(body)) {
+        return zoom_wide_standard::id;
+    }
+    if (matches<zoom_tele_variable>(body)) {
+        return zoom_tele_variable::id;
+    }
+    if (matches<zoom_wide_variable>(body)) {
+        return zoom_wide_variable::id;
+    }
+    if (matches<camera_number>(body)) {
+        return camera_number::id;
+    }
+    return 0;
+}
+
+static int drive_group(std::span<const uint8_t> body) {
+    return ptz_drive_group(coalesced_type(body));
+}
+
+// Of the drives in one batch only the newest of each group runs; see ptz_coalesce.h. There's no menu here to step through.
+static void coalesce_drives(const jr_visca::frame *frames, bool *superseded, int count) {
+    ptz_coalesce coalesce;
+    ptz_coalesce_init(&coalesce, 0, 1);
+    for (int i = count - 1; i >= 0; i--) {
+        superseded[i] = ptz_coalesce_superseded(&coalesce, coalesced_type(frames[i].body), frames[i].receiver);
+    }
+}
+
+// What an express frame stops, or would be stopped by; the bits are the same for both.
+enum : unsigned { motion_drive = 1, motion_zoom = 2, motion_move = 4, motion_all = 7 };
+
+// The motion an express frame stops, or 0 for a normal frame.
+static unsigned express_stops(std::span<const uint8_t> body) {
+    using namespace jr_visca;
+    if (matches<cancel>(body) || matches<clear>(body)) {
+        return motion_all;
+    }
+    if (matches<zoom_stop>(body)) {
+        return motion_zoom;
+    }
+    if (auto drive = decode<pan_tilt_drive>(body)) {
+        return drive->panDirection == JR_VISCA_PAN_DIRECTION_STOP && drive->tiltDirection == JR_VISCA_TILT_DIRECTION_STOP
+            ? (unsigned)motion_drive : 0u;
+    }
+    return 0;
+}
+
+// The motion a normal frame starts.
+static unsigned motion(std::span<const uint8_t> body) {
+    using namespace jr_visca;
+    switch (drive_group(body)) {
+        case PTZ_DRIVE_GROUP_PAN_TILT:
+            return motion_drive;
+        case PTZ_DRIVE_GROUP_ZOOM:
+            return motion_zoom;
+    }
+    if (matches<absolute_pan_tilt>(body) || matches<relative_pan_tilt>(body) || matches<home>(body) ||
+        matches<reset>(body) || matches<zoom_direct>(body)) {
+        return motion_move;
+    }
+    if (auto recall = decode<memory>(body)) {
+        return recall->mode == JR_VISCA_MEMORY_MODE_RECALL ? (unsigned)motion_move : 0u;
+    }
+    return 0;
+}
+
+int session::receive(std::span<const uint8_t> data) {
+    while (!data.empty()) {
+        std::size_t take = std::min(data.size(), sizeof(buffer_) - count_);
+        memcpy(buffer_ + count_, data.data(), take);
+        count_ += (int)take;
+        data = data.subspan(take);
+
+        // Everything that's arrived is split up before any of it runs, so drives can be coalesced.
+        jr_visca::frame frames[max_batch];
+        bool superseded[max_batch];
+        int frameCount = 0;
+        int consumed = 0;
+        int used = 0;
+        while (frameCount < max_batch &&
+               (used = jr_visca::split_frame(std::span<const uint8_t>(buffer_ + consumed, count_ - consumed),
+                                              frames[frameCount])) > 0) {
+            consumed += used;
+            frameCount++;
+        }
+        coalesce_drives(frames, superseded, frameCount);
+
+        // Express frames run first, in order. A superseded stop stops nothing; the drive after it wins.
+        unsigned stops[max_batch];
+        int expressCount = 0;
+        for (int i = 0; i < frameCount; i++) {
+            stops[i] = express_stops(frames[i].body);
+            if (!stops[i]) {
+                continue;
+            }
+            lane_stats &stats = stats_[(int)lane::express];
+            if (superseded[i]) {
+                stops[i] = 0;
+                ack_completion();
+                stats.run++;
+            } else if (expressCount++ >= express_limit) {
+                stops[i] = 0;
+                error(JR_VISCA_ERROR_BUFFER_FULL);
+                stats.rejected++;
+            } else {
+                moves_ = true;
+                handlers_.dispatch(*this, frames[i].body);
+                moves_ = false;
+                current_ = nullptr;
+                stats.run++;
+            }
+        }
+
+        // Then the rest, skipping the moves and drives an express frame after them has already stopped.
+        unsigned stoppedLater = 0;
+        for (int i = frameCount - 1; i >= 0; i--) {
+            unsigned here = stops[i];
+            stops[i] = stoppedLater;
+            stoppedLater |= here;
+        }
+        for (int i = 0; i < frameCount; i++) {
+            if (express_stops(frames[i].body)) {
+                continue;
+            }
+            lane_stats &stats = stats_[(int)lane::normal];
+            unsigned starts = motion(frames[i].body);
+            if (starts & stops[i]) {
+                // A drive has nothing left to do and says so; a move was cancelled before it started.
+                ack();
+                if (starts == motion_move) {
+                    error(JR_VISCA_ERROR_CANCELLED);
+                } else {
+                    completion();
+                }
+                stats.overtaken++;
+            } else if (superseded[i]) {
+                ack_completion();
+                stats.run++;
+            } else if (inFlight_ >= normal_limit) {
+                error(JR_VISCA_ERROR_BUFFER_FULL);
+                stats.rejected++;
+            } else {
+                moves_ = starts != 0;
+                handlers_.dispatch(*this, frames[i].body);
+                moves_ = false;
+                current_ = nullptr;
+                stats.run++;
+            }
+        }
+        if (used < 0) {
+            return -1;
+        }
+        count_ -= consumed;
+        memmove(buffer_, buffer_ + consumed, count_);
+        if (count_ == sizeof(buffer_)) {
+            // A full buffer with no terminator in it.
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#pragma mark Handlers
+
+static void move_to(session &s, ptz_fleet_axis axis, int32_t target, int32_t speed) {
+    ptz_fleet_move_to(s.fleet(), s.camera(), axis, target, speed);
+}
+
+static int32_t position(session &s, ptz_fleet_axis axis) {
+    return ptz_fleet_position(s.fleet(), s.camera(), axis);
+}
+
+// Pan_TiltDrive directions are 1 and 2, one of which is `negative`, or 3 for stop.
+static void drive(session &s, ptz_fleet_axis axis, uint8_t direction, uint8_t negative, int32_t speed) {
+    if (direction == 3) {
+        ptz_fleet_stop(s.fleet(), s.camera(), axis);
+    } else if (direction == 1 || direction == 2) {
+        ptz_fleet_jog(s.fleet(), s.camera(), axis, direction == negative ? -1 : 1, speed);
+    }
+}
+
+static void finish_move(session &s, bool arrived) {
+    if (arrived) {
+        s.completion();
+    } else {
+        s.error(JR_VISCA_ERROR_CANCELLED);
+    }
+}
+
+static command pan_tilt_drive(session &s, jr_visca::pan_tilt_drive m) {
+    s.ack();
+    drive(s, PTZ_FLEET_PAN, m.panDirection, JR_VISCA_PAN_DIRECTION_LEFT, s.pan_step(m.panSpeed));
+    drive(s, PTZ_FLEET_TILT, m.tiltDirection, JR_VISCA_TILT_DIRECTION_DOWN, s.tilt_step(m.tiltSpeed));
+    s.completion();
+    co_return;
+}
+
+static command absolute_pan_tilt(session &s, jr_visca::absolute_pan_tilt m) {
+    s.ack();
+    move_to(s, PTZ_FLEET_PAN, m.panPosition, s.pan_step(m.panSpeed));
+    move_to(s, PTZ_FLEET_TILT, m.tiltPosition, s.tilt_step(m.tiltSpeed));
+    bool arrived = co_await s.owner().arrival(s.camera());
+    finish_move(s, arrived);
+}
+
+static command relative_pan_tilt(session &s, jr_visca::relative_pan_tilt m) {
+    s.ack();
+    move_to(s, PTZ_FLEET_PAN, position(s, PTZ_FLEET_PAN) + m.panPosition, s.pan_step(m.panSpeed));
+    move_to(s, PTZ_FLEET_TILT, position(s, PTZ_FLEET_TILT) + m.tiltPosition, s.tilt_step(m.tiltSpeed));
+    bool arrived = co_await s.owner().arrival(s.camera());
+    finish_move(s, arrived);
+}
+
+static command home(session &s, jr_visca::home) {
+    s.ack();
+    move_to(s, PTZ_FLEET_PAN, 0, s.pan_step(pan_speed_max));
+    move_to(s, PTZ_FLEET_TILT, 0, s.tilt_step(tilt_speed_max));
+    bool arrived = co_await s.owner().arrival(s.camera());
+    finish_move(s, arrived);
+}
+
+// Center, then each end of tilt and of pan, and back to center, like PTZCamera's cameraReset:.
+static command reset(session &s, jr_visca::reset) {
+    static constexpr int32_t stops[][2] = {
+        {0, 0}, {0, PTZ_PT_MIN}, {0, PTZ_PT_MAX}, {0, 0}, {PTZ_PT_MIN, 0}, {PTZ_PT_MAX, 0}, {0, 0},
+    };
+    s.ack();
+    for (const auto &stop : stops) {
+        move_to(s, PTZ_FLEET_PAN, stop[0], s.pan_step(pan_speed_max));
+        move_to(s, PTZ_FLEET_TILT, stop[1], s.tilt_step(tilt_speed_max));
+        bool arrived = co_await s.owner().arrival(s.camera());
+        if (!arrived) {
+            s.error(JR_VISCA_ERROR_CANCELLED);
+            co_return;
+        }
+    }
+    s.completion();
+}
+
+static command memory(session &s, jr_visca::memory m) {
+    engine &e = s.owner();
+    switch (m.mode) {
+        case JR_VISCA_MEMORY_MODE_SET:
+            e.set_preset(s.camera(), m.memory,
+                         {position(s, PTZ_FLEET_PAN), position(s, PTZ_FLEET_TILT), position(s, PTZ_FLEET_ZOOM)});
+            s.ack_completion();
+            break;
+        case JR_VISCA_MEMORY_MODE_RESET:
+            e.clear_preset(s.camera(), m.memory);
+            s.ack_completion();
+            break;
+        case JR_VISCA_MEMORY_MODE_RECALL: {
+            uint32_t quirks = s.profile().quirks;
+            if (m.memory == 95 && (quirks & PTZ_QUIRK_PRESET_95_MENU)) {
+                // That's the OSD menu on a PTZOptics camera, and there's no menu here to open.
+                s.ack_completion();
+                co_return;
+            }
+            const preset *p = e.find_preset(s.camera(), m.memory);
+            if (!p) {
+                if (quirks & PTZ_QUIRK_STRICT_RECALL) {
+                    s.ack();
+                } else {
+                    s.ack_completion();
+                }
+                co_return;
+            }
+            s.ack();
+            e.note_command(s.camera(), JR_VISCA_MESSAGE_MEMORY, m.memory);
+            int32_t speed = e.preset_speed(s.camera());
+            move_to(s, PTZ_FLEET_PAN, p->pan, s.pan_step(speed));
+            move_to(s, PTZ_FLEET_TILT, p->tilt, s.tilt_step(speed));
+            move_to(s, PTZ_FLEET_ZOOM, p->zoom, speed);
+            bool arrived = co_await s.owner().arrival(s.camera());
+            finish_move(s, arrived);
+            break;
+        }
+        default:
+            s.ack_completion();
+            break;
+    }
+}
+
+static command preset_recall_speed(session &s, jr_visca::preset_recall_speed m) {
+    s.owner().set_preset_speed(s.camera(), (uint8_t)std::clamp<int>(m.value, 1, pan_speed_max));
+    s.ack_completion();
+    co_return;
+}
+
+static command zoom_stop(session &s, jr_visca::zoom_stop) {
+    ptz_fleet_stop(s.fleet(), s.camera(), PTZ_FLEET_ZOOM);
+    s.ack_completion();
+    co_return;
+}
+
+static command zoom_tele_standard(session &s, jr_visca::zoom_tele_standard) {
+    ptz_fleet_jog(s.fleet(), s.camera(), PTZ_FLEET_ZOOM, 1, 1);
+    s.ack_completion();
+    co_return;
+}
+
+static command zoom_wide_standard(session &s, jr_visca::zoom_wide_standard) {
+    ptz_fleet_jog(s.fleet(), s.camera(), PTZ_FLEET_ZOOM, -1, 1);
+    s.ack_completion();
+    co_return;
+}
+
+static command zoom_tele_variable(session &s, jr_visca::zoom_tele_variable m) {
+    ptz_fleet_jog(s.fleet(), s.camera(), PTZ_FLEET_ZOOM, 1, std::max<int32_t>(m.value, 1));
+    s.ack_completion();
+    co_return;
+}
+
+static command zoom_wide_variable(session &s, jr_visca::zoom_wide_variable m) {
+    ptz_fleet_jog(s.fleet(), s.camera(), PTZ_FLEET_ZOOM, -1, std::max<int32_t>(m.value, 1));
+    s.ack_completion();
+    co_return;
+}
+
+static command zoom_direct(session &s, jr_visca::zoom_direct m) {
+    ptz_fleet_set_position(s.fleet(), s.camera(), PTZ_FLEET_ZOOM, m.value);
+    s.ack_completion();
+    co_return;
+}
+
+static command focus_stop(session &s, jr_visca::focus_stop) {
+    ptz_fleet_stop(s.fleet(), s.camera(), PTZ_FLEET_FOCUS);
+    s.ack_completion();
+    co_return;
+}
+
+static void focus_step(session &s, int32_t delta) {
+    ptz_fleet_set_position(s.fleet(), s.camera(), PTZ_FLEET_FOCUS, position(s, PTZ_FLEET_FOCUS) + delta);
+}
+
+static command focus_far_standard(session &s, jr_visca::focus_far_standard) {
+    focus_step(s, 1);
+    s.ack_completion();
+    co_return;
+}
+
+static command focus_near_standard(session &s, jr_visca::focus_near_standard) {
+    focus_step(s, -1);
+    s.ack_completion();
+    co_return;
+}
+
+static command focus_far_variable(session &s, jr_visca::focus_far_variable m) {
+    focus_step(s, m.value);
+    s.ack_completion();
+    co_return;
+}
+
+static command focus_near_variable(session &s, jr_visca::focus_near_variable m) {
+    focus_step(s, -m.value);
+    s.ack_completion();
+    co_return;
+}
+
+static command focus_value(session &s, jr_visca::focus_value m) {
+    ptz_fleet_set_position(s.fleet(), s.camera(), PTZ_FLEET_FOCUS, m.value);
+    s.ack_completion();
+    co_return;
+}
+
+// Whatever was cancelled says so itself; with nothing running the Cancel gets the reply.
+static command cancel(session &s, jr_visca::cancel m) {
+    s.ack(m.socketNumber);
+    if (s.owner().cancel(s.camera()) == 0) {
+        s.error(JR_VISCA_ERROR_CANCELLED, m.socketNumber);
+    }
+    co_return;
+}
+
+static command clear(session &s, jr_visca::clear) {
+    s.owner().cancel(s.camera());
+    s.completion();
+    co_return;
+}
+
+static command motion_sync(session &s, jr_visca::motion_sync) {
+    s.completion();
+    co_return;
+}
+
+static command camera_number(session &s, jr_visca::camera_number) {
+    // The reply carries the next free address, for whatever is after us in the chain.
+    s.send(jr_visca::camera_number{(uint8_t)(s.address() + 1)});
+    co_return;
+}
+
+static command pan_tilt_position_inq(session &s, jr_visca::pan_tilt_position_inq) {
+    s.send(jr_visca::pan_tilt_position_response{(int16_t)position(s, PTZ_FLEET_PAN), (int16_t)position(s, PTZ_FLEET_TILT)});
+    co_return;
+}
+
+static command zoom_position_inq(session &s, jr_visca::zoom_position_inq) {
+    s.send(jr_visca::pqrs_response{(int16_t)position(s, PTZ_FLEET_ZOOM)});
+    co_return;
+}
+
+static command focus_value_inq(session &s, jr_visca::focus_value_inq) {
+    s.send(jr_visca::pqrs_response{(int16_t)position(s, PTZ_FLEET_FOCUS)});
+    co_return;
+}
+
+static command notify_subscribe(session &s, jr_visca::notify_subscribe m) {
+    s.subscribe(m.rate);
+    s.ack_completion();
+    co_return;
+}
+
+// Picture settings, which are only stored, and the inquiries that read them back.
+template <auto Field, class M>
+static command set_picture(session &s, M m) {
+    s.owner().picture_of(s.camera()).*Field = m.value;
+    s.ack_completion();
+    co_return;
+}
+
+template <auto Field, class Response, class M>
+static command picture_inq(session &s, M) {
+    s.send(Response{s.owner().picture_of(s.camera()).*Field});
+    co_return;
+}
+
+// LR_Reverse and PictureFlip are JR_VISCA_ON and JR_VISCA_OFF.
+template <bool picture::*Field, class M>
+static command set_on_off(session &s, M m) {
+    s.owner().picture_of(s.camera()).*Field = ONOFF_TO_BOOL(m.value);
+    s.ack_completion();
+    co_return;
+}
+
+template <bool picture::*Field, class M>
+static command on_off_inq(session &s, M) {
+    s.send(jr_visca::one_byte_response{(uint8_t)BOOL_TO_ONOFF(s.owner().picture_of(s.camera()).*Field)});
+    co_return;
+}
+
+static command focus_automatic(session &s, jr_visca::focus_automatic) {
+    s.owner().picture_of(s.camera()).autofocus = true;
+    s.ack_completion();
+    co_return;
+}
+
+static command focus_manual(session &s, jr_visca::focus_manual) {
+    s.owner().picture_of(s.camera()).autofocus = false;
+    s.ack_completion();
+    co_return;
+}
+
+static command focus_af_mode_inq(session &s, jr_visca::focus_af_mode_inq) {
+    bool autofocus = s.owner().picture_of(s.camera()).autofocus;
+    s.send(jr_visca::one_byte_response{(uint8_t)(autofocus ? JR_VISCA_AF_MODE_AUTO : JR_VISCA_AF_MODE_MANUAL)});
+    co_return;
+}
+
+// Black and white is the only effect; off is 00, or 02 on cameras that say so, like PTZCamera's pictureEffectMode.
+static command picture_effect(session &s, jr_visca::picture_effect m) {
+    s.owner().picture_of(s.camera()).bw = m.value == JR_VISCA_PICTURE_FX_MODE_BW;
+    s.ack_completion();
+    co_return;
+}
+
+static command picture_effect_inq(session &s, jr_visca::picture_effect_inq) {
+    uint8_t mode = (s.profile().quirks & PTZ_QUIRK_FX_OFF_REPLY) ? JR_VISCA_PICTURE_FX_MODE_OFF_REPLY : JR_VISCA_PICTURE_FX_MODE_OFF;
+    if (s.owner().picture_of(s.camera()).bw) {
+        mode = JR_VISCA_PICTURE_FX_MODE_BW;
+    }
+    s.send(jr_visca::one_byte_response{mode});
+    co_return;
+}
+
+// There's no OSD here to open.
+static command menu_mode_inq(session &s, jr_visca::menu_mode_inq) {
+    s.send(jr_visca::one_byte_response{JR_VISCA_OFF});
+    co_return;
+}
+
+// Commands for what isn't modelled are acked and ignored, like camera_handler does. An inquiry can't be: an
+// empty Completion is no answer, so it gets an error, a syntax error if it isn't VISCA we know at all.
+static command ignored(session &s, int messageType, std::span<const uint8_t> body) {
+    if (!body.empty() && body[0] == 0x09) {
+        s.error(messageType < 0 ? JR_VISCA_ERROR_SYNTAX : JR_VISCA_ERROR_NOT_EXECUTABLE, 0);
+    } else {
+        s.ack_completion();
+    }
+    co_return;
+}
+
+const registry &default_handlers() {
+    static const registry handlers = [] {
+        registry r;
+        r.on<jr_visca::pan_tilt_drive>(pan_tilt_drive);
+        r.on<jr_visca::absolute_pan_tilt>(absolute_pan_tilt);
+        r.on<jr_visca::relative_pan_tilt>(relative_pan_tilt);
+        r.on<jr_visca::home>(home);
+        r.on<jr_visca::reset>(reset);
+        r.on<jr_visca::memory>(memory);
+        r.on<jr_visca::preset_recall_speed>(preset_recall_speed);
+        r.on<jr_visca::zoom_stop>(zoom_stop);
+        r.on<jr_visca::zoom_tele_standard>(zoom_tele_standard);
+        r.on<jr_visca::zoom_wide_standard>(zoom_wide_standard);
+        r.on<jr_visca::zoom_tele_variable>(zoom_tele_variable);
+        r.on<jr_visca::zoom_wide_variable>(zoom_wide_variable);
+        r.on<jr_visca::zoom_direct>(zoom_direct);
+        r.on<jr_visca::focus_stop>(focus_stop);
+        r.on<jr_visca::focus_far_standard>(focus_far_standard);
+        r.on<jr_visca::focus_near_standard>(focus_near_standard);
+        r.on<jr_visca::focus_far_variable>(focus_far_variable);
+        r.on<jr_visca::focus_near_variable>(focus_near_variable);
+        r.on<jr_visca::focus_value>(focus_value);
+        r.on<jr_visca::cancel>(cancel);
+        r.on<jr_visca::clear>(clear);
+        r.on<jr_visca::motion_sync>(motion_sync);
+        r.on<jr_visca::camera_number>(camera_number);
+        r.on<jr_visca::pan_tilt_position_inq>(pan_tilt_position_inq);
+        r.on<jr_visca::zoom_position_inq>(zoom_position_inq);
+        r.on<jr_visca::focus_value_inq>(focus_value_inq);
+        r.on<jr_visca::notify_subscribe>(notify_subscribe);
+        r.on<jr_visca::focus_automatic>(focus_automatic);
+        r.on<jr_visca::focus_manual>(focus_manual);
+        r.on<jr_visca::focus_af_mode_inq>(focus_af_mode_inq);
+        r.on<jr_visca::wb_mode>(set_picture<&picture::wbMode>);
+        r.on<jr_visca::wb_mode_inq>(picture_inq<&picture::wbMode, jr_visca::one_byte_response>);
+        r.on<jr_visca::ae_mode>(set_picture<&picture::aeMode>);
+        r.on<jr_visca::ae_mode_inq>(picture_inq<&picture::aeMode, jr_visca::one_byte_response>);
+        r.on<jr_visca::awb_sens>(set_picture<&picture::awbSens>);
+        r.on<jr_visca::awb_sens_inq>(picture_inq<&picture::awbSens, jr_visca::one_byte_response>);
+        r.on<jr_visca::color_temp_direct>(set_picture<&picture::colorTemp>);
+        r.on<jr_visca::color_temp_inq>(picture_inq<&picture::colorTemp, jr_visca::one_byte_response>);
+        r.on<jr_visca::shutter_value>(set_picture<&picture::shutter>);
+        r.on<jr_visca::shutter_pos_inq>(picture_inq<&picture::shutter, jr_visca::pq_response>);
+        r.on<jr_visca::iris_value>(set_picture<&picture::iris>);
+        r.on<jr_visca::iris_pos_inq>(picture_inq<&picture::iris, jr_visca::pq_response>);
+        r.on<jr_visca::bright_direct>(set_picture<&picture::brightPos>);
+        r.on<jr_visca::bright_pos_inq>(picture_inq<&picture::brightPos, jr_visca::pq_response>);
+        r.on<jr_visca::aperture_value>(set_picture<&picture::aperture>);
+        r.on<jr_visca::aperture_value_inq>(picture_inq<&picture::aperture, jr_visca::pqrs_response>);
+        r.on<jr_visca::brightness>(set_picture<&picture::brightness>);
+        r.on<jr_visca::brightness_inq>(picture_inq<&picture::brightness, jr_visca::pqrs_response>);
+        r.on<jr_visca::contrast>(set_picture<&picture::contrast>);
+        r.on<jr_visca::contrast_inq>(picture_inq<&picture::contrast, jr_visca::pqrs_response>);
+        r.on<jr_visca::rgain_value>(set_picture<&picture::rGain>);
+        r.on<jr_visca::rgain_value_inq>(picture_inq<&picture::rGain, jr_visca::pqrs_response>);
+        r.on<jr_visca::bgain_value>(set_picture<&picture::bGain>);
+        r.on<jr_visca::bgain_value_inq>(picture_inq<&picture::bGain, jr_visca::pqrs_response>);
+        r.on<jr_visca::color_gain_direct>(set_picture<&picture::colorGain>);
+        r.on<jr_visca::color_gain_inq>(picture_inq<&picture::colorGain, jr_visca::pqrs_response>);
+        r.on<jr_visca::color_hue_direct>(set_picture<&picture::hue>);
+        r.on<jr_visca::color_hue_inq>(picture_inq<&picture::hue, jr_visca::pqrs_response>);
+        r.on<jr_visca::lr_reverse>(set_on_off<&picture::flipH>);
+        r.on<jr_visca::lr_reverse_inq>(on_off_inq<&picture::flipH>);
+        r.on<jr_visca::picture_flip>(set_on_off<&picture::flipV>);
+        r.on<jr_visca::picture_flip_inq>(on_off_inq<&picture::flipV>);
+        r.on<jr_visca::picture_effect>(picture_effect);
+        r.on<jr_visca::picture_effect_inq>(picture_effect_inq);
+        r.on<jr_visca::menu_mode_inq>(menu_mode_inq);
+        r.otherwise(ignored);
+        return r;
+    }();
+    return handlers;
+}
+
+} // namespace ptz
@@ -0,0 +1,495 @@
+//
+//  ptz_engine.hpp
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  VISCA command execution for a ptz_fleet. Each message type maps to a C++20 coroutine in a
+//  handler_registry; a command that takes time co_awaits the camera arriving, a timer, or a Cancel, on the
+//  engine that owns the fleet. A waiting command is just its coroutine frame, carved from its connection's
+//  frame_pool, so thousands of moves in flight cost under 200 bytes each rather than a thread or a block.
+//
+//  A session can also subscribe to position notifications, which run sends as the camera moves, so a
+//  controller tracking a move doesn't have to poll with inquiries.
+//
+//  Single-threaded: one thread owns the engine, its fleet and every session on it, and drives them with
+//  session::receive and engine::run.
+//
+
+#ifndef PTZ_ENGINE_HPP
+#define PTZ_ENGINE_HPP
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "jr_visca.hpp"
+
+extern "C" {
+#include "jr_socket.h"
+#include "ptz_color.h"
+#include "ptz_fleet.h"
+#include "ptz_notify.h"
+#include "ptz_profile.h"
+#include "ptz_telemetry.h"
+}
+
+namespace ptz {
+
+using clock = std::chrono::steady_clock;
+
+class engine;
+class session;
+
+#pragma mark Frames
+
+/**
+ * Coroutine frames for one connection. Frames are rounded up to a size class and kept on a free list per
+ * class when they finish, so a connection that has run a command once runs it again without malloc.
+ * Frames too big for any class come straight from malloc. Every frame must be gone before the pool is.
+ */
+class frame_pool {
+public:
+    frame_pool() = default;
+    frame_pool(const frame_pool &) = delete;
+    frame_pool &operator=(const frame_pool &) = delete;
+    ~frame_pool();
+
+    // nullptr if out of memory.
+    void *allocate(std::size_t size) noexcept;
+    // `size` is what was asked of allocate; the frame knows its own pool.
+    static void release(void *frame, std::size_t size) noexcept;
+
+    std::size_t live() const { return live_; }
+
+private:
+    static constexpr std::size_t granule = 64;
+    static constexpr std::size_t classes = 8;           // Pooled frames are up to 512 bytes, header included.
+    // Slabs for a class start small, since most connections only ever have a command or two running,
+    // and double each time the class runs out.
+    static constexpr std::size_t first_slab_blocks = 4;
+    static constexpr std::size_t max_slab_blocks = 64;
+
+    struct alignas(alignof(std::max_align_t)) header {
+        frame_pool *pool;
+    };
+    struct block {
+        block *next;
+    };
+    struct alignas(alignof(std::max_align_t)) slab {
+        slab *next;
+    };
+
+    block *free_[classes] = {};
+    std::size_t slabBlocks_[classes] = {};
+    slab *slabs_ = nullptr;
+    std::size_t live_ = 0;
+};
+
+#pragma mark Commands
+
+/**
+ * The return type of a handler coroutine. It starts running as soon as it's called and frees itself when
+ * it returns, so there's nothing to hold on to. Its first parameter must be the session it's running for,
+ * which is where its frame comes from.
+ */
+struct command {
+    struct promise_type {
+        template <class... Args>
+        promise_type(session &s, Args &...) noexcept;
+        ~promise_type();
+
+        template <class... Args>
+        static void *operator new(std::size_t size, session &s, Args &...) noexcept;
+        static void operator delete(void *frame, std::size_t size) noexcept { frame_pool::release(frame, size); }
+
+        static command get_return_object_on_allocation_failure() noexcept { return {}; }
+        command get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+
+        session &owner;
+        // When this command's ACK or inquiry reply goes out, and how long its Completion waits after that,
+        // from the session's profile. time_point::min() is right away.
+        clock::time_point answerAt;
+        clock::duration completionDelay;
+    };
+};
+
+#pragma mark Engine
+
+// A suspended command, linked into whatever it's waiting for. Lives in the command's frame.
+struct waiter {
+    std::coroutine_handle<> handle;
+    command::promise_type *promise = nullptr;
+    int camera;
+    bool cancelled = false;
+    waiter *prev = nullptr;
+    waiter *next = nullptr;
+    clock::time_point deadline;
+    std::size_t heapIndex = 0;
+};
+
+struct preset {
+    int32_t pan;
+    int32_t tilt;
+    int32_t zoom;
+};
+
+/**
+ * A camera's picture settings, in VISCA's own values, starting where PTZCamera's do. Nothing is rendered here;
+ * they're kept so an inquiry answers with what was last set.
+ */
+struct picture {
+    bool autofocus = true;
+    bool bw = false;
+    bool flipH = false;
+    bool flipV = false;
+    uint8_t wbMode = 0;
+    uint8_t aeMode = 0;
+    uint8_t awbSens = 0;
+    uint8_t colorTemp = 0x37;
+    uint8_t shutter = PTZ_SHUTTER_DEFAULT;
+    uint8_t iris = PTZ_IRIS_DEFAULT;
+    uint8_t brightPos = PTZ_BRIGHT_DEFAULT;
+    int16_t aperture = PTZ_APERTURE_DEFAULT;
+    int16_t brightness = PTZ_BRIGHTNESS_DEFAULT;
+    int16_t contrast = PTZ_CONTRAST_DEFAULT;
+    int16_t rGain = PTZ_RGAIN_DEFAULT;
+    int16_t bGain = PTZ_BGAIN_DEFAULT;
+    int16_t colorGain = PTZ_COLOR_GAIN_DEFAULT;
+    int16_t hue = PTZ_HUE_DEFAULT;
+};
+
+class engine {
+public:
+    /**
+     * `fleet` is already initialized and stays owned by the caller. The fleet advances one ptz_fleet_tick
+     * every `tick`, which is what VISCA speeds are measured against: pan speed 0x18 is 0x18 units a tick.
+     */
+    explicit engine(ptz_fleet *fleet, clock::duration tick = std::chrono::milliseconds(100));
+    engine(const engine &) = delete;
+    engine &operator=(const engine &) = delete;
+
+    ptz_fleet *fleet() const { return fleet_; }
+    clock::duration tick() const { return tick_; }
+
+    class arrival_awaiter {
+    public:
+        bool await_ready() const noexcept { return engine_.still(waiter_.camera); }
+        void await_suspend(std::coroutine_handle<command::promise_type> handle) noexcept;
+        // False if it was cancelled on the way.
+        bool await_resume() const noexcept { return !waiter_.cancelled; }
+    private:
+        friend class engine;
+        arrival_awaiter(engine &e, int camera) : engine_(e) { waiter_.camera = camera; }
+        engine &engine_;
+        waiter waiter_;
+    };
+
+    class sleep_awaiter {
+    public:
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<command::promise_type> handle) noexcept;
+        // False if the camera was cancelled first.
+        bool await_resume() const noexcept { return !waiter_.cancelled; }
+    private:
+        friend class engine;
+        sleep_awaiter(engine &e, int camera, clock::time_point deadline) : engine_(e) {
+            waiter_.camera = camera;
+            waiter_.deadline = deadline;
+        }
+        engine &engine_;
+        waiter waiter_;
+    };
+
+    // co_await: until every axis of `camera` has reached its target.
+    arrival_awaiter arrival(int camera) { return arrival_awaiter(*this, camera); }
+    // co_await: for `duration`, or until `camera` is cancelled.
+    sleep_awaiter sleep_for(int camera, clock::duration duration) {
+        return sleep_awaiter(*this, camera, clock::now() + duration);
+    }
+
+    /**
+     * Stops `camera` where it is and resumes everything waiting on it, with the wait reporting it was cancelled.
+     * They run on the next engine::run. Returns how many there were.
+     */
+    int cancel(int camera);
+
+    /**
+     * Ticks the fleet if a tick is due, then resumes every command whose wait is over, in the order they finished,
+     * then sends whatever position notifications are due.
+     */
+    void run(clock::time_point now);
+
+    // When run next has something to do; time_point::max() if nothing will happen until a command comes in.
+    clock::time_point next_wakeup() const;
+
+    std::size_t waiting() const { return waiting_; }
+
+    /**
+     * Queues every camera that moves on each tick to `telemetry`, which stays the caller's; nullptr stops.
+     * The tick only copies the rows; the recorder's thread encodes them.
+     */
+    void set_telemetry(ptz_telemetry_recorder *telemetry);
+    // What set `camera` moving, for telemetry: a JR_VISCA_MESSAGE_, and the preset if it's a recall.
+    void note_command(int camera, int messageType, int slot = PTZ_TELEMETRY_NO_SLOT);
+
+    // Presets, per camera. Recall speed is the one CAM_PresetRecallSpeed set, 0x18 until then.
+    const preset *find_preset(int camera, uint8_t index) const;
+    void set_preset(int camera, uint8_t index, const preset &value);
+    void clear_preset(int camera, uint8_t index);
+
+    // Sessions run sends position notifications to; see session::subscribe.
+    void add_subscriber(session *s);
+    void remove_subscriber(session *s);
+    // Sessions with replies waiting out their profile's delays, which run sends when they're due.
+    void add_delayed(session *s);
+    void remove_delayed(session *s);
+    uint8_t preset_speed(int camera) const { return presetSpeed_[camera]; }
+    void set_preset_speed(int camera, uint8_t speed) { presetSpeed_[camera] = speed; }
+    // What the picture commands have set on `camera`.
+    picture &picture_of(int camera) { return pictures_[camera]; }
+
+private:
+    bool still(int camera) const;
+    bool moving() const;
+    void link_arrival(waiter *w);
+    void unlink_arrival(waiter *w);
+    void push_timer(waiter *w);
+    void remove_timer(std::size_t index);
+    void sift_up(std::size_t index);
+    void sift_down(std::size_t index);
+    void make_ready(waiter *w);
+    void record_tick(clock::time_point now);
+
+    ptz_fleet *fleet_;
+    clock::duration tick_;
+    clock::time_point nextTick_;
+    waiter arrivals_;                       // Sentinel of a circular list.
+    std::vector<waiter *> timers_;          // Min-heap on deadline.
+    waiter *readyHead_ = nullptr;
+    waiter *readyTail_ = nullptr;
+    std::size_t waiting_ = 0;
+    std::unordered_map<uint32_t, preset> presets_;
+    std::vector<uint8_t> presetSpeed_;
+    std::vector<picture> pictures_;
+    std::vector<session *> subscribers_;
+    std::vector<session *> delayed_;
+    struct telemetry_command {
+        int32_t command;
+        int32_t slot;
+    };
+    ptz_telemetry_recorder *telemetry_ = nullptr;
+    std::vector<telemetry_command> commands_;   // By camera, while there's telemetry.
+};
+
+#pragma mark Handlers
+
+template <class List>
+class handler_registry;
+
+/**
+ * A handler coroutine per message type, in a slot typed for that message, so the message reaches it
+ * already decoded. Anything without a handler, or that didn't decode, goes to the fallback.
+ */
+template <class... Messages>
+class handler_registry<jr_visca::message_list<Messages...>> {
+public:
+    template <class M>
+    using handler = command (*)(session &, M);
+    using fallback = command (*)(session &, int messageType, std::span<const uint8_t> body);
+
+    template <class M>
+    void on(handler<M> h) { std::get<handler<M>>(handlers_) = h; }
+    void otherwise(fallback f) { fallback_ = f; }
+
+    // Returns the message type, or -1 for a frame nothing matched.
+    int dispatch(session &s, std::span<const uint8_t> body) const {
+        int messageType = jr_visca::message_list<Messages...>::dispatch(body, [&](const auto &message) {
+            using M = std::decay_t<decltype(message)>;
+            if (handler<M> h = std::get<handler<M>>(handlers_)) {
+                h(s, message);
+            } else if (fallback_) {
+                fallback_(s, M::id, body);
+            }
+        });
+        if (messageType < 0 && fallback_) {
+            fallback_(s, messageType, body);
+        }
+        return messageType;
+    }
+
+private:
+    std::tuple<handler<Messages>...> handlers_{};
+    fallback fallback_ = nullptr;
+};
+
+using registry = handler_registry<jr_visca::messages>;
+
+/**
+ * Handlers for what a ptz_fleet can do: drive, absolute and relative moves, home, reset, presets,
+ * zoom and focus, Cancel and IF_Clear, the position inquiries and notifications. Picture settings are kept
+ * and reported, as camera_handler does. Any other command is acked and ignored; any other inquiry gets an
+ * error, since there's no answer to give it.
+ */
+const registry &default_handlers();
+
+#pragma mark Sessions
+
+/**
+ * Stops, Cancel and IF_Clear are express: in each batch they run before anything else, so a Stop behind a
+ * flood of inquiries isn't answered after all of them. Everything else is normal.
+ */
+enum class lane { express, normal };
+
+struct lane_stats {
+    uint64_t run = 0;
+    uint64_t rejected = 0;      // Answered with ERROR_BUFFER_FULL.
+    uint64_t overtaken = 0;     // Moves and drives an express frame later in their batch stopped before they ran.
+};
+
+/**
+ * One connection, controlling one camera in the engine's fleet. Answers to any address, as
+ * VISCA over IP does, with `address` as the sender of its replies.
+ */
+class session {
+public:
+    session(engine &e, const registry &handlers, jr_socket socket, int camera, uint8_t address = 1);
+    session(const session &) = delete;
+    session &operator=(const session &) = delete;
+    // Cancels whatever it still has running.
+    ~session();
+
+    /**
+     * Takes bytes from the connection and starts a command for each complete frame. Of the Pan_TiltDrive and
+     * zoom drives that arrive together, only the last of each runs, as in camera_handler (see ptz_coalesce.h);
+     * the rest are just acknowledged. Express frames run first, and the moves and drives they'd have stopped
+     * don't run at all.
+     * Returns 0, or -1 if the data is corrupt and the connection should be dropped.
+     */
+    int receive(std::span<const uint8_t> data);
+
+    engine &owner() const { return engine_; }
+    ptz_fleet *fleet() const { return engine_.fleet(); }
+    int camera() const { return camera_; }
+    uint8_t address() const { return address_; }
+    frame_pool &pool() { return pool_; }
+    std::size_t in_flight() const { return inFlight_; }
+    const lane_stats &stats(lane l) const { return stats_[(int)l]; }
+
+    template <class M>
+    void send(const M &message) {
+        uint8_t data[JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH];
+        // Address Set goes to everyone, from no one.
+        bool addressSet = M::id == JR_VISCA_MESSAGE_CAMERA_NUMBER;
+        int length = jr_visca::encode(message, addressSet ? 0 : address_, addressSet ? jr_visca::broadcast_address : 0,
+                                      std::span<uint8_t>(data));
+        if (length > 0) {
+            send_data(data, length, reply_time(M::id));
+        }
+    }
+    void ack(uint8_t socketNumber = 1) { send(jr_visca::ack{socketNumber}); }
+    void completion(uint8_t socketNumber = 1) { send(jr_visca::completion{socketNumber}); }
+    void ack_completion(uint8_t socketNumber = 1) {
+        ack(socketNumber);
+        completion(socketNumber);
+    }
+    void error(uint8_t errorType, uint8_t socketNumber = 1) { send(jr_visca::error_reply{socketNumber, errorType}); }
+
+    /**
+     * The camera's timing, speeds and quirks; "sim" until this is called. `profile` must outlive the session.
+     * Speeds are scaled to the engine's tick, so a profile moves at its own degrees a second whatever the tick.
+     */
+    void set_profile(const ptz_profile &profile);
+    const ptz_profile &profile() const { return *profile_; }
+    // Position units a tick at VISCA `speed`.
+    int32_t pan_step(int speed) const;
+    int32_t tilt_step(int speed) const;
+
+    // Position notifications at no more than `rate` a second from the next engine::run on; 0 stops them.
+    void subscribe(int rate);
+    bool subscribed() const { return ptz_notify_active(&notify_); }
+
+private:
+    friend struct command::promise_type;
+    friend class engine;
+    clock::time_point reply_time(int messageType) const;
+    void send_data(const uint8_t *data, int length, clock::time_point due);
+    void write_data(const uint8_t *data, int length);
+    void flush_delayed(clock::time_point now);
+    void start_command(command::promise_type &promise, int messageType);
+    void update_notify(ptz_notify &notify) const;
+    void send_notifications(clock::time_point now);
+    clock::time_point next_notification() const;
+
+    engine &engine_;
+    const registry &handlers_;
+    jr_socket socket_;
+    int camera_;
+    uint8_t address_;
+    bool closing_ = false;
+    bool moves_ = false;                        // The frame being dispatched starts or stops something.
+    std::size_t inFlight_ = 0;
+    ptz_notify notify_ = {};
+    frame_pool pool_;
+    // The shortest frame is 3 bytes, so this is every frame a full buffer can hold.
+    static constexpr int max_batch = 1024 / 3;
+    // Express frames in one batch, and normal commands still running, past which frames get ERROR_BUFFER_FULL.
+    static constexpr int express_limit = 16;
+    static constexpr std::size_t normal_limit = 64;
+    lane_stats stats_[2];
+    const ptz_profile *profile_;
+    uint64_t rng_;
+    command::promise_type *current_ = nullptr;  // The command running right now, which sends are replies to.
+    struct delayed_send {
+        clock::time_point due;
+        int length;
+        uint8_t data[JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH];
+    };
+    std::vector<delayed_send> delayed_;         // In the order they're due.
+    uint8_t buffer_[1024];
+    int count_ = 0;
+};
+
+// The JR_VISCA_MESSAGE_ a handler was called for: its message's id, or the fallback's messageType.
+template <class M, class... Rest>
+constexpr int command_message_type(const M &message, const Rest &...) {
+    if constexpr (requires { M::id; }) {
+        return M::id;
+    } else if constexpr (std::is_same_v<M, int>) {
+        return message;
+    } else {
+        return 0;
+    }
+}
+
+template <class... Args>
+command::promise_type::promise_type(session &s, Args &...args) noexcept : owner(s) {
+    s.inFlight_++;
+    s.start_command(*this, command_message_type(args...));
+}
+
+inline command::promise_type::~promise_type() {
+    owner.inFlight_--;
+    if (owner.current_ == this) {
+        owner.current_ = nullptr;
+    }
+}
+
+template <class... Args>
+void *command::promise_type::operator new(std::size_t size, session &s, Args &...) noexcept {
+    return s.pool().allocate(size);
+}
+
+} // namespace ptz
+
+#endif
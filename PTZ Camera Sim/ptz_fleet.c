@@ -0,0 +1,127 @@
+//
+//  ptz_fleet.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_fleet.h"
+#include "ptz_simd.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const int32_t ptz_fleet_min[PTZ_FLEET_AXES] = { PTZ_PT_MIN, PTZ_PT_MIN, 0, 0 };
+static const int32_t ptz_fleet_max[PTZ_FLEET_AXES] = { PTZ_PT_MAX, PTZ_PT_MAX, PTZ_ZOOM_MAX, PTZ_FOCUS_MAX };
+static const uint32_t ptz_fleet_dirty[PTZ_FLEET_AXES] = { PTZ_STATE_PAN, PTZ_STATE_TILT, PTZ_STATE_ZOOM, PTZ_STATE_FOCUS };
+
+int ptz_fleet_init(ptz_fleet *fleet, int count) {
+    memset(fleet, 0, sizeof(*fleet));
+    if (count <= 0) {
+        return -1;
+    }
+    int chunks = (count + PTZ_FLEET_LANES - 1) / PTZ_FLEET_LANES;
+    size_t lanes = (size_t)chunks * PTZ_FLEET_LANES;
+    // One block: the axis arrays, then the two changed lists, then the chunk flags.
+    size_t size = lanes * sizeof(int32_t) * (3 * PTZ_FLEET_AXES + 2) + (size_t)chunks;
+    void *block = NULL;
+    if (posix_memalign(&block, 64, size) != 0) {
+        return -1;
+    }
+    memset(block, 0, size);
+    int32_t *next = block;
+    for (int axis = 0; axis < PTZ_FLEET_AXES; axis++) {
+        fleet->position[axis] = next;
+        fleet->target[axis] = next + lanes;
+        fleet->speed[axis] = next + 2 * lanes;
+        next += 3 * lanes;
+    }
+    fleet->changed = (uint32_t *)next;
+    fleet->changedDirty = (uint32_t *)(next + lanes);
+    fleet->active = (uint8_t *)(next + 2 * lanes);
+    fleet->count = count;
+    fleet->chunks = chunks;
+    fleet->block = block;
+    return 0;
+}
+
+void ptz_fleet_free(ptz_fleet *fleet) {
+    free(fleet->block);
+    memset(fleet, 0, sizeof(*fleet));
+}
+
+static inline int32_t ptz_fleet_clamp(ptz_fleet_axis axis, int32_t value) {
+    return value < ptz_fleet_min[axis] ? ptz_fleet_min[axis] : value > ptz_fleet_max[axis] ? ptz_fleet_max[axis] : value;
+}
+
+void ptz_fleet_move_to(ptz_fleet *fleet, int camera, ptz_fleet_axis axis, int32_t target, int32_t speed) {
+    fleet->target[axis][camera] = ptz_fleet_clamp(axis, target);
+    fleet->speed[axis][camera] = speed > 0 ? speed : 0;
+    fleet->active[camera / PTZ_FLEET_LANES] = 1;
+}
+
+void ptz_fleet_jog(ptz_fleet *fleet, int camera, ptz_fleet_axis axis, int direction, int32_t speed) {
+    if (direction == 0) {
+        ptz_fleet_stop(fleet, camera, axis);
+        return;
+    }
+    ptz_fleet_move_to(fleet, camera, axis, direction < 0 ? ptz_fleet_min[axis] : ptz_fleet_max[axis], speed);
+}
+
+void ptz_fleet_stop(ptz_fleet *fleet, int camera, ptz_fleet_axis axis) {
+    fleet->target[axis][camera] = fleet->position[axis][camera];
+}
+
+void ptz_fleet_set_position(ptz_fleet *fleet, int camera, ptz_fleet_axis axis, int32_t position) {
+    position = ptz_fleet_clamp(axis, position);
+    fleet->position[axis][camera] = position;
+    fleet->target[axis][camera] = position;
+}
+
+static inline ptz_i32x8 ptz_fleet_load(const int32_t *p) {
+    ptz_i32x8 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+int ptz_fleet_tick(ptz_fleet *fleet) {
+    int changedCount = 0;
+    for (int chunk = 0; chunk < fleet->chunks; chunk++) {
+        if (!fleet->active[chunk]) {
+            continue;
+        }
+        size_t base = (size_t)chunk * PTZ_FLEET_LANES;
+        ptz_i32x8 dirty = { 0 };
+        ptz_i32x8 remaining = { 0 };
+        for (int axis = 0; axis < PTZ_FLEET_AXES; axis++) {
+            ptz_i32x8 position = ptz_fleet_load(fleet->position[axis] + base);
+            ptz_i32x8 target = ptz_fleet_load(fleet->target[axis] + base);
+            ptz_i32x8 speed = ptz_fleet_load(fleet->speed[axis] + base);
+            // Step by the speed, or the rest of the way if that's less.
+            ptz_i32x8 delta = target - position;
+            ptz_i32x8 low = -speed;
+            ptz_i32x8 over = delta > speed;
+            ptz_i32x8 under = delta < low;
+            delta = (over & speed) | (under & low) | (~(over | under) & delta);
+            position += delta;
+            memcpy(fleet->position[axis] + base, &position, sizeof(position));
+            dirty |= (delta != 0) & (int32_t)ptz_fleet_dirty[axis];
+            remaining |= position != target;
+        }
+        for (int lane = 0; lane < PTZ_FLEET_LANES; lane++) {
+            if (dirty[lane] != 0) {
+                fleet->changed[changedCount] = (uint32_t)(base + lane);
+                fleet->changedDirty[changedCount] = (uint32_t)dirty[lane];
+                changedCount++;
+            }
+        }
+        // Stays on the list while anything is still short of its target, even at speed 0, so setting a speed later works.
+        int moving = 0;
+        for (int lane = 0; lane < PTZ_FLEET_LANES; lane++) {
+            moving |= remaining[lane];
+        }
+        fleet->active[chunk] = moving != 0;
+    }
+    fleet->changedCount = changedCount;
+    return changedCount;
+}
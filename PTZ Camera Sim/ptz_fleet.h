@@ -0,0 +1,78 @@
+//
+//  ptz_fleet.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Motion for many simulated heads at once. Every camera's pan, tilt, zoom and focus live in contiguous
+//  arrays, one per quantity and axis, so a tick is a single vector pass over the cameras that are moving,
+//  and what comes out is just the list of cameras that changed.
+//
+
+#ifndef ptz_fleet_h
+#define ptz_fleet_h
+
+#include <stdint.h>
+#include "ptz_state.h"
+
+typedef enum ptz_fleet_axis {
+    PTZ_FLEET_PAN,
+    PTZ_FLEET_TILT,
+    PTZ_FLEET_ZOOM,
+    PTZ_FLEET_FOCUS,
+    PTZ_FLEET_AXES
+} ptz_fleet_axis;
+
+// Cameras per vector. Arrays are padded to a multiple of this, so the tick has no scalar tail.
+#define PTZ_FLEET_LANES 8
+
+/**
+ * Not thread-safe; one thread owns the fleet and its ticks.
+ */
+typedef struct ptz_fleet {
+    int count;
+    int chunks;                             // count / PTZ_FLEET_LANES, rounded up.
+    int32_t *position[PTZ_FLEET_AXES];
+    int32_t *target[PTZ_FLEET_AXES];        // Where each axis is headed; equal to position when it's still.
+    int32_t *speed[PTZ_FLEET_AXES];         // Units per tick.
+    uint8_t *active;                        // Per chunk: something in it may still be moving.
+    uint32_t *changed;                      // After a tick: the cameras that moved...
+    uint32_t *changedDirty;                 // ...and PTZ_STATE_ bits for the axes that did.
+    int changedCount;
+    void *block;
+} ptz_fleet;
+
+/**
+ * Every camera starts at 0 on every axis, standing still. Returns 0, or -1 if the allocation failed.
+ */
+int ptz_fleet_init(ptz_fleet *fleet, int count);
+void ptz_fleet_free(ptz_fleet *fleet);
+
+/**
+ * Moves toward `target`, clamped to the axis's range, by `speed` units a tick: absolute moves and preset recall.
+ */
+void ptz_fleet_move_to(ptz_fleet *fleet, int camera, ptz_fleet_axis axis, int32_t target, int32_t speed);
+
+/**
+ * Keeps moving at `speed` in `direction` (-1 or 1) until stopped or the end of the axis: joystick moves.
+ */
+void ptz_fleet_jog(ptz_fleet *fleet, int camera, ptz_fleet_axis axis, int direction, int32_t speed);
+
+void ptz_fleet_stop(ptz_fleet *fleet, int camera, ptz_fleet_axis axis);
+
+/**
+ * Puts an axis somewhere without moving through the positions in between, and stops it there.
+ */
+void ptz_fleet_set_position(ptz_fleet *fleet, int camera, ptz_fleet_axis axis, int32_t position);
+
+static inline int32_t ptz_fleet_position(const ptz_fleet *fleet, int camera, ptz_fleet_axis axis) {
+    return fleet->position[axis][camera];
+}
+
+/**
+ * Advances every moving camera by one tick. Returns the number of cameras that moved, which are listed
+ * in `changed` and `changedDirty` until the next tick.
+ */
+int ptz_fleet_tick(ptz_fleet *fleet);
+
+#endif /* ptz_fleet_h */
@@ -0,0 +1,377 @@
+//
+//  ptz_http.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_http.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Linux has no SO_NOSIGPIPE; macOS has no MSG_NOSIGNAL. Either way a client hanging up must not kill us.
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Request line plus headers. Snapshot requests are a few hundred bytes.
+#define PTZ_HTTP_HEADER_MAX 8192
+
+typedef struct ptz_http_connection {
+    ptz_http_server *server;
+    int socket;
+    int slot;
+} ptz_http_connection;
+
+static const char *ptz_http_reason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 431: return "Request Header Fields Too Large";
+        case 503: return "Service Unavailable";
+        default: return "Internal Server Error";
+    }
+}
+
+int ptz_http_send(int fd, const void *data, size_t length) {
+    const uint8_t *p = data;
+    while (length > 0) {
+        ssize_t sent = send(fd, p, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+static int ptz_http_send_response(int fd, const ptz_http_request *request, const ptz_http_response *response, int keepAlive) {
+    char header[512];
+    char contentLength[48] = "";
+    // Streams have no length, so the end of the body is the end of the connection.
+    if (response->stream == NULL) {
+        snprintf(contentLength, sizeof(contentLength), "Content-Length: %zu\r\n", response->length);
+    }
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.1 %d %s\r\n"
+                          "Content-Type: %s\r\n"
+                          "%s"
+                          "Cache-Control: no-cache\r\n"
+                          "Connection: %s\r\n"
+                          "\r\n",
+                          response->status, ptz_http_reason(response->status),
+                          response->contentType ? response->contentType : "text/plain",
+                          contentLength, keepAlive ? "keep-alive" : "close");
+    if (ptz_http_send(fd, header, (size_t)length) < 0) {
+        return -1;
+    }
+    if (request != NULL && request->head) {
+        return 0;
+    }
+    if (response->stream != NULL) {
+        response->stream(fd, response->streamContext);
+        return 0;
+    }
+    return ptz_http_send(fd, response->body, response->length);
+}
+
+static void ptz_http_send_error(int fd, int status) {
+    const char *reason = ptz_http_reason(status);
+    ptz_http_response response = { .status = status, .body = (const uint8_t *)reason, .length = strlen(reason) };
+    ptz_http_send_response(fd, NULL, &response, 0);
+}
+
+// Case-insensitive search for `token` in a header line.
+static int ptz_http_line_contains(const char *line, const char *token) {
+    size_t length = strlen(token);
+    for (const char *p = line; *p != '\0'; p++) {
+        if (strncasecmp(p, token, length) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Fills in `request` from the header block. Returns the HTTP status to fail with, or 0 if it's a request we serve.
+static int ptz_http_parse(char *headers, ptz_http_request *request, int *keepAlive) {
+    memset(request, 0, sizeof(*request));
+    char target[512];
+    char version[16];
+    if (sscanf(headers, "%7s %511s %15s", request->method, target, version) != 3) {
+        return 400;
+    }
+    // 1.1 keeps the connection by default, 1.0 closes it.
+    *keepAlive = (strcmp(version, "HTTP/1.1") == 0);
+    char *line = strstr(headers, "\r\n");
+    while (line != NULL && line[2] != '\r') {
+        line += 2;
+        char *next = strstr(line, "\r\n");
+        if (next == NULL) {
+            break;
+        }
+        if (strncasecmp(line, "Connection:", 11) == 0) {
+            *next = '\0';
+            if (ptz_http_line_contains(line, "close")) {
+                *keepAlive = 0;
+            } else if (ptz_http_line_contains(line, "keep-alive")) {
+                *keepAlive = 1;
+            }
+            *next = '\r';
+        } else if (   (strncasecmp(line, "Content-Length:", 15) == 0 && atol(line + 15) != 0)
+                   || strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+            // We never read bodies, so we couldn't find the next request after one.
+            *keepAlive = 0;
+            return 405;
+        }
+        line = next;
+    }
+    if (strcmp(request->method, "HEAD") == 0) {
+        request->head = 1;
+    } else if (strcmp(request->method, "GET") != 0) {
+        *keepAlive = 0;
+        return 405;
+    }
+    char *query = strchr(target, '?');
+    if (query != NULL) {
+        *query++ = '\0';
+        snprintf(request->query, sizeof(request->query), "%s", query);
+    }
+    if (strlen(target) >= sizeof(request->path)) {
+        return 404;
+    }
+    strcpy(request->path, target);
+    return 0;
+}
+
+static void ptz_http_serve_connection(ptz_http_server *server, int fd) {
+    char buffer[PTZ_HTTP_HEADER_MAX + 1];
+    size_t used = 0;
+    for (;;) {
+        char *end;
+        buffer[used] = '\0';
+        while ((end = strstr(buffer, "\r\n\r\n")) == NULL) {
+            if (used == PTZ_HTTP_HEADER_MAX) {
+                ptz_http_send_error(fd, 431);
+                return;
+            }
+            // Timeouts land here too, which is how idle keep-alive connections go away.
+            ssize_t received = recv(fd, buffer + used, PTZ_HTTP_HEADER_MAX - used, 0);
+            if (received <= 0) {
+                return;
+            }
+            used += (size_t)received;
+            buffer[used] = '\0';
+        }
+        size_t headerLength = (size_t)(end - buffer) + 4;
+        end[2] = '\0';
+        ptz_http_request request;
+        int keepAlive = 0;
+        int status = ptz_http_parse(buffer, &request, &keepAlive);
+        if (status != 0) {
+            ptz_http_send_error(fd, status);
+            return;
+        }
+        ptz_http_response response = { .status = 404, .contentType = "text/plain",
+                                        .body = (const uint8_t *)"Not Found", .length = 9 };
+        server->handler(&request, &response, server->context);
+        if (response.stream != NULL) {
+            keepAlive = 0;
+        }
+        int sent = ptz_http_send_response(fd, &request, &response, keepAlive);
+        if (response.release != NULL) {
+            response.release(response.releaseContext);
+        }
+        if (sent < 0 || !keepAlive) {
+            return;
+        }
+        // Pipelined requests may already be in the buffer.
+        memmove(buffer, buffer + headerLength, used - headerLength);
+        used -= headerLength;
+    }
+}
+
+static void *ptz_http_connection_thread(void *arg) {
+    ptz_http_connection *connection = arg;
+    ptz_http_server *server = connection->server;
+    ptz_http_serve_connection(server, connection->socket);
+
+    pthread_mutex_lock(&server->lock);
+    // Closed under the lock so stop never shuts down a descriptor number that has already been reused.
+    close(connection->socket);
+    server->sockets[connection->slot] = -1;
+    if (--server->connections == 0) {
+        pthread_cond_broadcast(&server->idle);
+    }
+    pthread_mutex_unlock(&server->lock);
+    free(connection);
+    return NULL;
+}
+
+static void ptz_http_configure_socket(int fd) {
+    struct timeval timeout = { .tv_sec = PTZ_HTTP_IDLE_SECONDS };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+}
+
+// Hands `fd` to a new connection thread, or turns it away if we're full. Always takes ownership of `fd`.
+static void ptz_http_start_connection(ptz_http_server *server, int fd) {
+    ptz_http_configure_socket(fd);
+    pthread_mutex_lock(&server->lock);
+    int slot = -1;
+    for (int i = 0; i < PTZ_HTTP_MAX_CONNECTIONS && !server->stopping; i++) {
+        if (server->sockets[i] < 0) {
+            slot = i;
+            break;
+        }
+    }
+    ptz_http_connection *connection = (slot >= 0) ? malloc(sizeof(*connection)) : NULL;
+    if (connection == NULL) {
+        pthread_mutex_unlock(&server->lock);
+        ptz_http_send_error(fd, 503);
+        close(fd);
+        return;
+    }
+    connection->server = server;
+    connection->socket = fd;
+    connection->slot = slot;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    if (pthread_create(&thread, &attributes, ptz_http_connection_thread, connection) != 0) {
+        pthread_mutex_unlock(&server->lock);
+        pthread_attr_destroy(&attributes);
+        free(connection);
+        ptz_http_send_error(fd, 503);
+        close(fd);
+        return;
+    }
+    pthread_attr_destroy(&attributes);
+    server->sockets[slot] = fd;
+    server->connections++;
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void *ptz_http_accept_thread(void *arg) {
+    ptz_http_server *server = arg;
+    for (;;) {
+        int fd = accept(server->listenSocket, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            pthread_mutex_lock(&server->lock);
+            int stopping = server->stopping;
+            pthread_mutex_unlock(&server->lock);
+            if (!stopping) {
+                perror("accept");
+            }
+            return NULL;
+        }
+        ptz_http_start_connection(server, fd);
+    }
+}
+
+int ptz_http_server_start(ptz_http_server *server, int port, ptz_http_bind interfaces, ptz_http_handler handler, void *context) {
+    memset(server, 0, sizeof(*server));
+    server->port = port;
+    server->handler = handler;
+    server->context = context;
+    for (int i = 0; i < PTZ_HTTP_MAX_CONNECTIONS; i++) {
+        server->sockets[i] = -1;
+    }
+    server->listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (server->listenSocket < 0) {
+        perror("socket");
+        return -1;
+    }
+    int enable = 1;
+    setsockopt(server->listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    struct sockaddr_in address = { 0 };
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(interfaces == PTZ_HTTP_BIND_ANY ? INADDR_ANY : INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if (   bind(server->listenSocket, (struct sockaddr *)&address, sizeof(address)) < 0
+        || getsockname(server->listenSocket, (struct sockaddr *)&address, &addressLength) < 0) {
+        perror("bind");
+        close(server->listenSocket);
+        return -1;
+    }
+    server->port = ntohs(address.sin_port);
+    if (listen(server->listenSocket, PTZ_HTTP_MAX_CONNECTIONS) < 0) {
+        perror("listen");
+        close(server->listenSocket);
+        return -1;
+    }
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->idle, NULL);
+    if (pthread_create(&server->acceptThread, NULL, ptz_http_accept_thread, server) != 0) {
+        close(server->listenSocket);
+        pthread_mutex_destroy(&server->lock);
+        pthread_cond_destroy(&server->idle);
+        return -1;
+    }
+    return 0;
+}
+
+void ptz_http_server_stop(ptz_http_server *server) {
+    pthread_mutex_lock(&server->lock);
+    server->stopping = 1;
+    pthread_mutex_unlock(&server->lock);
+    // shutdown, not close: it wakes a thread blocked in accept on every platform.
+    shutdown(server->listenSocket, SHUT_RDWR);
+    pthread_join(server->acceptThread, NULL);
+    close(server->listenSocket);
+
+    pthread_mutex_lock(&server->lock);
+    for (int i = 0; i < PTZ_HTTP_MAX_CONNECTIONS; i++) {
+        if (server->sockets[i] >= 0) {
+            shutdown(server->sockets[i], SHUT_RDWR);
+        }
+    }
+    while (server->connections > 0) {
+        pthread_cond_wait(&server->idle, &server->lock);
+    }
+    pthread_mutex_unlock(&server->lock);
+    pthread_mutex_destroy(&server->lock);
+    pthread_cond_destroy(&server->idle);
+}
+
+int ptz_http_query_value(const char *query, const char *name, char *value, size_t valueSize) {
+    size_t nameLength = strlen(name);
+    const char *p = query;
+    while (p != NULL && *p != '\0') {
+        const char *end = strchr(p, '&');
+        size_t length = end ? (size_t)(end - p) : strlen(p);
+        if (length > nameLength && strncmp(p, name, nameLength) == 0 && p[nameLength] == '=') {
+            size_t valueLength = length - nameLength - 1;
+            if (valueLength >= valueSize) {
+                return 0;
+            }
+            memcpy(value, p + nameLength + 1, valueLength);
+            value[valueLength] = '\0';
+            return 1;
+        }
+        p = end ? end + 1 : NULL;
+    }
+    return 0;
+}
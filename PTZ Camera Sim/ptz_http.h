@@ -0,0 +1,92 @@
+//
+//  ptz_http.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Just enough HTTP/1.1 to serve camera snapshots and streams: GET and HEAD, keep-alive, no request bodies.
+//  Each connection gets its own thread, so a slow client only holds up itself.
+//
+
+#ifndef ptz_http_h
+#define ptz_http_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Real cameras serve snapshots on 80, which needs root; we'd rather not.
+#define PTZ_HTTP_PORT 8080
+#define PTZ_HTTP_MAX_CONNECTIONS 16
+// Idle keep-alive connections are closed after this long.
+#define PTZ_HTTP_IDLE_SECONDS 5
+
+// Snapshots and streams show whatever the camera is pointed at, so nothing off this machine sees them unless asked.
+typedef enum ptz_http_bind {
+    PTZ_HTTP_BIND_LOOPBACK,     // 127.0.0.1 only.
+    PTZ_HTTP_BIND_ANY,          // Every interface, for controllers and monitors on the network.
+} ptz_http_bind;
+
+typedef struct ptz_http_request {
+    char method[8];
+    char path[256];         // Without the query.
+    char query[256];        // After the '?', or empty.
+    int head;               // HEAD: send the headers only.
+} ptz_http_request;
+
+typedef struct ptz_http_response {
+    int status;
+    const char *contentType;
+    const uint8_t *body;
+    size_t length;
+    // Called once the body has been sent, or dropped, so the handler can free or release it.
+    void (*release)(void *context);
+    void *releaseContext;
+    // For bodies of unknown length, like MJPEG. Called after the headers instead of sending `body`,
+    // on the connection's thread, and writes with ptz_http_send until it's done or a send fails.
+    // The connection is closed afterwards.
+    void (*stream)(int socket, void *context);
+    void *streamContext;
+} ptz_http_response;
+
+/**
+ * Fills in `response` for `request`. Runs on the connection's thread; handlers must be thread-safe.
+ */
+typedef void (*ptz_http_handler)(const ptz_http_request *request, ptz_http_response *response, void *context);
+
+typedef struct ptz_http_server {
+    int listenSocket;
+    int port;               // The one actually bound, when started with 0.
+    ptz_http_handler handler;
+    void *context;
+    pthread_t acceptThread;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;    // Signaled when the last connection closes.
+    int stopping;
+    int connections;
+    int sockets[PTZ_HTTP_MAX_CONNECTIONS];   // Open connections, -1 for free slots, so stop can wake them.
+} ptz_http_server;
+
+/**
+ * Listens on `port` on the `interfaces` asked for and starts accepting on a background thread; a port of 0
+ * lets the system pick one, which ends up in server->port. Returns 0 on success, -1 if the socket couldn't be
+ * set up (usually because the port is taken).
+ */
+int ptz_http_server_start(ptz_http_server *server, int port, ptz_http_bind interfaces, ptz_http_handler handler, void *context);
+
+/**
+ * Stops accepting, shuts down open connections, and waits for every thread to finish.
+ */
+void ptz_http_server_stop(ptz_http_server *server);
+
+/**
+ * Sends all of `data` on a connection, for ptz_http_response.stream. Returns 0, or -1 once the client has gone.
+ */
+int ptz_http_send(int socket, const void *data, size_t length);
+
+/**
+ * Value of `name` in a query string like "a=1&b=2", copied to `value`. Returns 1 if found, 0 if not.
+ */
+int ptz_http_query_value(const char *query, const char *name, char *value, size_t valueSize);
+
+#endif /* ptz_http_h */
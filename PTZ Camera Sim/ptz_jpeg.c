@@ -0,0 +1,522 @@
+//
+//  ptz_jpeg.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_jpeg.h"
+#include "ptz_simd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Worst case for one 16x16 MCU: six blocks of a DC and 63 AC codes at 16 + 11 bits, every byte stuffed.
+#define PTZ_JPEG_MCU_MAX_BYTES 2560
+
+#pragma mark - Standard tables (ITU T.81 Annex K)
+
+static const uint8_t ptz_jpeg_zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static const uint8_t ptz_jpeg_base_quant[2][64] = {
+    {
+        16, 11, 10, 16,  24,  40,  51,  61,
+        12, 12, 14, 19,  26,  58,  60,  55,
+        14, 13, 16, 24,  40,  57,  69,  56,
+        14, 17, 22, 29,  51,  87,  80,  62,
+        18, 22, 37, 56,  68, 109, 103,  77,
+        24, 35, 55, 64,  81, 104, 113,  92,
+        49, 64, 78, 87, 103, 121, 120, 101,
+        72, 92, 95, 98, 112, 100, 103,  99
+    }, {
+        17, 18, 24, 47, 99, 99, 99, 99,
+        18, 21, 26, 66, 99, 99, 99, 99,
+        24, 26, 56, 99, 99, 99, 99, 99,
+        47, 66, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99
+    }
+};
+
+static const uint8_t ptz_jpeg_dc_bits[2][16] = {
+    { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 }
+};
+
+static const uint8_t ptz_jpeg_dc_values[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t ptz_jpeg_ac_bits[2][16] = {
+    { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d },
+    { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 }
+};
+
+static const uint8_t ptz_jpeg_ac_values[2][162] = {
+    {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+        0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    }, {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+        0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+        0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    }
+};
+
+// Per-row and per-column output scale of the AAN DCT.
+static const float ptz_jpeg_aan_scale[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
+#pragma mark - Tables
+
+static void ptz_jpeg_build_huffman(ptz_jpeg_huffman *table, const uint8_t bits[16], const uint8_t *values) {
+    memset(table, 0, sizeof(*table));
+    uint16_t code = 0;
+    int k = 0;
+    for (int length = 1; length <= 16; length++) {
+        for (int i = 0; i < bits[length - 1]; i++, k++) {
+            table->code[values[k]] = code++;
+            table->size[values[k]] = (uint8_t)length;
+        }
+        code <<= 1;
+    }
+}
+
+static uint8_t *ptz_jpeg_put16(uint8_t *p, int value) {
+    *p++ = (uint8_t)(value >> 8);
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+static uint8_t *ptz_jpeg_put_dht(uint8_t *p, int tableClass, int index, const uint8_t bits[16], const uint8_t *values) {
+    int count = 0;
+    for (int i = 0; i < 16; i++) {
+        count += bits[i];
+    }
+    *p++ = (uint8_t)((tableClass << 4) | index);
+    memcpy(p, bits, 16);
+    p += 16;
+    memcpy(p, values, (size_t)count);
+    return p + count;
+}
+
+void ptz_jpeg_tables_init(ptz_jpeg_tables *tables, int quality) {
+    memset(tables, 0, sizeof(*tables));
+    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+    tables->quality = quality;
+    // The IJG scaling, so quality numbers mean what they do everywhere else.
+    int scale = (quality < 50) ? 5000 / quality : 200 - quality * 2;
+
+    uint8_t quant[2][64];
+    for (int t = 0; t < 2; t++) {
+        for (int i = 0; i < 64; i++) {
+            int q = (ptz_jpeg_base_quant[t][i] * scale + 50) / 100;
+            quant[t][i] = (uint8_t)(q < 1 ? 1 : q > 255 ? 255 : q);
+        }
+        // The DCT leaves its output transposed: coefficient (row, column) ends up at column * 8 + row.
+        for (int row = 0; row < 8; row++) {
+            for (int column = 0; column < 8; column++) {
+                tables->divisors[t][column * 8 + row] =
+                    1.0f / (quant[t][row * 8 + column] * ptz_jpeg_aan_scale[row] * ptz_jpeg_aan_scale[column] * 8.0f);
+            }
+        }
+        ptz_jpeg_build_huffman(&tables->dc[t], ptz_jpeg_dc_bits[t], ptz_jpeg_dc_values);
+        ptz_jpeg_build_huffman(&tables->ac[t], ptz_jpeg_ac_bits[t], ptz_jpeg_ac_values[t]);
+    }
+
+    uint8_t *p = tables->header;
+    // SOI, then a JFIF APP0 so viewers don't guess at the color space.
+    static const uint8_t jfif[] = {
+        0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+    };
+    memcpy(p, jfif, sizeof(jfif));
+    p += sizeof(jfif);
+    *p++ = 0xFF;
+    *p++ = 0xDB;
+    p = ptz_jpeg_put16(p, 2 + 2 * 65);
+    for (int t = 0; t < 2; t++) {
+        *p++ = (uint8_t)t;
+        for (int i = 0; i < 64; i++) {
+            *p++ = quant[t][ptz_jpeg_zigzag[i]];
+        }
+    }
+    *p++ = 0xFF;
+    *p++ = 0xC4;
+    uint8_t *length = p;
+    p += 2;
+    for (int t = 0; t < 2; t++) {
+        p = ptz_jpeg_put_dht(p, 0, t, ptz_jpeg_dc_bits[t], ptz_jpeg_dc_values);
+        p = ptz_jpeg_put_dht(p, 1, t, ptz_jpeg_ac_bits[t], ptz_jpeg_ac_values[t]);
+    }
+    ptz_jpeg_put16(length, (int)(p - length));
+    tables->headerSize = (size_t)(p - tables->header);
+}
+
+void ptz_jpeg_buffer_free(ptz_jpeg_buffer *buffer) {
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+static int ptz_jpeg_reserve(ptz_jpeg_buffer *buffer, size_t needed) {
+    if (buffer->capacity - buffer->size >= needed) {
+        return 0;
+    }
+    size_t capacity = buffer->capacity * 2;
+    if (capacity < buffer->size + needed) {
+        capacity = buffer->size + needed;
+    }
+    uint8_t *data = realloc(buffer->data, capacity);
+    if (data == NULL) {
+        perror("realloc");
+        return -1;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+#pragma mark - Color conversion
+
+// One 8x8 block, a row per vector.
+typedef struct ptz_jpeg_block {
+    ptz_f32x8 rows[8];
+} ptz_jpeg_block;
+
+// Four luma blocks and the two chroma blocks they share, level shifted to center on zero.
+typedef struct ptz_jpeg_mcu {
+    ptz_jpeg_block y[4];
+    ptz_jpeg_block cb;
+    ptz_jpeg_block cr;
+} ptz_jpeg_mcu;
+
+// Channel `shift / 8` of 8 RGBA pixels loaded as little-endian words, as floats.
+// Masking whole words is much cheaper than byte shuffles on SSE2, which has no byte permute.
+static inline ptz_f32x8 ptz_jpeg_channel(ptz_i32x8 pixels, int shift) {
+    return PTZ_CONVERT((pixels >> shift) & 0xFF, ptz_f32x8);
+}
+
+// Adds neighboring pairs: 8 samples in, 4 out.
+static inline ptz_f32x4 ptz_jpeg_pair_sums(ptz_f32x8 v) {
+    return PTZ_SHUFFLE(v, v, 0, 2, 4, 6) + PTZ_SHUFFLE(v, v, 1, 3, 5, 7);
+}
+
+/**
+ * Converts 16 rows of 16 pixels to YCbCr, averaging each 2x2 square for chroma as it goes.
+ * `rows` point at the first pixel of each row; all 16 must have 64 readable bytes.
+ */
+static void ptz_jpeg_load_mcu(const uint8_t *const rows[16], ptz_jpeg_mcu *mcu) {
+    const ptz_f32x8 bias = (ptz_f32x8){0} + 128.0f;
+    float cb[8][8];
+    float cr[8][8];
+    for (int pair = 0; pair < 8; pair++) {
+        for (int half = 0; half < 2; half++) {
+            ptz_f32x8 r[2], g[2], b[2];
+            for (int i = 0; i < 2; i++) {
+                int y = pair * 2 + i;
+                ptz_i32x8 pixels;
+                memcpy(&pixels, rows[y] + half * 32, sizeof(pixels));
+                r[i] = ptz_jpeg_channel(pixels, 0);
+                g[i] = ptz_jpeg_channel(pixels, 8);
+                b[i] = ptz_jpeg_channel(pixels, 16);
+                mcu->y[(y / 8) * 2 + half].rows[y % 8] = 0.299f * r[i] + 0.587f * g[i] + 0.114f * b[i] - bias;
+            }
+            // The +128 chroma offset and the -128 level shift cancel.
+            ptz_f32x4 red = ptz_jpeg_pair_sums(r[0] + r[1]) * 0.25f;
+            ptz_f32x4 green = ptz_jpeg_pair_sums(g[0] + g[1]) * 0.25f;
+            ptz_f32x4 blue = ptz_jpeg_pair_sums(b[0] + b[1]) * 0.25f;
+            ptz_f32x4 u = -0.168736f * red - 0.331264f * green + 0.5f * blue;
+            ptz_f32x4 v = 0.5f * red - 0.418688f * green - 0.081312f * blue;
+            memcpy(&cb[pair][half * 4], &u, sizeof(u));
+            memcpy(&cr[pair][half * 4], &v, sizeof(v));
+        }
+    }
+    memcpy(mcu->cb.rows, cb, sizeof(cb));
+    memcpy(mcu->cr.rows, cr, sizeof(cr));
+}
+
+#pragma mark - DCT
+
+// One pass of the AAN float DCT (as in IJG's jfdctflt.c), on all eight columns at once.
+static inline void ptz_jpeg_dct_pass(ptz_f32x8 d[8]) {
+    ptz_f32x8 tmp0 = d[0] + d[7];
+    ptz_f32x8 tmp7 = d[0] - d[7];
+    ptz_f32x8 tmp1 = d[1] + d[6];
+    ptz_f32x8 tmp6 = d[1] - d[6];
+    ptz_f32x8 tmp2 = d[2] + d[5];
+    ptz_f32x8 tmp5 = d[2] - d[5];
+    ptz_f32x8 tmp3 = d[3] + d[4];
+    ptz_f32x8 tmp4 = d[3] - d[4];
+
+    ptz_f32x8 tmp10 = tmp0 + tmp3;
+    ptz_f32x8 tmp13 = tmp0 - tmp3;
+    ptz_f32x8 tmp11 = tmp1 + tmp2;
+    ptz_f32x8 tmp12 = tmp1 - tmp2;
+    d[0] = tmp10 + tmp11;
+    d[4] = tmp10 - tmp11;
+    ptz_f32x8 z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[2] = tmp13 + z1;
+    d[6] = tmp13 - z1;
+
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    ptz_f32x8 z5 = (tmp10 - tmp12) * 0.382683433f;
+    ptz_f32x8 z2 = 0.541196100f * tmp10 + z5;
+    ptz_f32x8 z4 = 1.306562965f * tmp12 + z5;
+    ptz_f32x8 z3 = tmp11 * 0.707106781f;
+    ptz_f32x8 z11 = tmp7 + z3;
+    ptz_f32x8 z13 = tmp7 - z3;
+    d[5] = z13 + z2;
+    d[3] = z13 - z2;
+    d[1] = z11 + z4;
+    d[7] = z11 - z4;
+}
+
+static inline void ptz_jpeg_transpose(ptz_f32x8 d[8]) {
+    ptz_f32x8 u[8], v[8];
+    for (int i = 0; i < 8; i += 2) {
+        u[i] = PTZ_SHUFFLE(d[i], d[i + 1], 0, 8, 1, 9, 4, 12, 5, 13);
+        u[i + 1] = PTZ_SHUFFLE(d[i], d[i + 1], 2, 10, 3, 11, 6, 14, 7, 15);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        v[i] = PTZ_SHUFFLE(u[i], u[i + 2], 0, 1, 8, 9, 4, 5, 12, 13);
+        v[i + 1] = PTZ_SHUFFLE(u[i], u[i + 2], 2, 3, 10, 11, 6, 7, 14, 15);
+        v[i + 2] = PTZ_SHUFFLE(u[i + 1], u[i + 3], 0, 1, 8, 9, 4, 5, 12, 13);
+        v[i + 3] = PTZ_SHUFFLE(u[i + 1], u[i + 3], 2, 3, 10, 11, 6, 7, 14, 15);
+    }
+    for (int i = 0; i < 4; i++) {
+        d[i] = PTZ_SHUFFLE(v[i], v[i + 4], 0, 1, 2, 3, 8, 9, 10, 11);
+        d[i + 4] = PTZ_SHUFFLE(v[i], v[i + 4], 4, 5, 6, 7, 12, 13, 14, 15);
+    }
+}
+
+// Forward DCT and quantization. `out` is transposed, like `divisors`.
+static void ptz_jpeg_dct_quantize(ptz_jpeg_block *block, const float divisors[64], int16_t out[64]) {
+    ptz_jpeg_dct_pass(block->rows);
+    ptz_jpeg_transpose(block->rows);
+    ptz_jpeg_dct_pass(block->rows);
+    for (int i = 0; i < 8; i++) {
+        ptz_f32x8 divisor;
+        memcpy(&divisor, divisors + i * 8, sizeof(divisor));
+        // Offset so truncation rounds to nearest, as IJG does.
+        ptz_i32x8 q = PTZ_CONVERT(block->rows[i] * divisor + 16384.5f, ptz_i32x8) - 16384;
+        ptz_i16x8 narrow = PTZ_CONVERT(q, ptz_i16x8);
+        memcpy(out + i * 8, &narrow, sizeof(narrow));
+    }
+}
+
+#pragma mark - Entropy coding
+
+typedef struct ptz_jpeg_writer {
+    uint8_t *out;
+    uint64_t bits;
+    int count;
+} ptz_jpeg_writer;
+
+static inline void ptz_jpeg_flush_byte(ptz_jpeg_writer *writer) {
+    writer->count -= 8;
+    uint8_t byte = (uint8_t)(writer->bits >> writer->count);
+    *writer->out++ = byte;
+    if (byte == 0xFF) {
+        *writer->out++ = 0;
+    }
+}
+
+static inline void ptz_jpeg_put_bits(ptz_jpeg_writer *writer, uint32_t value, int size) {
+    writer->bits = (writer->bits << size) | value;
+    writer->count += size;
+    if (writer->count >= 32) {
+        uint32_t word = (uint32_t)(writer->bits >> (writer->count - 32));
+        // No 0xFF bytes, which is nearly always, means no stuffing: all four go out at once.
+        uint32_t inverted = ~word;
+        if (((inverted - 0x01010101u) & ~inverted & 0x80808080u) == 0) {
+            uint8_t bytes[4] = { (uint8_t)(word >> 24), (uint8_t)(word >> 16), (uint8_t)(word >> 8), (uint8_t)word };
+            memcpy(writer->out, bytes, 4);
+            writer->out += 4;
+            writer->count -= 32;
+            return;
+        }
+        while (writer->count >= 8) {
+            ptz_jpeg_flush_byte(writer);
+        }
+    }
+}
+
+// Size category and the bits that follow it, as F.1.2.1 has them.
+static inline int ptz_jpeg_category(int value, uint32_t *bits) {
+    int magnitude = value < 0 ? -value : value;
+    int size = 32 - __builtin_clz((unsigned)magnitude);
+    *bits = (uint32_t)(value < 0 ? value - 1 : value) & ((1u << size) - 1);
+    return size;
+}
+
+static void ptz_jpeg_encode_block(ptz_jpeg_writer *writer, const int16_t coefficients[64], int *lastDC,
+                                  const ptz_jpeg_huffman *dc, const ptz_jpeg_huffman *ac) {
+    // Zigzag order through the DCT's transposed layout.
+    static const uint8_t order[64] = {
+         0,  8,  1,  2,  9, 16, 24, 17, 10,  3,  4, 11, 18, 25, 32, 40,
+        33, 26, 19, 12,  5,  6, 13, 20, 27, 34, 41, 48, 56, 49, 42, 35,
+        28, 21, 14,  7, 15, 22, 29, 36, 43, 50, 57, 58, 51, 44, 37, 30,
+        23, 31, 38, 45, 52, 59, 60, 53, 46, 39, 47, 54, 61, 62, 55, 63
+    };
+    int diff = coefficients[0] - *lastDC;
+    *lastDC = coefficients[0];
+    if (diff == 0) {
+        ptz_jpeg_put_bits(writer, dc->code[0], dc->size[0]);
+    } else {
+        uint32_t bits;
+        int size = ptz_jpeg_category(diff, &bits);
+        ptz_jpeg_put_bits(writer, dc->code[size], dc->size[size]);
+        ptz_jpeg_put_bits(writer, bits, size);
+    }
+
+    int last = 63;
+    while (last > 0 && coefficients[order[last]] == 0) {
+        last--;
+    }
+    int run = 0;
+    for (int k = 1; k <= last; k++) {
+        int value = coefficients[order[k]];
+        if (value == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            ptz_jpeg_put_bits(writer, ac->code[0xF0], ac->size[0xF0]);
+            run -= 16;
+        }
+        uint32_t bits;
+        int size = ptz_jpeg_category(value, &bits);
+        int symbol = (run << 4) | size;
+        ptz_jpeg_put_bits(writer, ac->code[symbol], ac->size[symbol]);
+        ptz_jpeg_put_bits(writer, bits, size);
+        run = 0;
+    }
+    if (last < 63) {
+        ptz_jpeg_put_bits(writer, ac->code[0x00], ac->size[0x00]);
+    }
+}
+
+#pragma mark - Encoder
+
+static uint8_t *ptz_jpeg_put_frame_header(uint8_t *p, int width, int height) {
+    // SOF0: 8 bits, three components, luma sampled 2x2 against chroma.
+    static const uint8_t components[] = { 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 };
+    *p++ = 0xFF;
+    *p++ = 0xC0;
+    p = ptz_jpeg_put16(p, 8 + 3 * 3);
+    *p++ = 8;
+    p = ptz_jpeg_put16(p, height);
+    p = ptz_jpeg_put16(p, width);
+    *p++ = 3;
+    memcpy(p, components, sizeof(components));
+    p += sizeof(components);
+    // SOS: all three components, luma on tables 0, chroma on tables 1, full spectral range.
+    static const uint8_t scan[] = { 0xFF, 0xDA, 0x00, 0x0C, 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+    memcpy(p, scan, sizeof(scan));
+    return p + sizeof(scan);
+}
+
+int ptz_jpeg_encode(const ptz_jpeg_tables *tables, const ptz_image *image, ptz_jpeg_buffer *buffer) {
+    int width = image->width;
+    int height = image->height;
+    if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF) {
+        return -1;
+    }
+    int mcuColumns = (width + 15) / 16;
+    int mcuRows = (height + 15) / 16;
+    size_t rowBytes = (size_t)mcuColumns * PTZ_JPEG_MCU_MAX_BYTES;
+    buffer->size = 0;
+    // Most frames come in well under a byte per pixel; the per-row check below covers the rest.
+    if (ptz_jpeg_reserve(buffer, tables->headerSize + 64 + (size_t)width * height / 2 + rowBytes) < 0) {
+        return -1;
+    }
+    memcpy(buffer->data, tables->header, tables->headerSize);
+    uint8_t *p = ptz_jpeg_put_frame_header(buffer->data + tables->headerSize, width, height);
+    buffer->size = (size_t)(p - buffer->data);
+
+    // The last MCU in a row usually hangs off the right edge; it's loaded from a copy with the edge pixel repeated.
+    uint8_t edge[16][64];
+    int edgeColumns = width - (mcuColumns - 1) * 16;
+    int dc[3] = { 0, 0, 0 };
+    ptz_jpeg_mcu mcu;
+    int16_t coefficients[64];
+    ptz_jpeg_writer writer = { 0 };
+    for (int mcuRow = 0; mcuRow < mcuRows; mcuRow++) {
+        if (ptz_jpeg_reserve(buffer, rowBytes + 8) < 0) {
+            return -1;
+        }
+        writer.out = buffer->data + buffer->size;
+        const uint8_t *rows[16];
+        for (int i = 0; i < 16; i++) {
+            int y = mcuRow * 16 + i;
+            rows[i] = ptz_image_row(image, y < height ? y : height - 1);
+        }
+        for (int mcuColumn = 0; mcuColumn < mcuColumns; mcuColumn++) {
+            const uint8_t *pixels[16];
+            if (mcuColumn == mcuColumns - 1 && edgeColumns < 16) {
+                for (int i = 0; i < 16; i++) {
+                    const uint8_t *src = rows[i] + mcuColumn * 64;
+                    memcpy(edge[i], src, (size_t)edgeColumns * 4);
+                    for (int x = edgeColumns; x < 16; x++) {
+                        memcpy(edge[i] + x * 4, src + (edgeColumns - 1) * 4, 4);
+                    }
+                    pixels[i] = edge[i];
+                }
+            } else {
+                for (int i = 0; i < 16; i++) {
+                    pixels[i] = rows[i] + mcuColumn * 64;
+                }
+            }
+            ptz_jpeg_load_mcu(pixels, &mcu);
+            for (int i = 0; i < 4; i++) {
+                ptz_jpeg_dct_quantize(&mcu.y[i], tables->divisors[0], coefficients);
+                ptz_jpeg_encode_block(&writer, coefficients, &dc[0], &tables->dc[0], &tables->ac[0]);
+            }
+            ptz_jpeg_dct_quantize(&mcu.cb, tables->divisors[1], coefficients);
+            ptz_jpeg_encode_block(&writer, coefficients, &dc[1], &tables->dc[1], &tables->ac[1]);
+            ptz_jpeg_dct_quantize(&mcu.cr, tables->divisors[1], coefficients);
+            ptz_jpeg_encode_block(&writer, coefficients, &dc[2], &tables->dc[1], &tables->ac[1]);
+        }
+        buffer->size = (size_t)(writer.out - buffer->data);
+    }
+    // Pad the last byte with ones, then EOI.
+    writer.out = buffer->data + buffer->size;
+    while (writer.count >= 8) {
+        ptz_jpeg_flush_byte(&writer);
+    }
+    if (writer.count > 0) {
+        int pad = 8 - writer.count;
+        writer.bits = (writer.bits << pad) | ((1u << pad) - 1);
+        writer.count = 8;
+        ptz_jpeg_flush_byte(&writer);
+    }
+    *writer.out++ = 0xFF;
+    *writer.out++ = 0xD9;
+    buffer->size = (size_t)(writer.out - buffer->data);
+    return 0;
+}
@@ -0,0 +1,62 @@
+//
+//  ptz_jpeg.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Baseline JPEG encoder for snapshots and streams. 4:2:0, standard Huffman tables, float AAN DCT
+//  on the ptz_simd vector types. Color conversion and chroma downsampling happen in the same pass that
+//  loads each 16x16 block, so the frame is only read once.
+//
+
+#ifndef ptz_jpeg_h
+#define ptz_jpeg_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ptz_render.h"
+
+// Quality presets, on the usual 1-100 scale.
+#define PTZ_JPEG_QUALITY_SNAPSHOT 92    // Stills: hard to tell from the original.
+#define PTZ_JPEG_QUALITY_STREAM 80      // Every frame of a stream: about a third the size of SNAPSHOT.
+#define PTZ_JPEG_QUALITY_PREVIEW 60     // Thumbnails and low-bandwidth clients.
+
+typedef struct ptz_jpeg_huffman {
+    uint16_t code[256];
+    uint8_t size[256];
+} ptz_jpeg_huffman;
+
+/**
+ * Everything about an encode that depends only on the quality. Read-only once set up,
+ * so one set can be shared by every thread encoding at that quality.
+ */
+typedef struct ptz_jpeg_tables {
+    int quality;
+    float divisors[2][64];      // Luma and chroma: 1 / (quantizer * DCT scale), in the order the DCT leaves its output.
+    ptz_jpeg_huffman dc[2];
+    ptz_jpeg_huffman ac[2];
+    uint8_t header[640];        // SOI, JFIF, DQT and DHT, which are the same for every frame.
+    size_t headerSize;
+} ptz_jpeg_tables;
+
+void ptz_jpeg_tables_init(ptz_jpeg_tables *tables, int quality);
+
+/**
+ * Output. Keep one around and pass it back in to reuse its allocation;
+ * it only grows when a frame doesn't fit.
+ */
+typedef struct ptz_jpeg_buffer {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} ptz_jpeg_buffer;
+
+void ptz_jpeg_buffer_free(ptz_jpeg_buffer *buffer);
+
+/**
+ * Encodes `image` into `buffer`, replacing what was there. Alpha is ignored.
+ * Returns 0, or -1 if the buffer couldn't grow or the image is empty or too large for JPEG.
+ */
+int ptz_jpeg_encode(const ptz_jpeg_tables *tables, const ptz_image *image, ptz_jpeg_buffer *buffer);
+
+#endif /* ptz_jpeg_h */
@@ -0,0 +1,60 @@
+//
+//  ptz_notify.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_notify.h"
+
+#include <string.h>
+
+void ptz_notify_subscribe(ptz_notify *notify, int rate) {
+    memset(notify, 0, sizeof(*notify));
+    if (rate > 0) {
+        notify->interval = 1000000000ull / (uint64_t)rate;
+    }
+}
+
+void ptz_notify_update(ptz_notify *notify, const int32_t position[PTZ_FLEET_AXES]) {
+    memcpy(notify->latest, position, sizeof(notify->latest));
+    if (!notify->primed) {
+        // Differs from `latest` everywhere, so the first take sends both.
+        for (int axis = 0; axis < PTZ_FLEET_AXES; axis++) {
+            notify->sent[axis] = ~position[axis];
+        }
+        notify->primed = 1;
+    }
+}
+
+uint32_t ptz_notify_pending(const ptz_notify *notify) {
+    if (!notify->interval || !notify->primed) {
+        return 0;
+    }
+    uint32_t pending = 0;
+    if (notify->latest[PTZ_FLEET_PAN] != notify->sent[PTZ_FLEET_PAN] ||
+        notify->latest[PTZ_FLEET_TILT] != notify->sent[PTZ_FLEET_TILT]) {
+        pending |= PTZ_NOTIFY_PAN_TILT;
+    }
+    if (notify->latest[PTZ_FLEET_ZOOM] != notify->sent[PTZ_FLEET_ZOOM] ||
+        notify->latest[PTZ_FLEET_FOCUS] != notify->sent[PTZ_FLEET_FOCUS]) {
+        pending |= PTZ_NOTIFY_LENS;
+    }
+    return pending;
+}
+
+uint32_t ptz_notify_take(ptz_notify *notify, uint64_t now) {
+    if (now < notify->next) {
+        return 0;
+    }
+    uint32_t pending = ptz_notify_pending(notify);
+    if (pending) {
+        memcpy(notify->sent, notify->latest, sizeof(notify->sent));
+        notify->next = now + notify->interval;
+    }
+    return pending;
+}
+
+uint64_t ptz_notify_next(const ptz_notify *notify) {
+    return ptz_notify_pending(notify) ? notify->next : UINT64_MAX;
+}
@@ -0,0 +1,59 @@
+//
+//  ptz_notify.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Rate limiting for pushed position notifications (JR_VISCA_MESSAGE_NOTIFY_SUBSCRIBE). One per subscribed
+//  controller: feed it every position as it changes, and ask it what to send. In between notifications
+//  only the latest position is kept, so a controller that asks for 10 a second gets at most 10, and the
+//  last one is always where the camera actually stopped.
+//
+
+#ifndef ptz_notify_h
+#define ptz_notify_h
+
+#include <stdint.h>
+#include "ptz_fleet.h"
+
+// What a notification carries: pan and tilt go in one message, zoom and focus in another.
+#define PTZ_NOTIFY_PAN_TILT (1u << 0)
+#define PTZ_NOTIFY_LENS (1u << 1)
+
+typedef struct ptz_notify {
+    uint64_t interval;                  // Nanoseconds between notifications; 0 when not subscribed.
+    uint64_t next;                      // Nothing goes out before this.
+    int primed;                         // `sent` holds something; until then everything is pending.
+    int32_t sent[PTZ_FLEET_AXES];       // What the controller was last told, by ptz_fleet_axis.
+    int32_t latest[PTZ_FLEET_AXES];
+} ptz_notify;
+
+/**
+ * Starts notifications at no more than `rate` a second, or stops them if `rate` is 0.
+ * The first one goes out as soon as there's a position, so the controller doesn't have to ask.
+ */
+void ptz_notify_subscribe(ptz_notify *notify, int rate);
+
+static inline int ptz_notify_active(const ptz_notify *notify) {
+    return notify->interval != 0;
+}
+
+void ptz_notify_update(ptz_notify *notify, const int32_t position[PTZ_FLEET_AXES]);
+
+/**
+ * PTZ_NOTIFY_ bits for what has changed since it was last sent, whether or not it's time to send it.
+ */
+uint32_t ptz_notify_pending(const ptz_notify *notify);
+
+/**
+ * PTZ_NOTIFY_ bits for what to send at `now`, in nanoseconds on any monotonic clock, or 0 if nothing has changed
+ * or it's too soon. What it returns is taken as sent; send `latest`.
+ */
+uint32_t ptz_notify_take(ptz_notify *notify, uint64_t now);
+
+/**
+ * When ptz_notify_take will next have something, or UINT64_MAX if nothing is pending.
+ */
+uint64_t ptz_notify_next(const ptz_notify *notify);
+
+#endif /* ptz_notify_h */
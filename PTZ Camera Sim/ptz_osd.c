@@ -0,0 +1,271 @@
+//
+//  ptz_osd.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_osd.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "ptz_simd.h"
+
+// Rows of 5 bits, leftmost pixel in bit 4. Anything missing is blank.
+static const uint8_t ptz_osd_font[128][7] = {
+    [' '] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    ['%'] = { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },
+    ['+'] = { 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 },
+    ['-'] = { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 },
+    ['.'] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c },
+    ['/'] = { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },
+    ['0'] = { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e },
+    ['1'] = { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e },
+    ['2'] = { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f },
+    ['3'] = { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e },
+    ['4'] = { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 },
+    ['5'] = { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e },
+    ['6'] = { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e },
+    ['7'] = { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },
+    ['8'] = { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e },
+    ['9'] = { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c },
+    [':'] = { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 },
+    ['<'] = { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },
+    ['>'] = { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },
+    ['A'] = { 0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 },
+    ['B'] = { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e },
+    ['C'] = { 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e },
+    ['D'] = { 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c },
+    ['E'] = { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f },
+    ['F'] = { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 },
+    ['G'] = { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f },
+    ['H'] = { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 },
+    ['I'] = { 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e },
+    ['J'] = { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c },
+    ['K'] = { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },
+    ['L'] = { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f },
+    ['M'] = { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 },
+    ['N'] = { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },
+    ['O'] = { 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },
+    ['P'] = { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 },
+    ['Q'] = { 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d },
+    ['R'] = { 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 },
+    ['S'] = { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e },
+    ['T'] = { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },
+    ['U'] = { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },
+    ['V'] = { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 },
+    ['W'] = { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a },
+    ['X'] = { 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 },
+    ['Y'] = { 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 },
+    ['Z'] = { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f },
+    ['_'] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f },
+};
+
+// Premultiplied RGBA.
+static const uint8_t ptz_osd_panel[4] = { 20, 20, 20, 176 };
+static const uint8_t ptz_osd_text[4] = { 255, 255, 255, 255 };
+static const uint8_t ptz_osd_bar[4] = { 188, 188, 188, 224 };
+static const uint8_t ptz_osd_bar_text[4] = { 0, 0, 0, 255 };
+
+// Never a real cell, so a new sprite draws every one.
+#define PTZ_OSD_STALE 0xffff
+
+void ptz_osd_init(ptz_osd *osd) {
+    memset(osd, 0, sizeof(*osd));
+    ptz_osd_clear(osd);
+}
+
+void ptz_osd_free(ptz_osd *osd) {
+    for (int i = 0; i < PTZ_OSD_SPRITES; i++) {
+        ptz_image_free(&osd->sprites[i].image);
+    }
+    memset(osd, 0, sizeof(*osd));
+}
+
+void ptz_osd_clear(ptz_osd *osd) {
+    for (int row = 0; row < PTZ_OSD_ROWS; row++) {
+        for (int column = 0; column < PTZ_OSD_COLUMNS; column++) {
+            osd->cells[row][column] = ' ';
+        }
+    }
+}
+
+void ptz_osd_set_text(ptz_osd *osd, int row, int column, const char *text, int highlight) {
+    if (row < 0 || row >= PTZ_OSD_ROWS) {
+        return;
+    }
+    for (; *text != '\0' && column < PTZ_OSD_COLUMNS; text++, column++) {
+        int c = toupper((unsigned char)*text);
+        if (c >= 128) {
+            c = ' ';
+        }
+        if (column >= 0) {
+            osd->cells[row][column] = (uint16_t)(c | (highlight ? PTZ_OSD_HIGHLIGHT : 0));
+        }
+    }
+}
+
+static const char *ptz_osd_wb_name(uint32_t wbMode) {
+    switch (wbMode) {
+        case 0: return "AUTO";
+        case 1: return "INDOOR";
+        case 2: return "OUTDOOR";
+        case 3: return "ONEPUSH";
+        case 5: return "MANUAL";
+        case PTZ_WB_MODE_COLOR: return "VAR";
+        default: return "-";
+    }
+}
+
+void ptz_osd_menu(ptz_osd *osd, const ptz_camera_state *state, const char *address) {
+    char values[PTZ_MENU_ITEMS][PTZ_OSD_COLUMNS];
+    static const char *labels[PTZ_MENU_ITEMS] = { "ADDRESS:", "PRESET SPEED:", "FOCUS:", "WB:", "COLOR TEMP:" };
+    snprintf(values[0], sizeof(values[0]), "%s", address);
+    snprintf(values[1], sizeof(values[1]), "%u", state->presetSpeed);
+    snprintf(values[2], sizeof(values[2]), "%u", state->focus);
+    snprintf(values[3], sizeof(values[3]), "%s", ptz_osd_wb_name(state->wbMode));
+    snprintf(values[4], sizeof(values[4]), "%u", state->colorTempIndex * 100 + 2500);
+
+    ptz_osd_clear(osd);
+    ptz_osd_set_text(osd, 0, (PTZ_OSD_COLUMNS - 4) / 2, "MENU", 0);
+    for (int i = 0; i < PTZ_MENU_ITEMS; i++) {
+        int row = i + 2;
+        int highlight = (i == (int)state->menuItem);
+        if (highlight) {
+            // The bar runs the width of the grid, not just under the text.
+            for (int column = 0; column < PTZ_OSD_COLUMNS; column++) {
+                osd->cells[row][column] = ' ' | PTZ_OSD_HIGHLIGHT;
+            }
+        }
+        ptz_osd_set_text(osd, row, 1, labels[i], highlight);
+        ptz_osd_set_text(osd, row, 15, values[i], highlight);
+    }
+}
+
+static inline void ptz_osd_fill(uint8_t *p, const uint8_t color[4], int count) {
+    for (int i = 0; i < count; i++) {
+        memcpy(p + i * 4, color, 4);
+    }
+}
+
+static void ptz_osd_draw_cell(ptz_image *image, int scale, int row, int column, uint16_t cell) {
+    int highlight = (cell & PTZ_OSD_HIGHLIGHT) != 0;
+    const uint8_t *background = highlight ? ptz_osd_bar : ptz_osd_panel;
+    const uint8_t *foreground = highlight ? ptz_osd_bar_text : ptz_osd_text;
+    const uint8_t *glyph = ptz_osd_font[cell & 0x7f];
+    int width = PTZ_OSD_CELL_WIDTH * scale;
+    int left = column * width;
+    int top = row * PTZ_OSD_CELL_HEIGHT * scale;
+    for (int y = 0; y < PTZ_OSD_CELL_HEIGHT * scale; y++) {
+        uint8_t *out = ptz_image_row(image, top + y) + left * 4;
+        // One font pixel of space above, then the 7 rows of the glyph. The column of space is on the right.
+        int glyphRow = y / scale - 1;
+        uint8_t bits = (glyphRow >= 0 && glyphRow < 7) ? glyph[glyphRow] : 0;
+        ptz_osd_fill(out, background, width);
+        for (int x = 0; x < 5; x++) {
+            if (bits & (0x10 >> x)) {
+                ptz_osd_fill(out + x * scale * 4, foreground, scale);
+            }
+        }
+    }
+}
+
+// Brings the sprite for `scale` up to date with the cells, allocating or replacing one if needed.
+static ptz_osd_sprite *ptz_osd_sprite_for_scale(ptz_osd *osd, int scale) {
+    ptz_osd_sprite *sprite = NULL;
+    for (int i = 0; i < PTZ_OSD_SPRITES && sprite == NULL; i++) {
+        if (osd->sprites[i].scale == scale) {
+            sprite = &osd->sprites[i];
+        }
+    }
+    if (sprite == NULL) {
+        sprite = &osd->sprites[0];
+        for (int i = 1; i < PTZ_OSD_SPRITES; i++) {
+            if (osd->sprites[i].used < sprite->used) {
+                sprite = &osd->sprites[i];
+            }
+        }
+        if (ptz_image_alloc(&sprite->image, PTZ_OSD_COLUMNS * PTZ_OSD_CELL_WIDTH * scale,
+                            PTZ_OSD_ROWS * PTZ_OSD_CELL_HEIGHT * scale) < 0) {
+            sprite->scale = 0;
+            return NULL;
+        }
+        sprite->scale = scale;
+        memset(sprite->cells, 0xff, sizeof(sprite->cells));
+    }
+    sprite->used = ++osd->clock;
+    for (int row = 0; row < PTZ_OSD_ROWS; row++) {
+        for (int column = 0; column < PTZ_OSD_COLUMNS; column++) {
+            uint16_t cell = osd->cells[row][column];
+            if (sprite->cells[row][column] != cell) {
+                ptz_osd_draw_cell(&sprite->image, scale, row, column, cell);
+                sprite->cells[row][column] = cell;
+            }
+        }
+    }
+    return sprite;
+}
+
+int ptz_osd_draw(ptz_osd *osd, ptz_image *dst, float opacity) {
+    int scaleX = dst->width / (PTZ_OSD_COLUMNS * PTZ_OSD_CELL_WIDTH * 2);
+    int scaleY = dst->height / (PTZ_OSD_ROWS * PTZ_OSD_CELL_HEIGHT * 2);
+    // Half the frame across, like the real thing, but never smaller than one pixel per font pixel.
+    int scale = scaleX < scaleY ? scaleX : scaleY;
+    if (scale < 1) {
+        scale = 1;
+    }
+    ptz_osd_sprite *sprite = ptz_osd_sprite_for_scale(osd, scale);
+    if (sprite == NULL) {
+        return -1;
+    }
+    if (sprite->image.width > dst->width || sprite->image.height > dst->height) {
+        // Too small for even the smallest font; nothing sensible to draw.
+        return 0;
+    }
+    unsigned alpha = (unsigned)lroundf((opacity < 0 ? 0 : opacity > 1 ? 1 : opacity) * 256);
+    ptz_osd_blend(&sprite->image, dst, (dst->width - sprite->image.width) / 2, (dst->height - sprite->image.height) / 2, alpha);
+    return 0;
+}
+
+// x / 255 for x in [0, 255 * 255 + 255], exactly.
+static inline ptz_u16x8 ptz_osd_div255(ptz_u16x8 x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Eight bytes, two pixels: out = src * opacity + dst * (255 - srcAlpha * opacity) / 255.
+static inline ptz_u16x8 ptz_osd_blend2(ptz_u16x8 s, ptz_u16x8 d, ptz_u16x8 opacity) {
+    s = (s * opacity + 128) >> 8;
+    ptz_u16x8 a = PTZ_SHUFFLE(s, s, 3, 3, 3, 3, 7, 7, 7, 7);
+    return s + ptz_osd_div255(d * (255 - a));
+}
+
+void ptz_osd_blend(const ptz_image *src, ptz_image *dst, int x, int y, unsigned opacity) {
+    const ptz_u16x8 o = (ptz_u16x8){0} + (uint16_t)opacity;
+    int count = src->width * 4;
+    for (int row = 0; row < src->height; row++) {
+        const uint8_t *s = ptz_image_row(src, row);
+        uint8_t *d = ptz_image_row(dst, y + row) + x * 4;
+        int i = 0;
+        for (; i + 16 <= count; i += 16) {
+            ptz_u8x16 vs = ptz_load_u8x16(s + i);
+            ptz_u8x16 vd = ptz_load_u8x16(d + i);
+            ptz_u16x8 lo = ptz_osd_blend2(PTZ_CONVERT(PTZ_SHUFFLE(vs, vs, 0, 1, 2, 3, 4, 5, 6, 7), ptz_u16x8),
+                                          PTZ_CONVERT(PTZ_SHUFFLE(vd, vd, 0, 1, 2, 3, 4, 5, 6, 7), ptz_u16x8), o);
+            ptz_u16x8 hi = ptz_osd_blend2(PTZ_CONVERT(PTZ_SHUFFLE(vs, vs, 8, 9, 10, 11, 12, 13, 14, 15), ptz_u16x8),
+                                          PTZ_CONVERT(PTZ_SHUFFLE(vd, vd, 8, 9, 10, 11, 12, 13, 14, 15), ptz_u16x8), o);
+            ptz_u8x8 olo = PTZ_CONVERT(lo, ptz_u8x8);
+            ptz_u8x8 ohi = PTZ_CONVERT(hi, ptz_u8x8);
+            ptz_store_u8x16(d + i, PTZ_SHUFFLE(olo, ohi, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        }
+        for (; i < count; i += 4) {
+            unsigned a = (s[i + 3] * opacity + 128) >> 8;
+            for (int c = 0; c < 4; c++) {
+                unsigned v = d[i + c] * (255 - a) + 128;
+                d[i + c] = (uint8_t)(((s[i + c] * opacity + 128) >> 8) + ((v + (v >> 8)) >> 8));
+            }
+        }
+    }
+}
@@ -0,0 +1,79 @@
+//
+//  ptz_osd.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The camera's on-screen display, drawn the way the hardware does it: a grid of character cells in a
+//  built-in 5x7 font. The grid is kept rasterized as premultiplied RGBA sprites, one per output size, and
+//  only the cells whose text or highlight changed are drawn again, so showing the menu over a frame is
+//  just a blend.
+//
+
+#ifndef ptz_osd_h
+#define ptz_osd_h
+
+#include <stdint.h>
+#include "ptz_render.h"
+#include "ptz_state.h"
+
+#define PTZ_OSD_COLUMNS 30
+#define PTZ_OSD_ROWS 7
+// Cells in font pixels: 5x7 glyphs with room for spacing and descent.
+#define PTZ_OSD_CELL_WIDTH 6
+#define PTZ_OSD_CELL_HEIGHT 10
+// Enough for the stream and every snapshot size to keep their own.
+#define PTZ_OSD_SPRITES 4
+
+// Or'd into a cell for the menu cursor: dark text on a light bar.
+#define PTZ_OSD_HIGHLIGHT 0x100
+
+typedef struct ptz_osd_sprite {
+    int scale;              // Output pixels per font pixel, or 0 if the sprite is unused.
+    uint64_t used;          // ptz_osd.clock when it was last drawn, for picking one to replace.
+    uint16_t cells[PTZ_OSD_ROWS][PTZ_OSD_COLUMNS];  // What's rasterized in `image` right now.
+    ptz_image image;
+} ptz_osd_sprite;
+
+/**
+ * Not thread-safe; the app only touches it on main.
+ */
+typedef struct ptz_osd {
+    uint16_t cells[PTZ_OSD_ROWS][PTZ_OSD_COLUMNS];  // Characters, plus PTZ_OSD_HIGHLIGHT.
+    uint64_t clock;
+    ptz_osd_sprite sprites[PTZ_OSD_SPRITES];
+} ptz_osd;
+
+void ptz_osd_init(ptz_osd *osd);
+void ptz_osd_free(ptz_osd *osd);
+
+/**
+ * Blanks every cell.
+ */
+void ptz_osd_clear(ptz_osd *osd);
+
+/**
+ * Writes `text` starting at a cell, clipped at the right edge. Lowercase is shown as uppercase,
+ * and characters the font doesn't have as spaces.
+ */
+void ptz_osd_set_text(ptz_osd *osd, int row, int column, const char *text, int highlight);
+
+/**
+ * Lays out the settings menu for `state`, with the cursor on state->menuItem.
+ * `address` is the camera's IP address, which isn't part of the state.
+ */
+void ptz_osd_menu(ptz_osd *osd, const ptz_camera_state *state, const char *address);
+
+/**
+ * Blends the grid, centered, over `dst` at `opacity` (0...1), at the largest whole-pixel font scale that fits.
+ * Returns 0, or -1 if a sprite couldn't be allocated.
+ */
+int ptz_osd_draw(ptz_osd *osd, ptz_image *dst, float opacity);
+
+/**
+ * Premultiplied `src` over `dst` with its top left at (x, y), scaled by `opacity` in [0, 256].
+ * `src` has to fit inside `dst`.
+ */
+void ptz_osd_blend(const ptz_image *src, ptz_image *dst, int x, int y, unsigned opacity);
+
+#endif /* ptz_osd_h */
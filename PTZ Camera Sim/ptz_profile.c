@@ -0,0 +1,411 @@
+//
+//  ptz_profile.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_profile.h"
+#include "ptz_state.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#pragma mark Built in
+
+// Slowest to fastest, each the same factor faster than the last, which is roughly how real speed tables go.
+static void spread_speeds(float *speeds, int count, float slowest, float fastest) {
+    for (int i = 1; i <= count; i++) {
+        speeds[i] = (count == 1) ? fastest : slowest * powf(fastest / slowest, (float)(i - 1) / (float)(count - 1));
+    }
+}
+
+// With a range of PTZ_RANGE_MAX degrees a degree is a unit, so speed * 10 degrees a second is `speed` units a 100ms step.
+static void sim_profile(ptz_profile *profile) {
+    memset(profile, 0, sizeof(*profile));
+    strcpy(profile->name, "sim");
+    profile->quirks = PTZ_QUIRK_PRESET_95_MENU | PTZ_QUIRK_FX_OFF_REPLY;
+    profile->stepMs = 100;
+    profile->panRange = PTZ_RANGE_MAX;
+    profile->tiltRange = PTZ_RANGE_MAX;
+    for (int i = 1; i <= PTZ_PROFILE_PAN_SPEEDS; i++) {
+        profile->panSpeeds[i] = i * 10.0f;
+    }
+    for (int i = 1; i <= PTZ_PROFILE_TILT_SPEEDS; i++) {
+        profile->tiltSpeeds[i] = i * 10.0f;
+    }
+    profile->ack = (ptz_profile_delay){ PTZ_PROFILE_FIXED, 0, 0 };
+    profile->completion = (ptz_profile_delay){ PTZ_PROFILE_FIXED, 0, 0 };
+}
+
+// PTZOptics 20X-SDI: 1.7-100°/s pan, 1.7-69.9°/s tilt, over ±170° and -30° to +90°.
+static void ptzoptics_profile(ptz_profile *profile) {
+    sim_profile(profile);
+    strcpy(profile->name, "ptzoptics");
+    profile->quirks |= PTZ_QUIRK_STRICT_RECALL;
+    profile->panRange = 340;
+    profile->tiltRange = 120;
+    spread_speeds(profile->panSpeeds, PTZ_PROFILE_PAN_SPEEDS, 1.7f, 100);
+    spread_speeds(profile->tiltSpeeds, PTZ_PROFILE_TILT_SPEEDS, 1.7f, 69.9f);
+    profile->ack = (ptz_profile_delay){ PTZ_PROFILE_NORMAL, 9, 3 };
+    profile->completion = (ptz_profile_delay){ PTZ_PROFILE_NORMAL, 30, 12 };
+}
+
+// Sony SRG-300: 1.1-101°/s pan, 1.1-91°/s tilt, over ±170° and -20° to +90°. Quick to answer, but with a tail.
+static void sony_profile(ptz_profile *profile) {
+    sim_profile(profile);
+    strcpy(profile->name, "sony");
+    profile->quirks = 0;
+    profile->stepMs = 50;
+    profile->panRange = 340;
+    profile->tiltRange = 110;
+    spread_speeds(profile->panSpeeds, PTZ_PROFILE_PAN_SPEEDS, 1.1f, 101);
+    spread_speeds(profile->tiltSpeeds, PTZ_PROFILE_TILT_SPEEDS, 1.1f, 91);
+    profile->ack = (ptz_profile_delay){ PTZ_PROFILE_LOGNORMAL, 4, 0.3f };
+    profile->completion = (ptz_profile_delay){ PTZ_PROFILE_LOGNORMAL, 12, 0.5f };
+}
+
+static const struct {
+    const char *name;
+    void (*make)(ptz_profile *profile);
+} builtins[] = {
+    { "sim", sim_profile },
+    { "ptzoptics", ptzoptics_profile },
+    { "sony", sony_profile },
+};
+
+int ptz_profile_builtin(ptz_profile *profile, const char *name) {
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        if (strcasecmp(name, builtins[i].name) == 0) {
+            builtins[i].make(profile);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+#pragma mark Files
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+static int parse_delay(const char *value, ptz_profile_delay *delay) {
+    static const struct {
+        const char *name;
+        ptz_profile_distribution distribution;
+        int arguments;
+    } kinds[] = {
+        { "fixed", PTZ_PROFILE_FIXED, 1 },
+        { "uniform", PTZ_PROFILE_UNIFORM, 2 },
+        { "normal", PTZ_PROFILE_NORMAL, 2 },
+        { "lognormal", PTZ_PROFILE_LOGNORMAL, 2 },
+    };
+    char kind[16];
+    float a = 0, b = 0;
+    int count = sscanf(value, "%15s %f %f", kind, &a, &b);
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+        if (count >= 1 && strcasecmp(kind, kinds[i].name) == 0) {
+            if (count - 1 != kinds[i].arguments || a < 0 || b < 0) {
+                return -1;
+            }
+            *delay = (ptz_profile_delay){ kinds[i].distribution, a, b };
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Either one for every speed, or the slowest and the fastest.
+static int parse_speeds(const char *value, float *speeds, int count) {
+    float parsed[PTZ_PROFILE_PAN_SPEEDS + 1];
+    int found = 0;
+    const char *p = value;
+    char *end;
+    while (found <= count) {
+        float speed = strtof(p, &end);
+        if (end == p) {
+            break;
+        }
+        if (speed <= 0) {
+            return -1;
+        }
+        parsed[found++] = speed;
+        p = end;
+    }
+    if (*trim((char *)p) != '\0') {
+        return -1;
+    }
+    if (found == 2) {
+        spread_speeds(speeds, count, parsed[0], parsed[1]);
+    } else if (found == count) {
+        memcpy(speeds + 1, parsed, count * sizeof(float));
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_quirks(char *value, uint32_t *quirks) {
+    static const struct {
+        const char *name;
+        uint32_t quirk;
+    } names[] = {
+        { "preset_95_menu", PTZ_QUIRK_PRESET_95_MENU },
+        { "strict_recall", PTZ_QUIRK_STRICT_RECALL },
+        { "fx_off_reply", PTZ_QUIRK_FX_OFF_REPLY },
+    };
+    uint32_t parsed = 0;
+    for (char *word = strtok(value, " \t,"); word; word = strtok(NULL, " \t,")) {
+        if (strcasecmp(word, "none") == 0) {
+            continue;
+        }
+        size_t i = 0;
+        while (i < sizeof(names) / sizeof(names[0]) && strcasecmp(word, names[i].name) != 0) {
+            i++;
+        }
+        if (i == sizeof(names) / sizeof(names[0])) {
+            return -1;
+        }
+        parsed |= names[i].quirk;
+    }
+    *quirks = parsed;
+    return 0;
+}
+
+static ptz_profile_override *find_override(ptz_profile *profile, int messageType) {
+    for (int i = 0; i < profile->overrideCount; i++) {
+        if (profile->overrides[i].messageType == messageType) {
+            return &profile->overrides[i];
+        }
+    }
+    if (profile->overrideCount == PTZ_PROFILE_OVERRIDES) {
+        return NULL;
+    }
+    ptz_profile_override *override = &profile->overrides[profile->overrideCount++];
+    memset(override, 0, sizeof(*override));
+    override->messageType = messageType;
+    return override;
+}
+
+// ack.N and completion.N
+static int parse_override(ptz_profile *profile, const char *key, const char *value) {
+    int completion = strncasecmp(key, "completion.", 11) == 0;
+    if (!completion && strncasecmp(key, "ack.", 4) != 0) {
+        return -1;
+    }
+    const char *number = key + (completion ? 11 : 4);
+    char *end;
+    errno = 0;
+    long messageType = strtol(number, &end, 0);
+    if (end == number || *end != '\0' || errno || messageType <= 0) {
+        return -1;
+    }
+    ptz_profile_delay delay;
+    if (parse_delay(value, &delay) < 0) {
+        return -1;
+    }
+    ptz_profile_override *override = find_override(profile, (int)messageType);
+    if (!override) {
+        return -1;
+    }
+    if (completion) {
+        override->completion = delay;
+        override->hasCompletion = 1;
+    } else {
+        override->ack = delay;
+        override->hasAck = 1;
+    }
+    return 0;
+}
+
+static int parse_line(ptz_profile *profile, char *key, char *value, int first) {
+    if (strcasecmp(key, "base") == 0) {
+        // Keeps the name it has, from the file's.
+        char name[sizeof(profile->name)];
+        memcpy(name, profile->name, sizeof(name));
+        if (!first || ptz_profile_builtin(profile, value) < 0) {
+            return -1;
+        }
+        memcpy(profile->name, name, sizeof(name));
+    } else if (strcasecmp(key, "name") == 0) {
+        snprintf(profile->name, sizeof(profile->name), "%s", value);
+    } else if (strcasecmp(key, "quirks") == 0) {
+        return parse_quirks(value, &profile->quirks);
+    } else if (strcasecmp(key, "step_ms") == 0) {
+        int step = atoi(value);
+        if (step <= 0) {
+            return -1;
+        }
+        profile->stepMs = (uint32_t)step;
+    } else if (strcasecmp(key, "seed") == 0) {
+        profile->seed = strtoull(value, NULL, 0);
+    } else if (strcasecmp(key, "pan_range") == 0 || strcasecmp(key, "tilt_range") == 0) {
+        float range = strtof(value, NULL);
+        if (range <= 0) {
+            return -1;
+        }
+        *(tolower((unsigned char)key[0]) == 'p' ? &profile->panRange : &profile->tiltRange) = range;
+    } else if (strcasecmp(key, "pan_speeds") == 0) {
+        return parse_speeds(value, profile->panSpeeds, PTZ_PROFILE_PAN_SPEEDS);
+    } else if (strcasecmp(key, "tilt_speeds") == 0) {
+        return parse_speeds(value, profile->tiltSpeeds, PTZ_PROFILE_TILT_SPEEDS);
+    } else if (strcasecmp(key, "ack") == 0) {
+        return parse_delay(value, &profile->ack);
+    } else if (strcasecmp(key, "completion") == 0) {
+        return parse_delay(value, &profile->completion);
+    } else {
+        return parse_override(profile, key, value);
+    }
+    return 0;
+}
+
+int ptz_profile_load(ptz_profile *profile, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    sim_profile(profile);
+    const char *slash = strrchr(path, '/');
+    snprintf(profile->name, sizeof(profile->name), "%s", slash ? slash + 1 : path);
+
+    char line[512];
+    int lineNumber = 0;
+    int first = 1;
+    int result = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char *text = trim(line);
+        if (*text == '\0') {
+            continue;
+        }
+        char *equals = strchr(text, '=');
+        if (!equals) {
+            fprintf(stderr, "%s:%d: expected key = value\n", path, lineNumber);
+            result = -1;
+            break;
+        }
+        *equals = '\0';
+        char *key = trim(text);
+        char *value = trim(equals + 1);
+        if (parse_line(profile, key, value, first) < 0) {
+            fprintf(stderr, "%s:%d: bad %s\n", path, lineNumber, key);
+            result = -1;
+            break;
+        }
+        first = 0;
+    }
+    fclose(file);
+    return result;
+}
+
+int ptz_profile_find(ptz_profile *profile, const char *nameOrPath) {
+    if (ptz_profile_builtin(profile, (nameOrPath && *nameOrPath) ? nameOrPath : "sim") == 0) {
+        return 0;
+    }
+    return ptz_profile_load(profile, nameOrPath);
+}
+
+#pragma mark Delays
+
+uint64_t ptz_profile_rng(const ptz_profile *profile) {
+    if (profile->seed) {
+        return profile->seed;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    // Never 0, which xorshift can't leave.
+    return ((uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec) | 1;
+}
+
+// xorshift64*, as a double in [0, 1).
+static double next_uniform(uint64_t *rng) {
+    uint64_t x = *rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *rng = x;
+    return (double)((x * 0x2545F4914F6CDD1Dull) >> 11) * 0x1.0p-53;
+}
+
+static double next_normal(uint64_t *rng) {
+    double u = 1.0 - next_uniform(rng);  // (0, 1], for the log.
+    double v = next_uniform(rng);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static uint64_t sample(const ptz_profile_delay *delay, uint64_t *rng) {
+    double ms;
+    switch (delay->distribution) {
+        case PTZ_PROFILE_FIXED:
+            ms = delay->a;
+            break;
+        case PTZ_PROFILE_UNIFORM:
+            ms = delay->a + (delay->b - delay->a) * next_uniform(rng);
+            break;
+        case PTZ_PROFILE_NORMAL:
+            ms = delay->a + delay->b * next_normal(rng);
+            break;
+        case PTZ_PROFILE_LOGNORMAL:
+            ms = delay->a * exp(delay->b * next_normal(rng));
+            break;
+        default:
+            ms = 0;
+            break;
+    }
+    return ms > 0 ? (uint64_t)(ms * 1e6) : 0;
+}
+
+static const ptz_profile_override *override_for(const ptz_profile *profile, int messageType) {
+    for (int i = 0; i < profile->overrideCount; i++) {
+        if (profile->overrides[i].messageType == messageType) {
+            return &profile->overrides[i];
+        }
+    }
+    return NULL;
+}
+
+uint64_t ptz_profile_ack_ns(const ptz_profile *profile, int messageType, uint64_t *rng) {
+    const ptz_profile_override *override = override_for(profile, messageType);
+    return sample((override && override->hasAck) ? &override->ack : &profile->ack, rng);
+}
+
+uint64_t ptz_profile_completion_ns(const ptz_profile *profile, int messageType, uint64_t *rng) {
+    const ptz_profile_override *override = override_for(profile, messageType);
+    return sample((override && override->hasCompletion) ? &override->completion : &profile->completion, rng);
+}
+
+#pragma mark Speeds
+
+static int32_t step_units(float degreesPerSecond, float range, uint64_t stepNs) {
+    double units = degreesPerSecond * ((double)stepNs / 1e9) * (PTZ_RANGE_MAX / range);
+    return units < 1 ? 1 : (int32_t)lround(units);
+}
+
+int32_t ptz_profile_pan_step(const ptz_profile *profile, int speed, uint64_t stepNs) {
+    speed = speed < 1 ? 1 : speed > PTZ_PROFILE_PAN_SPEEDS ? PTZ_PROFILE_PAN_SPEEDS : speed;
+    return step_units(profile->panSpeeds[speed], profile->panRange, stepNs);
+}
+
+int32_t ptz_profile_tilt_step(const ptz_profile *profile, int speed, uint64_t stepNs) {
+    speed = speed < 1 ? 1 : speed > PTZ_PROFILE_TILT_SPEEDS ? PTZ_PROFILE_TILT_SPEEDS : speed;
+    return step_units(profile->tiltSpeeds[speed], profile->tiltRange, stepNs);
+}
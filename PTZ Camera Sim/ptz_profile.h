@@ -0,0 +1,120 @@
+//
+//  ptz_profile.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  What makes one model of camera behave differently from another: how long it takes to ACK and to
+//  complete, how fast it really moves at each VISCA speed, and which of its firmware's oddities to copy.
+//  Each camera loads one at startup, either built in by name or from a file like this:
+//
+//      # Sony SRG-300, measured on the bench
+//      base = sony                     # Start from a built-in profile; must come first if it's there.
+//      name = SRG-300
+//      quirks = strict_recall          # Any of preset_95_menu, strict_recall, fx_off_reply; or none.
+//      step_ms = 50                    # How often moves advance.
+//      seed = 42                       # For jitter that's the same every run; 0 seeds from the clock.
+//      pan_range = 340                 # Degrees, end to end.
+//      tilt_range = 120
+//      pan_speeds = 1.1 101            # Degrees a second: either one for each VISCA speed, 1-0x18 for pan
+//      tilt_speeds = 1.1 91            # and 1-0x14 for tilt, or the slowest and fastest, spread geometrically.
+//      ack = lognormal 4 0.3           # Milliseconds: fixed MS, uniform LO HI, normal MEAN SD, lognormal MEDIAN SHAPE.
+//      completion = normal 12 4
+//      ack.0x947 = fixed 15            # For one message, by its JR_VISCA_MESSAGE_ number.
+//      completion.20 = uniform 40 80
+//
+//  The ACK delay is how long a camera takes to answer at all: it comes before the ACK, or before the reply
+//  to an inquiry. The completion delay comes on top of however long the command itself takes.
+//
+
+#ifndef ptz_profile_h
+#define ptz_profile_h
+
+#include <stdint.h>
+
+#define PTZ_PROFILE_PAN_SPEEDS 0x18
+#define PTZ_PROFILE_TILT_SPEEDS 0x14
+#define PTZ_PROFILE_OVERRIDES 32
+
+// Recalling preset 95 opens and closes the OSD menu, as PTZOptics cameras do.
+#define PTZ_QUIRK_PRESET_95_MENU (1u << 0)
+// Recalling a preset that was never set gets an ACK and never a Completion. PTZOptics again.
+#define PTZ_QUIRK_STRICT_RECALL (1u << 1)
+// CAM_PictureEffectModeInq answers 02 for off, where CAM_PictureEffect takes 00.
+#define PTZ_QUIRK_FX_OFF_REPLY (1u << 2)
+
+typedef enum ptz_profile_distribution {
+    PTZ_PROFILE_FIXED,          // Always `a`.
+    PTZ_PROFILE_UNIFORM,        // Anywhere from `a` to `b`.
+    PTZ_PROFILE_NORMAL,         // Mean `a`, standard deviation `b`, never below 0.
+    PTZ_PROFILE_LOGNORMAL,      // Median `a`, shape `b`: mostly close to `a`, with the occasional long one.
+} ptz_profile_distribution;
+
+typedef struct ptz_profile_delay {
+    ptz_profile_distribution distribution;
+    float a;                    // Milliseconds, or see ptz_profile_distribution.
+    float b;
+} ptz_profile_delay;
+
+typedef struct ptz_profile_override {
+    int messageType;            // JR_VISCA_MESSAGE_*
+    int hasAck;
+    int hasCompletion;
+    ptz_profile_delay ack;
+    ptz_profile_delay completion;
+} ptz_profile_override;
+
+typedef struct ptz_profile {
+    char name[64];
+    uint32_t quirks;            // PTZ_QUIRK_*
+    uint32_t stepMs;
+    uint64_t seed;
+    float panRange;
+    float tiltRange;
+    float panSpeeds[PTZ_PROFILE_PAN_SPEEDS + 1];    // By VISCA speed; [0] isn't used.
+    float tiltSpeeds[PTZ_PROFILE_TILT_SPEEDS + 1];
+    ptz_profile_delay ack;
+    ptz_profile_delay completion;
+    int overrideCount;
+    ptz_profile_override overrides[PTZ_PROFILE_OVERRIDES];
+} ptz_profile;
+
+/**
+ * Built in: "sim" is how the simulator has always behaved: the PTZOptics menu and picture effect quirks,
+ * no added latency, and pan and tilt moving `speed` units a 100ms step. "ptzoptics" and "sony" are modelled
+ * on real cameras.
+ * Returns 0, or -1 for any other name.
+ */
+int ptz_profile_builtin(ptz_profile *profile, const char *name);
+
+/**
+ * Reads a profile file, in the format above. Anything it doesn't set comes from "sim", or from its base.
+ * Returns 0, or -1 after saying what was wrong with it on stderr.
+ */
+int ptz_profile_load(ptz_profile *profile, const char *path);
+
+/**
+ * A built-in profile by name, or else a profile file at `nameOrPath`. NULL or "" is "sim". Returns 0 or -1.
+ */
+int ptz_profile_find(ptz_profile *profile, const char *nameOrPath);
+
+/**
+ * Where a camera's random delays start from: its seed, or the clock if it hasn't one.
+ */
+uint64_t ptz_profile_rng(const ptz_profile *profile);
+
+/**
+ * A sample of the ACK or completion delay for `messageType`, in nanoseconds. `rng` is the camera's, from
+ * ptz_profile_rng, and moves on; keep one per camera so each is reproducible on its own.
+ */
+uint64_t ptz_profile_ack_ns(const ptz_profile *profile, int messageType, uint64_t *rng);
+uint64_t ptz_profile_completion_ns(const ptz_profile *profile, int messageType, uint64_t *rng);
+
+/**
+ * How far pan or tilt moves at VISCA `speed` in one step of `stepNs`, in position units; at least 1.
+ * Speeds out of range are clamped to it.
+ */
+int32_t ptz_profile_pan_step(const ptz_profile *profile, int speed, uint64_t stepNs);
+int32_t ptz_profile_tilt_step(const ptz_profile *profile, int speed, uint64_t stepNs);
+
+#endif /* ptz_profile_h */
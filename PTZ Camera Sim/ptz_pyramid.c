@@ -0,0 +1,329 @@
+//
+//  ptz_pyramid.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_pyramid.h"
+#include "ptz_simd.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every level starts on its own page, so the mapping hands out page-aligned images.
+#define PTZ_PYRAMID_ALIGN 4096
+#define PTZ_PYRAMID_MAGIC "PTZMIP01"
+// Files are in native byte order; this catches one copied from a machine with the other one.
+#define PTZ_PYRAMID_BYTE_ORDER 0x01020304u
+
+typedef struct ptz_pyramid_header {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t levelCount;
+    uint64_t key;
+    uint64_t size;          // Of the whole file, header included.
+    struct {
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+        uint32_t reserved;
+        uint64_t offset;
+    } levels[PTZ_PYRAMID_MAX_LEVELS];
+} ptz_pyramid_header;
+
+_Static_assert(sizeof(ptz_pyramid_header) <= PTZ_PYRAMID_ALIGN, "pyramid header must fit in its page");
+
+static size_t ptz_align_up(size_t size) {
+    return (size + PTZ_PYRAMID_ALIGN - 1) & ~(size_t)(PTZ_PYRAMID_ALIGN - 1);
+}
+
+// Plus one row, the same overread padding ptz_image_alloc gives.
+static size_t ptz_level_bytes(int stride, int height) {
+    return (size_t)stride * (height + 1);
+}
+
+// An odd last column averages with itself.
+void ptz_pyramid_downsample_row(const uint8_t *top, const uint8_t *bottom, uint8_t *out, int srcWidth, int dstWidth) {
+    int x = 0;
+    // Four source pixels to two output pixels.
+    for (; 2 * x + 4 <= srcWidth; x += 2) {
+        ptz_u8x16 a = ptz_load_u8x16(top + x * 8);
+        ptz_u8x16 b = ptz_load_u8x16(bottom + x * 8);
+        ptz_u16x8 lo = PTZ_CONVERT(PTZ_SHUFFLE(a, a, 0, 1, 2, 3, 4, 5, 6, 7), ptz_u16x8)
+                     + PTZ_CONVERT(PTZ_SHUFFLE(b, b, 0, 1, 2, 3, 4, 5, 6, 7), ptz_u16x8);
+        ptz_u16x8 hi = PTZ_CONVERT(PTZ_SHUFFLE(a, a, 8, 9, 10, 11, 12, 13, 14, 15), ptz_u16x8)
+                     + PTZ_CONVERT(PTZ_SHUFFLE(b, b, 8, 9, 10, 11, 12, 13, 14, 15), ptz_u16x8);
+        ptz_u16x8 sum = PTZ_SHUFFLE(lo, hi, 0, 1, 2, 3, 8, 9, 10, 11) + PTZ_SHUFFLE(lo, hi, 4, 5, 6, 7, 12, 13, 14, 15);
+        ptz_store_u8x8(out + x * 4, PTZ_CONVERT((sum + 2) >> 2, ptz_u8x8));
+    }
+    for (; x < dstWidth; x++) {
+        int left = 2 * x * 4;
+        int right = (2 * x + 1 < srcWidth) ? left + 4 : left;
+        for (int c = 0; c < 4; c++) {
+            out[x * 4 + c] = (uint8_t)((top[left + c] + top[right + c] + bottom[left + c] + bottom[right + c] + 2) >> 2);
+        }
+    }
+}
+
+static void ptz_downsample(const ptz_image *src, ptz_image *dst) {
+    for (int y = 0; y < dst->height; y++) {
+        const uint8_t *top = ptz_image_row(src, 2 * y);
+        const uint8_t *bottom = (2 * y + 1 < src->height) ? top + src->stride : top;
+        ptz_pyramid_downsample_row(top, bottom, ptz_image_row(dst, y), src->width, dst->width);
+    }
+}
+
+int ptz_pyramid_level_count(int width, int height) {
+    int count = 0;
+    do {
+        count++;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    } while (count < PTZ_PYRAMID_MAX_LEVELS && width >= PTZ_PYRAMID_MIN_SIZE && height >= PTZ_PYRAMID_MIN_SIZE);
+    return count;
+}
+
+int ptz_pyramid_build(ptz_pyramid *pyramid, const ptz_image *base) {
+    memset(pyramid, 0, sizeof(*pyramid));
+    if (base->width < 1 || base->height < 1) {
+        return -1;
+    }
+    ptz_pyramid_header header = { 0 };
+    memcpy(header.magic, PTZ_PYRAMID_MAGIC, sizeof(header.magic));
+    header.byteOrder = PTZ_PYRAMID_BYTE_ORDER;
+    size_t offset = PTZ_PYRAMID_ALIGN;
+    int width = base->width;
+    int height = base->height;
+    int count = ptz_pyramid_level_count(width, height);
+    for (int i = 0; i < count; i++) {
+        int stride = (width * 4 + 15) & ~15;
+        header.levels[i].width = (uint32_t)width;
+        header.levels[i].height = (uint32_t)height;
+        header.levels[i].stride = (uint32_t)stride;
+        header.levels[i].offset = offset;
+        offset += ptz_align_up(ptz_level_bytes(stride, height));
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    header.levelCount = (uint32_t)count;
+    header.size = offset;
+
+    void *block = NULL;
+    if (posix_memalign(&block, PTZ_PYRAMID_ALIGN, offset) != 0) {
+        return -1;
+    }
+    // Zeroed so the padding we write to the cache file is deterministic.
+    memset(block, 0, offset);
+    memcpy(block, &header, sizeof(header));
+    pyramid->block = block;
+    pyramid->blockSize = offset;
+    pyramid->levelCount = count;
+    for (int i = 0; i < count; i++) {
+        ptz_image *level = &pyramid->levels[i];
+        level->width = (int)header.levels[i].width;
+        level->height = (int)header.levels[i].height;
+        level->stride = (int)header.levels[i].stride;
+        level->pixels = (uint8_t *)block + header.levels[i].offset;
+    }
+
+    for (int y = 0; y < base->height; y++) {
+        memcpy(ptz_image_row(&pyramid->levels[0], y), ptz_image_row(base, y), (size_t)base->width * 4);
+    }
+    for (int i = 1; i < count; i++) {
+        ptz_downsample(&pyramid->levels[i - 1], &pyramid->levels[i]);
+    }
+    return 0;
+}
+
+static int ptz_pyramid_header_is_valid(const ptz_pyramid_header *header, uint64_t key, size_t fileSize) {
+    if (   memcmp(header->magic, PTZ_PYRAMID_MAGIC, sizeof(header->magic)) != 0
+        || header->byteOrder != PTZ_PYRAMID_BYTE_ORDER
+        || header->key != key
+        || header->size != fileSize
+        || header->levelCount < 1 || header->levelCount > PTZ_PYRAMID_MAX_LEVELS) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < header->levelCount; i++) {
+        uint64_t width = header->levels[i].width;
+        uint64_t height = header->levels[i].height;
+        uint64_t stride = header->levels[i].stride;
+        uint64_t offset = header->levels[i].offset;
+        if (   width < 1 || height < 1 || width > INT32_MAX / 4
+            || stride < width * 4 || (stride & 15) != 0 || (offset % PTZ_PYRAMID_ALIGN) != 0
+            || offset < PTZ_PYRAMID_ALIGN || offset > fileSize || stride * (height + 1) > fileSize - offset) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int ptz_pyramid_map(ptz_pyramid *pyramid, const char *path, uint64_t key) {
+    memset(pyramid, 0, sizeof(*pyramid));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        // No cache yet is the normal first run; anything else is worth a note.
+        if (errno != ENOENT) {
+            perror("open pyramid cache");
+        }
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < PTZ_PYRAMID_ALIGN) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    void *block = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (block == MAP_FAILED) {
+        perror("mmap pyramid cache");
+        return -1;
+    }
+    const ptz_pyramid_header *header = block;
+    if (!ptz_pyramid_header_is_valid(header, key, size)) {
+        munmap(block, size);
+        return -1;
+    }
+    pyramid->block = block;
+    pyramid->blockSize = size;
+    pyramid->mapped = 1;
+    pyramid->levelCount = (int)header->levelCount;
+    for (int i = 0; i < pyramid->levelCount; i++) {
+        ptz_image *level = &pyramid->levels[i];
+        level->width = (int)header->levels[i].width;
+        level->height = (int)header->levels[i].height;
+        level->stride = (int)header->levels[i].stride;
+        level->pixels = (uint8_t *)block + header->levels[i].offset;
+    }
+    return 0;
+}
+
+static int ptz_write_all(int fd, const void *data, size_t size) {
+    const uint8_t *p = data;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
+
+int ptz_pyramid_write(const ptz_pyramid *pyramid, const char *path, uint64_t key) {
+    if (pyramid->block == NULL) {
+        return -1;
+    }
+    ptz_pyramid_header header;
+    memcpy(&header, pyramid->block, sizeof(header));
+    header.key = key;
+
+    char tempPath[1024];
+    if (snprintf(tempPath, sizeof(tempPath), "%s.%d.tmp", path, (int)getpid()) >= (int)sizeof(tempPath)) {
+        fprintf(stderr, "Pyramid cache path too long: %s\n", path);
+        return -1;
+    }
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("open pyramid cache");
+        return -1;
+    }
+    const uint8_t *block = pyramid->block;
+    uint8_t page[PTZ_PYRAMID_ALIGN] = { 0 };
+    memcpy(page, &header, sizeof(header));
+    if (   ptz_write_all(fd, page, sizeof(page)) < 0
+        || ptz_write_all(fd, block + PTZ_PYRAMID_ALIGN, pyramid->blockSize - PTZ_PYRAMID_ALIGN) < 0) {
+        perror("write pyramid cache");
+        close(fd);
+        unlink(tempPath);
+        return -1;
+    }
+    if (close(fd) < 0 || rename(tempPath, path) < 0) {
+        perror("save pyramid cache");
+        unlink(tempPath);
+        return -1;
+    }
+    return 0;
+}
+
+void ptz_pyramid_free(ptz_pyramid *pyramid) {
+    if (pyramid->mapped) {
+        munmap(pyramid->block, pyramid->blockSize);
+    } else {
+        free(pyramid->block);
+    }
+    memset(pyramid, 0, sizeof(*pyramid));
+}
+
+// FNV-1a, eight bytes at a time, with an extra shift so high bits of each word reach the low bits of the result.
+uint64_t ptz_pyramid_hash(const void *data, size_t size, uint64_t seed) {
+    const uint64_t prime = 0x100000001b3ULL;
+    const uint8_t *p = data;
+    uint64_t hash = (seed ^ 0xcbf29ce484222325ULL) * prime;
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; size > 0; size--, p++) {
+        hash = (hash ^ *p) * prime;
+    }
+    return hash ^ (hash >> 32);
+}
+
+int ptz_pyramid_level_for_width(const ptz_pyramid *pyramid, int width) {
+    int level = 0;
+    while (level + 1 < pyramid->levelCount && pyramid->levels[level + 1].width >= width) {
+        level++;
+    }
+    return level;
+}
+
+int ptz_pyramid_level_for_scale(const ptz_pyramid *pyramid, float scale) {
+    int level = 0;
+    while (   level + 1 < pyramid->levelCount
+           && (float)pyramid->levels[0].width / pyramid->levels[level + 1].width <= scale) {
+        level++;
+    }
+    return level;
+}
+
+int ptz_pyramid_viewport_for_state(const ptz_pyramid *pyramid, const ptz_camera_state *state, int width, int height,
+                                   ptz_viewport *viewport) {
+    if (pyramid->levelCount < 1 || width < 1 || height < 1) {
+        return -1;
+    }
+    const ptz_image *base = &pyramid->levels[0];
+    ptz_viewport_for_state(state, base->width, base->height, width, height, viewport);
+    int level = ptz_pyramid_level_for_scale(pyramid, viewport->width / width);
+    const ptz_image *src = &pyramid->levels[level];
+    // Levels round odd sizes up, so scale each axis by its own ratio rather than a power of two.
+    float scaleX = (float)src->width / base->width;
+    float scaleY = (float)src->height / base->height;
+    viewport->x *= scaleX;
+    viewport->width *= scaleX;
+    viewport->y *= scaleY;
+    viewport->height *= scaleY;
+    return level;
+}
+
+int ptz_render_pyramid_frame(ptz_renderer *renderer, const ptz_pyramid *pyramid, const ptz_camera_state *state, ptz_image *dst) {
+    ptz_viewport viewport;
+    int level = ptz_pyramid_viewport_for_state(pyramid, state, dst->width, dst->height, &viewport);
+    if (level < 0) {
+        return -1;
+    }
+    return ptz_render_viewport(renderer, &pyramid->levels[level], &viewport, dst);
+}
@@ -0,0 +1,91 @@
+//
+//  ptz_pyramid.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Mipmap pyramid of the source image, so every zoom level renders from a level near its own resolution.
+//  The whole pyramid is one block with the same layout as its cache file, so a warm start is a single mmap.
+//
+
+#ifndef ptz_pyramid_h
+#define ptz_pyramid_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ptz_render.h"
+
+// 3264x2448 only needs 6 levels to get down to the minimum; the rest is headroom for bigger sources.
+#define PTZ_PYRAMID_MAX_LEVELS 12
+// Stop halving once either side would be smaller than this.
+#define PTZ_PYRAMID_MIN_SIZE 64
+
+typedef struct ptz_pyramid {
+    int levelCount;
+    ptz_image levels[PTZ_PYRAMID_MAX_LEVELS];   // 0 is full resolution. Pixels point into `block`; don't free them.
+    void *block;
+    size_t blockSize;
+    int mapped;                                 // `block` is a read-only file mapping rather than our own memory.
+} ptz_pyramid;
+
+/**
+ * How many levels ptz_pyramid_build makes from a `width` x `height` base. Each is half the one before,
+ * rounded up.
+ */
+int ptz_pyramid_level_count(int width, int height);
+
+/**
+ * One row of the next level down from two rows of this one, as ptz_pyramid_build makes it: each pixel
+ * is the rounded mean of a 2x2 block. Pass the same row twice for an odd last row.
+ */
+void ptz_pyramid_downsample_row(const uint8_t *top, const uint8_t *bottom, uint8_t *out, int srcWidth, int dstWidth);
+
+/**
+ * Builds every level from `base` with a 2x2 box filter, copying `base` into level 0, so `base` can be freed afterward.
+ * Returns 0 on success, -1 on allocation failure or an empty image.
+ */
+int ptz_pyramid_build(ptz_pyramid *pyramid, const ptz_image *base);
+
+/**
+ * Maps the cache file at `path` if it exists and was written for `key`. Returns -1 (leaving `pyramid` empty) otherwise.
+ * The mapping is shared and read-only, so any number of processes can use one copy of the pixels.
+ */
+int ptz_pyramid_map(ptz_pyramid *pyramid, const char *path, uint64_t key);
+
+/**
+ * Writes `pyramid` to `path` for a later ptz_pyramid_map. Writes to a temporary file and renames it into place,
+ * so a reader never sees half a cache. Returns 0 on success, -1 on failure.
+ */
+int ptz_pyramid_write(const ptz_pyramid *pyramid, const char *path, uint64_t key);
+
+void ptz_pyramid_free(ptz_pyramid *pyramid);
+
+/**
+ * Cache key for the encoded source: a 64-bit hash of `size` bytes, chained from `seed`.
+ */
+uint64_t ptz_pyramid_hash(const void *data, size_t size, uint64_t seed);
+
+/**
+ * The smallest level that is still at least `width` pixels wide, or level 0 if none is.
+ */
+int ptz_pyramid_level_for_width(const ptz_pyramid *pyramid, int width);
+
+/**
+ * Level to sample when each output pixel covers `scale` level 0 pixels: the smallest one that is still no more
+ * than 2x down from the output, so the bilinear filter never skips source pixels.
+ */
+int ptz_pyramid_level_for_scale(const ptz_pyramid *pyramid, float scale);
+
+/**
+ * The level ptz_render_pyramid_frame samples for `state` at `width` x `height`, and the viewport in that level's pixels.
+ * Returns the level, or -1 if the pyramid is empty.
+ */
+int ptz_pyramid_viewport_for_state(const ptz_pyramid *pyramid, const ptz_camera_state *state, int width, int height,
+                                   ptz_viewport *viewport);
+
+/**
+ * Like ptz_render_frame, but samples the level that matches the zoom instead of always the full image.
+ */
+int ptz_render_pyramid_frame(ptz_renderer *renderer, const ptz_pyramid *pyramid, const ptz_camera_state *state, ptz_image *dst);
+
+#endif /* ptz_pyramid_h */
@@ -0,0 +1,306 @@
+//
+//  ptz_render.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_render.h"
+#include "ptz_simd.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+int ptz_image_alloc(ptz_image *image, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return -1;
+    }
+    int stride = (width * 4 + 15) & ~15;
+    if (image->pixels != NULL && image->stride * image->height >= stride * height) {
+        image->width = width;
+        image->height = height;
+        image->stride = stride;
+        return 0;
+    }
+    void *pixels = NULL;
+    // Extra row of padding so the SIMD loops can overread the last pixel.
+    if (posix_memalign(&pixels, 64, (size_t)stride * (height + 1)) != 0) {
+        return -1;
+    }
+    free(image->pixels);
+    image->pixels = pixels;
+    image->width = width;
+    image->height = height;
+    image->stride = stride;
+    return 0;
+}
+
+void ptz_image_free(ptz_image *image) {
+    free(image->pixels);
+    memset(image, 0, sizeof(*image));
+}
+
+void ptz_viewport_for_state(const ptz_camera_state *state, int srcWidth, int srcHeight, int dstWidth, int dstHeight, ptz_viewport *viewport) {
+    // Largest rect with the output aspect ratio that fits in the source.
+    float fitWidth = srcWidth;
+    float fitHeight = (float)srcWidth * dstHeight / dstWidth;
+    if (fitHeight > srcHeight) {
+        fitHeight = srcHeight;
+        fitWidth = (float)srcHeight * dstWidth / dstHeight;
+    }
+    float zoomScale = (float)state->zoom / PTZ_ZOOM_MAX;
+    float magnification = PTZ_MIN_MAGNIFICATION + zoomScale * (PTZ_MAX_MAGNIFICATION - PTZ_MIN_MAGNIFICATION);
+    viewport->width = fitWidth / magnification;
+    viewport->height = fitHeight / magnification;
+
+    // Scaled to (0..1), same as PTZCamera panScale/tiltScale.
+    float panScale = (float)(state->pan + PTZ_RANGE_SHIFT) / PTZ_RANGE_MAX;
+    float tiltScale = (float)(state->tilt + PTZ_RANGE_SHIFT) / PTZ_RANGE_MAX;
+    panScale = fminf(fmaxf(panScale, 0), 1);
+    tiltScale = fminf(fmaxf(tiltScale, 0), 1);
+    viewport->x = panScale * (srcWidth - viewport->width);
+    // AppKit's y goes up; ours goes down.
+    viewport->y = (1.0f - tiltScale) * (srcHeight - viewport->height);
+}
+
+void ptz_renderer_init(ptz_renderer *renderer) {
+    memset(renderer, 0, sizeof(*renderer));
+    renderer->rowSource[0] = renderer->rowSource[1] = -1;
+}
+
+void ptz_renderer_destroy(ptz_renderer *renderer) {
+    free(renderer->xIndex);
+    free(renderer->xWeight);
+    free(renderer->rows[0]);
+    free(renderer->rows[1]);
+    free(renderer->span);
+    free(renderer->blurRows);
+    free(renderer->blurSums);
+    ptz_renderer_init(renderer);
+}
+
+static int ptz_renderer_reserve(ptz_renderer *renderer, int width) {
+    if (width <= renderer->capacity) {
+        return 0;
+    }
+    int32_t *xIndex = realloc(renderer->xIndex, sizeof(int32_t) * width);
+    if (xIndex == NULL) {
+        return -1;
+    }
+    renderer->xIndex = xIndex;
+    uint16_t *xWeight = realloc(renderer->xWeight, sizeof(uint16_t) * 8 * width);
+    if (xWeight == NULL) {
+        return -1;
+    }
+    renderer->xWeight = xWeight;
+    for (int i = 0; i < 2; i++) {
+        // +16 so ptz_lerp_bytes never has to care about the tail.
+        uint8_t *row = realloc(renderer->rows[i], (size_t)width * 4 + 16);
+        if (row == NULL) {
+            return -1;
+        }
+        renderer->rows[i] = row;
+    }
+    renderer->capacity = width;
+    return 0;
+}
+
+// Source coordinate of the center of output sample `i`, as 16.16 fixed point.
+static inline int64_t ptz_sample_position(float origin, float scale, int i) {
+    return (int64_t)llroundf(((i + 0.5f) * scale + origin - 0.5f) * 65536.0f);
+}
+
+// Table for output columns `first` through `first + count - 1`.
+static void ptz_build_x_table(ptz_renderer *renderer, int srcWidth, float origin, float scale, int first, int count) {
+    for (int x = 0; x < count; x++) {
+        int64_t pos = ptz_sample_position(origin, scale, first + x);
+        int64_t i = pos >> 16;
+        uint16_t w = (uint16_t)((pos & 0xffff) >> 8);
+        if (i < 0) {
+            i = 0;
+            w = 0;
+        } else if (i >= srcWidth - 1) {
+            i = srcWidth - 1;
+            w = 0;
+        }
+        renderer->xIndex[x] = (int32_t)i * 4;
+        uint16_t *weights = renderer->xWeight + x * 8;
+        for (int c = 0; c < 4; c++) {
+            weights[c] = 256 - w;
+            weights[c + 4] = w;
+        }
+    }
+}
+
+// Horizontal half of the bilinear filter: one source row to one output-width row.
+static void ptz_resample_row(const ptz_renderer *renderer, const uint8_t *src, uint8_t *out, int dstWidth) {
+    const int32_t *xIndex = renderer->xIndex;
+    const uint16_t *xWeight = renderer->xWeight;
+    for (int x = 0; x < dstWidth; x++) {
+        // Left and right neighbors in one 8 byte load. The clamped last column reads one pixel into the padding with weight 0.
+        ptz_u16x8 pair = PTZ_CONVERT(ptz_load_u8x8(src + xIndex[x]), ptz_u16x8);
+        ptz_u16x8 weights;
+        memcpy(&weights, xWeight + x * 8, sizeof(weights));
+        ptz_u16x8 v = pair * weights;
+        ptz_u16x4 sum = (PTZ_SHUFFLE(v, v, 0, 1, 2, 3) + PTZ_SHUFFLE(v, v, 4, 5, 6, 7) + 128) >> 8;
+        ptz_store_pixel16(out + x * 4, sum);
+    }
+}
+
+// Returns the cached resampled copy of source row `y`, reusing whichever slot doesn't hold `keep`.
+static const uint8_t *ptz_cached_row(ptz_renderer *renderer, const ptz_image *src, int y, int keep, int dstWidth) {
+    for (int i = 0; i < 2; i++) {
+        if (renderer->rowSource[i] == y) {
+            return renderer->rows[i];
+        }
+    }
+    int slot = (renderer->rowSource[0] == keep) ? 1 : 0;
+    ptz_resample_row(renderer, ptz_image_row(src, y), renderer->rows[slot], dstWidth);
+    renderer->rowSource[slot] = y;
+    return renderer->rows[slot];
+}
+
+// The given rectangle of `dst`, bit for bit as a full render of `viewport` would have it
+// if the frame were moved `offsetX`, `offsetY` output pixels right and down.
+static int ptz_render_rect(ptz_renderer *renderer, const ptz_image *src, const ptz_viewport *viewport, ptz_image *dst,
+                           int left, int top, int width, int height, int offsetX, int offsetY) {
+    if (src->width < 1 || src->height < 1 || dst->width < 1 || dst->height < 1) {
+        return -1;
+    }
+    if (width < 1 || height < 1) {
+        return 0;
+    }
+    if (ptz_renderer_reserve(renderer, width) < 0) {
+        return -1;
+    }
+    float scaleX = viewport->width / dst->width;
+    float scaleY = viewport->height / dst->height;
+    ptz_build_x_table(renderer, src->width, viewport->x, scaleX, left + offsetX, width);
+    renderer->rowSource[0] = renderer->rowSource[1] = -1;
+
+    if (scaleY >= 1.0f) {
+        // Shrinking: every output row needs a fresh pair of source rows, so there's nothing to cache.
+        // Blend vertically over just the columns we sample, then resample that once.
+        int spanStart = renderer->xIndex[0];
+        int spanBytes = renderer->xIndex[width - 1] + 8 - spanStart;
+        if (spanBytes + 16 > renderer->spanCapacity) {
+            uint8_t *span = realloc(renderer->span, (size_t)spanBytes + 16);
+            if (span == NULL) {
+                return -1;
+            }
+            renderer->span = span;
+            renderer->spanCapacity = spanBytes + 16;
+        }
+        int32_t *xIndex = renderer->xIndex;
+        for (int x = 0; x < width; x++) {
+            xIndex[x] -= spanStart;
+        }
+        for (int y = top; y < top + height; y++) {
+            int64_t pos = ptz_sample_position(viewport->y, scaleY, y + offsetY);
+            int64_t sy = pos >> 16;
+            unsigned w = (unsigned)((pos & 0xffff) >> 8);
+            if (sy < 0) {
+                sy = 0;
+                w = 0;
+            } else if (sy >= src->height - 1) {
+                sy = src->height - 1;
+                w = 0;
+            }
+            const uint8_t *row = ptz_image_row(src, (int)sy) + spanStart;
+            uint8_t *out = ptz_image_row(dst, y) + left * 4;
+            if (w == 0) {
+                ptz_resample_row(renderer, row, out, width);
+            } else {
+                ptz_lerp_bytes(renderer->span, row, row + src->stride, w, spanBytes);
+                ptz_resample_row(renderer, renderer->span, out, width);
+            }
+        }
+        return 0;
+    }
+
+    for (int y = top; y < top + height; y++) {
+        int64_t pos = ptz_sample_position(viewport->y, scaleY, y + offsetY);
+        int64_t sy = pos >> 16;
+        unsigned w = (unsigned)((pos & 0xffff) >> 8);
+        if (sy < 0) {
+            sy = 0;
+            w = 0;
+        } else if (sy >= src->height - 1) {
+            sy = src->height - 1;
+            w = 0;
+        }
+        const uint8_t *upper = ptz_cached_row(renderer, src, (int)sy, (int)sy + 1, width);
+        uint8_t *out = ptz_image_row(dst, y) + left * 4;
+        if (w == 0) {
+            memcpy(out, upper, (size_t)width * 4);
+        } else {
+            const uint8_t *lower = ptz_cached_row(renderer, src, (int)sy + 1, (int)sy, width);
+            ptz_lerp_bytes(out, upper, lower, w, width * 4);
+        }
+    }
+    return 0;
+}
+
+int ptz_render_viewport(ptz_renderer *renderer, const ptz_image *src, const ptz_viewport *viewport, ptz_image *dst) {
+    return ptz_render_rect(renderer, src, viewport, dst, 0, 0, dst->width, dst->height, 0, 0);
+}
+
+int ptz_render_scroll(ptz_renderer *renderer, const ptz_image *src, const ptz_viewport *viewport,
+                      const ptz_image *previous, ptz_scroll_position *position, ptz_image *dst) {
+    int width = dst->width;
+    int height = dst->height;
+    float scaleX = viewport->width / width;
+    float scaleY = viewport->height / height;
+    int shiftX = 0;
+    int shiftY = 0;
+    int scroll = (   previous != NULL && previous->width == width && previous->height == height
+                  && viewport->width == position->anchor.width && viewport->height == position->anchor.height);
+    if (scroll) {
+        // Whole output pixels from the anchor, so copied pixels land exactly where a render would put them.
+        shiftX = (int)lroundf((viewport->x - position->anchor.x) / scaleX) - position->offsetX;
+        shiftY = (int)lroundf((viewport->y - position->anchor.y) / scaleY) - position->offsetY;
+        int64_t exposed = (int64_t)abs(shiftX) * height + (int64_t)abs(shiftY) * width - (int64_t)abs(shiftX) * abs(shiftY);
+        scroll = abs(shiftX) < width && abs(shiftY) < height
+                 && exposed <= (int64_t)(PTZ_RENDER_SCROLL_MAX_EXPOSED * width * height);
+    }
+    if (!scroll) {
+        position->anchor = *viewport;
+        position->offsetX = 0;
+        position->offsetY = 0;
+        return ptz_render_viewport(renderer, src, viewport, dst) < 0 ? -1 : 0;
+    }
+
+    // Output pixel (x, y) is previous pixel (x + shiftX, y + shiftY). Rows go in the order that's safe when they're the same image.
+    int exposedX = abs(shiftX);
+    int exposedY = abs(shiftY);
+    int copyLeft = shiftX < 0 ? exposedX : 0;
+    int copyWidth = width - exposedX;
+    int copyTop = shiftY < 0 ? exposedY : 0;
+    int copyHeight = height - exposedY;
+    for (int i = 0; i < copyHeight; i++) {
+        int y = (shiftY > 0) ? copyTop + i : copyTop + copyHeight - 1 - i;
+        memmove(ptz_image_row(dst, y) + copyLeft * 4,
+                ptz_image_row(previous, y + shiftY) + (copyLeft + shiftX) * 4,
+                (size_t)copyWidth * 4);
+    }
+
+    // Newly exposed rows across the full width, then the exposed columns beside the copy.
+    position->offsetX += shiftX;
+    position->offsetY += shiftY;
+    int stripTop = shiftY > 0 ? height - exposedY : 0;
+    int columnLeft = shiftX > 0 ? width - exposedX : 0;
+    if (   ptz_render_rect(renderer, src, &position->anchor, dst, 0, stripTop, width, exposedY,
+                           position->offsetX, position->offsetY) < 0
+        || ptz_render_rect(renderer, src, &position->anchor, dst, columnLeft, copyTop, exposedX, copyHeight,
+                           position->offsetX, position->offsetY) < 0) {
+        return -1;
+    }
+    return 1;
+}
+
+int ptz_render_frame(ptz_renderer *renderer, const ptz_image *src, const ptz_camera_state *state, ptz_image *dst) {
+    ptz_viewport viewport;
+    ptz_viewport_for_state(state, src->width, src->height, dst->width, dst->height, &viewport);
+    return ptz_render_viewport(renderer, src, &viewport, dst);
+}
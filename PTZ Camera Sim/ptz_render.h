@@ -0,0 +1,117 @@
+//
+//  ptz_render.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Portable camera view renderer. No AppKit: the app and headless tools hand it a decoded
+//  RGBA buffer and a ptz_camera_state and get the camera's output frame back.
+//
+
+#ifndef ptz_render_h
+#define ptz_render_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ptz_state.h"
+
+// Same range as the app's scroll view. We don't want to zoom all the way out on the image itself, because then there's no room to pan/tilt.
+#define PTZ_MIN_MAGNIFICATION 1.1f
+#define PTZ_MAX_MAGNIFICATION 25.0f
+
+/**
+ * Interleaved RGBA, 8 bits per channel, rows top to bottom.
+ * `stride` is in bytes and is always a multiple of 16 for images from ptz_image_alloc.
+ * Source images must have 4 readable bytes past the end of every row; ptz_image_alloc pads for that.
+ */
+typedef struct ptz_image {
+    int width;
+    int height;
+    int stride;
+    uint8_t *pixels;
+} ptz_image;
+
+/**
+ * Returns 0 on success, -1 if the allocation failed. Reuses the existing buffer if it is already big enough.
+ */
+int ptz_image_alloc(ptz_image *image, int width, int height);
+void ptz_image_free(ptz_image *image);
+
+static inline uint8_t *ptz_image_row(const ptz_image *image, int y) {
+    return image->pixels + (intptr_t)y * image->stride;
+}
+
+/**
+ * The part of the source image the camera is looking at, in source pixels, origin top left.
+ */
+typedef struct ptz_viewport {
+    float x;
+    float y;
+    float width;
+    float height;
+} ptz_viewport;
+
+/**
+ * Maps pan/tilt/zoom to the source rectangle for a `dstWidth` x `dstHeight` frame.
+ * Zoom 0 is PTZ_MIN_MAGNIFICATION on the largest rect of the output aspect that fits in the source;
+ * pan and tilt slide that rect across the rest of the image, with tilt up toward the top.
+ */
+void ptz_viewport_for_state(const ptz_camera_state *state, int srcWidth, int srcHeight, int dstWidth, int dstHeight, ptz_viewport *viewport);
+
+/**
+ * Scratch space for rendering. One per thread; it grows to the largest frame it has rendered and is then reused,
+ * so steady-state rendering doesn't allocate.
+ */
+typedef struct ptz_renderer {
+    int capacity;
+    int32_t *xIndex;        // Byte offset of the left source pixel for each output column.
+    uint16_t *xWeight;      // Left weights x4 then right weights x4 per output column, 0-256.
+    uint8_t *rows[2];       // Horizontally resampled source rows.
+    int rowSource[2];       // Which source row each of `rows` holds, or -1.
+    uint8_t *span;          // Vertically blended source span, when shrinking.
+    int spanCapacity;
+    uint8_t *blurRows;      // Ring of horizontally box-filtered rows for ptz_render_effects.
+    uint16_t *blurSums;     // Running vertical sums for one strip, then one row of horizontal sums.
+    size_t blurCapacity;
+} ptz_renderer;
+
+void ptz_renderer_init(ptz_renderer *renderer);
+void ptz_renderer_destroy(ptz_renderer *renderer);
+
+/**
+ * Bilinear crop-and-scale of `viewport` in `src` to fill all of `dst`.
+ * Returns 0 on success, -1 on allocation failure or bad arguments.
+ */
+int ptz_render_viewport(ptz_renderer *renderer, const ptz_image *src, const ptz_viewport *viewport, ptz_image *dst);
+
+// ptz_render_scroll does a full render instead once more than this fraction of the frame would need rendering.
+#define PTZ_RENDER_SCROLL_MAX_EXPOSED 0.5f
+
+/**
+ * Where a frame from ptz_render_scroll came from: the viewport of the last full render,
+ * and how many whole output pixels it has been moved right and down since.
+ */
+typedef struct ptz_scroll_position {
+    ptz_viewport anchor;
+    int offsetX;
+    int offsetY;
+} ptz_scroll_position;
+
+/**
+ * ptz_render_viewport for a camera that has only panned or tilted since `previous` was rendered.
+ * `previous` is the last frame from this function for the same `src`, and `position` is where it was;
+ * it may be `dst` itself. The overlap is copied and only the newly exposed edges are rendered.
+ * To line the copy up, moves are rounded to whole output pixels from the anchor, so the frame can be up to
+ * half a pixel off `viewport`, but never more. Renders the whole frame if `previous` is NULL, the zoom changed,
+ * or the move is too big to be worth it. Updates `position` to describe `dst`.
+ * Returns 1 if it scrolled, 0 if it rendered the whole frame, -1 on failure.
+ */
+int ptz_render_scroll(ptz_renderer *renderer, const ptz_image *src, const ptz_viewport *viewport,
+                      const ptz_image *previous, ptz_scroll_position *position, ptz_image *dst);
+
+/**
+ * Convenience: ptz_viewport_for_state followed by ptz_render_viewport.
+ */
+int ptz_render_frame(ptz_renderer *renderer, const ptz_image *src, const ptz_camera_state *state, ptz_image *dst);
+
+#endif /* ptz_render_h */
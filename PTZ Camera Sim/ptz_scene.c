@@ -0,0 +1,107 @@
+//
+//  ptz_scene.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_scene.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static ptz_scene_registry ptz_scene_shared = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .loaded = PTHREAD_COND_INITIALIZER,
+};
+
+ptz_scene_registry *ptz_scene_registry_shared(void) {
+    return &ptz_scene_shared;
+}
+
+void ptz_scene_registry_init(ptz_scene_registry *registry) {
+    memset(registry, 0, sizeof(*registry));
+    pthread_mutex_init(&registry->lock, NULL);
+    pthread_cond_init(&registry->loaded, NULL);
+}
+
+void ptz_scene_registry_destroy(ptz_scene_registry *registry) {
+    pthread_cond_destroy(&registry->loaded);
+    pthread_mutex_destroy(&registry->lock);
+    memset(registry, 0, sizeof(*registry));
+}
+
+// Under the registry's lock.
+static void ptz_scene_release_locked(ptz_scene *scene) {
+    if (--scene->refs > 0) {
+        return;
+    }
+    ptz_scene_registry *registry = scene->registry;
+    for (ptz_scene **link = &registry->scenes; *link != NULL; link = &(*link)->next) {
+        if (*link == scene) {
+            *link = scene->next;
+            registry->count--;
+            break;
+        }
+    }
+    ptz_pyramid_free(&scene->pyramid);
+    free(scene);
+}
+
+ptz_scene *ptz_scene_acquire(ptz_scene_registry *registry, uint64_t key, ptz_scene_loader loader, void *context) {
+    pthread_mutex_lock(&registry->lock);
+    ptz_scene *scene = registry->scenes;
+    // A failed scene stays listed until its waiters let go; skip it so the next acquire tries again.
+    while (scene != NULL && (scene->key != key || scene->failed)) {
+        scene = scene->next;
+    }
+    if (scene != NULL) {
+        scene->refs++;
+        while (scene->loading) {
+            pthread_cond_wait(&registry->loaded, &registry->lock);
+        }
+    } else {
+        scene = calloc(1, sizeof(*scene));
+        if (scene == NULL) {
+            pthread_mutex_unlock(&registry->lock);
+            return NULL;
+        }
+        scene->key = key;
+        scene->refs = 1;
+        scene->loading = 1;
+        scene->registry = registry;
+        scene->next = registry->scenes;
+        registry->scenes = scene;
+        registry->count++;
+        pthread_mutex_unlock(&registry->lock);
+
+        int result = loader(&scene->pyramid, key, context);
+
+        pthread_mutex_lock(&registry->lock);
+        scene->loading = 0;
+        scene->failed = result < 0 || scene->pyramid.levelCount == 0;
+        pthread_cond_broadcast(&registry->loaded);
+    }
+    if (scene->failed) {
+        ptz_scene_release_locked(scene);
+        scene = NULL;
+    }
+    pthread_mutex_unlock(&registry->lock);
+    return scene;
+}
+
+void ptz_scene_retain(ptz_scene *scene) {
+    pthread_mutex_lock(&scene->registry->lock);
+    scene->refs++;
+    pthread_mutex_unlock(&scene->registry->lock);
+}
+
+void ptz_scene_release(ptz_scene *scene) {
+    if (scene == NULL) {
+        return;
+    }
+    ptz_scene_registry *registry = scene->registry;
+    pthread_mutex_lock(&registry->lock);
+    ptz_scene_release_locked(scene);
+    pthread_mutex_unlock(&registry->lock);
+}
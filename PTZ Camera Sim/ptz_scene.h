@@ -0,0 +1,74 @@
+//
+//  ptz_scene.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Scene assets shared by every camera looking at the same venue. A scene's pyramid is loaded once,
+//  reference counted, and read-only from then on, so any number of renderers can sample it at once;
+//  each camera only owns its viewport state and output buffers.
+//
+//  That sharing is within one process. The app runs one camera per process, so there the registry only
+//  saves a reload; separate app instances share pixels because the pyramid they load is the cache file
+//  ptz_pyramid_map maps shared and read-only.
+//
+
+#ifndef ptz_scene_h
+#define ptz_scene_h
+
+#include <stdint.h>
+#include <pthread.h>
+#include "ptz_pyramid.h"
+
+typedef struct ptz_scene_registry ptz_scene_registry;
+
+typedef struct ptz_scene {
+    uint64_t key;                   // Identifies the source, e.g. ptz_pyramid_hash of the encoded image.
+    ptz_pyramid pyramid;            // Read-only once ptz_scene_acquire returns it.
+    // Owned by the registry, under its lock.
+    int refs;
+    int loading;
+    int failed;
+    ptz_scene_registry *registry;
+    struct ptz_scene *next;
+} ptz_scene;
+
+struct ptz_scene_registry {
+    pthread_mutex_t lock;
+    pthread_cond_t loaded;          // Broadcast when a scene finishes loading, successfully or not.
+    ptz_scene *scenes;
+    int count;
+};
+
+/**
+ * Fills in `pyramid` for a scene nobody has loaded yet. Called without the registry locked, so other scenes
+ * can be acquired meanwhile. Returns 0 or -1.
+ */
+typedef int (*ptz_scene_loader)(ptz_pyramid *pyramid, uint64_t key, void *context);
+
+/**
+ * The registry for this process. Use it unless you need scenes that are never shared.
+ */
+ptz_scene_registry *ptz_scene_registry_shared(void);
+
+void ptz_scene_registry_init(ptz_scene_registry *registry);
+
+/**
+ * Only once every scene has been released.
+ */
+void ptz_scene_registry_destroy(ptz_scene_registry *registry);
+
+/**
+ * The scene for `key`, loading it with `loader` if nobody has it. If another thread is already loading it,
+ * waits for that instead of loading a second copy. Returns a retained scene, or NULL if it couldn't be loaded.
+ */
+ptz_scene *ptz_scene_acquire(ptz_scene_registry *registry, uint64_t key, ptz_scene_loader loader, void *context);
+
+void ptz_scene_retain(ptz_scene *scene);
+
+/**
+ * The last release frees the pyramid. NULL is ignored.
+ */
+void ptz_scene_release(ptz_scene *scene);
+
+#endif /* ptz_scene_h */
@@ -0,0 +1,174 @@
+//
+//  ptz_server.cpp
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace ptz {
+
+server::server(const ptz_config &config) : config_(config) {
+}
+
+server::~server() {
+    // Sessions cancel what they have running on the way out, so they go before the engine.
+    for (auto &c : connections_) {
+        c->session.reset();
+        jr_socket_closeSocket(c->socket);
+    }
+    connections_.clear();
+    engine_.reset();
+    if (recording_) {
+        ptz_telemetry_recorder_close(&telemetry_);
+    }
+    if (fleetReady_) {
+        ptz_fleet_free(&fleet_);
+    }
+    for (listener &l : listeners_) {
+        jr_socket_closeServerSocket(l.socket);
+    }
+}
+
+int server::start() {
+    // Cameras that share a profile share its copy; sessions point into profiles_, so it's filled before any exist.
+    std::unordered_map<std::string, int> loaded;
+    cameraProfiles_.resize(config_.cameras);
+    for (int camera = 0; camera < config_.cameras; camera++) {
+        std::string name = ptz_config_profile(&config_, camera);
+        auto found = loaded.find(name);
+        if (found == loaded.end()) {
+            ptz_profile profile;
+            if (ptz_profile_find(&profile, name.c_str()) < 0) {
+                fprintf(stderr, "camera %d: no profile %s\n", camera, name.c_str());
+                return -1;
+            }
+            found = loaded.emplace(name, (int)profiles_.size()).first;
+            profiles_.push_back(profile);
+        }
+        cameraProfiles_[camera] = found->second;
+    }
+
+    if (ptz_fleet_init(&fleet_, config_.cameras) < 0) {
+        fprintf(stderr, "can't make a fleet of %d cameras\n", config_.cameras);
+        return -1;
+    }
+    fleetReady_ = true;
+    engine_ = std::make_unique<engine>(&fleet_, std::chrono::milliseconds(config_.tickMs));
+    if (config_.telemetry[0]) {
+        if (ptz_telemetry_recorder_open(&telemetry_, config_.telemetry, (uint64_t)config_.telemetryMB << 20) < 0) {
+            return -1;
+        }
+        recording_ = true;
+        engine_->set_telemetry(&telemetry_);
+    }
+
+    listeners_.reserve(config_.cameras);
+    for (int camera = 0; camera < config_.cameras; camera++) {
+        listener l;
+        if (jr_socket_setupServerSocket(config_.port ? config_.port + camera : 0, &l.socket) == -1) {
+            jr_socket_closeServerSocket(l.socket);
+            fprintf(stderr, "camera %d: can't listen on port %d\n", camera, config_.port ? config_.port + camera : 0);
+            return -1;
+        }
+        sockaddr_in address = {};
+        socklen_t length = sizeof(address);
+        getsockname(l.socket._serverSocket, (sockaddr *)&address, &length);
+        l.port = ntohs(address.sin_port);
+        listeners_.push_back(l);
+    }
+    return 0;
+}
+
+void server::accept_connection(int camera) {
+    auto c = std::make_unique<connection>();
+    if (jr_socket_accept(listeners_[camera].socket, &c->socket) == -1) {
+        return;
+    }
+    c->session = std::make_unique<ptz::session>(*engine_, default_handlers(), c->socket, camera);
+    c->session->set_profile(profiles_[cameraProfiles_[camera]]);
+    if (config_.notifyRate) {
+        c->session->subscribe(config_.notifyRate);
+    }
+    connections_.push_back(std::move(c));
+}
+
+bool server::receive(connection &c) {
+    uint8_t buffer[1024];
+    int count = jr_socket_receive(c.socket, (char *)buffer, sizeof(buffer));
+    if (count <= 0) {
+        return false;
+    }
+    return c.session->receive(std::span<const uint8_t>(buffer, count)) == 0;
+}
+
+int server::poll_once(clock::duration timeout) {
+    fds_.clear();
+    for (const listener &l : listeners_) {
+        fds_.push_back({l.socket._serverSocket, POLLIN, 0});
+    }
+    for (const auto &c : connections_) {
+        fds_.push_back({c->socket._socket, POLLIN, 0});
+    }
+
+    clock::time_point now = clock::now();
+    clock::duration wait = std::min(timeout, engine_->next_wakeup() - now);
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(std::max(wait, clock::duration::zero())).count();
+    int ready = poll(fds_.data(), (nfds_t)fds_.size(), (int)std::min<decltype(ms)>(ms, INT_MAX));
+    if (ready == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        perror("poll");
+        return -1;
+    }
+
+    if (ready > 0) {
+        // Connections first: fds_ has them in the order they were before any of these are accepted.
+        std::size_t first = listeners_.size();
+        for (std::size_t i = 0; i < connections_.size() && first + i < fds_.size(); i++) {
+            if (fds_[first + i].revents && !receive(*connections_[i])) {
+                connections_[i]->session.reset();
+                jr_socket_closeSocket(connections_[i]->socket);
+                connections_[i].reset();
+            }
+        }
+        connections_.erase(std::remove(connections_.begin(), connections_.end(), nullptr), connections_.end());
+        for (std::size_t camera = 0; camera < first; camera++) {
+            if (fds_[camera].revents & POLLIN) {
+                accept_connection((int)camera);
+            }
+        }
+    }
+    engine_->run(clock::now());
+    return 0;
+}
+
+void server::flush_telemetry() {
+    if (recording_) {
+        ptz_telemetry_recorder_flush(&telemetry_);
+    }
+}
+
+int server::run(const volatile std::sig_atomic_t &stop) {
+    while (!stop) {
+        // Signals interrupt the poll, but one could land just before it; this is how late it can notice.
+        if (poll_once(std::chrono::seconds(1)) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+} // namespace ptz
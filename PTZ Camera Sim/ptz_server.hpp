@@ -0,0 +1,89 @@
+//
+//  ptz_server.hpp
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The whole simulator without the app: a ptz_fleet of cameras, the engine that runs VISCA on them, and a
+//  listening port per camera, all on one thread in one poll loop. Any number of controllers can connect to
+//  a camera's port; each gets its own session. It can record every move to a telemetry file as well.
+//  ptzd is this and a config file.
+//
+
+#ifndef PTZ_SERVER_HPP
+#define PTZ_SERVER_HPP
+
+#include <csignal>
+#include <memory>
+#include <vector>
+
+#include <poll.h>
+
+#include "ptz_engine.hpp"
+
+extern "C" {
+#include "ptz_config.h"
+}
+
+namespace ptz {
+
+class server {
+public:
+    explicit server(const ptz_config &config);
+    server(const server &) = delete;
+    server &operator=(const server &) = delete;
+    // Drops every connection and closes the ports.
+    ~server();
+
+    /**
+     * Loads each camera's profile and opens its port. Returns 0, or -1 after saying why on stderr.
+     */
+    int start();
+
+    /**
+     * Waits up to `timeout` for a connection, for commands, or for the engine to have something to do, and
+     * handles whatever came. Returns 0, or -1 if polling failed for anything but a signal.
+     */
+    int poll_once(clock::duration timeout);
+
+    // poll_once until `stop` is set, from a signal handler say.
+    int run(const volatile std::sig_atomic_t &stop);
+
+    int cameras() const { return config_.cameras; }
+    // The port `camera` is listening on; the one the system picked if the config's port was 0.
+    int port(int camera) const { return listeners_[camera].port; }
+    std::size_t connections() const { return connections_.size(); }
+    ptz_fleet *fleet() { return &fleet_; }
+    // Waits for the recorder to catch up, and puts rows still waiting for their block in the file.
+    void flush_telemetry();
+    engine &owner() { return *engine_; }
+
+private:
+    struct listener {
+        jr_server_socket socket;
+        int port;
+    };
+    struct connection {
+        jr_socket socket;
+        std::unique_ptr<ptz::session> session;
+    };
+    void accept_connection(int camera);
+    // False if it's gone, or sent something that isn't VISCA.
+    bool receive(connection &c);
+
+    ptz_config config_;
+    ptz_fleet fleet_;
+    bool fleetReady_ = false;
+    std::unique_ptr<engine> engine_;
+    ptz_telemetry_recorder telemetry_ = {};
+    bool recording_ = false;
+    std::vector<ptz_profile> profiles_;     // Each different one once.
+    std::vector<int> cameraProfiles_;       // Index into profiles_, by camera.
+    std::vector<listener> listeners_;
+    std::vector<std::unique_ptr<connection>> connections_;
+    std::vector<pollfd> fds_;               // Listeners, then connections, rebuilt each poll_once.
+};
+
+} // namespace ptz
+
+#endif
@@ -0,0 +1,80 @@
+//
+//  ptz_simd.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Portable SIMD types for the render kernels. These are the GCC/Clang vector extensions,
+//  so the same source becomes SSE on Intel Macs and Linux boxes and NEON on Apple silicon.
+//
+
+#ifndef ptz_simd_h
+#define ptz_simd_h
+
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t  ptz_u8x8   __attribute__((vector_size(8)));
+typedef uint8_t  ptz_u8x16  __attribute__((vector_size(16)));
+typedef uint16_t ptz_u16x8  __attribute__((vector_size(16)));
+typedef uint16_t ptz_u16x4  __attribute__((vector_size(8)));
+typedef int16_t  ptz_i16x8  __attribute__((vector_size(16)));
+typedef uint32_t ptz_u32x4  __attribute__((vector_size(16)));
+typedef int32_t  ptz_i32x4  __attribute__((vector_size(16)));
+typedef int32_t  ptz_i32x8  __attribute__((vector_size(32)));
+typedef float    ptz_f32x4  __attribute__((vector_size(16)));
+typedef float    ptz_f32x8  __attribute__((vector_size(32)));
+typedef uint8_t  ptz_u8x4   __attribute__((vector_size(4)));
+
+#define PTZ_CONVERT(_v, _type) __builtin_convertvector((_v), _type)
+#define PTZ_SHUFFLE __builtin_shufflevector
+
+// Unaligned loads and stores. memcpy is the portable spelling; compilers turn it into one instruction.
+static inline ptz_u8x8 ptz_load_u8x8(const uint8_t *p) { ptz_u8x8 v; memcpy(&v, p, sizeof(v)); return v; }
+static inline ptz_u8x16 ptz_load_u8x16(const uint8_t *p) { ptz_u8x16 v; memcpy(&v, p, sizeof(v)); return v; }
+static inline void ptz_store_u8x8(uint8_t *p, ptz_u8x8 v) { memcpy(p, &v, sizeof(v)); }
+static inline void ptz_store_u8x16(uint8_t *p, ptz_u8x16 v) { memcpy(p, &v, sizeof(v)); }
+
+// One RGBA pixel widened to 16 bits per channel.
+static inline ptz_u16x4 ptz_load_pixel16(const uint8_t *p) {
+    ptz_u8x4 b;
+    memcpy(&b, p, 4);
+    return PTZ_CONVERT(b, ptz_u16x4);
+}
+
+static inline void ptz_store_pixel16(uint8_t *p, ptz_u16x4 v) {
+    ptz_u8x4 b = PTZ_CONVERT(v, ptz_u8x4);
+    memcpy(p, &b, 4);
+}
+
+static inline ptz_u32x4 ptz_load_pixel32(const uint8_t *p) {
+    ptz_u32x4 v = { p[0], p[1], p[2], p[3] };
+    return v;
+}
+
+/**
+ * Blends two runs of bytes: out = (a * (256 - w) + b * w + 128) >> 8, with `w` in [0, 256].
+ * This is the vertical half of the bilinear filter, and it's the loop that touches every output byte.
+ */
+static inline void ptz_lerp_bytes(uint8_t *out, const uint8_t *a, const uint8_t *b, unsigned w, int count) {
+    const ptz_u16x8 wb = (ptz_u16x8){0} + (uint16_t)w;
+    const ptz_u16x8 wa = (ptz_u16x8){0} + (uint16_t)(256 - w);
+    const ptz_u16x8 round = (ptz_u16x8){0} + 128;
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        ptz_u8x16 va = ptz_load_u8x16(a + i);
+        ptz_u8x16 vb = ptz_load_u8x16(b + i);
+        ptz_u16x8 lo = (PTZ_CONVERT(PTZ_SHUFFLE(va, va, 0, 1, 2, 3, 4, 5, 6, 7), ptz_u16x8) * wa
+                        + PTZ_CONVERT(PTZ_SHUFFLE(vb, vb, 0, 1, 2, 3, 4, 5, 6, 7), ptz_u16x8) * wb + round) >> 8;
+        ptz_u16x8 hi = (PTZ_CONVERT(PTZ_SHUFFLE(va, va, 8, 9, 10, 11, 12, 13, 14, 15), ptz_u16x8) * wa
+                        + PTZ_CONVERT(PTZ_SHUFFLE(vb, vb, 8, 9, 10, 11, 12, 13, 14, 15), ptz_u16x8) * wb + round) >> 8;
+        ptz_u8x8 olo = PTZ_CONVERT(lo, ptz_u8x8);
+        ptz_u8x8 ohi = PTZ_CONVERT(hi, ptz_u8x8);
+        ptz_store_u8x16(out + i, PTZ_SHUFFLE(olo, ohi, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    }
+    for (; i < count; i++) {
+        out[i] = (uint8_t)((a[i] * (256 - w) + b[i] * w + 128) >> 8);
+    }
+}
+
+#endif /* ptz_simd_h */
@@ -0,0 +1,150 @@
+//
+//  ptz_snapshot.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_snapshot.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Shared between the cache and every response still sending it.
+struct ptz_snapshot_frame {
+    atomic_int refs;
+    uint64_t key;
+    uint8_t *data;
+    size_t size;
+};
+
+static const int ptz_snapshot_sizes[PTZ_SNAPSHOT_SIZE_COUNT][2] = {
+    { 1920, 1080 }, { 960, 600 }, { 480, 300 }
+};
+
+void ptz_snapshot_size(int index, int *width, int *height) {
+    *width = ptz_snapshot_sizes[index][0];
+    *height = ptz_snapshot_sizes[index][1];
+}
+
+static void ptz_snapshot_frame_retain(ptz_snapshot_frame *frame) {
+    atomic_fetch_add(&frame->refs, 1);
+}
+
+static void ptz_snapshot_frame_release(void *context) {
+    ptz_snapshot_frame *frame = context;
+    if (frame != NULL && atomic_fetch_sub(&frame->refs, 1) == 1) {
+        free(frame->data);
+        free(frame);
+    }
+}
+
+void ptz_snapshot_service_init(ptz_snapshot_service *service, ptz_snapshot_render_fn render, ptz_snapshot_encode_fn encode, void *context) {
+    memset(service, 0, sizeof(*service));
+    pthread_mutex_init(&service->lock, NULL);
+    service->render = render;
+    service->encode = encode;
+    service->context = context;
+    service->stateKey = ptz_state_render_key(&service->state);
+}
+
+void ptz_snapshot_service_destroy(ptz_snapshot_service *service) {
+    for (int i = 0; i < PTZ_SNAPSHOT_SIZE_COUNT; i++) {
+        ptz_snapshot_frame_release(service->frames[i]);
+    }
+    pthread_mutex_destroy(&service->lock);
+    memset(service, 0, sizeof(*service));
+}
+
+void ptz_snapshot_service_set_state(ptz_snapshot_service *service, const ptz_camera_state *state) {
+    uint64_t key = ptz_state_render_key(state);
+    pthread_mutex_lock(&service->lock);
+    service->state = *state;
+    service->stateKey = key;
+    pthread_mutex_unlock(&service->lock);
+}
+
+// Renders and encodes outside the lock, so a slow encode doesn't hold up the camera or other clients.
+static ptz_snapshot_frame *ptz_snapshot_frame_create(ptz_snapshot_service *service, const ptz_camera_state *state,
+                                                     uint64_t key, int width, int height) {
+    ptz_image image = { 0 };
+    ptz_snapshot_frame *frame = calloc(1, sizeof(*frame));
+    if (   frame == NULL
+        || ptz_image_alloc(&image, width, height) < 0
+        || service->render(state, &image, service->context) < 0
+        || service->encode(&image, &frame->data, &frame->size, service->context) < 0) {
+        ptz_image_free(&image);
+        free(frame);
+        return NULL;
+    }
+    ptz_image_free(&image);
+    atomic_init(&frame->refs, 1);
+    frame->key = key;
+    return frame;
+}
+
+static void ptz_snapshot_respond_text(ptz_http_response *response, int status, const char *text) {
+    response->status = status;
+    response->contentType = "text/plain";
+    response->body = (const uint8_t *)text;
+    response->length = strlen(text);
+}
+
+void ptz_snapshot_handle_request(const ptz_http_request *request, ptz_http_response *response, void *context) {
+    ptz_snapshot_service *service = context;
+    if (strcmp(request->path, "/snapshot.jpg") != 0) {
+        return;
+    }
+    int index = 0;
+    char resolution[32];
+    if (ptz_http_query_value(request->query, "resolution", resolution, sizeof(resolution))) {
+        index = -1;
+        for (int i = 0; i < PTZ_SNAPSHOT_SIZE_COUNT; i++) {
+            char name[32];
+            snprintf(name, sizeof(name), "%dx%d", ptz_snapshot_sizes[i][0], ptz_snapshot_sizes[i][1]);
+            if (strcmp(name, resolution) == 0) {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0) {
+            ptz_snapshot_respond_text(response, 400, "Supported resolutions are 1920x1080, 960x600 and 480x300");
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&service->lock);
+    ptz_camera_state state = service->state;
+    uint64_t key = service->stateKey;
+    ptz_snapshot_frame *frame = service->frames[index];
+    if (frame != NULL && frame->key == key) {
+        ptz_snapshot_frame_retain(frame);
+        service->hits++;
+    } else {
+        frame = NULL;
+        service->misses++;
+    }
+    pthread_mutex_unlock(&service->lock);
+
+    if (frame == NULL) {
+        frame = ptz_snapshot_frame_create(service, &state, key, ptz_snapshot_sizes[index][0], ptz_snapshot_sizes[index][1]);
+        if (frame == NULL) {
+            ptz_snapshot_respond_text(response, 500, "Snapshot failed");
+            return;
+        }
+        ptz_snapshot_frame_retain(frame);
+        pthread_mutex_lock(&service->lock);
+        ptz_snapshot_frame *old = service->frames[index];
+        service->frames[index] = frame;
+        pthread_mutex_unlock(&service->lock);
+        ptz_snapshot_frame_release(old);
+    }
+    response->status = 200;
+    response->contentType = "image/jpeg";
+    response->body = frame->data;
+    response->length = frame->size;
+    response->release = ptz_snapshot_frame_release;
+    response->releaseContext = frame;
+}
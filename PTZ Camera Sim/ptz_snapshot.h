@@ -0,0 +1,68 @@
+//
+//  ptz_snapshot.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  snapshot.jpg on demand. The camera publishes its state here on every tick, which is only a copy;
+//  a frame is rendered and encoded when a client asks for one, and kept until the picture changes.
+//
+
+#ifndef ptz_snapshot_h
+#define ptz_snapshot_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "ptz_state.h"
+#include "ptz_render.h"
+#include "ptz_http.h"
+
+// The resolutions real cameras offer for snapshot.jpg. The first is the default.
+#define PTZ_SNAPSHOT_SIZE_COUNT 3
+
+/**
+ * Renders the camera's view of `state` into `frame`, which is already allocated at the requested size.
+ * Called on an HTTP connection thread. Returns 0 or -1.
+ */
+typedef int (*ptz_snapshot_render_fn)(const ptz_camera_state *state, ptz_image *frame, void *context);
+
+/**
+ * Encodes `frame` as JPEG into a buffer from malloc. Called on an HTTP connection thread. Returns 0 or -1.
+ */
+typedef int (*ptz_snapshot_encode_fn)(const ptz_image *frame, uint8_t **data, size_t *size, void *context);
+
+typedef struct ptz_snapshot_frame ptz_snapshot_frame;
+
+typedef struct ptz_snapshot_service {
+    pthread_mutex_t lock;
+    ptz_camera_state state;
+    uint64_t stateKey;                                      // ptz_state_render_key(&state)
+    ptz_snapshot_frame *frames[PTZ_SNAPSHOT_SIZE_COUNT];    // Last encoded frame at each size, or NULL.
+    ptz_snapshot_render_fn render;
+    ptz_snapshot_encode_fn encode;
+    void *context;
+    uint64_t hits;
+    uint64_t misses;
+} ptz_snapshot_service;
+
+void ptz_snapshot_service_init(ptz_snapshot_service *service, ptz_snapshot_render_fn render, ptz_snapshot_encode_fn encode, void *context);
+void ptz_snapshot_service_destroy(ptz_snapshot_service *service);
+
+/**
+ * The camera's current state. Cheap enough to call on every tick; nothing is rendered until a request comes in.
+ */
+void ptz_snapshot_service_set_state(ptz_snapshot_service *service, const ptz_camera_state *state);
+
+/**
+ * Size `index` of PTZ_SNAPSHOT_SIZE_COUNT: 1920x1080, 960x600, 480x300.
+ */
+void ptz_snapshot_size(int index, int *width, int *height);
+
+/**
+ * ptz_http_handler for /snapshot.jpg, with `context` the service. The size comes from `resolution=WxH`
+ * in the query and defaults to the largest.
+ */
+void ptz_snapshot_handle_request(const ptz_http_request *request, ptz_http_response *response, void *context);
+
+#endif /* ptz_snapshot_h */
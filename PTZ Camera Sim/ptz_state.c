@@ -0,0 +1,100 @@
+//
+//  ptz_state.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_state.h"
+
+#include <string.h>
+#include <stddef.h>
+
+void ptz_state_feed_init(ptz_state_feed *feed) {
+    memset(feed, 0, sizeof(*feed));
+}
+
+int ptz_state_feed_subscribe(ptz_state_feed *feed, ptz_state_callback callback, void *context) {
+    for (int i = 0; i < PTZ_STATE_MAX_SUBSCRIBERS; i++) {
+        if (feed->subscribers[i].callback == NULL) {
+            feed->subscribers[i].callback = callback;
+            feed->subscribers[i].context = context;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void *ptz_state_feed_unsubscribe(ptz_state_feed *feed, int token) {
+    if (token < 0 || token >= PTZ_STATE_MAX_SUBSCRIBERS) {
+        return NULL;
+    }
+    void *context = feed->subscribers[token].context;
+    feed->subscribers[token].callback = NULL;
+    feed->subscribers[token].context = NULL;
+    return context;
+}
+
+int ptz_state_feed_mark(ptz_state_feed *feed, uint32_t dirty) {
+    int wasClean = (feed->pending == 0);
+    feed->pending |= dirty;
+    return wasClean && dirty != 0;
+}
+
+int ptz_state_feed_publish(ptz_state_feed *feed, const ptz_camera_state *state) {
+    if (feed->pending == 0) {
+        return 0;
+    }
+    ptz_state_delta delta;
+    delta.dirty = feed->pending;
+    delta.sequence = ++feed->sequence;
+    delta.state = *state;
+    // Clear first so a subscriber that writes state schedules the next delta instead of extending this one.
+    feed->pending = 0;
+    for (int i = 0; i < PTZ_STATE_MAX_SUBSCRIBERS; i++) {
+        if (feed->subscribers[i].callback != NULL) {
+            feed->subscribers[i].callback(&delta, feed->subscribers[i].context);
+        }
+    }
+    return 1;
+}
+
+uint64_t ptz_state_render_key(const ptz_camera_state *state) {
+    ptz_camera_state key;
+    // Field by field, so the padding is zero and the fields that don't show stay out.
+    memset(&key, 0, sizeof(key));
+    key.pan = state->pan;
+    key.tilt = state->tilt;
+    key.zoom = state->zoom;
+    key.focus = state->focus;
+    key.autofocus = state->autofocus;
+    key.menuVisible = state->menuVisible;
+    if (state->menuVisible) {
+        // Only on screen while the menu is.
+        key.presetSpeed = state->presetSpeed;
+        key.menuItem = state->menuItem;
+    }
+    key.bwMode = state->bwMode;
+    key.flipH = state->flipH;
+    key.flipV = state->flipV;
+    key.wbMode = state->wbMode;
+    key.colorTempIndex = state->colorTempIndex;
+    key.aeMode = state->aeMode;
+    key.aperture = state->aperture;
+    key.shutter = state->shutter;
+    key.iris = state->iris;
+    key.brightPos = state->brightPos;
+    key.brightness = state->brightness;
+    key.contrast = state->contrast;
+    key.rGain = state->rGain;
+    key.bGain = state->bGain;
+    key.colorgain = state->colorgain;
+    key.hue = state->hue;
+    // FNV-1a.
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const uint8_t *bytes = (const uint8_t *)&key;
+    for (size_t i = 0; i < sizeof(key); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,152 @@
+//
+//  ptz_state.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#ifndef ptz_state_h
+#define ptz_state_h
+
+#include <stdint.h>
+
+// VISCA position ranges the sim uses. Pan and tilt are -0x100...0x100.
+#define PTZ_ZOOM_MAX 0x100
+#define PTZ_PT_MAX 0x100
+#define PTZ_PT_MIN -0x100
+#define PTZ_RANGE_MAX 0x200
+#define PTZ_RANGE_SHIFT 0x100
+#define PTZ_FOCUS_MAX 0x100
+#define PTZ_WB_MODE_COLOR 0x20
+#define PTZ_MENU_ITEMS 5                // Rows in the OSD menu; see ptz_osd_menu.
+
+// Dirty bits for ptz_state_delta.dirty, one per field in ptz_camera_state.
+#define PTZ_STATE_PAN               (1u << 0)
+#define PTZ_STATE_TILT              (1u << 1)
+#define PTZ_STATE_ZOOM              (1u << 2)
+#define PTZ_STATE_FOCUS             (1u << 3)
+#define PTZ_STATE_AUTOFOCUS         (1u << 4)
+#define PTZ_STATE_MENU_VISIBLE      (1u << 5)
+#define PTZ_STATE_WB_MODE           (1u << 6)
+#define PTZ_STATE_COLOR_TEMP        (1u << 7)
+#define PTZ_STATE_BW_MODE           (1u << 8)
+#define PTZ_STATE_FLIP_H            (1u << 9)
+#define PTZ_STATE_FLIP_V            (1u << 10)
+#define PTZ_STATE_PRESET_SPEED      (1u << 11)
+#define PTZ_STATE_AE_MODE           (1u << 12)
+#define PTZ_STATE_APERTURE          (1u << 13)
+#define PTZ_STATE_SHUTTER           (1u << 14)
+#define PTZ_STATE_IRIS              (1u << 15)
+#define PTZ_STATE_BRIGHT_POS        (1u << 16)
+#define PTZ_STATE_BRIGHTNESS        (1u << 17)
+#define PTZ_STATE_CONTRAST          (1u << 18)
+#define PTZ_STATE_RGAIN             (1u << 19)
+#define PTZ_STATE_BGAIN             (1u << 20)
+#define PTZ_STATE_COLOR_GAIN        (1u << 21)
+#define PTZ_STATE_HUE               (1u << 22)
+#define PTZ_STATE_AWB_SENS          (1u << 23)
+#define PTZ_STATE_MENU_ITEM         (1u << 24)
+
+// Convenience groups for consumers that only care about some of the picture.
+#define PTZ_STATE_VIEWPORT_MASK     (PTZ_STATE_PAN | PTZ_STATE_TILT | PTZ_STATE_ZOOM)
+#define PTZ_STATE_COLOR_MASK        (PTZ_STATE_WB_MODE | PTZ_STATE_COLOR_TEMP | PTZ_STATE_BW_MODE | PTZ_STATE_AE_MODE \
+                                     | PTZ_STATE_APERTURE | PTZ_STATE_SHUTTER | PTZ_STATE_IRIS | PTZ_STATE_BRIGHT_POS \
+                                     | PTZ_STATE_BRIGHTNESS | PTZ_STATE_CONTRAST | PTZ_STATE_RGAIN | PTZ_STATE_BGAIN \
+                                     | PTZ_STATE_COLOR_GAIN | PTZ_STATE_HUE)
+#define PTZ_STATE_EFFECTS_MASK      (PTZ_STATE_FOCUS | PTZ_STATE_AUTOFOCUS | PTZ_STATE_COLOR_MASK \
+                                     | PTZ_STATE_FLIP_H | PTZ_STATE_FLIP_V)
+#define PTZ_STATE_ALL               ((1u << 25) - 1)
+
+/**
+ * Plain-value copy of everything a renderer or controller can observe about a camera.
+ * Units are the camera's own (VISCA) units, not the scaled values the UI uses.
+ */
+typedef struct ptz_camera_state {
+    int32_t pan;
+    int32_t tilt;
+    uint32_t zoom;
+    uint32_t focus;
+    uint8_t autofocus;
+    uint8_t menuVisible;
+    uint8_t bwMode;
+    uint8_t flipH;
+    uint8_t flipV;
+    uint32_t wbMode;
+    uint32_t colorTempIndex;
+    uint32_t presetSpeed;
+    uint32_t aeMode;
+    uint32_t aperture;
+    uint32_t shutter;
+    uint32_t iris;
+    uint32_t brightPos;
+    uint32_t brightness;
+    uint32_t contrast;
+    uint32_t rGain;
+    uint32_t bGain;
+    uint32_t colorgain;
+    uint32_t hue;
+    uint32_t awbSens;
+    uint32_t menuItem;      // OSD menu cursor, 0...PTZ_MENU_ITEMS - 1.
+} ptz_camera_state;
+
+/**
+ * One coalesced update: every field whose bit is set in `dirty` changed at least once
+ * since the previous delta. `state` holds the current value of all fields, dirty or not.
+ */
+typedef struct ptz_state_delta {
+    uint32_t dirty;
+    uint64_t sequence;
+    ptz_camera_state state;
+} ptz_state_delta;
+
+typedef void (*ptz_state_callback)(const ptz_state_delta *delta, void *context);
+
+#define PTZ_STATE_MAX_SUBSCRIBERS 16
+
+/**
+ * Fan-out point for camera state changes.
+ *
+ * Writers call `ptz_state_feed_mark` as often as they like; the owner of the engine tick
+ * calls `ptz_state_feed_publish` once per tick, which delivers a single delta to every subscriber.
+ * Not thread-safe: all calls for one feed must come from the same thread (main, for the app).
+ */
+typedef struct ptz_state_feed {
+    struct {
+        ptz_state_callback callback;
+        void *context;
+    } subscribers[PTZ_STATE_MAX_SUBSCRIBERS];
+    uint32_t pending;
+    uint64_t sequence;
+} ptz_state_feed;
+
+void ptz_state_feed_init(ptz_state_feed *feed);
+
+/**
+ * Returns a token >= 0 for `ptz_state_feed_unsubscribe`, or -1 if the feed is full.
+ */
+int ptz_state_feed_subscribe(ptz_state_feed *feed, ptz_state_callback callback, void *context);
+
+/**
+ * Returns the context that was passed to `ptz_state_feed_subscribe`, so the caller can release it.
+ */
+void *ptz_state_feed_unsubscribe(ptz_state_feed *feed, int token);
+
+/**
+ * Accumulates `dirty` into the pending delta.
+ * Returns 1 if the feed was clean before this call, i.e. the caller needs to schedule a publish.
+ */
+int ptz_state_feed_mark(ptz_state_feed *feed, uint32_t dirty);
+
+/**
+ * Delivers the pending delta, if any, to every subscriber and clears it.
+ * Returns 1 if a delta was published, 0 if nothing had changed.
+ */
+int ptz_state_feed_publish(ptz_state_feed *feed, const ptz_camera_state *state);
+
+/**
+ * Hash of the fields that change the rendered picture, for caching encoded frames.
+ * Two states with the same key render the same pixels; preset speed and AWB sensitivity are left out.
+ */
+uint64_t ptz_state_render_key(const ptz_camera_state *state);
+
+#endif /* ptz_state_h */
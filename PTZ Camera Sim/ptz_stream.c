@@ -0,0 +1,594 @@
+//
+//  ptz_stream.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_stream.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PTZ_STREAM_BOUNDARY "ptzframe"
+// How often a sink waiting on a reader or a full pipe checks whether we're stopping.
+#define PTZ_STREAM_POLL_MS 250
+
+// Shared between the stream and every MJPEG client still sending it.
+struct ptz_stream_jpeg {
+    int refs;       // Under the stream's lock.
+    uint8_t *data;
+    size_t size;
+};
+
+#pragma mark - Frames
+
+// The release functions are called with the lock held.
+static void ptz_stream_frame_release(ptz_stream_frame *frame) {
+    if (frame != NULL) {
+        frame->refs--;
+    }
+}
+
+static void ptz_stream_jpeg_release(ptz_stream_jpeg *jpeg) {
+    if (jpeg != NULL && --jpeg->refs == 0) {
+        free(jpeg->data);
+        free(jpeg);
+    }
+}
+
+static ptz_stream_frame *ptz_stream_free_frame(ptz_stream *stream) {
+    for (int i = 0; i < PTZ_STREAM_FRAMES; i++) {
+        if (stream->frames[i].refs == 0) {
+            return &stream->frames[i];
+        }
+    }
+    return NULL;
+}
+
+static void ptz_stream_update_consumers(ptz_stream *stream, int jpeg, int delta) {
+    pthread_mutex_lock(&stream->lock);
+    stream->consumers += delta;
+    if (jpeg) {
+        stream->jpegConsumers += delta;
+    }
+    pthread_cond_broadcast(&stream->changed);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+/**
+ * Waits for a frame published after `*sequence` and takes a reference to it, and to its JPEG if `jpeg` isn't NULL.
+ * Consumers that fall behind skip straight to the newest frame. Returns 0, or -1 once the stream is stopping.
+ */
+static int ptz_stream_next(ptz_stream *stream, uint64_t *sequence, ptz_stream_frame **frame, ptz_stream_jpeg **jpeg) {
+    pthread_mutex_lock(&stream->lock);
+    while (   !stream->stopping
+           && (stream->sequence == *sequence || stream->latest == NULL || (jpeg != NULL && stream->latestJpeg == NULL))) {
+        pthread_cond_wait(&stream->changed, &stream->lock);
+    }
+    if (stream->stopping) {
+        pthread_mutex_unlock(&stream->lock);
+        return -1;
+    }
+    *sequence = stream->sequence;
+    if (frame != NULL) {
+        *frame = stream->latest;
+        (*frame)->refs++;
+    }
+    if (jpeg != NULL) {
+        *jpeg = stream->latestJpeg;
+        (*jpeg)->refs++;
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return 0;
+}
+
+static void ptz_stream_put(ptz_stream *stream, ptz_stream_frame *frame, ptz_stream_jpeg *jpeg) {
+    pthread_mutex_lock(&stream->lock);
+    ptz_stream_frame_release(frame);
+    ptz_stream_jpeg_release(jpeg);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+static int ptz_stream_is_stopping(ptz_stream *stream) {
+    pthread_mutex_lock(&stream->lock);
+    int stopping = stream->stopping;
+    pthread_mutex_unlock(&stream->lock);
+    return stopping;
+}
+
+#pragma mark - Render and encode
+
+static void ptz_stream_timespec_add(struct timespec *time, long nanoseconds) {
+    time->tv_nsec += nanoseconds;
+    while (time->tv_nsec >= 1000000000L) {
+        time->tv_nsec -= 1000000000L;
+        time->tv_sec++;
+    }
+}
+
+static int64_t ptz_stream_timespec_diff(const struct timespec *a, const struct timespec *b) {
+    return (int64_t)(a->tv_sec - b->tv_sec) * 1000000000LL + (a->tv_nsec - b->tv_nsec);
+}
+
+static void *ptz_stream_render_thread(void *arg) {
+    ptz_stream *stream = arg;
+    long period = 1000000000L / stream->fps;
+    struct timespec deadline = { 0 };
+    int scheduled = 0;
+    pthread_mutex_lock(&stream->lock);
+    for (;;) {
+        while (stream->consumers == 0 && !stream->stopping) {
+            scheduled = 0;
+            pthread_cond_wait(&stream->changed, &stream->lock);
+        }
+        if (stream->stopping) {
+            break;
+        }
+        // Realtime, not monotonic: it's the only clock pthread_cond_timedwait takes everywhere.
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (!scheduled) {
+            deadline = now;
+            scheduled = 1;
+        } else {
+            ptz_stream_timespec_add(&deadline, period);
+            int64_t late = ptz_stream_timespec_diff(&now, &deadline);
+            if (late > period) {
+                // Too far behind to catch up; skip the ticks we missed rather than rendering a burst.
+                stream->stats.dropped += (uint64_t)(late / period);
+                deadline = now;
+            }
+            int waited = 0;
+            while (!stream->stopping && stream->consumers > 0 && waited != ETIMEDOUT) {
+                waited = pthread_cond_timedwait(&stream->changed, &stream->lock, &deadline);
+            }
+            if (stream->stopping || stream->consumers == 0) {
+                continue;
+            }
+        }
+
+        ptz_camera_state state = stream->state;
+        uint64_t key = stream->stateKey;
+        if (   stream->latest != NULL && stream->latest->key == key && stream->queueCount == 0
+            && (stream->jpegConsumers == 0 || stream->latestJpeg != NULL)) {
+            // Nothing has changed: send the last frame again instead of rendering and encoding it again.
+            stream->sequence++;
+            stream->stats.repeated++;
+            pthread_cond_broadcast(&stream->changed);
+            continue;
+        }
+        ptz_stream_frame *frame = ptz_stream_free_frame(stream);
+        if (frame == NULL) {
+            stream->stats.dropped++;
+            continue;
+        }
+        frame->refs = 1;
+        // Only this thread replaces it, so it stays put while we render without the lock.
+        ptz_stream_frame *previous = stream->previous;
+        pthread_mutex_unlock(&stream->lock);
+        int result = ptz_image_alloc(&frame->image, stream->width, stream->height);
+        if (result == 0) {
+            result = stream->render(&state, &frame->image, previous != NULL ? &previous->image : NULL, stream->context);
+        }
+        pthread_mutex_lock(&stream->lock);
+        if (result < 0) {
+            frame->refs = 0;
+            stream->stats.dropped++;
+            continue;
+        }
+        frame->key = key;
+        stream->stats.rendered++;
+        ptz_stream_frame_release(stream->previous);
+        frame->refs++;
+        stream->previous = frame;
+        if (stream->queueCount == PTZ_STREAM_QUEUE) {
+            // The encoder is behind. The oldest frame is the one nobody will miss.
+            ptz_stream_frame_release(stream->queue[0]);
+            memmove(stream->queue, stream->queue + 1, sizeof(stream->queue[0]) * (PTZ_STREAM_QUEUE - 1));
+            stream->queueCount--;
+            stream->stats.dropped++;
+        }
+        // The queue takes over the renderer's reference.
+        stream->queue[stream->queueCount++] = frame;
+        pthread_cond_broadcast(&stream->changed);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+static void *ptz_stream_encode_thread(void *arg) {
+    ptz_stream *stream = arg;
+    pthread_mutex_lock(&stream->lock);
+    for (;;) {
+        while (stream->queueCount == 0 && !stream->stopping) {
+            pthread_cond_wait(&stream->changed, &stream->lock);
+        }
+        if (stream->stopping) {
+            break;
+        }
+        ptz_stream_frame *frame = stream->queue[0];
+        memmove(stream->queue, stream->queue + 1, sizeof(stream->queue[0]) * (PTZ_STREAM_QUEUE - 1));
+        stream->queueCount--;
+        // Raw sinks only need the pixels; don't encode for nobody.
+        int wantJpeg = (stream->jpegConsumers > 0);
+        pthread_mutex_unlock(&stream->lock);
+
+        ptz_stream_jpeg *jpeg = NULL;
+        if (wantJpeg) {
+            jpeg = calloc(1, sizeof(*jpeg));
+            if (jpeg != NULL && stream->encode(&frame->image, &jpeg->data, &jpeg->size, stream->context) < 0) {
+                free(jpeg);
+                jpeg = NULL;
+            }
+        }
+
+        pthread_mutex_lock(&stream->lock);
+        if (wantJpeg && jpeg == NULL) {
+            ptz_stream_frame_release(frame);
+            stream->stats.dropped++;
+            continue;
+        }
+        if (jpeg != NULL) {
+            jpeg->refs = 1;
+            stream->stats.encoded++;
+        }
+        ptz_stream_frame_release(stream->latest);
+        ptz_stream_jpeg_release(stream->latestJpeg);
+        stream->latest = frame;
+        stream->latestJpeg = jpeg;
+        stream->sequence++;
+        pthread_cond_broadcast(&stream->changed);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+#pragma mark - MJPEG
+
+static void ptz_stream_send_mjpeg(int socket, void *context) {
+    ptz_stream *stream = context;
+    uint64_t sequence = 0;
+    ptz_stream_update_consumers(stream, 1, 1);
+    for (;;) {
+        ptz_stream_jpeg *jpeg;
+        if (ptz_stream_next(stream, &sequence, NULL, &jpeg) < 0) {
+            break;
+        }
+        char header[128];
+        int length = snprintf(header, sizeof(header),
+                              "--" PTZ_STREAM_BOUNDARY "\r\n"
+                              "Content-Type: image/jpeg\r\n"
+                              "Content-Length: %zu\r\n"
+                              "\r\n", jpeg->size);
+        // While this blocks on a slow client, newer frames replace each other; it only ever gets the latest.
+        int sent = (   ptz_http_send(socket, header, (size_t)length) == 0
+                    && ptz_http_send(socket, jpeg->data, jpeg->size) == 0
+                    && ptz_http_send(socket, "\r\n", 2) == 0);
+        ptz_stream_put(stream, NULL, jpeg);
+        if (!sent) {
+            break;
+        }
+    }
+    ptz_stream_update_consumers(stream, 1, -1);
+}
+
+void ptz_stream_handle_request(const ptz_http_request *request, ptz_http_response *response, void *context) {
+    if (strcmp(request->path, "/stream.mjpg") != 0) {
+        return;
+    }
+    response->status = 200;
+    response->contentType = "multipart/x-mixed-replace; boundary=" PTZ_STREAM_BOUNDARY;
+    response->body = NULL;
+    response->length = 0;
+    response->stream = ptz_stream_send_mjpeg;
+    response->streamContext = context;
+}
+
+#pragma mark - Raw sink
+
+size_t ptz_stream_y4m_size(int width, int height) {
+    size_t chroma = (size_t)((width + 1) / 2) * (size_t)((height + 1) / 2);
+    return (size_t)width * (size_t)height + 2 * chroma;
+}
+
+// BT.601 studio range, which is what ffmpeg assumes for Y4M.
+static inline uint8_t ptz_stream_luma(int r, int g, int b) {
+    return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+void ptz_stream_rgba_to_y4m(const ptz_image *image, uint8_t *yuv) {
+    int width = image->width;
+    int height = image->height;
+    int chromaWidth = (width + 1) / 2;
+    uint8_t *yPlane = yuv;
+    uint8_t *cbPlane = yuv + (size_t)width * height;
+    uint8_t *crPlane = cbPlane + (size_t)chromaWidth * ((height + 1) / 2);
+    for (int y = 0; y < height; y += 2) {
+        const uint8_t *rows[2] = { ptz_image_row(image, y), ptz_image_row(image, y + 1 < height ? y + 1 : y) };
+        int rowCount = (y + 1 < height) ? 2 : 1;
+        for (int r = 0; r < rowCount; r++) {
+            const uint8_t *p = rows[r];
+            uint8_t *out = yPlane + (size_t)(y + r) * width;
+            for (int x = 0; x < width; x++, p += 4) {
+                out[x] = ptz_stream_luma(p[0], p[1], p[2]);
+            }
+        }
+        // 420jpeg siting: each chroma sample is the average of the 2x2 block it sits in the middle of.
+        uint8_t *cb = cbPlane + (size_t)(y / 2) * chromaWidth;
+        uint8_t *cr = crPlane + (size_t)(y / 2) * chromaWidth;
+        for (int cx = 0; cx < chromaWidth; cx++) {
+            int x = cx * 2;
+            int columns = (x + 1 < width) ? 2 : 1;
+            int sumR = 0, sumG = 0, sumB = 0;
+            for (int r = 0; r < rowCount; r++) {
+                for (int c = 0; c < columns; c++) {
+                    const uint8_t *p = rows[r] + (x + c) * 4;
+                    sumR += p[0];
+                    sumG += p[1];
+                    sumB += p[2];
+                }
+            }
+            int count = rowCount * columns;
+            int red = (sumR + count / 2) / count;
+            int green = (sumG + count / 2) / count;
+            int blue = (sumB + count / 2) / count;
+            // Offset before shifting so the sums stay positive.
+            cb[cx] = (uint8_t)((-38 * red - 74 * green + 112 * blue + 128 + (128 << 8)) >> 8);
+            cr[cx] = (uint8_t)((112 * red - 94 * green - 18 * blue + 128 + (128 << 8)) >> 8);
+        }
+    }
+}
+
+// The sink's descriptor is non-blocking, so a reader that stops reading can't keep us from stopping.
+static int ptz_stream_write_all(ptz_stream *stream, int fd, const void *data, size_t length) {
+    const uint8_t *p = data;
+    while (length > 0) {
+        ssize_t written = write(fd, p, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return -1;
+            }
+            struct pollfd waitFor = { .fd = fd, .events = POLLOUT };
+            poll(&waitFor, 1, PTZ_STREAM_POLL_MS);
+            if (ptz_stream_is_stopping(stream)) {
+                return -1;
+            }
+            continue;
+        }
+        p += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+// Waits for the next reader. Returns a non-blocking descriptor to write to, or -1 once the stream is stopping.
+static int ptz_stream_sink_wait(ptz_stream *stream) {
+    while (!ptz_stream_is_stopping(stream)) {
+        int fd = -1;
+        if (stream->sinkSocket >= 0) {
+            struct pollfd waitFor = { .fd = stream->sinkSocket, .events = POLLIN };
+            if (poll(&waitFor, 1, PTZ_STREAM_POLL_MS) > 0) {
+                fd = accept(stream->sinkSocket, NULL, NULL);
+            }
+        } else {
+            // Opening a FIFO to write fails with ENXIO until someone has it open to read.
+            fd = open(stream->sinkPath, O_WRONLY | O_NONBLOCK);
+            if (fd < 0) {
+                if (errno != ENXIO) {
+                    perror("open");
+                    return -1;
+                }
+                usleep(PTZ_STREAM_POLL_MS * 1000);
+            }
+        }
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            return fd;
+        }
+    }
+    return -1;
+}
+
+static void ptz_stream_send_raw(ptz_stream *stream, int fd, uint8_t *buffer, size_t frameSize) {
+    if (stream->sinkFormat == PTZ_STREAM_Y4M) {
+        char header[128];
+        int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                              stream->width, stream->height, stream->fps);
+        if (ptz_stream_write_all(stream, fd, header, (size_t)length) < 0) {
+            return;
+        }
+    }
+    uint64_t sequence = 0;
+    for (;;) {
+        ptz_stream_frame *frame;
+        if (ptz_stream_next(stream, &sequence, &frame, NULL) < 0) {
+            return;
+        }
+        // Copied out first so the frame goes back to the renderer before we block on the reader.
+        if (stream->sinkFormat == PTZ_STREAM_Y4M) {
+            ptz_stream_rgba_to_y4m(&frame->image, buffer);
+        } else {
+            size_t rowBytes = (size_t)stream->width * 4;
+            for (int y = 0; y < stream->height; y++) {
+                memcpy(buffer + y * rowBytes, ptz_image_row(&frame->image, y), rowBytes);
+            }
+        }
+        ptz_stream_put(stream, frame, NULL);
+        if (   (stream->sinkFormat == PTZ_STREAM_Y4M && ptz_stream_write_all(stream, fd, "FRAME\n", 6) < 0)
+            || ptz_stream_write_all(stream, fd, buffer, frameSize) < 0) {
+            return;
+        }
+    }
+}
+
+static void *ptz_stream_sink_thread(void *arg) {
+    ptz_stream *stream = arg;
+    // A FIFO reader going away raises SIGPIPE. Blocked on this thread, the write just fails with EPIPE instead.
+    sigset_t pipeSignal;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, NULL);
+
+    size_t frameSize = (stream->sinkFormat == PTZ_STREAM_Y4M) ? ptz_stream_y4m_size(stream->width, stream->height)
+                                                              : (size_t)stream->width * stream->height * 4;
+    uint8_t *buffer = malloc(frameSize);
+    if (buffer == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    int fd;
+    while ((fd = ptz_stream_sink_wait(stream)) >= 0) {
+        ptz_stream_update_consumers(stream, 0, 1);
+        ptz_stream_send_raw(stream, fd, buffer, frameSize);
+        ptz_stream_update_consumers(stream, 0, -1);
+        close(fd);
+    }
+    free(buffer);
+    return NULL;
+}
+
+int ptz_stream_open_sink(ptz_stream *stream, const char *path, ptz_stream_format format) {
+    if (stream->sinkRunning) {
+        fprintf(stderr, "ptz_stream: a sink is already open at %s\n", stream->sinkPath);
+        return -1;
+    }
+    int listenSocket = -1;
+    if (strncmp(path, "unix:", 5) == 0) {
+        path += 5;
+        struct sockaddr_un address = { 0 };
+        if (strlen(path) >= sizeof(address.sun_path)) {
+            fprintf(stderr, "ptz_stream: socket path too long: %s\n", path);
+            return -1;
+        }
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, path);
+        listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenSocket < 0) {
+            perror("socket");
+            return -1;
+        }
+        // Left over from a previous run.
+        unlink(path);
+        if (bind(listenSocket, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(listenSocket, 1) < 0) {
+            perror("bind");
+            close(listenSocket);
+            return -1;
+        }
+    } else {
+        struct stat info;
+        if (stat(path, &info) < 0) {
+            if (errno != ENOENT || mkfifo(path, 0644) < 0) {
+                perror("mkfifo");
+                return -1;
+            }
+        } else if (!S_ISFIFO(info.st_mode)) {
+            fprintf(stderr, "ptz_stream: %s is not a FIFO\n", path);
+            return -1;
+        }
+    }
+    if (strlen(path) >= sizeof(stream->sinkPath)) {
+        fprintf(stderr, "ptz_stream: path too long: %s\n", path);
+        if (listenSocket >= 0) {
+            close(listenSocket);
+        }
+        return -1;
+    }
+    strcpy(stream->sinkPath, path);
+    stream->sinkFormat = format;
+    stream->sinkSocket = listenSocket;
+    if (pthread_create(&stream->sinkThread, NULL, ptz_stream_sink_thread, stream) != 0) {
+        if (listenSocket >= 0) {
+            close(listenSocket);
+            unlink(path);
+        }
+        stream->sinkSocket = -1;
+        return -1;
+    }
+    stream->sinkRunning = 1;
+    return 0;
+}
+
+#pragma mark - Lifetime
+
+int ptz_stream_start(ptz_stream *stream, int width, int height, int fps,
+                     ptz_stream_render_fn render, ptz_stream_encode_fn encode, void *context) {
+    memset(stream, 0, sizeof(*stream));
+    stream->width = width;
+    stream->height = height;
+    stream->fps = fps;
+    stream->render = render;
+    stream->encode = encode;
+    stream->context = context;
+    stream->sinkSocket = -1;
+    stream->stateKey = ptz_state_render_key(&stream->state);
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->changed, NULL);
+    if (pthread_create(&stream->renderThread, NULL, ptz_stream_render_thread, stream) != 0) {
+        pthread_mutex_destroy(&stream->lock);
+        pthread_cond_destroy(&stream->changed);
+        return -1;
+    }
+    if (pthread_create(&stream->encodeThread, NULL, ptz_stream_encode_thread, stream) != 0) {
+        pthread_mutex_lock(&stream->lock);
+        stream->stopping = 1;
+        pthread_cond_broadcast(&stream->changed);
+        pthread_mutex_unlock(&stream->lock);
+        pthread_join(stream->renderThread, NULL);
+        pthread_mutex_destroy(&stream->lock);
+        pthread_cond_destroy(&stream->changed);
+        return -1;
+    }
+    return 0;
+}
+
+void ptz_stream_stop(ptz_stream *stream) {
+    pthread_mutex_lock(&stream->lock);
+    stream->stopping = 1;
+    pthread_cond_broadcast(&stream->changed);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->renderThread, NULL);
+    pthread_join(stream->encodeThread, NULL);
+    if (stream->sinkRunning) {
+        pthread_join(stream->sinkThread, NULL);
+        if (stream->sinkSocket >= 0) {
+            close(stream->sinkSocket);
+            unlink(stream->sinkPath);
+        }
+    }
+
+    // MJPEG clients run on the HTTP server's threads; they let go as soon as they see we're stopping.
+    pthread_mutex_lock(&stream->lock);
+    while (stream->consumers > 0) {
+        pthread_cond_wait(&stream->changed, &stream->lock);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    ptz_stream_jpeg_release(stream->latestJpeg);
+    for (int i = 0; i < PTZ_STREAM_FRAMES; i++) {
+        ptz_image_free(&stream->frames[i].image);
+    }
+    pthread_mutex_destroy(&stream->lock);
+    pthread_cond_destroy(&stream->changed);
+    memset(stream, 0, sizeof(*stream));
+}
+
+void ptz_stream_set_state(ptz_stream *stream, const ptz_camera_state *state) {
+    uint64_t key = ptz_state_render_key(state);
+    pthread_mutex_lock(&stream->lock);
+    stream->state = *state;
+    stream->stateKey = key;
+    pthread_mutex_unlock(&stream->lock);
+}
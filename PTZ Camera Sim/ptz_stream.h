@@ -0,0 +1,135 @@
+//
+//  ptz_stream.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Live video out at a fixed frame rate: MJPEG over HTTP, and raw Y4M or RGBA frames to a FIFO or
+//  Unix socket for ffmpeg. Render, encode and send each run on their own threads with bounded
+//  queues between them; a stage that falls behind drops frames rather than holding up the one before it,
+//  so a slow client never stalls the camera. Nothing is rendered while nobody is watching.
+//
+
+#ifndef ptz_stream_h
+#define ptz_stream_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "ptz_state.h"
+#include "ptz_render.h"
+#include "ptz_http.h"
+
+#define PTZ_STREAM_WIDTH 1280
+#define PTZ_STREAM_HEIGHT 720
+#define PTZ_STREAM_FPS 30
+
+// Rendered frames waiting for the encoder. When it's full the oldest is dropped.
+#define PTZ_STREAM_QUEUE 2
+// Enough that the renderer always has one free: one rendering, the queue, one encoding, the latest,
+// the previous one it renders from, and one being sent raw.
+#define PTZ_STREAM_FRAMES (PTZ_STREAM_QUEUE + 5)
+
+/**
+ * Renders the camera's view of `state` into `frame`, which is already allocated at the stream size.
+ * `previous` is the last frame this rendered, or NULL, for reusing with ptz_render_scroll.
+ * Called on the stream's render thread. Returns 0 or -1.
+ */
+typedef int (*ptz_stream_render_fn)(const ptz_camera_state *state, ptz_image *frame, const ptz_image *previous,
+                                    void *context);
+
+/**
+ * Encodes `frame` as JPEG into a buffer from malloc. Called on the stream's encode thread. Returns 0 or -1.
+ */
+typedef int (*ptz_stream_encode_fn)(const ptz_image *frame, uint8_t **data, size_t *size, void *context);
+
+typedef enum ptz_stream_format {
+    PTZ_STREAM_Y4M,     // YUV4MPEG2, 4:2:0 BT.601: `ffmpeg -i unix:/path` or `ffmpeg -i /path/to/fifo`.
+    PTZ_STREAM_RGBA,    // Bare frames: `ffmpeg -f rawvideo -pix_fmt rgba -s 1280x720 -r 30 -i ...`.
+} ptz_stream_format;
+
+typedef struct ptz_stream_frame {
+    int refs;               // Under the stream's lock. 0 means free for the renderer.
+    uint64_t key;           // ptz_state_render_key of what it shows.
+    ptz_image image;
+} ptz_stream_frame;
+
+typedef struct ptz_stream_jpeg ptz_stream_jpeg;
+
+typedef struct ptz_stream_stats {
+    uint64_t rendered;
+    uint64_t repeated;      // Ticks where nothing had changed, so the last frame went out again.
+    uint64_t encoded;
+    uint64_t dropped;       // Ticks missed, or frames the encoder never got to.
+} ptz_stream_stats;
+
+typedef struct ptz_stream {
+    int width;
+    int height;
+    int fps;
+    ptz_stream_render_fn render;
+    ptz_stream_encode_fn encode;
+    void *context;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;     // Broadcast on new state, new frames, consumers coming and going, and stop.
+    ptz_camera_state state;
+    uint64_t stateKey;
+    ptz_stream_frame frames[PTZ_STREAM_FRAMES];
+    ptz_stream_frame *queue[PTZ_STREAM_QUEUE];
+    int queueCount;
+    ptz_stream_frame *previous; // Last frame rendered, for the next render to start from.
+    ptz_stream_frame *latest;   // Last published frame, and its JPEG if anyone wanted one.
+    ptz_stream_jpeg *latestJpeg;
+    uint64_t sequence;          // Bumped every time a frame is published, repeats included.
+    int consumers;
+    int jpegConsumers;
+    int stopping;
+    ptz_stream_stats stats;
+    pthread_t renderThread;
+    pthread_t encodeThread;
+
+    // Raw output. One reader at a time; when it goes away we wait for the next.
+    char sinkPath[1024];
+    ptz_stream_format sinkFormat;
+    int sinkSocket;             // Listening Unix socket, or -1 for a FIFO.
+    int sinkRunning;
+    pthread_t sinkThread;
+} ptz_stream;
+
+/**
+ * Starts the render and encode threads; they sleep until there's a consumer.
+ * Returns 0, or -1 if the threads couldn't be started.
+ */
+int ptz_stream_start(ptz_stream *stream, int width, int height, int fps,
+                     ptz_stream_render_fn render, ptz_stream_encode_fn encode, void *context);
+
+/**
+ * Stops every thread, waits for the HTTP clients to let go, and frees the frames.
+ */
+void ptz_stream_stop(ptz_stream *stream);
+
+/**
+ * The camera's current state. Only a copy; cheap enough to call on every tick.
+ */
+void ptz_stream_set_state(ptz_stream *stream, const ptz_camera_state *state);
+
+/**
+ * Writes raw frames to `path`: "unix:/some/path" listens on a Unix socket there, anything else is a FIFO,
+ * created if it doesn't exist. Returns 0, or -1 if the path couldn't be set up.
+ */
+int ptz_stream_open_sink(ptz_stream *stream, const char *path, ptz_stream_format format);
+
+/**
+ * ptz_http_handler for /stream.mjpg, with `context` the stream.
+ */
+void ptz_stream_handle_request(const ptz_http_request *request, ptz_http_response *response, void *context);
+
+/**
+ * Converts RGBA to the planes of a 4:2:0 Y4M frame: Y at full size, then Cb and Cr at half size, rounded up.
+ * `yuv` holds ptz_stream_y4m_size bytes.
+ */
+size_t ptz_stream_y4m_size(int width, int height);
+void ptz_stream_rgba_to_y4m(const ptz_image *image, uint8_t *yuv);
+
+#endif /* ptz_stream_h */
@@ -0,0 +1,504 @@
+//
+//  ptz_telemetry.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_telemetry.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HEADER_SIZE 4096
+#define BLOCK_MAGIC 0x4b4c4254u                     // "TBLK"
+#define MAX_ROW (10 * PTZ_TELEMETRY_COLUMNS)        // Every column at its longest varint.
+#define MAX_CAMERA (1 << 24)                        // Past this a reader takes a block to be garbage.
+
+static const char file_magic[8] = "PTZTLM1";
+
+typedef struct file_header {
+    char magic[8];
+    uint32_t blockSize;
+    uint32_t blockCount;
+} file_header;
+
+typedef struct block_header {
+    uint32_t magic;
+    uint32_t rows;
+    uint64_t sequence;                              // From 1. 0 while it's being written, or never was.
+    uint64_t firstTime;
+    uint64_t lastTime;
+    uint32_t lengths[PTZ_TELEMETRY_COLUMNS];
+} block_header;
+
+#define PAYLOAD (PTZ_TELEMETRY_BLOCK - sizeof(block_header))
+
+struct ptz_telemetry_last {
+    uint64_t block;                                 // The sequence of the block `row` is in; 0 for none.
+    ptz_telemetry_row row;
+};
+
+static block_header *block_at(uint8_t *map, uint32_t index) {
+    return (block_header *)(map + HEADER_SIZE + (size_t)index * PTZ_TELEMETRY_BLOCK);
+}
+
+#pragma mark Varints
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static inline uint8_t *put(uint8_t *p, uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+typedef struct column_reader {
+    const uint8_t *p;
+    const uint8_t *end;
+} column_reader;
+
+// Returns 0, or -1 if the column ran out.
+static int get(column_reader *column, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && column->p < column->end; shift += 7) {
+        uint8_t byte = *column->p++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Room in `*last` for `camera`, with anything new never seen.
+static int reserve_last(ptz_telemetry_last **last, int *count, int32_t camera) {
+    if (camera < *count) {
+        return 0;
+    }
+    int grown = *count ? *count : 64;
+    while (grown <= camera) {
+        grown *= 2;
+    }
+    ptz_telemetry_last *more = realloc(*last, grown * sizeof(**last));
+    if (!more) {
+        return -1;
+    }
+    memset(more + *count, 0, (grown - *count) * sizeof(*more));
+    *last = more;
+    *count = grown;
+    return 0;
+}
+
+#pragma mark Recording
+
+int ptz_telemetry_open(ptz_telemetry *telemetry, const char *path, uint64_t budget) {
+    memset(telemetry, 0, sizeof(*telemetry));
+    telemetry->fd = -1;
+    if (budget < HEADER_SIZE + 2 * PTZ_TELEMETRY_BLOCK) {
+        fprintf(stderr, "%s: a budget of %llu bytes is less than two blocks\n", path, (unsigned long long)budget);
+        return -1;
+    }
+    uint64_t blocks = (budget - HEADER_SIZE) / PTZ_TELEMETRY_BLOCK;
+    telemetry->blockCount = blocks > UINT32_MAX ? UINT32_MAX : (uint32_t)blocks;
+    telemetry->mapSize = HEADER_SIZE + (size_t)telemetry->blockCount * PTZ_TELEMETRY_BLOCK;
+
+    telemetry->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (telemetry->fd == -1) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(telemetry->fd, &st) == -1) {
+        perror(path);
+        ptz_telemetry_close(telemetry);
+        return -1;
+    }
+    // Start over unless it's the same shape, and then pick up after its newest block.
+    file_header existing = { { 0 }, 0, 0 };
+    int same = (uint64_t)st.st_size == telemetry->mapSize &&
+               pread(telemetry->fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+               memcmp(existing.magic, file_magic, sizeof(file_magic)) == 0 &&
+               existing.blockSize == PTZ_TELEMETRY_BLOCK && existing.blockCount == telemetry->blockCount;
+    if (!same && (ftruncate(telemetry->fd, 0) == -1 || ftruncate(telemetry->fd, (off_t)telemetry->mapSize) == -1)) {
+        perror(path);
+        ptz_telemetry_close(telemetry);
+        return -1;
+    }
+    telemetry->map = mmap(NULL, telemetry->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, telemetry->fd, 0);
+    if (telemetry->map == MAP_FAILED) {
+        telemetry->map = NULL;
+        perror(path);
+        ptz_telemetry_close(telemetry);
+        return -1;
+    }
+    telemetry->sequence = 1;
+    if (same) {
+        for (uint32_t i = 0; i < telemetry->blockCount; i++) {
+            block_header *header = block_at(telemetry->map, i);
+            if (header->magic == BLOCK_MAGIC && header->sequence >= telemetry->sequence) {
+                telemetry->sequence = header->sequence + 1;
+            }
+        }
+    } else {
+        file_header header = { { 0 }, PTZ_TELEMETRY_BLOCK, telemetry->blockCount };
+        memcpy(header.magic, file_magic, sizeof(file_magic));
+        memcpy(telemetry->map, &header, sizeof(header));
+    }
+
+    telemetry->columns[0] = malloc(PTZ_TELEMETRY_COLUMNS * PAYLOAD);
+    if (!telemetry->columns[0]) {
+        perror("ptz_telemetry_open");
+        ptz_telemetry_close(telemetry);
+        return -1;
+    }
+    for (int c = 1; c < PTZ_TELEMETRY_COLUMNS; c++) {
+        telemetry->columns[c] = telemetry->columns[0] + c * PAYLOAD;
+    }
+    return 0;
+}
+
+void ptz_telemetry_record(ptz_telemetry *telemetry, const ptz_telemetry_row *row) {
+    if (row->camera < 0 || row->camera >= MAX_CAMERA ||
+        reserve_last(&telemetry->last, &telemetry->lastCount, row->camera) < 0) {
+        return;
+    }
+    if (telemetry->used + MAX_ROW > PAYLOAD) {
+        ptz_telemetry_flush(telemetry);
+    }
+    // Each block stands alone, so a camera's first row in it is against zeros.
+    ptz_telemetry_last *last = &telemetry->last[row->camera];
+    ptz_telemetry_row previous = { 0 };
+    if (last->block == telemetry->sequence) {
+        previous = last->row;
+    }
+    uint64_t time = row->time;
+    if (telemetry->rows == 0) {
+        telemetry->firstTime = time;
+        telemetry->lastTime = time;
+        telemetry->lastCamera = 0;
+    } else if (time < telemetry->lastTime) {
+        time = telemetry->lastTime;
+    }
+
+    uint64_t values[PTZ_TELEMETRY_COLUMNS] = {
+        time - telemetry->lastTime,
+        zigzag((int64_t)row->camera - telemetry->lastCamera),
+        zigzag((int64_t)row->pan - previous.pan),
+        zigzag((int64_t)row->tilt - previous.tilt),
+        zigzag((int64_t)row->zoom - previous.zoom),
+        zigzag((int64_t)row->focus - previous.focus),
+        zigzag((int64_t)row->command - previous.command),
+        zigzag((int64_t)row->slot - previous.slot),
+    };
+    // Through locals: stores through a uint8_t * could be to anything, so the struct's fields would be reloaded.
+    uint32_t used = 0;
+    for (int c = 0; c < PTZ_TELEMETRY_COLUMNS; c++) {
+        uint8_t *start = telemetry->columns[c] + telemetry->lengths[c];
+        uint32_t length = (uint32_t)(put(start, values[c]) - start);
+        telemetry->lengths[c] += length;
+        used += length;
+    }
+    telemetry->used += used;
+
+    last->block = telemetry->sequence;
+    last->row = *row;
+    last->row.time = time;
+    telemetry->lastTime = time;
+    telemetry->lastCamera = row->camera;
+    telemetry->rows++;
+}
+
+void ptz_telemetry_flush(ptz_telemetry *telemetry) {
+    if (!telemetry->rows || !telemetry->map) {
+        return;
+    }
+    // Marked unwritten first, so a reader never takes the old block's header with the new block's columns.
+    block_header *header = block_at(telemetry->map, (uint32_t)(telemetry->sequence % telemetry->blockCount));
+    __atomic_store_n(&header->sequence, 0, __ATOMIC_RELEASE);
+    uint8_t *p = (uint8_t *)(header + 1);
+    for (int c = 0; c < PTZ_TELEMETRY_COLUMNS; c++) {
+        memcpy(p, telemetry->columns[c], telemetry->lengths[c]);
+        p += telemetry->lengths[c];
+        header->lengths[c] = telemetry->lengths[c];
+        telemetry->lengths[c] = 0;
+    }
+    header->magic = BLOCK_MAGIC;
+    header->rows = telemetry->rows;
+    header->firstTime = telemetry->firstTime;
+    header->lastTime = telemetry->lastTime;
+    __atomic_store_n(&header->sequence, telemetry->sequence, __ATOMIC_RELEASE);
+
+    telemetry->sequence++;
+    telemetry->rows = 0;
+    telemetry->used = 0;
+}
+
+void ptz_telemetry_close(ptz_telemetry *telemetry) {
+    ptz_telemetry_flush(telemetry);
+    if (telemetry->map) {
+        munmap(telemetry->map, telemetry->mapSize);
+    }
+    if (telemetry->fd != -1) {
+        close(telemetry->fd);
+    }
+    free(telemetry->columns[0]);
+    free(telemetry->last);
+    memset(telemetry, 0, sizeof(*telemetry));
+    telemetry->fd = -1;
+}
+
+#pragma mark Recording on a thread
+
+static void *recorder_thread(void *context) {
+    ptz_telemetry_recorder *recorder = context;
+    pthread_mutex_lock(&recorder->lock);
+    for (;;) {
+        if (recorder->queued) {
+            // Take the whole queue, leaving the one just recorded for the next batch.
+            ptz_telemetry_row *rows = recorder->queue;
+            size_t count = recorder->queued, capacity = recorder->capacity;
+            recorder->queue = recorder->spare;
+            recorder->capacity = recorder->spareCapacity;
+            recorder->queued = 0;
+            pthread_mutex_unlock(&recorder->lock);
+            for (size_t i = 0; i < count; i++) {
+                ptz_telemetry_record(&recorder->telemetry, &rows[i]);
+            }
+            pthread_mutex_lock(&recorder->lock);
+            recorder->spare = rows;
+            recorder->spareCapacity = capacity;
+        } else if (recorder->flushed != recorder->flushes) {
+            uint64_t asked = recorder->flushes;
+            pthread_mutex_unlock(&recorder->lock);
+            ptz_telemetry_flush(&recorder->telemetry);
+            pthread_mutex_lock(&recorder->lock);
+            recorder->flushed = asked;
+            pthread_cond_broadcast(&recorder->flushedChanged);
+        } else if (recorder->stopping) {
+            break;
+        } else {
+            pthread_cond_wait(&recorder->wake, &recorder->lock);
+        }
+    }
+    pthread_mutex_unlock(&recorder->lock);
+    return NULL;
+}
+
+int ptz_telemetry_recorder_open(ptz_telemetry_recorder *recorder, const char *path, uint64_t budget) {
+    memset(recorder, 0, sizeof(*recorder));
+    if (ptz_telemetry_open(&recorder->telemetry, path, budget) < 0) {
+        return -1;
+    }
+    pthread_mutex_init(&recorder->lock, NULL);
+    pthread_cond_init(&recorder->wake, NULL);
+    pthread_cond_init(&recorder->flushedChanged, NULL);
+    int error = pthread_create(&recorder->thread, NULL, recorder_thread, recorder);
+    if (error != 0) {
+        fprintf(stderr, "%s: can't start recording: %s\n", path, strerror(error));
+        pthread_cond_destroy(&recorder->flushedChanged);
+        pthread_cond_destroy(&recorder->wake);
+        pthread_mutex_destroy(&recorder->lock);
+        ptz_telemetry_close(&recorder->telemetry);
+        return -1;
+    }
+    return 0;
+}
+
+ptz_telemetry_row *ptz_telemetry_recorder_reserve(ptz_telemetry_recorder *recorder, size_t count) {
+    pthread_mutex_lock(&recorder->lock);
+    size_t needed = recorder->queued + count;
+    if (needed > PTZ_TELEMETRY_QUEUE_ROWS) {
+        recorder->dropped += count;
+        pthread_mutex_unlock(&recorder->lock);
+        return NULL;
+    }
+    if (needed > recorder->capacity) {
+        size_t grown = recorder->capacity ? recorder->capacity : 1024;
+        while (grown < needed) {
+            grown *= 2;
+        }
+        ptz_telemetry_row *more = realloc(recorder->queue, grown * sizeof(*more));
+        if (!more) {
+            recorder->dropped += count;
+            pthread_mutex_unlock(&recorder->lock);
+            return NULL;
+        }
+        recorder->queue = more;
+        recorder->capacity = grown;
+    }
+    return recorder->queue + recorder->queued;
+}
+
+void ptz_telemetry_recorder_commit(ptz_telemetry_recorder *recorder, size_t count) {
+    // Only a queue that was empty has a thread that might be waiting on it.
+    int wake = recorder->queued == 0 && count > 0;
+    recorder->queued += count;
+    pthread_mutex_unlock(&recorder->lock);
+    if (wake) {
+        pthread_cond_signal(&recorder->wake);
+    }
+}
+
+void ptz_telemetry_recorder_flush(ptz_telemetry_recorder *recorder) {
+    pthread_mutex_lock(&recorder->lock);
+    uint64_t ticket = ++recorder->flushes;
+    pthread_cond_signal(&recorder->wake);
+    while (recorder->flushed < ticket) {
+        pthread_cond_wait(&recorder->flushedChanged, &recorder->lock);
+    }
+    pthread_mutex_unlock(&recorder->lock);
+}
+
+void ptz_telemetry_recorder_close(ptz_telemetry_recorder *recorder) {
+    pthread_mutex_lock(&recorder->lock);
+    recorder->stopping = 1;
+    pthread_cond_signal(&recorder->wake);
+    pthread_mutex_unlock(&recorder->lock);
+    pthread_join(recorder->thread, NULL);
+    ptz_telemetry_close(&recorder->telemetry);
+    pthread_cond_destroy(&recorder->flushedChanged);
+    pthread_cond_destroy(&recorder->wake);
+    pthread_mutex_destroy(&recorder->lock);
+    free(recorder->queue);
+    free(recorder->spare);
+    recorder->queue = recorder->spare = NULL;
+    recorder->queued = recorder->capacity = recorder->spareCapacity = 0;
+}
+
+#pragma mark Reading
+
+typedef struct block_order {
+    uint64_t sequence;
+    uint32_t index;
+} block_order;
+
+static int compare_blocks(const void *a, const void *b) {
+    uint64_t x = ((const block_order *)a)->sequence;
+    uint64_t y = ((const block_order *)b)->sequence;
+    return (x > y) - (x < y);
+}
+
+// Decodes one block, copied out of the map first. Returns nonzero if `visit` asked to stop.
+static int read_block(const block_header *header, ptz_telemetry_last **last, int *lastCount,
+                      uint64_t from, uint64_t to, ptz_telemetry_visit visit, void *context) {
+    static _Thread_local uint8_t copy[PTZ_TELEMETRY_BLOCK];
+    uint64_t sequence = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+    memcpy(copy, header, sizeof(copy));
+    // Being rewritten while it was copied.
+    if (__atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE) != sequence) {
+        return 0;
+    }
+    const block_header *block = (const block_header *)copy;
+    column_reader columns[PTZ_TELEMETRY_COLUMNS];
+    const uint8_t *p = copy + sizeof(block_header);
+    for (int c = 0; c < PTZ_TELEMETRY_COLUMNS; c++) {
+        if (block->lengths[c] > (size_t)(copy + sizeof(copy) - p)) {
+            return 0;
+        }
+        columns[c] = (column_reader){ p, p + block->lengths[c] };
+        p += block->lengths[c];
+    }
+
+    uint64_t time = block->firstTime;
+    int64_t camera = 0;
+    for (uint32_t r = 0; r < block->rows; r++) {
+        uint64_t values[PTZ_TELEMETRY_COLUMNS];
+        for (int c = 0; c < PTZ_TELEMETRY_COLUMNS; c++) {
+            if (get(&columns[c], &values[c]) < 0) {
+                return 0;
+            }
+        }
+        time += values[PTZ_TELEMETRY_TIME];
+        camera += unzigzag(values[PTZ_TELEMETRY_CAMERA]);
+        if (camera < 0 || camera >= MAX_CAMERA || reserve_last(last, lastCount, (int32_t)camera) < 0) {
+            return 0;
+        }
+        ptz_telemetry_last *previous = &(*last)[camera];
+        if (previous->block != sequence) {
+            memset(&previous->row, 0, sizeof(previous->row));
+            previous->block = sequence;
+        }
+        ptz_telemetry_row *row = &previous->row;
+        row->time = time;
+        row->camera = (int32_t)camera;
+        row->pan += (int32_t)unzigzag(values[PTZ_TELEMETRY_PAN]);
+        row->tilt += (int32_t)unzigzag(values[PTZ_TELEMETRY_TILT]);
+        row->zoom += (int32_t)unzigzag(values[PTZ_TELEMETRY_ZOOM]);
+        row->focus += (int32_t)unzigzag(values[PTZ_TELEMETRY_FOCUS]);
+        row->command += (int32_t)unzigzag(values[PTZ_TELEMETRY_COMMAND]);
+        row->slot += (int32_t)unzigzag(values[PTZ_TELEMETRY_SLOT]);
+        if (time >= from && time <= to && visit(row, context)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int ptz_telemetry_read(const char *path, uint64_t from, uint64_t to, ptz_telemetry_visit visit, void *context) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    file_header file;
+    if (fstat(fd, &st) == -1 || pread(fd, &file, sizeof(file), 0) != sizeof(file) ||
+        memcmp(file.magic, file_magic, sizeof(file_magic)) != 0 || file.blockSize != PTZ_TELEMETRY_BLOCK ||
+        (uint64_t)st.st_size < HEADER_SIZE + (uint64_t)file.blockCount * PTZ_TELEMETRY_BLOCK) {
+        fprintf(stderr, "%s: not telemetry\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = HEADER_SIZE + (size_t)file.blockCount * PTZ_TELEMETRY_BLOCK;
+    uint8_t *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    block_order *order = malloc(file.blockCount * sizeof(*order));
+    if (!order) {
+        perror("ptz_telemetry_read");
+        munmap(map, size);
+        return -1;
+    }
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < file.blockCount; i++) {
+        const block_header *header = block_at(map, i);
+        uint64_t sequence = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+        if (header->magic == BLOCK_MAGIC && sequence != 0 && header->lastTime >= from && header->firstTime <= to) {
+            order[count++] = (block_order){ sequence, i };
+        }
+    }
+    qsort(order, count, sizeof(*order), compare_blocks);
+
+    ptz_telemetry_last *last = NULL;
+    int lastCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (read_block(block_at(map, order[i].index), &last, &lastCount, from, to, visit, context)) {
+            break;
+        }
+    }
+    free(last);
+    free(order);
+    munmap(map, size);
+    return 0;
+}
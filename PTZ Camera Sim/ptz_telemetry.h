@@ -0,0 +1,143 @@
+//
+//  ptz_telemetry.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Every step of every move, for working out what a controller really did: overshoot, hunting, how close
+//  a recall landed. A row is one camera's state after a step; cameras that didn't move that step get none.
+//
+//  The file is a ring of fixed-size blocks behind a header page, memory-mapped, so its size never goes past
+//  the budget it was opened with and the oldest block is the one that goes. A block holds its rows column by
+//  column; each column is a run of varints, each the difference from that camera's previous row in the
+//  block (zigzagged where it can go down), so a camera in the middle of a move costs a few bytes a step.
+//  Rows wait in memory until their block fills, or until ptz_telemetry_flush.
+//
+//  ptz_telemetry_recorder does the encoding on a thread of its own, so a recorder with a tick to get through
+//  only copies its rows into a queue.
+//
+
+#ifndef ptz_telemetry_h
+#define ptz_telemetry_h
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PTZ_TELEMETRY_BLOCK (64 * 1024)
+#define PTZ_TELEMETRY_NO_SLOT -1
+#define PTZ_TELEMETRY_QUEUE_ROWS (256 * 1024)   // How far a recorder's thread can fall behind before rows are dropped.
+
+typedef struct ptz_telemetry_row {
+    uint64_t time;              // Nanoseconds, on whatever clock the recorder uses; rows come in this order.
+    int32_t camera;
+    int32_t pan;
+    int32_t tilt;
+    int32_t zoom;
+    int32_t focus;
+    int32_t command;            // JR_VISCA_MESSAGE_ that set it moving, or 0.
+    int32_t slot;               // The preset it's recalling, or PTZ_TELEMETRY_NO_SLOT.
+} ptz_telemetry_row;
+
+enum {
+    PTZ_TELEMETRY_TIME,
+    PTZ_TELEMETRY_CAMERA,
+    PTZ_TELEMETRY_PAN,
+    PTZ_TELEMETRY_TILT,
+    PTZ_TELEMETRY_ZOOM,
+    PTZ_TELEMETRY_FOCUS,
+    PTZ_TELEMETRY_COMMAND,
+    PTZ_TELEMETRY_SLOT,
+    PTZ_TELEMETRY_COLUMNS
+};
+
+typedef struct ptz_telemetry_last ptz_telemetry_last;
+
+/**
+ * Not thread-safe; whoever records owns it.
+ */
+typedef struct ptz_telemetry {
+    int fd;
+    uint8_t *map;
+    size_t mapSize;
+    uint32_t blockCount;
+    uint64_t sequence;                              // The next block's.
+    uint32_t rows;                                  // Waiting for the next block.
+    uint64_t firstTime;
+    uint64_t lastTime;
+    int32_t lastCamera;
+    uint8_t *columns[PTZ_TELEMETRY_COLUMNS];        // Each as long as a block, so none can overflow first.
+    uint32_t lengths[PTZ_TELEMETRY_COLUMNS];
+    uint32_t used;
+    ptz_telemetry_last *last;                       // By camera: its previous row, and the block it was in.
+    int lastCount;
+} ptz_telemetry;
+
+/**
+ * Opens `path` for recording in no more than `budget` bytes, at least a header page and two blocks. A file
+ * already there with the same budget is carried on from; anything else there is replaced.
+ * Returns 0, or -1 after saying why with perror.
+ */
+int ptz_telemetry_open(ptz_telemetry *telemetry, const char *path, uint64_t budget);
+
+void ptz_telemetry_record(ptz_telemetry *telemetry, const ptz_telemetry_row *row);
+
+/**
+ * Writes whatever rows are waiting as a block of their own.
+ */
+void ptz_telemetry_flush(ptz_telemetry *telemetry);
+
+// Flushes and closes.
+void ptz_telemetry_close(ptz_telemetry *telemetry);
+
+/**
+ * Calls `visit` for each row in `path` from `from` to `to` inclusive, oldest first, until it returns
+ * nonzero. Safe while another process is recording; rows it hasn't flushed yet aren't there.
+ * Returns 0, or -1 if the file isn't there or isn't telemetry.
+ */
+typedef int (*ptz_telemetry_visit)(const ptz_telemetry_row *row, void *context);
+int ptz_telemetry_read(const char *path, uint64_t from, uint64_t to, ptz_telemetry_visit visit, void *context);
+
+/**
+ * A ptz_telemetry and the thread that records to it. Rows are queued a batch at a time: reserve room,
+ * fill it in, commit. Whoever queues them owns the recorder; the thread only ever takes the whole queue.
+ */
+typedef struct ptz_telemetry_recorder {
+    ptz_telemetry telemetry;                        // The thread's.
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;                            // For the thread: rows, a flush, or stopping.
+    pthread_cond_t flushedChanged;
+    ptz_telemetry_row *queue;
+    size_t queued;
+    size_t capacity;
+    ptz_telemetry_row *spare;                       // The queue the thread is recording from, swapped with queue.
+    size_t spareCapacity;
+    uint64_t flushes;                               // Asked for,
+    uint64_t flushed;                               // and done.
+    uint64_t dropped;                               // Rows that found the queue full.
+    int stopping;
+} ptz_telemetry_recorder;
+
+/**
+ * Opens `path` as ptz_telemetry_open does, and starts the thread.
+ * Returns 0, or -1 after saying why.
+ */
+int ptz_telemetry_recorder_open(ptz_telemetry_recorder *recorder, const char *path, uint64_t budget);
+
+/**
+ * Room at the end of the queue for `count` rows, with the recorder locked until ptz_telemetry_recorder_commit.
+ * NULL, with nothing locked and the rows counted as dropped, if that would put it past PTZ_TELEMETRY_QUEUE_ROWS.
+ */
+ptz_telemetry_row *ptz_telemetry_recorder_reserve(ptz_telemetry_recorder *recorder, size_t count);
+void ptz_telemetry_recorder_commit(ptz_telemetry_recorder *recorder, size_t count);
+
+/**
+ * Waits for everything queued so far to be recorded and flushed.
+ */
+void ptz_telemetry_recorder_flush(ptz_telemetry_recorder *recorder);
+
+// Records what's queued, stops the thread, and closes.
+void ptz_telemetry_recorder_close(ptz_telemetry_recorder *recorder);
+
+#endif /* ptz_telemetry_h */
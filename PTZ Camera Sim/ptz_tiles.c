@@ -0,0 +1,585 @@
+//
+//  ptz_tiles.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_tiles.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define PTZ_TILES_MAGIC "PTZTILE1"
+#define PTZ_TILES_BYTE_ORDER 0x01020304u
+#define PTZ_TILES_HEADER_SIZE 4096
+
+typedef struct ptz_tiles_header {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t tileSize;
+    uint32_t format;
+    uint32_t levelCount;
+    uint32_t tileCount;
+    uint32_t reserved;
+    uint64_t tableOffset;
+    uint64_t size;              // Of the whole file.
+    struct {
+        uint32_t width;
+        uint32_t height;
+    } levels[PTZ_PYRAMID_MAX_LEVELS];
+} ptz_tiles_header;
+
+// One per tile, levels in order, then rows top to bottom, then columns.
+typedef struct ptz_tiles_entry {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t reserved;
+} ptz_tiles_entry;
+
+_Static_assert(sizeof(ptz_tiles_header) <= PTZ_TILES_HEADER_SIZE, "tile header must fit in its page");
+
+static int ptz_tiles_layout(ptz_tiles *tiles, const ptz_tiles_header *header) {
+    int tileSize = (int)header->tileSize;
+    int first = 0;
+    for (uint32_t i = 0; i < header->levelCount; i++) {
+        ptz_tile_level *level = &tiles->levels[i];
+        level->width = (int)header->levels[i].width;
+        level->height = (int)header->levels[i].height;
+        if (level->width < 1 || level->height < 1) {
+            return -1;
+        }
+        level->columns = (level->width + tileSize - 1) / tileSize;
+        level->rows = (level->height + tileSize - 1) / tileSize;
+        level->firstTile = first;
+        first += level->columns * level->rows;
+        tiles->shape.levels[i].width = level->width;
+        tiles->shape.levels[i].height = level->height;
+    }
+    tiles->shape.levelCount = (int)header->levelCount;
+    return (uint32_t)first == header->tileCount ? 0 : -1;
+}
+
+static void ptz_tiles_reset_cache(ptz_tiles *tiles) {
+    for (int i = 0; i < tiles->slotCount; i++) {
+        tiles->slots[i].tile = -1;
+        tiles->slots[i].prev = i - 1;
+        tiles->slots[i].next = (i + 1 < tiles->slotCount) ? i + 1 : -1;
+    }
+    tiles->head = 0;
+    tiles->tail = tiles->slotCount - 1;
+    for (uint32_t i = 0; i <= tiles->lookupMask; i++) {
+        tiles->lookup[i] = -1;
+    }
+}
+
+int ptz_tiles_open(ptz_tiles *tiles, const char *path, int cacheTiles) {
+    memset(tiles, 0, sizeof(*tiles));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open tiles");
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < PTZ_TILES_HEADER_SIZE) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror("mmap tiles");
+        return -1;
+    }
+    tiles->mapping = mapping;
+    tiles->mappingSize = size;
+
+    const ptz_tiles_header *header = mapping;
+    if (   memcmp(header->magic, PTZ_TILES_MAGIC, sizeof(header->magic)) != 0
+        || header->byteOrder != PTZ_TILES_BYTE_ORDER
+        || header->size != size
+        || header->tileSize < 16 || header->tileSize > 4096 || (header->tileSize & 15) != 0
+        || header->levelCount < 1 || header->levelCount > PTZ_PYRAMID_MAX_LEVELS
+        || header->tableOffset > size
+        || (uint64_t)header->tileCount * sizeof(ptz_tiles_entry) > size - header->tableOffset
+        || ptz_tiles_layout(tiles, header) < 0) {
+        fprintf(stderr, "%s is not a tile container\n", path);
+        ptz_tiles_close(tiles);
+        return -1;
+    }
+    tiles->tileSize = (int)header->tileSize;
+    tiles->format = (int)header->format;
+    tiles->levelCount = (int)header->levelCount;
+    tiles->tileCount = (int)header->tileCount;
+    tiles->table = tiles->mapping + header->tableOffset;
+
+    tiles->slotCount = cacheTiles > 0 ? cacheTiles : PTZ_TILE_CACHE_DEFAULT;
+    uint32_t lookupSize = 16;
+    while (lookupSize < (uint32_t)tiles->slotCount * 2) {
+        lookupSize *= 2;
+    }
+    tiles->lookupMask = lookupSize - 1;
+    tiles->slots = calloc(tiles->slotCount, sizeof(ptz_tile_slot));
+    tiles->lookup = malloc(sizeof(int32_t) * lookupSize);
+    if (tiles->slots == NULL || tiles->lookup == NULL) {
+        ptz_tiles_close(tiles);
+        return -1;
+    }
+    ptz_tiles_reset_cache(tiles);
+    return 0;
+}
+
+void ptz_tiles_close(ptz_tiles *tiles) {
+    if (tiles->mapping != NULL) {
+        munmap((void *)tiles->mapping, tiles->mappingSize);
+    }
+    for (int i = 0; i < tiles->slotCount && tiles->slots != NULL; i++) {
+        ptz_image_free(&tiles->slots[i].image);
+    }
+    free(tiles->slots);
+    free(tiles->lookup);
+    ptz_image_free(&tiles->region);
+    memset(tiles, 0, sizeof(*tiles));
+}
+
+void ptz_tiles_set_decoder(ptz_tiles *tiles, ptz_tile_decoder decoder, void *context) {
+    tiles->decoder = decoder;
+    tiles->decoderContext = context;
+    // Anything decoded so far came from the old decoder.
+    if (tiles->slots != NULL) {
+        ptz_tiles_reset_cache(tiles);
+    }
+}
+
+#pragma mark - LRU cache
+
+static inline uint32_t ptz_tiles_hash(const ptz_tiles *tiles, int32_t tile) {
+    return ((uint32_t)tile * 2654435761u) & tiles->lookupMask;
+}
+
+static int32_t ptz_tiles_find(const ptz_tiles *tiles, int32_t tile, uint32_t *position) {
+    uint32_t i = ptz_tiles_hash(tiles, tile);
+    while (tiles->lookup[i] >= 0) {
+        if (tiles->slots[tiles->lookup[i]].tile == tile) {
+            *position = i;
+            return tiles->lookup[i];
+        }
+        i = (i + 1) & tiles->lookupMask;
+    }
+    *position = i;
+    return -1;
+}
+
+// Linear probing delete: pull later entries of the same run back into the hole so lookups never stop early.
+static void ptz_tiles_forget(ptz_tiles *tiles, int32_t tile) {
+    uint32_t hole;
+    if (ptz_tiles_find(tiles, tile, &hole) < 0) {
+        return;
+    }
+    tiles->lookup[hole] = -1;
+    uint32_t i = hole;
+    for (;;) {
+        i = (i + 1) & tiles->lookupMask;
+        int32_t slot = tiles->lookup[i];
+        if (slot < 0) {
+            return;
+        }
+        uint32_t home = ptz_tiles_hash(tiles, tiles->slots[slot].tile);
+        // Leave it if its home is cyclically in (hole, i].
+        int stays = (hole <= i) ? (home > hole && home <= i) : (home > hole || home <= i);
+        if (!stays) {
+            tiles->lookup[hole] = slot;
+            tiles->lookup[i] = -1;
+            hole = i;
+        }
+    }
+}
+
+static void ptz_tiles_touch(ptz_tiles *tiles, int32_t slot) {
+    if (tiles->head == slot) {
+        return;
+    }
+    ptz_tile_slot *s = &tiles->slots[slot];
+    tiles->slots[s->prev].next = s->next;
+    if (s->next >= 0) {
+        tiles->slots[s->next].prev = s->prev;
+    } else {
+        tiles->tail = s->prev;
+    }
+    s->prev = -1;
+    s->next = tiles->head;
+    tiles->slots[tiles->head].prev = slot;
+    tiles->head = slot;
+}
+
+const ptz_image *ptz_tiles_get(ptz_tiles *tiles, int level, int column, int row) {
+    if (level < 0 || level >= tiles->levelCount) {
+        return NULL;
+    }
+    const ptz_tile_level *info = &tiles->levels[level];
+    if (column < 0 || column >= info->columns || row < 0 || row >= info->rows) {
+        return NULL;
+    }
+    int32_t tile = info->firstTile + row * info->columns + column;
+    ptz_tiles_entry entry;
+    memcpy(&entry, (const ptz_tiles_entry *)tiles->table + tile, sizeof(entry));
+    if (entry.offset > tiles->mappingSize || entry.size > tiles->mappingSize - entry.offset) {
+        return NULL;
+    }
+    const uint8_t *data = tiles->mapping + entry.offset;
+    int tileSize = tiles->tileSize;
+
+    if (tiles->format == PTZ_TILE_FORMAT_RGBA) {
+        if (entry.size != (uint64_t)tileSize * tileSize * 4) {
+            return NULL;
+        }
+        // Already pixels: let the page cache do the caching.
+        tiles->view = (ptz_image){ .width = tileSize, .height = tileSize, .stride = tileSize * 4, .pixels = (uint8_t *)data };
+        return &tiles->view;
+    }
+    if (tiles->decoder == NULL) {
+        return NULL;
+    }
+    uint32_t position;
+    int32_t slot = ptz_tiles_find(tiles, tile, &position);
+    if (slot >= 0) {
+        ptz_tiles_touch(tiles, slot);
+        return &tiles->slots[slot].image;
+    }
+    slot = tiles->tail;
+    ptz_tile_slot *s = &tiles->slots[slot];
+    if (s->tile >= 0) {
+        ptz_tiles_forget(tiles, s->tile);
+        s->tile = -1;
+    }
+    if (   ptz_image_alloc(&s->image, tileSize, tileSize) < 0
+        || tiles->decoder(data, entry.size, &s->image, tiles->decoderContext) < 0) {
+        return NULL;
+    }
+    s->tile = tile;
+    // The eviction may have moved entries, so probe again for the free spot.
+    ptz_tiles_find(tiles, tile, &position);
+    tiles->lookup[position] = slot;
+    ptz_tiles_touch(tiles, slot);
+    return &s->image;
+}
+
+#pragma mark - Writing
+
+static void ptz_tiles_cut(const ptz_image *level, int column, int row, ptz_image *tile) {
+    int x0 = column * tile->width;
+    int y0 = row * tile->height;
+    int width = (x0 + tile->width <= level->width) ? tile->width : level->width - x0;
+    int height = (y0 + tile->height <= level->height) ? tile->height : level->height - y0;
+    for (int y = 0; y < tile->height; y++) {
+        uint8_t *out = ptz_image_row(tile, y);
+        if (y < height) {
+            memcpy(out, ptz_image_row(level, y0 + y) + x0 * 4, (size_t)width * 4);
+            memset(out + width * 4, 0, (size_t)(tile->width - width) * 4);
+        } else {
+            memset(out, 0, (size_t)tile->width * 4);
+        }
+    }
+}
+
+// Opens the temporary file and lays out the levels already in writer->levels; the tiles can then come in any order.
+static int ptz_tiles_begin(ptz_tiles_writer *writer, const char *path, int tileSize, int format,
+                           ptz_tile_encoder encoder, void *context) {
+    if (writer->levelCount < 1 || tileSize < 16 || tileSize > 4096 || (tileSize & 15) != 0) {
+        return -1;
+    }
+    writer->tileSize = tileSize;
+    writer->encoder = encoder;
+    writer->context = context;
+    writer->format = encoder == NULL ? PTZ_TILE_FORMAT_RGBA : format;
+    int first = 0;
+    for (int i = 0; i < writer->levelCount; i++) {
+        ptz_tile_level *level = &writer->levels[i];
+        level->columns = (level->width + tileSize - 1) / tileSize;
+        level->rows = (level->height + tileSize - 1) / tileSize;
+        level->firstTile = first;
+        first += level->columns * level->rows;
+    }
+    writer->tileCount = first;
+
+    if (   snprintf(writer->path, sizeof(writer->path), "%s", path) >= (int)sizeof(writer->path)
+        || snprintf(writer->tempPath, sizeof(writer->tempPath), "%s.%d.tmp", path, (int)getpid())
+           >= (int)sizeof(writer->tempPath)) {
+        fprintf(stderr, "Tile container path too long: %s\n", path);
+        return -1;
+    }
+    writer->table = calloc((size_t)writer->tileCount, sizeof(ptz_tiles_entry));
+    if (writer->table == NULL || ptz_image_alloc(&writer->tile, tileSize, tileSize) < 0) {
+        return -1;
+    }
+    writer->file = fopen(writer->tempPath, "wb");
+    if (writer->file == NULL) {
+        perror("open tiles");
+        return -1;
+    }
+    // Header and table go in last, once the offsets are known.
+    writer->offset = PTZ_TILES_HEADER_SIZE + (uint64_t)writer->tileCount * sizeof(ptz_tiles_entry);
+    if (fseeko(writer->file, (off_t)writer->offset, SEEK_SET) < 0) {
+        perror("write tiles");
+        return -1;
+    }
+    return 0;
+}
+
+// Cuts tile `column`, `row` of `level` out of `pixels`, which starts at the top of that row of tiles.
+static int ptz_tiles_put(ptz_tiles_writer *writer, int level, int column, int row, const ptz_image *pixels) {
+    ptz_image *tile = &writer->tile;
+    ptz_tiles_cut(pixels, column, 0, tile);
+    uint8_t *data = tile->pixels;
+    size_t size = (size_t)writer->tileSize * writer->tileSize * 4;
+    if (writer->encoder != NULL && writer->encoder(tile, &data, &size, writer->context) < 0) {
+        return -1;
+    }
+    size_t written = fwrite(data, 1, size, writer->file);
+    if (data != tile->pixels) {
+        free(data);
+    }
+    if (written != size || size > UINT32_MAX) {
+        perror("write tiles");
+        return -1;
+    }
+    const ptz_tile_level *info = &writer->levels[level];
+    ptz_tiles_entry *entry = (ptz_tiles_entry *)writer->table + info->firstTile + row * info->columns + column;
+    entry->offset = writer->offset;
+    entry->size = (uint32_t)size;
+    writer->offset += size;
+    return 0;
+}
+
+// Writes the header and table and renames the file into place if `result` is still 0, then frees everything.
+static int ptz_tiles_end(ptz_tiles_writer *writer, int result) {
+    int failed = result < 0;
+    if (writer->file != NULL) {
+        ptz_tiles_header header = { 0 };
+        memcpy(header.magic, PTZ_TILES_MAGIC, sizeof(header.magic));
+        header.byteOrder = PTZ_TILES_BYTE_ORDER;
+        header.tileSize = (uint32_t)writer->tileSize;
+        header.format = (uint32_t)writer->format;
+        header.levelCount = (uint32_t)writer->levelCount;
+        header.tileCount = (uint32_t)writer->tileCount;
+        header.tableOffset = PTZ_TILES_HEADER_SIZE;
+        header.size = writer->offset;
+        for (int i = 0; i < writer->levelCount; i++) {
+            header.levels[i].width = (uint32_t)writer->levels[i].width;
+            header.levels[i].height = (uint32_t)writer->levels[i].height;
+        }
+        uint8_t page[PTZ_TILES_HEADER_SIZE] = { 0 };
+        memcpy(page, &header, sizeof(header));
+        if (   result == 0
+            && (   fseeko(writer->file, 0, SEEK_SET) < 0
+                || fwrite(page, 1, sizeof(page), writer->file) != sizeof(page)
+                || fwrite(writer->table, sizeof(ptz_tiles_entry), (size_t)writer->tileCount, writer->file)
+                   != (size_t)writer->tileCount)) {
+            result = -1;
+        }
+        if (fclose(writer->file) != 0) {
+            result = -1;
+        }
+        if (result == 0 && rename(writer->tempPath, writer->path) < 0) {
+            result = -1;
+        }
+        // What failed before this has already said why.
+        if (result < 0 && !failed) {
+            perror("write tiles");
+        }
+        if (result < 0) {
+            unlink(writer->tempPath);
+        }
+    } else {
+        result = -1;
+    }
+    for (int i = 0; i < PTZ_PYRAMID_MAX_LEVELS; i++) {
+        ptz_image_free(&writer->strips[i]);
+    }
+    ptz_image_free(&writer->tile);
+    free(writer->table);
+    free(writer->downsampled);
+    memset(writer, 0, sizeof(*writer));
+    return result;
+}
+
+int ptz_tiles_write(const char *path, const ptz_pyramid *pyramid, int tileSize, int format, ptz_tile_encoder encoder, void *context) {
+    ptz_tiles_writer writer = { 0 };
+    writer.levelCount = pyramid->levelCount;
+    for (int i = 0; i < pyramid->levelCount; i++) {
+        writer.levels[i].width = pyramid->levels[i].width;
+        writer.levels[i].height = pyramid->levels[i].height;
+    }
+    if (ptz_tiles_begin(&writer, path, tileSize, format, encoder, context) < 0) {
+        return ptz_tiles_end(&writer, -1);
+    }
+    for (int i = 0; i < pyramid->levelCount; i++) {
+        const ptz_image *level = &pyramid->levels[i];
+        for (int row = 0; row < writer.levels[i].rows; row++) {
+            // The level from this row of tiles down, so each tile is cut from the top of it.
+            int top = row * tileSize;
+            ptz_image strip = { level->width, level->height - top, level->stride, ptz_image_row(level, top) };
+            for (int column = 0; column < writer.levels[i].columns; column++) {
+                if (ptz_tiles_put(&writer, i, column, row, &strip) < 0) {
+                    return ptz_tiles_end(&writer, -1);
+                }
+            }
+        }
+    }
+    return ptz_tiles_end(&writer, 0);
+}
+
+int ptz_tiles_writer_open(ptz_tiles_writer *writer, const char *path, int width, int height, int tileSize, int format,
+                          ptz_tile_encoder encoder, void *context) {
+    memset(writer, 0, sizeof(*writer));
+    if (width < 1 || height < 1) {
+        return -1;
+    }
+    writer->levelCount = ptz_pyramid_level_count(width, height);
+    for (int i = 0; i < writer->levelCount; i++) {
+        writer->levels[i].width = width;
+        writer->levels[i].height = height;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    if (ptz_tiles_begin(writer, path, tileSize, format, encoder, context) < 0) {
+        ptz_tiles_end(writer, -1);
+        return -1;
+    }
+    for (int i = 0; i < writer->levelCount; i++) {
+        if (ptz_image_alloc(&writer->strips[i], writer->levels[i].width, tileSize) < 0) {
+            ptz_tiles_end(writer, -1);
+            return -1;
+        }
+    }
+    writer->downsampled = malloc((size_t)writer->strips[0].stride);
+    if (writer->downsampled == NULL) {
+        ptz_tiles_end(writer, -1);
+        return -1;
+    }
+    return 0;
+}
+
+// Adds the next row of `level`, writing its strip out when that's full and passing rows down as they pair up.
+static int ptz_tiles_writer_add(ptz_tiles_writer *writer, int level, const uint8_t *pixels) {
+    const ptz_tile_level *info = &writer->levels[level];
+    ptz_image *strip = &writer->strips[level];
+    int y = writer->rowsIn[level]++;
+    if (y >= info->height) {
+        return -1;
+    }
+    int tileSize = writer->tileSize;
+    uint8_t *row = ptz_image_row(strip, y % tileSize);
+    memcpy(row, pixels, (size_t)info->width * 4);
+
+    // The row above is still in the strip: tileSize is even, so a pair never straddles two strips.
+    int last = y == info->height - 1;
+    if (level + 1 < writer->levelCount && ((y & 1) || last)) {
+        const uint8_t *top = (y & 1) ? row - strip->stride : row;
+        ptz_pyramid_downsample_row(top, row, writer->downsampled, info->width, writer->levels[level + 1].width);
+        if (ptz_tiles_writer_add(writer, level + 1, writer->downsampled) < 0) {
+            return -1;
+        }
+    }
+    if (y % tileSize == tileSize - 1 || last) {
+        ptz_image filled = { info->width, y % tileSize + 1, strip->stride, strip->pixels };
+        for (int column = 0; column < info->columns; column++) {
+            if (ptz_tiles_put(writer, level, column, y / tileSize, &filled) < 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int ptz_tiles_writer_add_row(ptz_tiles_writer *writer, const uint8_t *pixels) {
+    if (!writer->failed && ptz_tiles_writer_add(writer, 0, pixels) < 0) {
+        writer->failed = 1;
+    }
+    return writer->failed ? -1 : 0;
+}
+
+int ptz_tiles_writer_finish(ptz_tiles_writer *writer) {
+    int result = writer->failed ? -1 : 0;
+    for (int i = 0; i < writer->levelCount; i++) {
+        if (writer->rowsIn[i] != writer->levels[i].height) {
+            if (result == 0) {
+                fprintf(stderr, "%s: %d of %d rows\n", writer->path, writer->rowsIn[0], writer->levels[0].height);
+            }
+            result = -1;
+        }
+    }
+    return ptz_tiles_end(writer, result);
+}
+
+#pragma mark - Rendering
+
+// Stitches the `width` x `height` block at `x0`, `y0` of `level` into tiles->region, one tile at a time.
+static int ptz_tiles_copy_region(ptz_tiles *tiles, int level, int x0, int y0, int width, int height) {
+    if (ptz_image_alloc(&tiles->region, width, height) < 0) {
+        return -1;
+    }
+    const int tileSize = tiles->tileSize;
+    const int x1 = x0 + width;
+    const int y1 = y0 + height;
+    for (int row = y0 / tileSize; row <= (y1 - 1) / tileSize; row++) {
+        for (int column = x0 / tileSize; column <= (x1 - 1) / tileSize; column++) {
+            const ptz_image *tile = ptz_tiles_get(tiles, level, column, row);
+            if (tile == NULL) {
+                return -1;
+            }
+            int tx0 = column * tileSize > x0 ? column * tileSize : x0;
+            int tx1 = (column + 1) * tileSize < x1 ? (column + 1) * tileSize : x1;
+            int ty0 = row * tileSize > y0 ? row * tileSize : y0;
+            int ty1 = (row + 1) * tileSize < y1 ? (row + 1) * tileSize : y1;
+            for (int y = ty0; y < ty1; y++) {
+                memcpy(ptz_image_row(&tiles->region, y - y0) + (tx0 - x0) * 4,
+                       ptz_image_row(tile, y - row * tileSize) + (tx0 - column * tileSize) * 4,
+                       (size_t)(tx1 - tx0) * 4);
+            }
+        }
+    }
+    return 0;
+}
+
+int ptz_render_tiled_frame(ptz_renderer *renderer, ptz_tiles *tiles, const ptz_camera_state *state, ptz_image *dst) {
+    if (tiles->levelCount < 1 || dst->width < 1 || dst->height < 1) {
+        return -1;
+    }
+    const ptz_tile_level *base = &tiles->levels[0];
+    ptz_viewport viewport;
+    ptz_viewport_for_state(state, base->width, base->height, dst->width, dst->height, &viewport);
+    int level = ptz_pyramid_level_for_scale(&tiles->shape, viewport.width / dst->width);
+    const ptz_tile_level *info = &tiles->levels[level];
+    float scaleX = (float)info->width / base->width;
+    float scaleY = (float)info->height / base->height;
+    viewport.x *= scaleX;
+    viewport.width *= scaleX;
+    viewport.y *= scaleY;
+    viewport.height *= scaleY;
+
+    // Everything the bilinear filter can touch, with a pixel to spare on each side so the renderer's
+    // edge clamping only ever happens at the real edge of the scene.
+    int x0 = (int)floorf(viewport.x) - 1;
+    int y0 = (int)floorf(viewport.y) - 1;
+    int x1 = (int)ceilf(viewport.x + viewport.width) + 2;
+    int y1 = (int)ceilf(viewport.y + viewport.height) + 2;
+    x0 = x0 < 0 ? 0 : x0;
+    y0 = y0 < 0 ? 0 : y0;
+    x1 = x1 > info->width ? info->width : x1;
+    y1 = y1 > info->height ? info->height : y1;
+    if (x1 <= x0 || y1 <= y0 || ptz_tiles_copy_region(tiles, level, x0, y0, x1 - x0, y1 - y0) < 0) {
+        return -1;
+    }
+    viewport.x -= x0;
+    viewport.y -= y0;
+    return ptz_render_viewport(renderer, &tiles->region, &viewport, dst);
+}
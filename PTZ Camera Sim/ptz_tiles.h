@@ -0,0 +1,152 @@
+//
+//  ptz_tiles.h
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Tiled scene images for panoramas too big to decode whole. A container file holds every pyramid level
+//  cut into fixed-size tiles; rendering a frame only reads the tiles under the viewport, and decoded tiles
+//  live in a fixed-size LRU cache, so memory doesn't grow with the scene. ptz_tiles_writer makes one from a
+//  source a row at a time, for the same reason: the ptztiles tool converts images that won't fit in memory.
+//
+
+#ifndef ptz_tiles_h
+#define ptz_tiles_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "ptz_render.h"
+#include "ptz_pyramid.h"
+
+#define PTZ_TILE_SIZE_DEFAULT 256
+#define PTZ_TILE_CACHE_DEFAULT 256      // 64MB of 256x256 tiles; enough for two 1080p frames' worth.
+
+// Tile payload formats.
+#define PTZ_TILE_FORMAT_RGBA 0          // Rows of tileSize RGBA pixels. Read straight from the mapping, never cached.
+#define PTZ_TILE_FORMAT_JPEG 1          // Needs a decoder; see ptz_tiles_set_decoder.
+
+/**
+ * Decodes one tile's payload into `tile`, which is already allocated at tileSize x tileSize. Returns 0 or -1.
+ */
+typedef int (*ptz_tile_decoder)(const uint8_t *data, size_t size, ptz_image *tile, void *context);
+
+/**
+ * Encodes one tile for ptz_tiles_write. `*data` must come from malloc; the writer frees it. Returns 0 or -1.
+ */
+typedef int (*ptz_tile_encoder)(const ptz_image *tile, uint8_t **data, size_t *size, void *context);
+
+typedef struct ptz_tile_level {
+    int width;
+    int height;
+    int columns;
+    int rows;
+    int firstTile;          // Index of this level's top left tile in the container's tile table.
+} ptz_tile_level;
+
+typedef struct ptz_tile_slot {
+    int32_t tile;           // Tile table index, or -1 if empty.
+    int32_t prev;           // LRU list, most recently used first.
+    int32_t next;
+    ptz_image image;
+} ptz_tile_slot;
+
+/**
+ * An open container. Not thread-safe: the cache and scratch space are shared by every call.
+ */
+typedef struct ptz_tiles {
+    int tileSize;
+    int format;
+    int levelCount;
+    ptz_tile_level levels[PTZ_PYRAMID_MAX_LEVELS];
+    ptz_pyramid shape;      // The levels' sizes without their pixels, so picking one is ptz_pyramid's rule.
+    int tileCount;
+    const uint8_t *mapping;
+    size_t mappingSize;
+    const void *table;
+
+    ptz_tile_decoder decoder;
+    void *decoderContext;
+
+    ptz_tile_slot *slots;
+    int slotCount;
+    int32_t head;           // Most recently used slot.
+    int32_t tail;           // Next to be evicted.
+    int32_t *lookup;        // Open-addressed tile -> slot map, `lookupMask + 1` entries.
+    uint32_t lookupMask;
+
+    ptz_image view;         // What ptz_tiles_get returns for RGBA tiles.
+    ptz_image region;       // The tiles under the viewport, stitched together for the renderer.
+} ptz_tiles;
+
+/**
+ * Maps the container at `path` and sets up a cache of `cacheTiles` decoded tiles. Returns 0, or -1 if the file
+ * is missing or not a tile container.
+ */
+int ptz_tiles_open(ptz_tiles *tiles, const char *path, int cacheTiles);
+void ptz_tiles_close(ptz_tiles *tiles);
+
+void ptz_tiles_set_decoder(ptz_tiles *tiles, ptz_tile_decoder decoder, void *context);
+
+/**
+ * Writes every level of `pyramid` as `tileSize` tiles. With no encoder the tiles are PTZ_TILE_FORMAT_RGBA;
+ * otherwise `encoder` produces payloads of `format`. Returns 0 on success, -1 on failure.
+ */
+int ptz_tiles_write(const char *path, const ptz_pyramid *pyramid, int tileSize, int format, ptz_tile_encoder encoder, void *context);
+
+/**
+ * A container being written from the top row of the base image down. Only a strip of tileSize rows of
+ * each level is held; the smaller levels are built from it as the rows come in, as ptz_pyramid_build
+ * would build them.
+ */
+typedef struct ptz_tiles_writer {
+    FILE *file;
+    char path[1024];
+    char tempPath[1024];
+    int tileSize;
+    int format;
+    ptz_tile_encoder encoder;
+    void *context;
+    int levelCount;
+    ptz_tile_level levels[PTZ_PYRAMID_MAX_LEVELS];
+    int tileCount;
+    void *table;                                    // The tile table, filled in as tiles are written.
+    uint64_t offset;                                // Where the next tile goes.
+    ptz_image strips[PTZ_PYRAMID_MAX_LEVELS];       // The current strip of each level.
+    int rowsIn[PTZ_PYRAMID_MAX_LEVELS];             // Rows each level has had so far.
+    ptz_image tile;
+    uint8_t *downsampled;                           // One row of the next level down.
+    int failed;
+} ptz_tiles_writer;
+
+/**
+ * Starts a container at `path` for a `width` x `height` base image, as ptz_tiles_write would write its
+ * pyramid. Returns 0, or -1 if the file or its strips can't be made.
+ */
+int ptz_tiles_writer_open(ptz_tiles_writer *writer, const char *path, int width, int height, int tileSize, int format,
+                          ptz_tile_encoder encoder, void *context);
+
+/**
+ * The next row of the base image: `width` RGBA pixels. Returns 0, or -1 once anything has failed.
+ */
+int ptz_tiles_writer_add_row(ptz_tiles_writer *writer, const uint8_t *pixels);
+
+/**
+ * Writes the tile table and moves the container into place, or removes it if a row is missing or anything
+ * failed. Frees the writer either way. Returns 0 or -1.
+ */
+int ptz_tiles_writer_finish(ptz_tiles_writer *writer);
+
+/**
+ * One tile, decoding it into the cache if it isn't there already. The result is valid until the next call.
+ * Returns NULL if the tile is out of range or won't decode.
+ */
+const ptz_image *ptz_tiles_get(ptz_tiles *tiles, int level, int column, int row);
+
+/**
+ * ptz_render_pyramid_frame for a tiled scene: picks the level for the zoom and reads only the tiles the
+ * viewport overlaps. Returns 0 on success, -1 on failure.
+ */
+int ptz_render_tiled_frame(ptz_renderer *renderer, ptz_tiles *tiles, const ptz_camera_state *state, ptz_image *dst);
+
+#endif /* ptz_tiles_h */
@@ -0,0 +1,69 @@
+//
+//  ptzd.cpp
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The simulator as a daemon, for running controller tests where there's no Mac: no window, no video,
+//  just VISCA on a port per camera.
+//
+//      ptzd [config]
+//
+//  See ptz_config.h for the config file. It says which ports it took on stdout once it's listening, and
+//  stops cleanly on SIGINT or SIGTERM.
+//
+
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/resource.h>
+
+#include "ptz_server.hpp"
+
+static volatile std::sig_atomic_t stopping = 0;
+
+static void stop(int) {
+    stopping = 1;
+}
+
+int main(int argc, const char *argv[]) {
+    if (argc > 2 || (argc == 2 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))) {
+        fprintf(stderr, "usage: %s [config]\n", argv[0]);
+        return 2;
+    }
+    ptz_config config;
+    ptz_config_defaults(&config);
+    if (argc == 2 && ptz_config_load(&config, argv[1]) < 0) {
+        return 1;
+    }
+
+    // A port per camera and a socket per controller; that's past the usual 1024 for a big fleet.
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+    // A controller that hangs up mid-reply is a failed send, not the end of everyone else's cameras.
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction action = {};
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    ptz::server server(config);
+    if (server.start() < 0) {
+        return 1;
+    }
+    if (config.port) {
+        printf("ptzd: %d camera%s on ports %d-%d\n", server.cameras(), server.cameras() == 1 ? "" : "s",
+               server.port(0), server.port(server.cameras() - 1));
+    } else {
+        // The system picked them, so they're anywhere.
+        for (int camera = 0; camera < server.cameras(); camera++) {
+            printf("ptzd: camera %d on port %d\n", camera, server.port(camera));
+        }
+    }
+    fflush(stdout);
+    return server.run(stopping) < 0 ? 1 : 0;
+}
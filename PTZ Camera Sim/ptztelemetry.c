@@ -0,0 +1,118 @@
+//
+//  ptztelemetry.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Reads a telemetry file (ptz_telemetry.h) out as CSV, for a spreadsheet or a plotting script.
+//
+//      ptztelemetry [-c camera] [-f seconds] [-t seconds] [-s] file
+//
+//  Times are seconds from the first row still in the file; -f and -t pick a range of them, -c one camera.
+//  -s says what's in the file instead: how many rows, for how many cameras, over how long.
+//
+
+#include "ptz_telemetry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct export_context {
+    uint64_t start;
+    int camera;                 // -1 for all of them.
+    uint64_t rows;
+    uint64_t last;
+    uint8_t *cameras;           // For -s: each one that has a row.
+    int cameraCount;
+    int summary;
+} export_context;
+
+static int first_row(const ptz_telemetry_row *row, void *context) {
+    *(uint64_t *)context = row->time;
+    return 1;
+}
+
+static int export_row(const ptz_telemetry_row *row, void *context) {
+    export_context *export = context;
+    if (export->camera >= 0 && row->camera != export->camera) {
+        return 0;
+    }
+    export->rows++;
+    export->last = row->time;
+    if (export->summary) {
+        if (row->camera >= export->cameraCount) {
+            int count = row->camera + 1;
+            uint8_t *cameras = realloc(export->cameras, count);
+            if (!cameras) {
+                return 1;
+            }
+            memset(cameras + export->cameraCount, 0, count - export->cameraCount);
+            export->cameras = cameras;
+            export->cameraCount = count;
+        }
+        export->cameras[row->camera] = 1;
+        return 0;
+    }
+    printf("%.6f,%d,%d,%d,%d,%d,%d,%d\n", (row->time - export->start) / 1e9, row->camera, row->pan, row->tilt,
+           row->zoom, row->focus, row->command, row->slot);
+    return 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-c camera] [-f seconds] [-t seconds] [-s] file\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    export_context export = { 0 };
+    export.camera = -1;
+    double from = 0, to = -1;
+    int option;
+    while ((option = getopt(argc, argv, "c:f:t:s")) != -1) {
+        switch (option) {
+            case 'c':
+                export.camera = atoi(optarg);
+                break;
+            case 'f':
+                from = atof(optarg);
+                break;
+            case 't':
+                to = atof(optarg);
+                break;
+            case 's':
+                export.summary = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind != argc - 1 || from < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char *path = argv[optind];
+
+    if (ptz_telemetry_read(path, 0, UINT64_MAX, first_row, &export.start) < 0) {
+        return 1;
+    }
+    uint64_t fromTime = export.start + (uint64_t)(from * 1e9);
+    uint64_t toTime = to < 0 ? UINT64_MAX : export.start + (uint64_t)(to * 1e9);
+    if (!export.summary) {
+        printf("time,camera,pan,tilt,zoom,focus,command,slot\n");
+    }
+    if (ptz_telemetry_read(path, fromTime, toTime, export_row, &export) < 0) {
+        return 1;
+    }
+    if (export.summary) {
+        int cameras = 0;
+        for (int i = 0; i < export.cameraCount; i++) {
+            cameras += export.cameras[i];
+        }
+        printf("%llu rows, %d cameras, %.3f seconds\n", (unsigned long long)export.rows, cameras,
+               export.rows ? (export.last - export.start) / 1e9 : 0.0);
+    }
+    free(export.cameras);
+    return 0;
+}
@@ -0,0 +1,199 @@
+//
+//  ptztiles.c
+//  PTZ Camera Sim
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Makes a tile container (ptz_tiles.h) for a scene too big to decode whole. The source is read a row at a
+//  time, so memory is a strip of tiles per level however big the panorama is.
+//
+//      ptztiles [-s tile size] [-q jpeg quality] source.ppm container
+//
+//  The source is binary PPM (P6) or PAM (P7, RGB or RGB_ALPHA), 8 bits a channel; "-" reads it from stdin,
+//  so any converter that can write one can pipe a panorama straight in. Tiles are JPEG at -q, or raw RGBA
+//  with -q 0.
+//
+
+#include "ptz_jpeg.h"
+#include "ptz_tiles.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct source {
+    FILE *file;
+    int width;
+    int height;
+    int channels;               // 3 or 4.
+} source;
+
+// The next whitespace-separated word of a PPM header, skipping comments. Returns 0, or -1 at the end.
+static int header_word(FILE *file, char *word, size_t size) {
+    int c = fgetc(file);
+    for (;;) {
+        while (c != EOF && isspace(c)) {
+            c = fgetc(file);
+        }
+        if (c != '#') {
+            break;
+        }
+        while (c != EOF && c != '\n') {
+            c = fgetc(file);
+        }
+    }
+    size_t length = 0;
+    while (c != EOF && !isspace(c) && length + 1 < size) {
+        word[length++] = (char)c;
+        c = fgetc(file);
+    }
+    word[length] = '\0';
+    // The one whitespace character after the last word is the end of the header.
+    return length ? 0 : -1;
+}
+
+// After the magic: width, height and maxval.
+static int read_ppm_header(source *src) {
+    char width[32], height[32], maxval[32];
+    src->channels = 3;
+    if (   header_word(src->file, width, sizeof(width)) < 0 || header_word(src->file, height, sizeof(height)) < 0
+        || header_word(src->file, maxval, sizeof(maxval)) < 0) {
+        return -1;
+    }
+    src->width = atoi(width);
+    src->height = atoi(height);
+    return atoi(maxval) == 255 ? 0 : -1;
+}
+
+// After the magic: name and value lines up to ENDHDR.
+static int read_pam_header(source *src) {
+    char word[32];
+    int maxval = 0;
+    src->channels = 0;
+    for (;;) {
+        if (header_word(src->file, word, sizeof(word)) < 0) {
+            return -1;
+        }
+        if (strcmp(word, "ENDHDR") == 0) {
+            break;
+        }
+        char value[32];
+        if (header_word(src->file, value, sizeof(value)) < 0) {
+            return -1;
+        }
+        if (strcmp(word, "WIDTH") == 0) {
+            src->width = atoi(value);
+        } else if (strcmp(word, "HEIGHT") == 0) {
+            src->height = atoi(value);
+        } else if (strcmp(word, "DEPTH") == 0) {
+            src->channels = atoi(value);
+        } else if (strcmp(word, "MAXVAL") == 0) {
+            maxval = atoi(value);
+        }
+    }
+    return maxval == 255 && (src->channels == 3 || src->channels == 4) ? 0 : -1;
+}
+
+static int open_source(source *src, const char *path) {
+    memset(src, 0, sizeof(*src));
+    src->file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (src->file == NULL) {
+        perror(path);
+        return -1;
+    }
+    int p = fgetc(src->file);
+    int kind = fgetc(src->file);
+    int result = -1;
+    if (p == 'P' && kind == '6') {
+        result = read_ppm_header(src);
+    } else if (p == 'P' && kind == '7') {
+        result = read_pam_header(src);
+    }
+    if (result < 0 || src->width < 1 || src->height < 1) {
+        fprintf(stderr, "%s: not an 8-bit binary PPM or PAM\n", path);
+        if (src->file != stdin) {
+            fclose(src->file);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+static int encode_jpeg(const ptz_image *tile, uint8_t **data, size_t *size, void *context) {
+    ptz_jpeg_buffer buffer = { 0 };
+    if (ptz_jpeg_encode(context, tile, &buffer) < 0) {
+        ptz_jpeg_buffer_free(&buffer);
+        return -1;
+    }
+    // The writer frees it.
+    *data = buffer.data;
+    *size = buffer.size;
+    return 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-s tile size] [-q jpeg quality] source.ppm container\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int tileSize = PTZ_TILE_SIZE_DEFAULT;
+    int quality = PTZ_JPEG_QUALITY_SNAPSHOT;
+    int option;
+    while ((option = getopt(argc, argv, "s:q:")) != -1) {
+        switch (option) {
+            case 's':
+                tileSize = atoi(optarg);
+                break;
+            case 'q':
+                quality = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind != argc - 2 || quality < 0 || quality > 100) {
+        usage(argv[0]);
+        return 2;
+    }
+    source src;
+    if (open_source(&src, argv[optind]) < 0) {
+        return 1;
+    }
+    ptz_jpeg_tables tables;
+    ptz_jpeg_tables_init(&tables, quality ? quality : PTZ_JPEG_QUALITY_SNAPSHOT);
+    ptz_tiles_writer writer;
+    if (ptz_tiles_writer_open(&writer, argv[optind + 1], src.width, src.height, tileSize, PTZ_TILE_FORMAT_JPEG,
+                              quality ? encode_jpeg : NULL, &tables) < 0) {
+        fprintf(stderr, "%s: can't write a container with %d pixel tiles\n", argv[optind + 1], tileSize);
+        return 1;
+    }
+    size_t inSize = (size_t)src.width * src.channels;
+    uint8_t *in = malloc(inSize);
+    uint8_t *row = malloc((size_t)src.width * 4);
+    int result = in != NULL && row != NULL ? 0 : -1;
+    for (int y = 0; y < src.height && result == 0; y++) {
+        if (fread(in, 1, inSize, src.file) != inSize) {
+            fprintf(stderr, "%s: ends at row %d of %d\n", argv[optind], y, src.height);
+            result = -1;
+            break;
+        }
+        for (int x = 0; x < src.width; x++) {
+            memcpy(row + x * 4, in + x * src.channels, 3);
+            row[x * 4 + 3] = src.channels == 4 ? in[x * src.channels + 3] : 0xff;
+        }
+        result = ptz_tiles_writer_add_row(&writer, row);
+    }
+    // Finishing early leaves rows missing, which removes what was written.
+    if (ptz_tiles_writer_finish(&writer) < 0) {
+        result = -1;
+    }
+    free(in);
+    free(row);
+    if (src.file != stdin) {
+        fclose(src.file);
+    }
+    return result < 0 ? 1 : 0;
+}
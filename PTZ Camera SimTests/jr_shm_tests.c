@@ -0,0 +1,190 @@
+//
+//  jr_shm_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  jr_shm between two threads: the server on one, the controller on the other, talking through jr_socket
+//  like camera_handler.m does. Every wait here has to be ended by the other side's wake; if one isn't,
+//  the alarm fails the test instead of letting it hang.
+//
+
+#define _GNU_SOURCE
+
+#include "jr_shm.h"
+#include "jr_socket.h"
+#include "ptz_test.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+// More than the ring holds, so the sender has to wait for the receiver to make room, and the ring wraps.
+#define BULK_SIZE (JR_SHM_RING_SIZE * 16 + 123)
+
+static void pause_ms(int milliseconds) {
+    struct timespec delay = { milliseconds / 1000, (milliseconds % 1000) * 1000000L };
+    nanosleep(&delay, NULL);
+}
+
+// The camera's end: accepts, answers one command, soaks up the bulk transfer, then waits for the close.
+typedef struct camera_thread {
+    jr_shm_server server;
+    jr_socket socket;
+    int accepted;
+    long bulkReceived;
+    int bulkCorrupt;
+    int closedReceive;       // What receive returned once the controller had gone.
+    int sendAfterClose;
+} camera_thread;
+
+static void *run_camera(void *context) {
+    camera_thread *camera = context;
+    camera->accepted = jr_shm_accept(camera->server, &camera->socket) == 0;
+    if (!camera->accepted) {
+        return NULL;
+    }
+    // A CAM_PowerInq, then ACK and completion for the next command, byte by byte from the other end.
+    char command[5];
+    int length = 0;
+    while (length < 5) {
+        int count = jr_socket_receive(camera->socket, command + length, 5 - length);
+        if (count <= 0) {
+            return NULL;
+        }
+        length += count;
+    }
+    if (memcmp(command, "\x81\x09\x04\x00\xff", 5) == 0) {
+        jr_socket_send(camera->socket, "\x90\x50\x02\xff", 4);
+    }
+
+    char buffer[1000];
+    while (camera->bulkReceived < BULK_SIZE) {
+        int count = jr_socket_receive(camera->socket, buffer, sizeof(buffer));
+        if (count <= 0) {
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            camera->bulkCorrupt |= (uint8_t)buffer[i] != (uint8_t)((camera->bulkReceived + i) * 7);
+        }
+        camera->bulkReceived += count;
+        // Slower than the controller, so it fills the ring and has to be woken for more room.
+        if (camera->bulkReceived < JR_SHM_RING_SIZE * 2) {
+            pause_ms(1);
+        }
+    }
+    jr_socket_send(camera->socket, "\x90\x41\xff", 3);
+
+    // Then nothing until the controller hangs up, which has to wake this.
+    camera->closedReceive = jr_socket_receive(camera->socket, buffer, sizeof(buffer));
+    camera->sendAfterClose = jr_socket_send(camera->socket, "\x90\x51\xff", 3);
+    jr_socket_closeSocket(camera->socket);
+    return NULL;
+}
+
+static int receive_exactly(jr_socket socket, char *buffer, int length) {
+    int received = 0;
+    while (received < length) {
+        int count = jr_socket_receive(socket, buffer + received, length - received);
+        if (count <= 0) {
+            return -1;
+        }
+        received += count;
+    }
+    return 0;
+}
+
+// The whole conversation, with the controller connecting by `name`, or by fd for an anonymous segment.
+static void test_conversation(const char *name) {
+    camera_thread camera;
+    memset(&camera, 0, sizeof(camera));
+    CHECK(jr_shm_setupServer(name, &camera.server) == 0);
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_camera, &camera);
+
+    // Late, so the camera is already asleep in accept and connecting has to wake it.
+    pause_ms(20);
+    jr_socket controller;
+    CHECK(jr_shm_connect(name, name ? -1 : jr_shm_serverFD(camera.server), &controller) == 0);
+    // One controller per segment.
+    jr_socket second;
+    CHECK(jr_shm_connect(name, name ? -1 : jr_shm_serverFD(camera.server), &second) == -1);
+
+    // A round trip, sent in two pieces.
+    CHECK(jr_socket_send(controller, "\x81\x09", 2) == 0);
+    pause_ms(5);
+    CHECK(jr_socket_send(controller, "\x04\x00\xff", 3) == 0);
+    char reply[4];
+    CHECK(receive_exactly(controller, reply, 4) == 0);
+    CHECK(memcmp(reply, "\x90\x50\x02\xff", 4) == 0);
+
+    // Far more than the ring holds in one go.
+    char *bulk = malloc(BULK_SIZE);
+    for (int i = 0; i < BULK_SIZE; i++) {
+        bulk[i] = (char)(i * 7);
+    }
+    CHECK(jr_socket_send(controller, bulk, BULK_SIZE) == 0);
+    free(bulk);
+    CHECK(receive_exactly(controller, reply, 3) == 0);
+    CHECK(memcmp(reply, "\x90\x41\xff", 3) == 0);
+
+    // The camera is waiting for more; hanging up wakes it with an orderly 0, and its send fails.
+    pause_ms(20);
+    jr_socket_closeSocket(controller);
+    pthread_join(thread, NULL);
+    CHECK(camera.accepted);
+    CHECK(camera.bulkReceived == BULK_SIZE);
+    CHECK(!camera.bulkCorrupt);
+    CHECK(camera.closedReceive == 0);
+    CHECK(camera.sendAfterClose == -1);
+    jr_shm_closeServer(camera.server);
+
+    // And a name goes away with the server.
+    if (name != NULL) {
+        CHECK(shm_open(name, O_RDWR, 0) == -1);
+    }
+}
+
+// Whatever was sent before a close is still there to read; then receive says the connection is over.
+static void test_close_drains(void) {
+    jr_shm_server server;
+    CHECK(jr_shm_setupServer(NULL, &server) == 0);
+    jr_socket controller, camera;
+    CHECK(jr_shm_connect(NULL, jr_shm_serverFD(server), &controller) == 0);
+    CHECK(jr_shm_accept(server, &camera) == 0);
+    CHECK(jr_socket_send(controller, "\x81\x01\x04\x00\x02\xff", 6) == 0);
+    jr_socket_closeSocket(controller);
+    char buffer[16];
+    CHECK(jr_socket_receive(camera, buffer, sizeof(buffer)) == 6);
+    CHECK(memcmp(buffer, "\x81\x01\x04\x00\x02\xff", 6) == 0);
+    CHECK(jr_socket_receive(camera, buffer, sizeof(buffer)) == 0);
+    jr_socket_closeSocket(camera);
+    jr_shm_closeServer(server);
+}
+
+static void test_not_a_segment(void) {
+    // Too small to be one.
+    int fd = memfd_create("jr_shm_tests", 0);
+    CHECK(fd >= 0);
+    CHECK(ftruncate(fd, 64) == 0);
+    jr_socket socket;
+    CHECK(jr_shm_connect(NULL, fd, &socket) == -1);
+    close(fd);
+}
+
+int main(void) {
+    alarm(30);
+    char name[64];
+    snprintf(name, sizeof(name), "/jr_shm_tests-%d", (int)getpid());
+    test_conversation(NULL);
+    test_conversation(name);
+    test_close_drains();
+    test_not_a_segment();
+    return ptz_test_result();
+}
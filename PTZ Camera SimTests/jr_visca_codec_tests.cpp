@@ -0,0 +1,237 @@
+//
+//  jr_visca_codec_tests.cpp
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  jr_visca.hpp against jr_visca.c. For every definition in the C table there's a C++ type with the same id,
+//  signature and mask; and frames made from that signature with random parameter bits decode to the same
+//  message and the same fields both ways, then encode back to the same bytes both ways.
+//
+
+extern "C" {
+#include "jr_visca.h"
+}
+#include "jr_visca.hpp"
+#include "ptz_test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+// jr_visca.c's table, which it doesn't export a type for; this has to match its jr_viscaMessageDefinition.
+struct c_definition {
+    uint8_t signature[JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH - 2];
+    uint8_t signatureMask[JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH - 2];
+    int signatureLength;
+    int commandType;
+    void (*handleParameters)(void *frame, union jr_viscaMessageParameters *messageParameters, bool isDecodingFrame);
+};
+extern "C" c_definition definitions[];
+
+#pragma mark Fields
+
+// Whether the C++ message `m` and the C parameters `p` say the same thing, one shape at a time.
+
+template <class M>
+    requires (std::tuple_size_v<decltype(M::fields())> == 0)
+static bool same(const M &, const jr_viscaMessageParameters &) { return true; }
+
+template <int Id, uint8_t Category, uint8_t Command>
+static bool same(const jr_visca::byte_command<Id, Category, Command> &m, const jr_viscaMessageParameters &p) {
+    return m.value == p.oneByteParameters.byteValue;
+}
+
+template <int Id, uint8_t Command, uint8_t Subcommand>
+static bool same(const jr_visca::nibble_command<Id, Command, Subcommand> &m, const jr_viscaMessageParameters &p) {
+    return m.value == p.oneByteParameters.byteValue;
+}
+
+template <int Id, uint8_t Command>
+static bool same(const jr_visca::pq_command<Id, Command> &m, const jr_viscaMessageParameters &p) {
+    return m.value == p.int16Parameters.int16Value;
+}
+
+template <int Id, uint8_t Command>
+static bool same(const jr_visca::pqrs_command<Id, Command> &m, const jr_viscaMessageParameters &p) {
+    return m.value == p.int16Parameters.int16Value;
+}
+
+template <int Id, uint8_t Command>
+static bool same(const jr_visca::pan_tilt_position<Id, Command> &m, const jr_viscaMessageParameters &p) {
+    const auto &c = p.absolutePanTiltPositionParameters;
+    return m.panSpeed == c.panSpeed && m.tiltSpeed == c.tiltSpeed && m.panPosition == c.panPosition
+        && m.tiltPosition == c.tiltPosition;
+}
+
+static bool same(const jr_visca::one_byte_response &m, const jr_viscaMessageParameters &p) {
+    return m.value == p.oneByteParameters.byteValue;
+}
+
+static bool same(const jr_visca::p_response &m, const jr_viscaMessageParameters &p) {
+    return m.value == p.oneByteParameters.byteValue;
+}
+
+static bool same(const jr_visca::pqrs_response &m, const jr_viscaMessageParameters &p) {
+    return m.value == p.int16Parameters.int16Value;
+}
+
+static bool same(const jr_visca::pq_response &m, const jr_viscaMessageParameters &p) {
+    return m.value == p.int16Parameters.int16Value;
+}
+
+static bool same(const jr_visca::pan_tilt_position_response &m, const jr_viscaMessageParameters &p) {
+    const auto &c = p.panTiltPositionInqResponseParameters;
+    return m.panPosition == c.panPosition && m.tiltPosition == c.tiltPosition;
+}
+
+template <int Id, uint8_t Reply>
+static bool same(const jr_visca::socket_reply<Id, Reply> &m, const jr_viscaMessageParameters &p) {
+    return m.socketNumber == p.ackCompletionParameters.socketNumber;
+}
+
+static bool same(const jr_visca::cancel &m, const jr_viscaMessageParameters &p) {
+    return m.socketNumber == p.ackCompletionParameters.socketNumber;
+}
+
+static bool same(const jr_visca::error_reply &m, const jr_viscaMessageParameters &p) {
+    return m.socketNumber == p.errorReplyParameters.socketNumber && m.errorType == p.errorReplyParameters.errorType;
+}
+
+static bool same(const jr_visca::pan_tilt_drive &m, const jr_viscaMessageParameters &p) {
+    const auto &c = p.panTiltDriveParameters;
+    return m.panSpeed == c.panSpeed && m.tiltSpeed == c.tiltSpeed && m.panDirection == c.panDirection
+        && m.tiltDirection == c.tiltDirection;
+}
+
+static bool same(const jr_visca::camera_number &m, const jr_viscaMessageParameters &p) {
+    return m.cameraNum == p.cameraNumberParameters.cameraNum;
+}
+
+static bool same(const jr_visca::memory &m, const jr_viscaMessageParameters &p) {
+    return m.memory == p.memoryParameters.memory && m.mode == p.memoryParameters.mode;
+}
+
+static bool same(const jr_visca::notify_subscribe &m, const jr_viscaMessageParameters &p) {
+    return m.rate == p.int16Parameters.int16Value;
+}
+
+static bool same(const jr_visca::pan_tilt_notify &m, const jr_viscaMessageParameters &p) {
+    const auto &c = p.panTiltPositionInqResponseParameters;
+    return m.first == c.panPosition && m.second == c.tiltPosition;
+}
+
+static bool same(const jr_visca::lens_notify &m, const jr_viscaMessageParameters &p) {
+    const auto &c = p.lensNotifyParameters;
+    return m.first == c.zoomPosition && m.second == c.focusPosition;
+}
+
+#pragma mark Tables
+
+// The C++ type with `id`'s signature and mask, if there is one.
+struct cpp_signature {
+    int size = 0;
+    const uint8_t *bytes = nullptr;
+    const uint8_t *mask = nullptr;
+};
+
+template <class... Messages>
+static cpp_signature find(jr_visca::message_list<Messages...>, int id) {
+    cpp_signature result;
+    (void)((Messages::id == id && (result = {int(Messages::sig.size), Messages::sig.bytes.data(), Messages::sig.mask.data()},
+                                   true)) || ...);
+    return result;
+}
+
+template <class... Messages>
+static constexpr int count(jr_visca::message_list<Messages...>) { return sizeof...(Messages); }
+
+static void test_tables() {
+    int definitionCount = 0;
+    for (const c_definition *d = definitions; d->signatureLength; d++, definitionCount++) {
+        cpp_signature sig = find(jr_visca::messages{}, d->commandType);
+        if (sig.size == 0) {
+            fprintf(stderr, "no C++ type for message %d\n", d->commandType);
+            failures++;
+            continue;
+        }
+        CHECK(sig.size == d->signatureLength);
+        if (sig.size == d->signatureLength) {
+            CHECK(memcmp(sig.bytes, d->signature, sig.size) == 0);
+            CHECK(memcmp(sig.mask, d->signatureMask, sig.size) == 0);
+        }
+    }
+    // And nothing in C++ that isn't in C.
+    CHECK(definitionCount == count(jr_visca::messages{}));
+}
+
+#pragma mark Round trips
+
+static void round_trip(const c_definition &d, std::mt19937 &random) {
+    uint8_t data[JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH];
+    int length = d.signatureLength + 2;
+    uint8_t sender, receiver;
+    do {
+        sender = random() % 8;
+        receiver = random() % 16;
+    } while (sender == 7 && receiver == 0x0f);      // 0xff would be a terminator.
+    data[0] = uint8_t(0x80 | (sender << 4) | receiver);
+    for (int i = 0; i < d.signatureLength; i++) {
+        // Anything in the parameter bits but the terminator.
+        uint8_t byte;
+        do {
+            byte = uint8_t((random() & ~d.signatureMask[i]) | d.signature[i]);
+        } while (byte == 0xff);
+        data[1 + i] = byte;
+    }
+    data[length - 1] = 0xff;
+
+    int cType;
+    jr_viscaMessageParameters cParameters;
+    memset(&cParameters, 0, sizeof(cParameters));
+    uint8_t cSender, cReceiver;
+    CHECK(jr_viscaDecodeMessage(data, length, &cType, &cParameters, &cSender, &cReceiver) == length);
+
+    jr_visca::frame frame;
+    CHECK(jr_visca::split_frame(std::span<const uint8_t>(data, length), frame) == length);
+    CHECK(frame.sender == cSender && frame.receiver == cReceiver);
+
+    bool fields = false;
+    uint8_t cppData[JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH];
+    int cppLength = -1;
+    int cppType = jr_visca::messages::dispatch(frame.body, [&](const auto &message) {
+        fields = same(message, cParameters);
+        cppLength = jr_visca::encode(message, frame.sender, frame.receiver, std::span<uint8_t>(cppData));
+    });
+    // An earlier definition can take the frame, but it has to be the same one both ways.
+    CHECK(cppType == cType);
+    if (cppType != cType || !fields) {
+        fprintf(stderr, "message %d:", d.commandType);
+        for (int i = 0; i < length; i++) {
+            fprintf(stderr, " %02x", data[i]);
+        }
+        fprintf(stderr, " decodes as %d in C, %d in C++\n", cType, cppType);
+    }
+    CHECK(fields);
+
+    uint8_t cData[JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH];
+    int cLength = jr_viscaEncodeMessage(cData, sizeof(cData), cType, cParameters, cSender, cReceiver);
+    CHECK(cLength == cppLength);
+    CHECK(cLength > 0 && cLength == cppLength && memcmp(cData, cppData, cLength) == 0);
+}
+
+static void test_round_trips() {
+    std::mt19937 random(42);
+    for (const c_definition *d = definitions; d->signatureLength; d++) {
+        int before = failures;
+        for (int i = 0; i < 2000 && failures == before; i++) {
+            round_trip(*d, random);
+        }
+    }
+}
+
+int main() {
+    test_tables();
+    test_round_trips();
+    return ptz_test_result();
+}
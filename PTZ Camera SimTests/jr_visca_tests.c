@@ -0,0 +1,53 @@
+//
+//  jr_visca_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "jr_visca.h"
+#include "ptz_test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// The bytes camera_handler.m's sendMessage puts on the wire for an Address Set reply naming `next`.
+static int address_set_reply(uint8_t *data, uint8_t next) {
+    union jr_viscaMessageParameters parameters;
+    parameters.cameraNumberParameters.cameraNum = next;
+    return jr_viscaEncodeMessage(data, JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH, JR_VISCA_MESSAGE_CAMERA_NUMBER,
+                                 parameters, 0, 8);
+}
+
+static void test_address_set(void) {
+    // A controller starts the chain at 1.
+    uint8_t request[] = { 0x88, 0x30, 0x01, 0xff };
+    int messageType;
+    union jr_viscaMessageParameters parameters;
+    uint8_t sender, receiver;
+    CHECK(jr_viscaDecodeMessage(request, sizeof(request), &messageType, &parameters, &sender, &receiver) == 4);
+    CHECK(messageType == JR_VISCA_MESSAGE_CAMERA_NUMBER);
+    CHECK(parameters.cameraNumberParameters.cameraNum == 1);
+    CHECK(sender == 0 && receiver == 8);
+
+    // Or further along, when something ahead of us in the chain has taken some.
+    uint8_t later[] = { 0x88, 0x30, 0x05, 0xff };
+    CHECK(jr_viscaDecodeMessage(later, sizeof(later), &messageType, &parameters, &sender, &receiver) == 4);
+    CHECK(messageType == JR_VISCA_MESSAGE_CAMERA_NUMBER);
+    CHECK(parameters.cameraNumberParameters.cameraNum == 5);
+
+    // A single camera takes 1 and passes on 2; three of them pass on 4.
+    uint8_t data[JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH];
+    CHECK(address_set_reply(data, 1 + 1) == 4);
+    CHECK(memcmp(data, (uint8_t[]){ 0x88, 0x30, 0x02, 0xff }, 4) == 0);
+    CHECK(address_set_reply(data, 1 + 3) == 4);
+    CHECK(memcmp(data, (uint8_t[]){ 0x88, 0x30, 0x04, 0xff }, 4) == 0);
+    // A full chain passes on 8.
+    CHECK(address_set_reply(data, 8) == 4);
+    CHECK(memcmp(data, (uint8_t[]){ 0x88, 0x30, 0x08, 0xff }, 4) == 0);
+}
+
+int main(void) {
+    test_address_set();
+    return ptz_test_result();
+}
@@ -0,0 +1,276 @@
+//
+//  ptz_3a_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Autofocus, auto exposure and auto white balance, run the way AppDelegate's timers run them against a
+//  synthetic scene, until they settle. Settling is not enough: where they settle has to be right.
+//
+
+#include "ptz_3a.h"
+#include "ptz_af.h"
+#include "ptz_color.h"
+#include "ptz_effects.h"
+#include "ptz_pyramid.h"
+#include "ptz_test.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Lens positions closer to the subject than this have a blur radius of 0, so they all measure the same.
+#define DEPTH_OF_FIELD (PTZ_FOCUS_MAX / 20)
+
+#define MAX_3A_TICKS 100
+
+static void default_state(ptz_camera_state *state) {
+    memset(state, 0, sizeof(*state));
+    state->autofocus = 1;
+    state->wbMode = PTZ_WB_MODE_AUTO;
+    state->aeMode = PTZ_AE_MODE_FULL_AUTO;
+    state->aperture = PTZ_APERTURE_DEFAULT;
+    state->shutter = PTZ_SHUTTER_DEFAULT;
+    state->iris = PTZ_IRIS_DEFAULT;
+    state->brightPos = PTZ_BRIGHT_DEFAULT;
+    state->brightness = PTZ_BRIGHTNESS_DEFAULT;
+    state->contrast = PTZ_CONTRAST_DEFAULT;
+    state->rGain = PTZ_RGAIN_DEFAULT;
+    state->bGain = PTZ_BGAIN_DEFAULT;
+    state->colorgain = PTZ_COLOR_GAIN_DEFAULT;
+    state->hue = PTZ_HUE_DEFAULT;
+}
+
+// Detail at every scale, in `tint` around a mean of `level`.
+static int build_scene(ptz_pyramid *pyramid, int level, const float tint[3]) {
+    ptz_image base = { 0 };
+    if (ptz_image_alloc(&base, 1280, 720) < 0) {
+        return -1;
+    }
+    uint32_t grain = 7;
+    for (int y = 0; y < base.height; y++) {
+        uint8_t *row = ptz_image_row(&base, y);
+        for (int x = 0; x < base.width; x++) {
+            grain = grain * 1103515245 + 12345;
+            float detail = 0.5f * sinf(x * 0.9f) * cosf(y * 0.7f) + 0.3f * sinf(x * 0.05f + y * 0.03f)
+                         + 0.2f * (((grain >> 16) & 0xff) / 127.5f - 1);
+            for (int c = 0; c < 3; c++) {
+                float v = level * tint[c] * (1 + 0.4f * detail);
+                row[x * 4 + c] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+            }
+            row[x * 4 + 3] = 0xff;
+        }
+    }
+    int result = ptz_pyramid_build(pyramid, &base);
+    ptz_image_free(&base);
+    return result;
+}
+
+#pragma mark Autofocus
+
+// AppDelegate's autofocusTick, to completion. Returns where the lens ended up.
+static int run_autofocus(const ptz_pyramid *pyramid, ptz_camera_state *state) {
+    ptz_af_probe probe;
+    ptz_af_probe_init(&probe);
+    ptz_af af;
+    memset(&af, 0, sizeof(af));
+    ptz_af_start(&af, state->focus);
+    int ticks = 0;
+    while (af.searching && ticks++ <= PTZ_AF_MAX_TICKS) {
+        float score = ptz_af_measure(&probe, pyramid, state, (uint32_t)af.position);
+        CHECK(score >= 0);
+        state->focus = ptz_af_step(&af, score);
+    }
+    CHECK(!af.searching);
+    CHECK(ticks <= PTZ_AF_MAX_TICKS);
+    ptz_af_probe_destroy(&probe);
+    return (int)state->focus;
+}
+
+static void test_autofocus(const ptz_pyramid *pyramid) {
+    const struct {
+        int32_t tilt;
+        uint32_t zoom;
+        uint32_t focus;
+    } cases[] = {
+        { 0, 0, 0 },                            // Wide, from the near end stop.
+        { 0, 0, PTZ_FOCUS_MAX },                // And the far one.
+        { 0x80, 0x80, 0x20 },                   // Zoomed in and tilted up: the subject is further off.
+        { -0x100, 0xC0, 0xE0 },
+        { 0, 0x40, 0x30 + 0x40 * 0x90 / 0x100 },  // Already there.
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        ptz_camera_state state;
+        default_state(&state);
+        state.tilt = cases[i].tilt;
+        state.zoom = cases[i].zoom;
+        state.focus = cases[i].focus;
+        int subject = (int)ptz_af_subject_focus(&state);
+        int focus = run_autofocus(pyramid, &state);
+        if (abs(focus - subject) > DEPTH_OF_FIELD) {
+            fprintf(stderr, "autofocus %zu: %#x for a subject at %#x\n", i, focus, subject);
+        }
+        CHECK(abs(focus - subject) <= DEPTH_OF_FIELD);
+
+        // And the picture it settled on has no blur.
+        ptz_effects effects;
+        ptz_effects_for_state(&state, NULL, &effects);
+        CHECK(effects.blurRadius == 0);
+    }
+}
+
+#pragma mark Exposure and white balance
+
+// Runs AppDelegate's autoExposureTick until nothing changes, and returns how many ticks that took.
+static int run_3a(ptz_renderer *renderer, const ptz_pyramid *pyramid, ptz_camera_state *state) {
+    ptz_image frame = { 0 };
+    int ticks = 0;
+    for (; ticks < MAX_3A_TICKS; ticks++) {
+        CHECK(ptz_image_alloc(&frame, PTZ_3A_FRAME_WIDTH, PTZ_3A_FRAME_HEIGHT) == 0);
+        CHECK(ptz_render_pyramid_frame(renderer, pyramid, state, &frame) == 0);
+        ptz_3a_stats stats;
+        ptz_3a_stats_compute(&frame, &stats);
+        ptz_3a_settings settings;
+        if (ptz_3a_update(&stats, state, &settings) == 0) {
+            break;
+        }
+        state->iris = settings.iris;
+        state->shutter = settings.shutter;
+        state->rGain = settings.rGain;
+        state->bGain = settings.bGain;
+    }
+    ptz_image_free(&frame);
+    return ticks;
+}
+
+// The picture as the camera would put it out: color and exposure applied, measured the way ptz_3a measures.
+static void output_stats(ptz_renderer *renderer, const ptz_pyramid *pyramid, const ptz_camera_state *state,
+                         ptz_3a_stats *stats) {
+    ptz_image frame = { 0 }, output = { 0 };
+    CHECK(ptz_image_alloc(&frame, PTZ_3A_FRAME_WIDTH, PTZ_3A_FRAME_HEIGHT) == 0);
+    CHECK(ptz_render_pyramid_frame(renderer, pyramid, state, &frame) == 0);
+    ptz_color_lut *lut = malloc(sizeof(*lut));
+    ptz_color_lut_init(lut);
+    ptz_effects effects;
+    ptz_effects_for_state(state, lut, &effects);
+    effects.blurRadius = 0;
+    CHECK(ptz_render_effects(renderer, &frame, &effects, &output) == 0);
+    ptz_3a_stats_compute(&output, stats);
+    free(lut);
+    ptz_image_free(&output);
+    ptz_image_free(&frame);
+}
+
+static float exposure_stops(const ptz_camera_state *state) {
+    ptz_color_params params;
+    ptz_color_params_for_state(state, &params);
+    return ptz_color_exposure_stops(&params);
+}
+
+static void test_auto_exposure(ptz_renderer *renderer) {
+    const float neutral[3] = { 1, 1, 1 };
+    const struct {
+        int level;
+        uint32_t aeMode;
+        float direction;        // Which way exposure has to go.
+    } cases[] = {
+        { 40, PTZ_AE_MODE_FULL_AUTO, 1 },           // Dim room.
+        { 200, PTZ_AE_MODE_FULL_AUTO, -1 },         // Bright window.
+        { 50, PTZ_AE_MODE_SHUTTER_PRIORITY, 1 },    // Only the iris moves.
+        { 180, PTZ_AE_MODE_IRIS_PRIORITY, -1 },     // Only the shutter moves.
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        ptz_pyramid pyramid;
+        memset(&pyramid, 0, sizeof(pyramid));
+        CHECK(build_scene(&pyramid, cases[i].level, neutral) == 0);
+        ptz_camera_state state;
+        default_state(&state);
+        state.wbMode = PTZ_WB_MODE_ONE_PUSH;
+        state.aeMode = cases[i].aeMode;
+
+        ptz_3a_stats before;
+        output_stats(renderer, &pyramid, &state, &before);
+        int ticks = run_3a(renderer, &pyramid, &state);
+        CHECK(ticks > 0 && ticks < MAX_3A_TICKS);
+        CHECK(exposure_stops(&state) * cases[i].direction > 0.5f);
+        if (cases[i].aeMode == PTZ_AE_MODE_SHUTTER_PRIORITY) {
+            CHECK(state.shutter == PTZ_SHUTTER_DEFAULT);
+        }
+        if (cases[i].aeMode == PTZ_AE_MODE_IRIS_PRIORITY) {
+            CHECK(state.iris == PTZ_IRIS_DEFAULT);
+        }
+
+        // Where it stopped, the picture is about mid gray, and a lot closer to it than where it started.
+        ptz_3a_stats after;
+        output_stats(renderer, &pyramid, &state, &after);
+        float error = fabsf(log2f(after.luma / PTZ_3A_TARGET_LUMA));
+        if (error > 0.5f) {
+            fprintf(stderr, "exposure %zu settled at luma %.3f, %.2f stops\n", i, after.luma, exposure_stops(&state));
+        }
+        CHECK(error <= 0.5f);
+        CHECK(error < fabsf(log2f(before.luma / PTZ_3A_TARGET_LUMA)));
+        ptz_pyramid_free(&pyramid);
+    }
+
+    // Manual exposure is left alone.
+    ptz_pyramid pyramid;
+    memset(&pyramid, 0, sizeof(pyramid));
+    CHECK(build_scene(&pyramid, 40, neutral) == 0);
+    ptz_camera_state state;
+    default_state(&state);
+    state.wbMode = PTZ_WB_MODE_MANUAL;
+    state.aeMode = PTZ_AE_MODE_MANUAL;
+    CHECK(!ptz_3a_is_active(&state));
+    CHECK(run_3a(renderer, &pyramid, &state) == 0);
+    CHECK(state.iris == PTZ_IRIS_DEFAULT && state.shutter == PTZ_SHUTTER_DEFAULT);
+    ptz_pyramid_free(&pyramid);
+}
+
+static void test_auto_white_balance(ptz_renderer *renderer) {
+    // Tungsten: too much red, not enough blue.
+    const float warm[3] = { 1.25f, 1.0f, 0.7f };
+    ptz_pyramid pyramid;
+    memset(&pyramid, 0, sizeof(pyramid));
+    CHECK(build_scene(&pyramid, 110, warm) == 0);
+    ptz_camera_state state;
+    default_state(&state);
+    state.aeMode = PTZ_AE_MODE_MANUAL;
+
+    ptz_3a_stats before;
+    output_stats(renderer, &pyramid, &state, &before);
+    int ticks = run_3a(renderer, &pyramid, &state);
+    CHECK(ticks > 0 && ticks < MAX_3A_TICKS);
+    CHECK(state.rGain < PTZ_RGAIN_DEFAULT);
+    CHECK(state.bGain > PTZ_BGAIN_DEFAULT);
+
+    // Gray world: the output averages out about gray. Not exactly, since the stats stand in gamma 2 for
+    // the sRGB curve the gains are applied on, but a cast of 25-50% comes down to a few percent.
+    ptz_3a_stats after;
+    output_stats(renderer, &pyramid, &state, &after);
+    float redCast = after.mean[0] / after.mean[1], blueCast = after.mean[2] / after.mean[1];
+    if (fabsf(redCast - 1) > 0.08f || fabsf(blueCast - 1) > 0.08f) {
+        fprintf(stderr, "white balance settled at R/G %.3f, B/G %.3f\n", redCast, blueCast);
+    }
+    CHECK(fabsf(redCast - 1) <= 0.08f);
+    CHECK(fabsf(blueCast - 1) <= 0.08f);
+    CHECK(fabsf(redCast - 1) < fabsf(before.mean[0] / before.mean[1] - 1));
+    CHECK(fabsf(blueCast - 1) < fabsf(before.mean[2] / before.mean[1] - 1));
+    ptz_pyramid_free(&pyramid);
+}
+
+int main(void) {
+    const float neutral[3] = { 1, 1, 1 };
+    ptz_pyramid pyramid;
+    memset(&pyramid, 0, sizeof(pyramid));
+    CHECK(build_scene(&pyramid, 128, neutral) == 0);
+    test_autofocus(&pyramid);
+    ptz_pyramid_free(&pyramid);
+
+    ptz_renderer renderer;
+    ptz_renderer_init(&renderer);
+    test_auto_exposure(&renderer);
+    test_auto_white_balance(&renderer);
+    ptz_renderer_destroy(&renderer);
+    return ptz_test_result();
+}
@@ -0,0 +1,197 @@
+//
+//  ptz_af_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The autofocus hill climb over a sweep of zoom, tilt and starting focus: every search has to settle sharp,
+//  and quickly. And the vector sharpness metric against a plain scalar one.
+//
+
+#include "ptz_af.h"
+#include "ptz_effects.h"
+#include "ptz_pyramid.h"
+#include "ptz_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The slowest a search should be: the whole range at full steps, when it starts off the wrong way across a blur
+// too flat to steer by, then four halvings of the step and the tick that lands. 21 ticks, 0.7s at 30 Hz.
+#define SETTLE_TICKS (PTZ_FOCUS_MAX / PTZ_AF_STEP + 5)
+
+// Fine detail that a little defocus washes out, so far from the subject the score is flat noise and the
+// search has to sweep rather than climb. ptz_3a_tests has the easier scene with detail at every scale.
+static int build_scene(ptz_pyramid *pyramid) {
+    ptz_image base = { 0 };
+    if (ptz_image_alloc(&base, 1280, 720) < 0) {
+        return -1;
+    }
+    uint32_t grain = 11;
+    for (int y = 0; y < base.height; y++) {
+        uint8_t *row = ptz_image_row(&base, y);
+        for (int x = 0; x < base.width; x++) {
+            grain = grain * 1103515245 + 12345;
+            int checker = ((x / 3) ^ (y / 3)) & 1 ? 40 : -40;
+            int wash = (x + y) * 60 / (base.width + base.height);
+            int v = 100 + checker + wash + (int)((grain >> 16) & 31) - 16;
+            row[x * 4 + 0] = (uint8_t)(v + 10);
+            row[x * 4 + 1] = (uint8_t)v;
+            row[x * 4 + 2] = (uint8_t)(v - 10);
+            row[x * 4 + 3] = 0xff;
+        }
+    }
+    int result = ptz_pyramid_build(pyramid, &base);
+    ptz_image_free(&base);
+    return result;
+}
+
+static float reference_sharpness(const ptz_image *image, int left, int top, int width, int height) {
+    if (width < 2 || height < 2) {
+        return 0;
+    }
+    uint64_t sum = 0;
+    for (int y = top; y < top + height - 1; y++) {
+        for (int x = left; x < left + width - 1; x++) {
+            int g = ptz_image_row(image, y)[x * 4 + 1];
+            int dx = ptz_image_row(image, y)[(x + 1) * 4 + 1] - g;
+            int dy = ptz_image_row(image, y + 1)[x * 4 + 1] - g;
+            sum += (uint64_t)(dx * dx + dy * dy);
+        }
+    }
+    return (float)((double)sum / ((double)(width - 1) * (height - 1)));
+}
+
+// Widths on both sides of the 8-lane loop, and rectangles that don't start at the image's corner.
+static void test_sharpness(void) {
+    ptz_image image = { 0 };
+    CHECK(ptz_image_alloc(&image, 200, 40) == 0);
+    uint32_t seed = 99;
+    for (int y = 0; y < image.height; y++) {
+        uint8_t *row = ptz_image_row(&image, y);
+        for (int x = 0; x < image.width * 4; x++) {
+            seed = seed * 1664525 + 1013904223;
+            row[x] = (uint8_t)(seed >> 24);
+        }
+    }
+    const int widths[] = { 0, 1, 2, 3, 8, 9, 10, 16, 17, 63, 128, 199, 200 };
+    for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+        for (int left = 0; left <= 3 && left + widths[i] <= image.width; left += 3) {
+            float vector = ptz_af_sharpness(&image, left, 5, widths[i], 30);
+            float scalar = reference_sharpness(&image, left, 5, widths[i], 30);
+            if (vector != scalar) {
+                fprintf(stderr, "width %d at %d: %f, expected %f\n", widths[i], left, vector, scalar);
+            }
+            CHECK(vector == scalar);
+        }
+    }
+    CHECK(ptz_af_sharpness(&image, 0, 0, 10, 1) == 0);
+
+    // Flat is 0; worst-case contrast is 2 * 255^2 without overflowing a lane.
+    for (int y = 0; y < image.height; y++) {
+        uint8_t *row = ptz_image_row(&image, y);
+        for (int x = 0; x < image.width; x++) {
+            row[x * 4 + 1] = 7;
+        }
+    }
+    CHECK(ptz_af_sharpness(&image, 0, 0, image.width, image.height) == 0);
+    for (int y = 0; y < image.height; y++) {
+        uint8_t *row = ptz_image_row(&image, y);
+        for (int x = 0; x < image.width; x++) {
+            row[x * 4 + 1] = ((x ^ y) & 1) ? 255 : 0;
+        }
+    }
+    CHECK(ptz_af_sharpness(&image, 0, 0, image.width, image.height) == 2 * 255 * 255);
+    ptz_image_free(&image);
+}
+
+// What AppDelegate's autofocusTick does, until the search ends. Returns the number of ticks it took.
+static int run_search(ptz_af_probe *probe, const ptz_pyramid *pyramid, ptz_camera_state *state, ptz_af *af) {
+    ptz_af_start(af, state->focus);
+    int ticks = 0;
+    while (af->searching && ticks <= PTZ_AF_MAX_TICKS) {
+        float score = ptz_af_measure(probe, pyramid, state, (uint32_t)af->position);
+        CHECK(score >= 0);
+        state->focus = ptz_af_step(af, score);
+        ticks++;
+    }
+    return ticks;
+}
+
+static void test_sweep(const ptz_pyramid *pyramid) {
+    ptz_af_probe probe;
+    ptz_af_probe_init(&probe);
+    ptz_af af;
+    memset(&af, 0, sizeof(af));
+    int fastest = PTZ_AF_MAX_TICKS, slowest = 0, searches = 0;
+    for (uint32_t zoom = 0; zoom <= PTZ_ZOOM_MAX; zoom += PTZ_ZOOM_MAX / 8) {
+        for (int32_t tilt = PTZ_PT_MIN; tilt <= PTZ_PT_MAX; tilt += PTZ_PT_MAX / 2) {
+            for (uint32_t start = 0; start <= PTZ_FOCUS_MAX; start += PTZ_FOCUS_MAX / 4) {
+                ptz_camera_state state;
+                memset(&state, 0, sizeof(state));
+                state.autofocus = 1;
+                state.zoom = zoom;
+                state.tilt = tilt;
+                state.focus = start;
+                int ticks = run_search(&probe, pyramid, &state, &af);
+                searches++;
+                CHECK(!af.searching);
+                fastest = ticks < fastest ? ticks : fastest;
+                slowest = ticks > slowest ? ticks : slowest;
+
+                // Settled with nothing left to blur.
+                ptz_effects effects;
+                ptz_effects_for_state(&state, NULL, &effects);
+                if (effects.blurRadius != 0 || ticks > SETTLE_TICKS) {
+                    fprintf(stderr, "zoom %#x tilt %d from %#x: focus %#x for %#x after %d ticks\n", zoom, tilt,
+                            start, state.focus, ptz_af_subject_focus(&state), ticks);
+                }
+                CHECK(effects.blurRadius == 0);
+                CHECK(ticks <= SETTLE_TICKS);
+
+                // A search from where it settled stays put.
+                uint32_t settled = state.focus;
+                run_search(&probe, pyramid, &state, &af);
+                CHECK(abs((int)state.focus - (int)settled) <= PTZ_AF_STEP);
+            }
+        }
+    }
+    printf("%d searches settled in %d-%d ticks\n", searches, fastest, slowest);
+    ptz_af_probe_destroy(&probe);
+}
+
+// However bad the scores, a search ends by PTZ_AF_MAX_TICKS.
+static void test_tick_bound(void) {
+    ptz_af af;
+    memset(&af, 0, sizeof(af));
+    ptz_af_start(&af, PTZ_FOCUS_MAX / 2);
+    int ticks = 0;
+    uint32_t seed = 5;
+    while (af.searching && ticks < 10 * PTZ_AF_MAX_TICKS) {
+        seed = seed * 1664525 + 1013904223;
+        ptz_af_step(&af, (float)(seed >> 8));
+        ticks++;
+    }
+    CHECK(!af.searching);
+    CHECK(ticks <= PTZ_AF_MAX_TICKS);
+    // A flat score: nothing to climb, and it still stops.
+    ptz_af_start(&af, 0);
+    ticks = 0;
+    while (af.searching && ticks < 10 * PTZ_AF_MAX_TICKS) {
+        uint32_t position = ptz_af_step(&af, 1);
+        CHECK(position <= PTZ_FOCUS_MAX);
+        ticks++;
+    }
+    CHECK(!af.searching);
+    CHECK(ticks <= PTZ_AF_MAX_TICKS);
+}
+
+int main(void) {
+    test_sharpness();
+    test_tick_bound();
+    ptz_pyramid pyramid;
+    CHECK(build_scene(&pyramid) == 0);
+    test_sweep(&pyramid);
+    ptz_pyramid_free(&pyramid);
+    return ptz_test_result();
+}
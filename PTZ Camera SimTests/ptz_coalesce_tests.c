@@ -0,0 +1,83 @@
+//
+//  ptz_coalesce_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Which drives in a batch camera_handler and the engine skip: the newest of each group for each camera,
+//  nothing across an Address Set, and no Pan_TiltDrive at all while the menu is up.
+//
+
+#include "jr_visca.h"
+#include "ptz_coalesce.h"
+#include "ptz_test.h"
+
+#include <string.h>
+
+#define DRIVE JR_VISCA_MESSAGE_PAN_TILT_DRIVE
+#define ZOOM JR_VISCA_MESSAGE_ZOOM_TELE_VARIABLE
+#define ADDRESS_SET JR_VISCA_MESSAGE_CAMERA_NUMBER
+#define INQUIRY JR_VISCA_MESSAGE_PAN_TILT_POSITION_INQ
+
+// Runs a batch through newest first, as the receive loops do, and checks what's superseded.
+static void check_batch(const int *types, const uint8_t *receivers, const int *expected, int count,
+                        int menuVisible, int oneCamera) {
+    ptz_coalesce coalesce;
+    ptz_coalesce_init(&coalesce, menuVisible, oneCamera);
+    for (int i = count - 1; i >= 0; i--) {
+        int superseded = ptz_coalesce_superseded(&coalesce, types[i], receivers ? receivers[i] : 1);
+        if (superseded != expected[i]) {
+            fprintf(stderr, "frame %d: superseded %d, expected %d\n", i, superseded, expected[i]);
+        }
+        CHECK(superseded == expected[i]);
+    }
+}
+
+static void test_groups(void) {
+    CHECK(ptz_drive_group(DRIVE) == PTZ_DRIVE_GROUP_PAN_TILT);
+    CHECK(ptz_drive_group(JR_VISCA_MESSAGE_ZOOM_STOP) == PTZ_DRIVE_GROUP_ZOOM);
+    CHECK(ptz_drive_group(JR_VISCA_MESSAGE_ZOOM_TELE_STANDARD) == PTZ_DRIVE_GROUP_ZOOM);
+    CHECK(ptz_drive_group(JR_VISCA_MESSAGE_ZOOM_WIDE_STANDARD) == PTZ_DRIVE_GROUP_ZOOM);
+    CHECK(ptz_drive_group(ZOOM) == PTZ_DRIVE_GROUP_ZOOM);
+    CHECK(ptz_drive_group(JR_VISCA_MESSAGE_ZOOM_WIDE_VARIABLE) == PTZ_DRIVE_GROUP_ZOOM);
+    // Moves go somewhere; each one counts.
+    CHECK(ptz_drive_group(JR_VISCA_MESSAGE_ABSOLUTE_PAN_TILT) == 0);
+    CHECK(ptz_drive_group(JR_VISCA_MESSAGE_ZOOM_DIRECT) == 0);
+    CHECK(ptz_drive_group(INQUIRY) == 0);
+}
+
+static void test_batches(void) {
+    // The newest of each group, with other frames in between.
+    const int types[] = { DRIVE, ZOOM, INQUIRY, DRIVE, ZOOM, DRIVE, INQUIRY };
+    const int newest[] = { 1, 1, 0, 1, 0, 0, 0 };
+    check_batch(types, NULL, newest, 7, 0, 1);
+
+    // An Address Set in the middle: each side keeps its own newest.
+    const int renumbered[] = { DRIVE, DRIVE, ZOOM, ADDRESS_SET, DRIVE, ZOOM, ZOOM, DRIVE };
+    const int sides[] = { 1, 0, 0, 0, 1, 1, 0, 0 };
+    check_batch(renumbered, NULL, sides, 8, 0, 1);
+
+    // With the menu up every Pan_TiltDrive is a step through it; zooms still coalesce.
+    const int menu[] = { DRIVE, ZOOM, DRIVE, ZOOM, DRIVE };
+    const int steps[] = { 0, 1, 0, 0, 0 };
+    check_batch(menu, NULL, steps, 5, 1, 1);
+
+    // A chain: each camera's own newest. One camera answers to anything, so there addresses don't matter.
+    const int chain[] = { DRIVE, DRIVE, DRIVE, DRIVE, ZOOM, ZOOM };
+    const uint8_t receivers[] = { 1, 2, 1, 3, 2, 1 };
+    const int perCamera[] = { 1, 0, 0, 0, 0, 0 };
+    check_batch(chain, receivers, perCamera, 6, 0, 0);
+    const int oneCamera[] = { 1, 1, 1, 0, 1, 0 };
+    check_batch(chain, receivers, oneCamera, 6, 0, 1);
+
+    // Broadcasts are an address of their own.
+    const uint8_t broadcast[] = { 8, 1, 8, 1, 8, 8 };
+    const int perAddress[] = { 1, 1, 0, 0, 1, 0 };
+    check_batch(chain, broadcast, perAddress, 6, 0, 0);
+}
+
+int main(void) {
+    test_groups();
+    test_batches();
+    return ptz_test_result();
+}
@@ -0,0 +1,93 @@
+//
+//  ptz_config_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_config.h"
+#include "ptz_test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void write_file(const char *path, const char *text) {
+    FILE *file = fopen(path, "w");
+    fputs(text, file);
+    fclose(file);
+}
+
+static void test_defaults(void) {
+    ptz_config config;
+    ptz_config_defaults(&config);
+    CHECK(config.cameras == 1);
+    CHECK(config.port == 5678);
+    CHECK(config.tickMs == 100);
+    CHECK(config.notifyRate == 0);
+    CHECK(strcmp(ptz_config_profile(&config, 0), "") == 0);
+}
+
+static void test_file(void) {
+    mkdir("ptz_config_tests.d", 0755);
+    write_file("ptz_config_tests.d/ptzd.conf",
+               "# Sixteen cameras\n"
+               "cameras = 16\n"
+               "port = 0x2000          # In hex, why not.\n"
+               "tick_ms = 20\n"
+               "notify_rate = 5\n"
+               "profile = sony\n"
+               "profile.3 = bench/srg300.profile\n"
+               "profile.4 = /etc/ptz/a.profile\n"
+               "profile.3 = ptzoptics\n");
+    ptz_config config;
+    ptz_config_defaults(&config);
+    CHECK(ptz_config_load(&config, "ptz_config_tests.d/ptzd.conf") == 0);
+    CHECK(config.cameras == 16);
+    CHECK(config.port == 0x2000);
+    CHECK(config.tickMs == 20);
+    CHECK(config.notifyRate == 5);
+    CHECK(config.overrideCount == 2);
+    CHECK(strcmp(ptz_config_profile(&config, 0), "sony") == 0);
+    CHECK(strcmp(ptz_config_profile(&config, 3), "ptzoptics") == 0);
+    CHECK(strcmp(ptz_config_profile(&config, 4), "/etc/ptz/a.profile") == 0);
+    CHECK(strcmp(ptz_config_profile(&config, 15), "sony") == 0);
+
+    // Relative profile paths are from the config's directory.
+    write_file("ptz_config_tests.d/ptzd.conf", "profile = bench/srg300.profile\n");
+    ptz_config_defaults(&config);
+    CHECK(ptz_config_load(&config, "ptz_config_tests.d/ptzd.conf") == 0);
+    CHECK(strcmp(ptz_config_profile(&config, 0), "ptz_config_tests.d/bench/srg300.profile") == 0);
+    remove("ptz_config_tests.d/ptzd.conf");
+    rmdir("ptz_config_tests.d");
+}
+
+static void test_errors(void) {
+    static const char *bad[] = {
+        "cameras = 0\n",
+        "cameras = lots\n",
+        "port = 70000\n",
+        "cameras = 100\nport = 65500\n",
+        "cameras = 2\nprofile.2 = sony\n",
+        "tick_ms = 0\n",
+        "colour = blue\n",
+        "just words\n",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        write_file("ptz_config_tests.conf", bad[i]);
+        ptz_config config;
+        ptz_config_defaults(&config);
+        CHECK(ptz_config_load(&config, "ptz_config_tests.conf") == -1);
+    }
+    remove("ptz_config_tests.conf");
+    ptz_config config;
+    CHECK(ptz_config_load(&config, "ptz_config_tests.nonesuch") == -1);
+}
+
+int main(void) {
+    test_defaults();
+    test_file();
+    test_errors();
+    return ptz_test_result();
+}
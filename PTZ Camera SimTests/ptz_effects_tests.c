@@ -0,0 +1,276 @@
+//
+//  ptz_effects_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The defocus blur against a naive box filter, the color LUT on images where the answer is known,
+//  and the flips.
+//
+
+#include "ptz_effects.h"
+#include "ptz_af.h"
+#include "ptz_test.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t random_state = 0x9E3779B9;
+
+static uint32_t next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void fill_noise(ptz_image *image, int width, int height) {
+    CHECK(ptz_image_alloc(image, width, height) == 0);
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = ptz_image_row(image, y);
+        for (int x = 0; x < width; x++) {
+            uint32_t noise = next_random();
+            memcpy(row + x * 4, &noise, 4);
+            row[x * 4 + 3] = 0xff;
+        }
+    }
+}
+
+static void default_state(ptz_camera_state *state) {
+    memset(state, 0, sizeof(*state));
+    state->wbMode = PTZ_WB_MODE_ONE_PUSH;
+    state->aeMode = PTZ_AE_MODE_MANUAL;
+    state->aperture = PTZ_APERTURE_DEFAULT;
+    state->shutter = PTZ_SHUTTER_DEFAULT;
+    state->iris = PTZ_IRIS_DEFAULT;
+    state->brightPos = PTZ_BRIGHT_DEFAULT;
+    state->brightness = PTZ_BRIGHTNESS_DEFAULT;
+    state->contrast = PTZ_CONTRAST_DEFAULT;
+    state->rGain = PTZ_RGAIN_DEFAULT;
+    state->bGain = PTZ_BGAIN_DEFAULT;
+    state->colorgain = PTZ_COLOR_GAIN_DEFAULT;
+    state->hue = PTZ_HUE_DEFAULT;
+    state->focus = ptz_af_subject_focus(state);
+}
+
+static inline int clamp_index(int v, int size) {
+    return v < 0 ? 0 : v >= size ? size - 1 : v;
+}
+
+// The largest difference between `dst` and a (2r+1)^2 box average of `src` with the edges carried on.
+static int compare_to_box(const ptz_image *src, int radius, const ptz_image *dst) {
+    int worst = 0;
+    const double area = (2.0 * radius + 1) * (2.0 * radius + 1);
+    for (int y = 0; y < src->height; y++) {
+        const uint8_t *out = ptz_image_row(dst, y);
+        for (int x = 0; x < src->width; x++) {
+            for (int c = 0; c < 3; c++) {
+                double sum = 0;
+                for (int dy = -radius; dy <= radius; dy++) {
+                    const uint8_t *row = ptz_image_row(src, clamp_index(y + dy, src->height));
+                    for (int dx = -radius; dx <= radius; dx++) {
+                        sum += row[clamp_index(x + dx, src->width) * 4 + c];
+                    }
+                }
+                int difference = abs(out[x * 4 + c] - (int)lround(sum / area));
+                if (difference > worst) {
+                    worst = difference;
+                }
+            }
+        }
+    }
+    return worst;
+}
+
+static void test_blur(void) {
+    ptz_renderer renderer;
+    ptz_renderer_init(&renderer);
+    ptz_image src = { 0 }, dst = { 0 };
+    ptz_effects effects;
+    memset(&effects, 0, sizeof(effects));
+
+    // Wide enough for two strips, and a radius taller than the image.
+    const struct {
+        int width, height, radius;
+    } cases[] = {
+        { 1100, 24, 5 },
+        { 67, 20, 17 },
+        { 40, 40, 1 },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        fill_noise(&src, cases[i].width, cases[i].height);
+        effects.blurRadius = cases[i].radius;
+        CHECK(ptz_render_effects(&renderer, &src, &effects, &dst) == 0);
+        CHECK(dst.width == src.width && dst.height == src.height);
+        // Each pass rounds to bytes once.
+        int difference = compare_to_box(&src, cases[i].radius, &dst);
+        if (difference > 1) {
+            fprintf(stderr, "blur %zu is off by %d\n", i, difference);
+        }
+        CHECK(difference <= 1);
+    }
+
+    // Out of place only.
+    CHECK(ptz_render_effects(&renderer, &src, &effects, &src) == -1);
+
+    ptz_renderer_destroy(&renderer);
+    ptz_image_free(&dst);
+    ptz_image_free(&src);
+}
+
+static void test_effects_for_state(void) {
+    ptz_camera_state state;
+    default_state(&state);
+    ptz_color_lut lut;
+    ptz_color_lut_init(&lut);
+    ptz_effects effects;
+
+    // In focus with every setting at its default, there's nothing to do.
+    ptz_effects_for_state(&state, &lut, &effects);
+    CHECK(effects.blurRadius == 0);
+    CHECK(effects.lut == NULL);
+    CHECK(ptz_effects_is_identity(&effects));
+
+    // Half the focus range off is a sigma of 10: a box with the same variance is 35 wide.
+    state.focus += 0x80;
+    ptz_effects_for_state(&state, &lut, &effects);
+    CHECK(effects.blurRadius == 17);
+    ptz_effects_scale(&effects, 0.5f);
+    CHECK(effects.blurRadius == 9);
+
+    default_state(&state);
+    state.flipV = 1;
+    state.bwMode = 1;
+    ptz_effects_for_state(&state, &lut, &effects);
+    CHECK(effects.flipV && !effects.flipH);
+    CHECK(effects.lut == &lut);
+    CHECK(!ptz_effects_is_identity(&effects));
+}
+
+static void fill_gray_ramp(ptz_image *image) {
+    CHECK(ptz_image_alloc(image, 256, 4) == 0);
+    for (int y = 0; y < image->height; y++) {
+        uint8_t *row = ptz_image_row(image, y);
+        for (int x = 0; x < 256; x++) {
+            row[x * 4 + 0] = row[x * 4 + 1] = row[x * 4 + 2] = (uint8_t)x;
+            row[x * 4 + 3] = 0xff;
+        }
+    }
+}
+
+static double srgb_to_linear(double c) {
+    return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+static double linear_to_srgb(double c) {
+    return c <= 0.0031308 ? c * 12.92 : 1.055 * pow(c, 1 / 2.4) - 0.055;
+}
+
+static void test_lut(void) {
+    ptz_renderer renderer;
+    ptz_renderer_init(&renderer);
+    ptz_image src = { 0 }, dst = { 0 };
+    ptz_camera_state state;
+    ptz_color_lut lut;
+    ptz_color_lut_init(&lut);
+    ptz_effects effects;
+
+    // One stop up doubles the light: grays stay gray, to within the float rounding of the saturation math,
+    // and come out at sRGB(2 * linear), clipped. The 17-point table is only exact at its lattice points,
+    // so allow for the curve between them.
+    fill_gray_ramp(&src);
+    default_state(&state);
+    state.iris = PTZ_IRIS_DEFAULT + 2;
+    ptz_effects_for_state(&state, &lut, &effects);
+    CHECK(effects.lut != NULL);
+    CHECK(ptz_render_effects(&renderer, &src, &effects, &dst) == 0);
+    int worst = 0, gray = 1;
+    for (int x = 0; x < 256; x++) {
+        const uint8_t *px = ptz_image_row(&dst, 2) + x * 4;
+        double light = fmin(1.0, 2 * srgb_to_linear(x / 255.0));
+        int expected = (int)lround(linear_to_srgb(light) * 255);
+        int difference = abs(px[1] - expected);
+        worst = difference > worst ? difference : worst;
+        gray &= abs(px[0] - px[1]) <= 1 && abs(px[2] - px[1]) <= 1;
+        CHECK(px[3] == 0xff);
+    }
+    if (worst > 3) {
+        fprintf(stderr, "+1 stop is off by %d\n", worst);
+    }
+    CHECK(worst <= 3);
+    CHECK(gray);
+    CHECK(ptz_image_row(&dst, 0)[255 * 4] == 0xff);
+    CHECK(ptz_image_row(&dst, 0)[0] == 0);
+
+    // B&W with everything else neutral is plain luma, which is linear in the input, so the table has it exactly.
+    fill_noise(&src, 64, 64);
+    default_state(&state);
+    state.bwMode = 1;
+    ptz_effects_for_state(&state, &lut, &effects);
+    CHECK(ptz_render_effects(&renderer, &src, &effects, &dst) == 0);
+    worst = 0;
+    gray = 1;
+    for (int y = 0; y < src.height; y++) {
+        const uint8_t *in = ptz_image_row(&src, y), *out = ptz_image_row(&dst, y);
+        for (int x = 0; x < src.width; x++) {
+            int expected = (int)lround(0.299 * in[x * 4] + 0.587 * in[x * 4 + 1] + 0.114 * in[x * 4 + 2]);
+            int difference = abs(out[x * 4 + 1] - expected);
+            worst = difference > worst ? difference : worst;
+            gray &= out[x * 4] == out[x * 4 + 1] && out[x * 4 + 1] == out[x * 4 + 2];
+        }
+    }
+    CHECK(worst <= 1);
+    CHECK(gray);
+
+    // Changing nothing doesn't rebuild the table.
+    ptz_color_params params;
+    ptz_color_params_for_state(&state, &params);
+    CHECK(ptz_color_lut_update(&lut, &params) == 0);
+    params.hue++;
+    CHECK(ptz_color_lut_update(&lut, &params) == 1);
+
+    ptz_renderer_destroy(&renderer);
+    ptz_image_free(&dst);
+    ptz_image_free(&src);
+}
+
+// Flipping the blurred picture is the same as blurring and then flipping it by hand.
+static void test_flip(void) {
+    ptz_renderer renderer;
+    ptz_renderer_init(&renderer);
+    ptz_image src = { 0 }, plain = { 0 }, flipped = { 0 };
+    fill_noise(&src, 1050, 13);
+
+    for (int radius = 0; radius <= 3; radius += 3) {
+        ptz_effects effects = { radius, 0, 0, NULL };
+        CHECK(ptz_render_effects(&renderer, &src, &effects, &plain) == 0);
+        effects.flipH = effects.flipV = 1;
+        CHECK(ptz_render_effects(&renderer, &src, &effects, &flipped) == 0);
+        int same = 1;
+        for (int y = 0; y < src.height; y++) {
+            const uint8_t *a = ptz_image_row(&plain, y), *b = ptz_image_row(&flipped, src.height - 1 - y);
+            for (int x = 0; x < src.width; x++) {
+                same &= memcmp(a + x * 4, b + (src.width - 1 - x) * 4, 4) == 0;
+            }
+        }
+        CHECK(same);
+        if (radius == 0) {
+            CHECK(memcmp(ptz_image_row(&plain, 5), ptz_image_row(&src, 5), src.width * 4) == 0);
+        }
+    }
+
+    ptz_renderer_destroy(&renderer);
+    ptz_image_free(&flipped);
+    ptz_image_free(&plain);
+    ptz_image_free(&src);
+}
+
+int main(void) {
+    test_blur();
+    test_effects_for_state();
+    test_lut();
+    test_flip();
+    return ptz_test_result();
+}
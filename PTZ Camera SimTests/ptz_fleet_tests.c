@@ -0,0 +1,211 @@
+//
+//  ptz_fleet_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  ptz_fleet_tick against a camera-at-a-time reference: where every axis ends up each tick, which cameras
+//  it says changed, and when a chunk stops being looked at.
+//
+
+#include "ptz_fleet.h"
+#include "ptz_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const uint32_t axis_dirty[PTZ_FLEET_AXES] = { PTZ_STATE_PAN, PTZ_STATE_TILT, PTZ_STATE_ZOOM, PTZ_STATE_FOCUS };
+
+// What one tick does to one axis of one camera.
+static int32_t reference_step(int32_t position, int32_t target, int32_t speed) {
+    int32_t delta = target - position;
+    if (delta > speed) {
+        delta = speed;
+    } else if (delta < -speed) {
+        delta = -speed;
+    }
+    return position + delta;
+}
+
+static int chunk_at_rest(const ptz_fleet *fleet, int chunk) {
+    for (int lane = 0; lane < PTZ_FLEET_LANES; lane++) {
+        int camera = chunk * PTZ_FLEET_LANES + lane;
+        for (int axis = 0; axis < PTZ_FLEET_AXES; axis++) {
+            if (fleet->position[axis][camera] != fleet->target[axis][camera]) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// Out-of-range targets stop at the end of the axis, and every move gets all the way there.
+static void test_clamped_moves(void) {
+    ptz_fleet fleet;
+    CHECK(ptz_fleet_init(&fleet, 4) == 0);
+    ptz_fleet_move_to(&fleet, 0, PTZ_FLEET_PAN, 0x7fff, 0x18);
+    ptz_fleet_move_to(&fleet, 0, PTZ_FLEET_TILT, -0x7fff, 0x18);
+    ptz_fleet_move_to(&fleet, 1, PTZ_FLEET_ZOOM, 0x1000, 0x07);
+    ptz_fleet_move_to(&fleet, 1, PTZ_FLEET_FOCUS, -5, 0x10);
+    ptz_fleet_jog(&fleet, 2, PTZ_FLEET_PAN, -1, 0x30);
+    ptz_fleet_jog(&fleet, 3, PTZ_FLEET_ZOOM, 1, 0x30);
+    CHECK(fleet.target[PTZ_FLEET_PAN][0] == PTZ_PT_MAX);
+    CHECK(fleet.target[PTZ_FLEET_TILT][0] == PTZ_PT_MIN);
+    CHECK(fleet.target[PTZ_FLEET_ZOOM][1] == PTZ_ZOOM_MAX);
+    CHECK(fleet.target[PTZ_FLEET_FOCUS][1] == 0);
+    CHECK(fleet.target[PTZ_FLEET_PAN][2] == PTZ_PT_MIN);
+    CHECK(fleet.target[PTZ_FLEET_ZOOM][3] == PTZ_ZOOM_MAX);
+
+    // Never more than the speed a tick, and never past the end.
+    int ticks = 0;
+    int32_t previousPan = 0;
+    while (ptz_fleet_tick(&fleet) > 0 && ticks < 1000) {
+        int32_t pan = ptz_fleet_position(&fleet, 0, PTZ_FLEET_PAN);
+        CHECK(pan - previousPan == (PTZ_PT_MAX - previousPan < 0x18 ? PTZ_PT_MAX - previousPan : 0x18));
+        previousPan = pan;
+        ticks++;
+    }
+    // The slowest is zoom, 0x100 at 7 a tick.
+    CHECK(ticks == (PTZ_ZOOM_MAX + 6) / 7);
+    CHECK(ptz_fleet_position(&fleet, 0, PTZ_FLEET_PAN) == PTZ_PT_MAX);
+    CHECK(ptz_fleet_position(&fleet, 0, PTZ_FLEET_TILT) == PTZ_PT_MIN);
+    CHECK(ptz_fleet_position(&fleet, 1, PTZ_FLEET_ZOOM) == PTZ_ZOOM_MAX);
+    CHECK(ptz_fleet_position(&fleet, 1, PTZ_FLEET_FOCUS) == 0);
+    CHECK(ptz_fleet_position(&fleet, 2, PTZ_FLEET_PAN) == PTZ_PT_MIN);
+    CHECK(ptz_fleet_position(&fleet, 3, PTZ_FLEET_ZOOM) == PTZ_ZOOM_MAX);
+
+    // Jumps clamp too.
+    ptz_fleet_set_position(&fleet, 0, PTZ_FLEET_FOCUS, 0x400);
+    CHECK(ptz_fleet_position(&fleet, 0, PTZ_FLEET_FOCUS) == PTZ_FOCUS_MAX);
+    CHECK(ptz_fleet_tick(&fleet) == 0);
+    ptz_fleet_free(&fleet);
+}
+
+// Many cameras across several chunks, the last one partial, each tick checked against the reference.
+static void test_against_reference(void) {
+    enum { COUNT = 45 };
+    ptz_fleet fleet;
+    CHECK(ptz_fleet_init(&fleet, COUNT) == 0);
+    CHECK(fleet.chunks == (COUNT + PTZ_FLEET_LANES - 1) / PTZ_FLEET_LANES);
+    int32_t position[PTZ_FLEET_AXES][COUNT] = { { 0 } };
+    int32_t target[PTZ_FLEET_AXES][COUNT] = { { 0 } };
+    int32_t speed[PTZ_FLEET_AXES][COUNT] = { { 0 } };
+    srand(1234);
+    // Every third camera moves, on one or two axes; the fourth chunk gets nothing.
+    for (int camera = 0; camera < COUNT; camera += 3) {
+        if (camera / PTZ_FLEET_LANES == 3) {
+            continue;
+        }
+        for (int axis = 0; axis < PTZ_FLEET_AXES; axis++) {
+            if ((camera + axis) % 2 == 0) {
+                continue;
+            }
+            int32_t to = rand() % 0x500 - 0x280;
+            int32_t by = rand() % 0x40 + 1;
+            ptz_fleet_move_to(&fleet, camera, axis, to, by);
+            int32_t low = axis < PTZ_FLEET_ZOOM ? PTZ_PT_MIN : 0;
+            int32_t high = axis < PTZ_FLEET_ZOOM ? PTZ_PT_MAX : axis == PTZ_FLEET_ZOOM ? PTZ_ZOOM_MAX : PTZ_FOCUS_MAX;
+            target[axis][camera] = to < low ? low : to > high ? high : to;
+            speed[axis][camera] = by;
+        }
+    }
+
+    int ticks = 0;
+    for (;;) {
+        uint32_t expectedChanged[COUNT];
+        uint32_t expectedDirty[COUNT];
+        int expectedCount = 0;
+        for (int camera = 0; camera < COUNT; camera++) {
+            uint32_t dirty = 0;
+            for (int axis = 0; axis < PTZ_FLEET_AXES; axis++) {
+                int32_t next = reference_step(position[axis][camera], target[axis][camera], speed[axis][camera]);
+                if (next != position[axis][camera]) {
+                    dirty |= axis_dirty[axis];
+                }
+                position[axis][camera] = next;
+            }
+            if (dirty) {
+                expectedChanged[expectedCount] = (uint32_t)camera;
+                expectedDirty[expectedCount] = dirty;
+                expectedCount++;
+            }
+        }
+
+        int changed = ptz_fleet_tick(&fleet);
+        CHECK(changed == expectedCount);
+        CHECK(fleet.changedCount == changed);
+        if (changed == expectedCount) {
+            // In camera order, with exactly the axes that moved.
+            for (int i = 0; i < changed; i++) {
+                CHECK(fleet.changed[i] == expectedChanged[i]);
+                CHECK(fleet.changedDirty[i] == expectedDirty[i]);
+            }
+        }
+        for (int camera = 0; camera < COUNT; camera++) {
+            for (int axis = 0; axis < PTZ_FLEET_AXES; axis++) {
+                CHECK(ptz_fleet_position(&fleet, camera, axis) == position[axis][camera]);
+            }
+        }
+        // A chunk is on the list exactly as long as something in it hasn't arrived.
+        for (int chunk = 0; chunk < fleet.chunks; chunk++) {
+            CHECK(fleet.active[chunk] == !chunk_at_rest(&fleet, chunk));
+        }
+        CHECK(!fleet.active[3]);
+        if (changed == 0 || ++ticks > 1000) {
+            break;
+        }
+    }
+    CHECK(ticks < 1000);
+    for (int chunk = 0; chunk < fleet.chunks; chunk++) {
+        CHECK(!fleet.active[chunk]);
+    }
+    ptz_fleet_free(&fleet);
+}
+
+// One camera arriving doesn't take its chunk off the list while a neighbour is still moving.
+static void test_chunk_retires(void) {
+    ptz_fleet fleet;
+    CHECK(ptz_fleet_init(&fleet, PTZ_FLEET_LANES * 2) == 0);
+    int near = PTZ_FLEET_LANES, far = PTZ_FLEET_LANES + 5;
+    ptz_fleet_move_to(&fleet, near, PTZ_FLEET_PAN, 0x10, 0x10);
+    ptz_fleet_move_to(&fleet, far, PTZ_FLEET_TILT, 0x30, 0x10);
+    CHECK(!fleet.active[0] && fleet.active[1]);
+
+    CHECK(ptz_fleet_tick(&fleet) == 2);
+    CHECK(fleet.changed[0] == (uint32_t)near && fleet.changedDirty[0] == PTZ_STATE_PAN);
+    CHECK(fleet.changed[1] == (uint32_t)far && fleet.changedDirty[1] == PTZ_STATE_TILT);
+    CHECK(fleet.active[1]);
+
+    CHECK(ptz_fleet_tick(&fleet) == 1);
+    CHECK(fleet.changed[0] == (uint32_t)far);
+    CHECK(fleet.active[1]);
+
+    CHECK(ptz_fleet_tick(&fleet) == 1);
+    CHECK(ptz_fleet_position(&fleet, far, PTZ_FLEET_TILT) == 0x30);
+    CHECK(!fleet.active[1]);
+    CHECK(ptz_fleet_tick(&fleet) == 0);
+
+    // A move at speed 0 goes nowhere but keeps the chunk listed, so giving it a speed later still moves it.
+    ptz_fleet_move_to(&fleet, 2, PTZ_FLEET_ZOOM, 0x20, 0);
+    CHECK(ptz_fleet_tick(&fleet) == 0);
+    CHECK(fleet.active[0]);
+    ptz_fleet_move_to(&fleet, 2, PTZ_FLEET_ZOOM, 0x20, 0x20);
+    CHECK(ptz_fleet_tick(&fleet) == 1);
+    CHECK(!fleet.active[0]);
+
+    // Stopping counts as arriving.
+    ptz_fleet_jog(&fleet, 3, PTZ_FLEET_PAN, 1, 4);
+    CHECK(ptz_fleet_tick(&fleet) == 1);
+    ptz_fleet_stop(&fleet, 3, PTZ_FLEET_PAN);
+    CHECK(ptz_fleet_tick(&fleet) == 0);
+    CHECK(!fleet.active[0]);
+    CHECK(ptz_fleet_position(&fleet, 3, PTZ_FLEET_PAN) == 4);
+    ptz_fleet_free(&fleet);
+}
+
+int main(void) {
+    test_clamped_moves();
+    test_against_reference();
+    test_chunk_retires();
+    return ptz_test_result();
+}
@@ -0,0 +1,229 @@
+//
+//  ptz_http_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The snapshot server on loopback with a stub renderer and encoder: requests on one kept-alive connection,
+//  pipelined ones in a single send, 404s and 400s, each of the three sizes, and a frame rendered once and then
+//  served from the cache until something that shows in the picture changes.
+//
+
+#include "ptz_http.h"
+#include "ptz_snapshot.h"
+#include "ptz_test.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int renders;
+
+// The frame carries the pan in its first pixel, which the encoder writes out with the size.
+static int stub_render(const ptz_camera_state *state, ptz_image *frame, void *context) {
+    renders++;
+    frame->pixels[0] = (uint8_t)state->pan;
+    return 0;
+}
+
+static int stub_encode(const ptz_image *frame, uint8_t **data, size_t *size, void *context) {
+    char text[64];
+    int length = snprintf(text, sizeof(text), "%dx%d pan %d", frame->width, frame->height, frame->pixels[0]);
+    *data = malloc((size_t)length);
+    if (*data == NULL) {
+        return -1;
+    }
+    memcpy(*data, text, (size_t)length);
+    *size = (size_t)length;
+    return 0;
+}
+
+typedef struct response {
+    int status;
+    int keepAlive;
+    char body[256];
+} response;
+
+static int connect_to(const ptz_http_server *server) {
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    struct sockaddr_in address = { 0 };
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server->port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+static void send_text(int fd, const char *text) {
+    CHECK(ptz_http_send(fd, text, strlen(text)) == 0);
+}
+
+// One response off `fd`: headers up to the blank line, then Content-Length bytes of body. Reads a byte at a
+// time so a pipelined response after it stays in the socket. Returns 0, or -1 if the connection closed first.
+static int read_response(int fd, response *r) {
+    char headers[1024];
+    size_t used = 0;
+    memset(r, 0, sizeof(*r));
+    while (used < 4 || memcmp(headers + used - 4, "\r\n\r\n", 4) != 0) {
+        if (used == sizeof(headers) - 1 || recv(fd, headers + used, 1, 0) != 1) {
+            return -1;
+        }
+        used++;
+    }
+    headers[used] = '\0';
+    sscanf(headers, "HTTP/1.1 %d", &r->status);
+    r->keepAlive = strstr(headers, "Connection: keep-alive") != NULL;
+    const char *length = strstr(headers, "Content-Length: ");
+    size_t bodyLength = length ? (size_t)atol(length + 16) : 0;
+    if (bodyLength >= sizeof(r->body)) {
+        return -1;
+    }
+    for (size_t got = 0; got < bodyLength; ) {
+        ssize_t received = recv(fd, r->body + got, bodyLength - got, 0);
+        if (received <= 0) {
+            return -1;
+        }
+        got += (size_t)received;
+    }
+    return 0;
+}
+
+static void get(int fd, const char *target, response *r) {
+    char request[512];
+    snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", target);
+    send_text(fd, request);
+    CHECK(read_response(fd, r) == 0);
+}
+
+static void test_loopback(ptz_http_server *server) {
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    CHECK(getsockname(server->listenSocket, (struct sockaddr *)&address, &length) == 0);
+    CHECK(address.sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+    CHECK(server->port != 0 && ntohs(address.sin_port) == server->port);
+}
+
+static void test_requests(ptz_http_server *server) {
+    int fd = connect_to(server);
+    response r;
+
+    // Three sizes and the default, all on one connection.
+    get(fd, "/snapshot.jpg?resolution=960x600", &r);
+    CHECK(r.status == 200 && r.keepAlive);
+    CHECK(strcmp(r.body, "960x600 pan 10") == 0);
+    get(fd, "/snapshot.jpg?resolution=480x300", &r);
+    CHECK(r.status == 200 && strcmp(r.body, "480x300 pan 10") == 0);
+    get(fd, "/snapshot.jpg?resolution=1920x1080", &r);
+    CHECK(r.status == 200 && strcmp(r.body, "1920x1080 pan 10") == 0);
+    get(fd, "/snapshot.jpg", &r);
+    CHECK(r.status == 200 && strcmp(r.body, "1920x1080 pan 10") == 0);
+
+    // Neither of these costs the connection.
+    get(fd, "/snapshot.jpg?resolution=640x480", &r);
+    CHECK(r.status == 400 && r.keepAlive);
+    get(fd, "/index.html", &r);
+    CHECK(r.status == 404 && r.keepAlive);
+    CHECK(strcmp(r.body, "Not Found") == 0);
+
+    // HEAD is the headers alone, so the next response follows right after them.
+    send_text(fd, "HEAD /snapshot.jpg?resolution=480x300 HTTP/1.1\r\n\r\n");
+    char head[512];
+    size_t used = 0;
+    while (used < 4 || memcmp(head + used - 4, "\r\n\r\n", 4) != 0) {
+        CHECK(recv(fd, head + used, 1, 0) == 1);
+        used++;
+    }
+    head[used] = '\0';
+    CHECK(strncmp(head, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    CHECK(strstr(head, "Content-Length: 14\r\n") != NULL);
+
+    // Pipelined: three requests in one send, answered in order; the last asks to close.
+    send_text(fd, "GET /snapshot.jpg?resolution=480x300 HTTP/1.1\r\n\r\n"
+                  "GET /nothing HTTP/1.1\r\n\r\n"
+                  "GET /snapshot.jpg?resolution=960x600 HTTP/1.1\r\nConnection: close\r\n\r\n");
+    CHECK(read_response(fd, &r) == 0);
+    CHECK(r.status == 200 && strcmp(r.body, "480x300 pan 10") == 0);
+    CHECK(read_response(fd, &r) == 0);
+    CHECK(r.status == 404);
+    CHECK(read_response(fd, &r) == 0);
+    CHECK(r.status == 200 && !r.keepAlive && strcmp(r.body, "960x600 pan 10") == 0);
+    CHECK(read_response(fd, &r) < 0);
+    close(fd);
+
+    // HTTP/1.0 closes after one, and bodies are refused rather than left to be mistaken for the next request.
+    fd = connect_to(server);
+    send_text(fd, "GET /snapshot.jpg HTTP/1.0\r\n\r\n");
+    CHECK(read_response(fd, &r) == 0);
+    CHECK(r.status == 200 && !r.keepAlive);
+    CHECK(read_response(fd, &r) < 0);
+    close(fd);
+    fd = connect_to(server);
+    send_text(fd, "POST /snapshot.jpg HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc");
+    CHECK(read_response(fd, &r) == 0);
+    CHECK(r.status == 405 && !r.keepAlive);
+    close(fd);
+}
+
+static void test_cache(ptz_http_server *server, ptz_snapshot_service *service) {
+    ptz_camera_state state = { 0 };
+    state.pan = 20;
+    ptz_snapshot_service_set_state(service, &state);
+    int fd = connect_to(server);
+    response r;
+
+    renders = 0;
+    uint64_t hits = service->hits, misses = service->misses;
+    get(fd, "/snapshot.jpg?resolution=480x300", &r);
+    CHECK(strcmp(r.body, "480x300 pan 20") == 0);
+    CHECK(renders == 1 && service->misses == misses + 1);
+    get(fd, "/snapshot.jpg?resolution=480x300", &r);
+    CHECK(strcmp(r.body, "480x300 pan 20") == 0);
+    CHECK(renders == 1 && service->hits == hits + 1);
+
+    // Each size is cached on its own.
+    get(fd, "/snapshot.jpg?resolution=960x600", &r);
+    CHECK(renders == 2 && service->misses == misses + 2);
+
+    // The preset speed only shows with the menu up, so it's still the same picture.
+    state.presetSpeed = 5;
+    ptz_snapshot_service_set_state(service, &state);
+    get(fd, "/snapshot.jpg?resolution=480x300", &r);
+    CHECK(renders == 2 && service->hits == hits + 2);
+
+    // A pan is a new picture, at every size.
+    state.pan = 21;
+    ptz_snapshot_service_set_state(service, &state);
+    get(fd, "/snapshot.jpg?resolution=480x300", &r);
+    CHECK(strcmp(r.body, "480x300 pan 21") == 0);
+    CHECK(renders == 3 && service->misses == misses + 3);
+    get(fd, "/snapshot.jpg?resolution=960x600", &r);
+    CHECK(strcmp(r.body, "960x600 pan 21") == 0);
+    CHECK(renders == 4 && service->misses == misses + 4);
+    close(fd);
+}
+
+int main(void) {
+    alarm(30);
+    ptz_snapshot_service service;
+    ptz_snapshot_service_init(&service, stub_render, stub_encode, NULL);
+    ptz_camera_state state = { 0 };
+    state.pan = 10;
+    ptz_snapshot_service_set_state(&service, &state);
+    ptz_http_server server;
+    if (ptz_http_server_start(&server, 0, PTZ_HTTP_BIND_LOOPBACK, ptz_snapshot_handle_request, &service) < 0) {
+        return 1;
+    }
+    test_loopback(&server);
+    test_requests(&server);
+    test_cache(&server, &service);
+    ptz_http_server_stop(&server);
+    ptz_snapshot_service_destroy(&service);
+    return ptz_test_result();
+}
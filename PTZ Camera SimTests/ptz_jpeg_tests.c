@@ -0,0 +1,169 @@
+//
+//  ptz_jpeg_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  ptz_jpeg's output through libjpeg's decoder: it has to decode without complaint, at the right size,
+//  and look like what went in.
+//
+
+#include "ptz_jpeg.h"
+#include "ptz_test.h"
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jpeglib.h>
+
+// Something like a picture: smooth shading, a few hard edges, and a little grain.
+static void fill_scene(ptz_image *image, int width, int height) {
+    CHECK(ptz_image_alloc(image, width, height) == 0);
+    uint32_t grain = 12345;
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = ptz_image_row(image, y);
+        for (int x = 0; x < width; x++) {
+            grain = grain * 1103515245 + 12345;
+            int noise = (int)((grain >> 16) & 7) - 4;
+            int r = 40 + x * 160 / width + noise;
+            int g = 60 + y * 140 / height + noise;
+            int b = 128 + (int)(60 * sin(x * 0.05) * cos(y * 0.07)) + noise;
+            // A gray box and a white bar; gray, so 4:2:0 chroma doesn't smear its edges.
+            if (x > width / 4 && x < width / 2 && y > height / 3 && y < height * 2 / 3) {
+                r = g = b = 90;
+            }
+            if (y > height - 20 && y < height - 12) {
+                r = g = b = 240;
+            }
+            row[x * 4 + 0] = (uint8_t)(r < 0 ? 0 : r > 255 ? 255 : r);
+            row[x * 4 + 1] = (uint8_t)(g < 0 ? 0 : g > 255 ? 255 : g);
+            row[x * 4 + 2] = (uint8_t)(b < 0 ? 0 : b > 255 ? 255 : b);
+            row[x * 4 + 3] = 0xff;
+        }
+    }
+}
+
+typedef struct decode_error {
+    struct jpeg_error_mgr manager;
+    jmp_buf jump;
+} decode_error;
+
+static void decode_error_exit(j_common_ptr cinfo) {
+    decode_error *error = (decode_error *)cinfo->err;
+    (*cinfo->err->output_message)(cinfo);
+    longjmp(error->jump, 1);
+}
+
+static void count_warning(j_common_ptr cinfo, int level) {
+    if (level < 0) {
+        (*cinfo->err->output_message)(cinfo);
+        failures++;
+    }
+}
+
+// Decodes `buffer` into `image` as RGBA; returns 0, or -1 if libjpeg won't have it.
+static int decode(const ptz_jpeg_buffer *buffer, ptz_image *image) {
+    struct jpeg_decompress_struct cinfo;
+    decode_error error;
+    cinfo.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = decode_error_exit;
+    error.manager.emit_message = count_warning;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, buffer->data, (unsigned long)buffer->size);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    if (cinfo.output_components != 3 || ptz_image_alloc(image, (int)cinfo.output_width, (int)cinfo.output_height) < 0) {
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+    uint8_t *scanline = malloc(cinfo.output_width * 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        uint8_t *out = ptz_image_row(image, (int)cinfo.output_scanline);
+        jpeg_read_scanlines(&cinfo, &scanline, 1);
+        for (JDIMENSION x = 0; x < cinfo.output_width; x++) {
+            memcpy(out + x * 4, scanline + x * 3, 3);
+            out[x * 4 + 3] = 0xff;
+        }
+    }
+    free(scanline);
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return 0;
+}
+
+static double psnr(const ptz_image *a, const ptz_image *b) {
+    double squares = 0;
+    for (int y = 0; y < a->height; y++) {
+        const uint8_t *ra = ptz_image_row(a, y), *rb = ptz_image_row(b, y);
+        for (int x = 0; x < a->width; x++) {
+            for (int c = 0; c < 3; c++) {
+                double d = (double)ra[x * 4 + c] - rb[x * 4 + c];
+                squares += d * d;
+            }
+        }
+    }
+    double mse = squares / ((double)a->width * a->height * 3);
+    return mse == 0 ? INFINITY : 10 * log10(255.0 * 255.0 / mse);
+}
+
+static void test_round_trip(int width, int height) {
+    ptz_image src = { 0 }, decoded = { 0 };
+    fill_scene(&src, width, height);
+    ptz_jpeg_buffer buffer = { 0 };
+    size_t previousSize = 0;
+    double previousPSNR = 0;
+    // About what libjpeg's own encoder gets at the same settings; the smallest image is mostly edges and does worst.
+    const struct {
+        int quality;
+        double minimumPSNR;
+    } qualities[] = {
+        { PTZ_JPEG_QUALITY_PREVIEW, 31 },
+        { PTZ_JPEG_QUALITY_STREAM, 32 },
+        { PTZ_JPEG_QUALITY_SNAPSHOT, 34 },
+    };
+    for (size_t i = 0; i < sizeof(qualities) / sizeof(qualities[0]); i++) {
+        ptz_jpeg_tables tables;
+        ptz_jpeg_tables_init(&tables, qualities[i].quality);
+        CHECK(ptz_jpeg_encode(&tables, &src, &buffer) == 0);
+        CHECK(buffer.size > 4);
+        CHECK(buffer.data[0] == 0xff && buffer.data[1] == 0xd8);
+        CHECK(buffer.data[buffer.size - 2] == 0xff && buffer.data[buffer.size - 1] == 0xd9);
+        // Better pictures cost more.
+        CHECK(buffer.size > previousSize);
+        previousSize = buffer.size;
+
+        CHECK(decode(&buffer, &decoded) == 0);
+        CHECK(decoded.width == width && decoded.height == height);
+        if (decoded.width == width && decoded.height == height) {
+            double quality = psnr(&src, &decoded);
+            if (quality < qualities[i].minimumPSNR) {
+                fprintf(stderr, "%dx%d at quality %d: %.1f dB\n", width, height, qualities[i].quality, quality);
+            }
+            CHECK(quality >= qualities[i].minimumPSNR);
+            CHECK(quality > previousPSNR);
+            previousPSNR = quality;
+        }
+    }
+    ptz_jpeg_buffer_free(&buffer);
+    ptz_image_free(&decoded);
+    ptz_image_free(&src);
+}
+
+int main(void) {
+    // Whole MCUs, and sizes that end partway through one both ways.
+    test_round_trip(640, 368);
+    test_round_trip(333, 201);
+    test_round_trip(17, 9);
+    return ptz_test_result();
+}
@@ -0,0 +1,151 @@
+//
+//  ptz_notify_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The notification limiter on a made-up clock: no more than the rate asked for, only the latest position,
+//  and always the one the camera stopped at. And the subscribe and notification frames on the wire.
+//
+
+#include "jr_visca.h"
+#include "ptz_notify.h"
+#include "ptz_test.h"
+
+#include <string.h>
+
+#define MS 1000000ull
+
+static void set_pan(int32_t position[PTZ_FLEET_AXES], int32_t pan) {
+    position[PTZ_FLEET_PAN] = pan;
+}
+
+static void test_rate(void) {
+    ptz_notify notify;
+    ptz_notify_subscribe(&notify, 10);
+    CHECK(ptz_notify_active(&notify));
+    // Nothing to say until there's a position.
+    CHECK(ptz_notify_take(&notify, 0) == 0);
+    CHECK(ptz_notify_next(&notify) == UINT64_MAX);
+
+    // The first goes out right away, both groups of it.
+    int32_t position[PTZ_FLEET_AXES] = { 100, -5, 0x200, 0x80 };
+    ptz_notify_update(&notify, position);
+    CHECK(ptz_notify_take(&notify, 1000 * MS) == (PTZ_NOTIFY_PAN_TILT | PTZ_NOTIFY_LENS));
+    CHECK(memcmp(notify.latest, position, sizeof(position)) == 0);
+    CHECK(ptz_notify_next(&notify) == UINT64_MAX);
+
+    // A pan every 10ms: one notification per 100ms, carrying the pan as it was at the time.
+    int sent = 0;
+    for (uint64_t t = 1010 * MS; t <= 1500 * MS; t += 10 * MS) {
+        set_pan(position, position[PTZ_FLEET_PAN] + 1);
+        ptz_notify_update(&notify, position);
+        uint32_t groups = ptz_notify_take(&notify, t);
+        if (groups) {
+            CHECK(groups == PTZ_NOTIFY_PAN_TILT);
+            CHECK(notify.latest[PTZ_FLEET_PAN] == position[PTZ_FLEET_PAN]);
+            CHECK(t == 1100 * MS + (uint64_t)sent * 100 * MS);
+            sent++;
+        } else {
+            CHECK(ptz_notify_next(&notify) > t);
+        }
+    }
+    CHECK(sent == 5);
+
+    // It stops just after a send. The stop goes out when the interval's up, and then there's nothing more.
+    set_pan(position, 900);
+    ptz_notify_update(&notify, position);
+    CHECK(ptz_notify_take(&notify, 1510 * MS) == 0);
+    CHECK(ptz_notify_next(&notify) == 1600 * MS);
+    CHECK(ptz_notify_take(&notify, 1599 * MS) == 0);
+    CHECK(ptz_notify_take(&notify, 1600 * MS) == PTZ_NOTIFY_PAN_TILT);
+    CHECK(notify.latest[PTZ_FLEET_PAN] == 900);
+    CHECK(ptz_notify_next(&notify) == UINT64_MAX);
+    CHECK(ptz_notify_take(&notify, 5000 * MS) == 0);
+
+    // Out and back between sends is no change at all.
+    set_pan(position, 901);
+    ptz_notify_update(&notify, position);
+    set_pan(position, 900);
+    ptz_notify_update(&notify, position);
+    CHECK(ptz_notify_pending(&notify) == 0);
+
+    // Focus alone is a lens notification.
+    position[PTZ_FLEET_FOCUS]++;
+    ptz_notify_update(&notify, position);
+    CHECK(ptz_notify_take(&notify, 6000 * MS) == PTZ_NOTIFY_LENS);
+}
+
+static void test_unsubscribe(void) {
+    ptz_notify notify;
+    ptz_notify_subscribe(&notify, 30);
+    int32_t position[PTZ_FLEET_AXES] = { 1, 2, 3, 4 };
+    ptz_notify_update(&notify, position);
+    CHECK(ptz_notify_take(&notify, 0) != 0);
+    set_pan(position, 7);
+    ptz_notify_update(&notify, position);
+
+    // A rate of 0 stops them, even with a change waiting.
+    ptz_notify_subscribe(&notify, 0);
+    CHECK(!ptz_notify_active(&notify));
+    ptz_notify_update(&notify, position);
+    CHECK(ptz_notify_pending(&notify) == 0);
+    CHECK(ptz_notify_take(&notify, 10000 * MS) == 0);
+    CHECK(ptz_notify_next(&notify) == UINT64_MAX);
+
+    // Subscribing again starts over with everything.
+    ptz_notify_subscribe(&notify, 30);
+    CHECK(notify.interval == 1000000000ull / 30);
+    ptz_notify_update(&notify, position);
+    CHECK(ptz_notify_take(&notify, 10000 * MS) == (PTZ_NOTIFY_PAN_TILT | PTZ_NOTIFY_LENS));
+}
+
+static void test_frames(void) {
+    int messageType;
+    union jr_viscaMessageParameters parameters;
+    uint8_t sender, receiver;
+
+    // 8x 01 7F 01 0p 0q FF: 30 a second, then 00 to stop.
+    uint8_t subscribe[] = { 0x81, 0x01, 0x7f, 0x01, 0x01, 0x0e, 0xff };
+    CHECK(jr_viscaDecodeMessage(subscribe, sizeof(subscribe), &messageType, &parameters, &sender, &receiver) == 7);
+    CHECK(messageType == JR_VISCA_MESSAGE_NOTIFY_SUBSCRIBE);
+    CHECK(parameters.int16Parameters.int16Value == 30);
+    uint8_t unsubscribe[] = { 0x81, 0x01, 0x7f, 0x01, 0x00, 0x00, 0xff };
+    CHECK(jr_viscaDecodeMessage(unsubscribe, sizeof(unsubscribe), &messageType, &parameters, &sender, &receiver) == 7);
+    CHECK(messageType == JR_VISCA_MESSAGE_NOTIFY_SUBSCRIBE);
+    CHECK(parameters.int16Parameters.int16Value == 0);
+    uint8_t data[JR_VISCA_MAX_ENCODED_MESSAGE_DATA_LENGTH];
+    parameters.int16Parameters.int16Value = 30;
+    CHECK(jr_viscaEncodeMessage(data, sizeof(data), JR_VISCA_MESSAGE_NOTIFY_SUBSCRIBE, parameters, 0, 1) == 7);
+    CHECK(memcmp(data, subscribe, sizeof(subscribe)) == 0);
+
+    // y0 07 7F 01 pan tilt FF and y0 07 7F 02 zoom focus FF, negative positions in two's complement.
+    parameters.panTiltPositionInqResponseParameters.panPosition = 0x1234;
+    parameters.panTiltPositionInqResponseParameters.tiltPosition = -2;
+    const uint8_t panTilt[] = { 0x90, 0x07, 0x7f, 0x01, 0x01, 0x02, 0x03, 0x04, 0x0f, 0x0f, 0x0f, 0x0e, 0xff };
+    CHECK(jr_viscaEncodeMessage(data, sizeof(data), JR_VISCA_MESSAGE_PAN_TILT_NOTIFY, parameters, 1, 0) == 13);
+    CHECK(memcmp(data, panTilt, sizeof(panTilt)) == 0);
+    memset(&parameters, 0, sizeof(parameters));
+    CHECK(jr_viscaDecodeMessage(data, 13, &messageType, &parameters, &sender, &receiver) == 13);
+    CHECK(messageType == JR_VISCA_MESSAGE_PAN_TILT_NOTIFY);
+    CHECK(parameters.panTiltPositionInqResponseParameters.panPosition == 0x1234);
+    CHECK(parameters.panTiltPositionInqResponseParameters.tiltPosition == -2);
+    CHECK(sender == 1 && receiver == 0);
+
+    parameters.lensNotifyParameters.zoomPosition = 0x4000;
+    parameters.lensNotifyParameters.focusPosition = 0x0abc;
+    const uint8_t lens[] = { 0x90, 0x07, 0x7f, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x0a, 0x0b, 0x0c, 0xff };
+    CHECK(jr_viscaEncodeMessage(data, sizeof(data), JR_VISCA_MESSAGE_LENS_NOTIFY, parameters, 1, 0) == 13);
+    CHECK(memcmp(data, lens, sizeof(lens)) == 0);
+    CHECK(jr_viscaDecodeMessage(data, 13, &messageType, &parameters, &sender, &receiver) == 13);
+    CHECK(messageType == JR_VISCA_MESSAGE_LENS_NOTIFY);
+    CHECK(parameters.lensNotifyParameters.zoomPosition == 0x4000);
+    CHECK(parameters.lensNotifyParameters.focusPosition == 0x0abc);
+}
+
+int main(void) {
+    test_rate();
+    test_unsubscribe();
+    test_frames();
+    return ptz_test_result();
+}
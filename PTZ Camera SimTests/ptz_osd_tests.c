@@ -0,0 +1,236 @@
+//
+//  ptz_osd_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The OSD's blend against exact integer arithmetic, and its sprites: only cells that changed are drawn
+//  again, and each scale keeps its own sprite.
+//
+
+#include "ptz_osd.h"
+#include "ptz_test.h"
+
+#include <string.h>
+
+// round(x / 255), the division ptz_osd_blend's div255 stands in for.
+static unsigned reference_div255(unsigned x) {
+    return (2 * x + 255) / 510;
+}
+
+static uint8_t reference_blend(uint8_t s, uint8_t sa, uint8_t d, unsigned opacity) {
+    unsigned a = (sa * opacity + 128) >> 8;
+    return (uint8_t)(((s * opacity + 128) >> 8) + reference_div255(d * (255 - a)));
+}
+
+// Every premultiplied source against every destination byte, at a few opacities. 259 pixels a row,
+// so 256 go through the vector loop and the last 3 through the scalar one.
+static void test_blend(void) {
+    const int width = 259;
+    ptz_image src = { 0 }, dst = { 0 };
+    CHECK(ptz_image_alloc(&src, width, 256) == 0);
+    CHECK(ptz_image_alloc(&dst, width, 256) == 0);
+    const unsigned opacities[] = { 256, 255, 200, 128, 77, 1, 0 };
+    int mismatches = 0;
+    for (size_t o = 0; o < sizeof(opacities) / sizeof(opacities[0]); o++) {
+        for (int alpha = 0; alpha < 256; alpha++) {
+            // Color can be anything up to alpha; row c has color c.
+            for (int c = 0; c <= alpha; c++) {
+                uint8_t *s = ptz_image_row(&src, c);
+                uint8_t *d = ptz_image_row(&dst, c);
+                for (int x = 0; x < width; x++) {
+                    uint8_t dv = (uint8_t)x;
+                    s[x * 4 + 0] = (uint8_t)c;
+                    s[x * 4 + 1] = (uint8_t)(c / 2);
+                    s[x * 4 + 2] = (uint8_t)(alpha - c);
+                    s[x * 4 + 3] = (uint8_t)alpha;
+                    d[x * 4 + 0] = dv;
+                    d[x * 4 + 1] = (uint8_t)(255 - dv);
+                    d[x * 4 + 2] = (uint8_t)(dv * 7);
+                    d[x * 4 + 3] = (uint8_t)(dv | 0x80);
+                }
+            }
+            ptz_image srcRows = src, dstRows = dst;
+            srcRows.height = dstRows.height = alpha + 1;
+            ptz_osd_blend(&srcRows, &dstRows, 0, 0, opacities[o]);
+            for (int c = 0; c <= alpha; c++) {
+                const uint8_t *s = ptz_image_row(&src, c);
+                const uint8_t *d = ptz_image_row(&dst, c);
+                for (int x = 0; x < width; x++) {
+                    uint8_t dv = (uint8_t)x;
+                    const uint8_t before[4] = { dv, (uint8_t)(255 - dv), (uint8_t)(dv * 7), (uint8_t)(dv | 0x80) };
+                    for (int k = 0; k < 4; k++) {
+                        uint8_t expected = reference_blend(s[x * 4 + k], (uint8_t)alpha, before[k], opacities[o]);
+                        if (d[x * 4 + k] != expected && mismatches++ < 5) {
+                            fprintf(stderr, "opacity %u src %u/%d dst %u: %u, expected %u\n", opacities[o],
+                                    s[x * 4 + k], alpha, before[k], d[x * 4 + k], expected);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+
+    // Blending at an offset leaves everything outside the sprite alone.
+    ptz_image small = { 0 };
+    CHECK(ptz_image_alloc(&small, 5, 3) == 0);
+    memset(small.pixels, 0xff, (size_t)small.stride * small.height);
+    memset(dst.pixels, 0x10, (size_t)dst.stride * dst.height);
+    ptz_osd_blend(&small, &dst, 7, 11, 256);
+    for (int y = 0; y < 20; y++) {
+        const uint8_t *d = ptz_image_row(&dst, y);
+        for (int x = 0; x < 20; x++) {
+            int inside = x >= 7 && x < 12 && y >= 11 && y < 14;
+            CHECK(d[x * 4] == (inside ? 0xff : 0x10));
+        }
+    }
+    ptz_image_free(&small);
+    ptz_image_free(&src);
+    ptz_image_free(&dst);
+}
+
+static ptz_osd_sprite *sprite_with_scale(ptz_osd *osd, int scale) {
+    for (int i = 0; i < PTZ_OSD_SPRITES; i++) {
+        if (osd->sprites[i].scale == scale) {
+            return &osd->sprites[i];
+        }
+    }
+    return NULL;
+}
+
+static uint8_t *cell_pixel(ptz_osd_sprite *sprite, int row, int column) {
+    return ptz_image_row(&sprite->image, row * PTZ_OSD_CELL_HEIGHT * sprite->scale)
+         + column * PTZ_OSD_CELL_WIDTH * sprite->scale * 4;
+}
+
+// A frame just big enough for the font at `scale`.
+static void alloc_frame(ptz_image *frame, int scale) {
+    CHECK(ptz_image_alloc(frame, PTZ_OSD_COLUMNS * PTZ_OSD_CELL_WIDTH * 2 * scale,
+                          PTZ_OSD_ROWS * PTZ_OSD_CELL_HEIGHT * 2 * scale) == 0);
+}
+
+// Moving the cursor redraws the two rows it left and landed on, and nothing else.
+static void test_menu_redraw(void) {
+    ptz_osd osd;
+    ptz_osd_init(&osd);
+    ptz_camera_state state;
+    memset(&state, 0, sizeof(state));
+    state.presetSpeed = 12;
+    state.focus = 0x80;
+    state.menuItem = 1;
+    ptz_osd_menu(&osd, &state, "10.0.0.7");
+    ptz_image frame = { 0 };
+    alloc_frame(&frame, 1);
+    CHECK(ptz_osd_draw(&osd, &frame, 1) == 0);
+    ptz_osd_sprite *sprite = sprite_with_scale(&osd, 1);
+    CHECK(sprite != NULL);
+    if (sprite == NULL) {
+        return;
+    }
+    CHECK(memcmp(sprite->cells, osd.cells, sizeof(osd.cells)) == 0);
+
+    // Mark the top left pixel of every cell; whatever gets drawn again loses its mark.
+    for (int row = 0; row < PTZ_OSD_ROWS; row++) {
+        for (int column = 0; column < PTZ_OSD_COLUMNS; column++) {
+            memset(cell_pixel(sprite, row, column), 0x5a, 4);
+        }
+    }
+    state.menuItem = 3;
+    ptz_osd_menu(&osd, &state, "10.0.0.7");
+    CHECK(ptz_osd_draw(&osd, &frame, 1) == 0);
+    CHECK(sprite_with_scale(&osd, 1) == sprite);
+    CHECK(memcmp(sprite->cells, osd.cells, sizeof(osd.cells)) == 0);
+    int redrawn = 0;
+    for (int row = 0; row < PTZ_OSD_ROWS; row++) {
+        for (int column = 0; column < PTZ_OSD_COLUMNS; column++) {
+            int marked = cell_pixel(sprite, row, column)[0] == 0x5a;
+            int cursorRow = row == 1 + 2 || row == 3 + 2;
+            CHECK(marked == !cursorRow);
+            redrawn += !marked;
+        }
+    }
+    CHECK(redrawn == 2 * PTZ_OSD_COLUMNS);
+
+    // Drawing again with nothing changed draws nothing.
+    memset(cell_pixel(sprite, 3, 0), 0x5a, 4);
+    CHECK(ptz_osd_draw(&osd, &frame, 1) == 0);
+    CHECK(cell_pixel(sprite, 3, 0)[0] == 0x5a);
+
+    // One value changing redraws just its cells.
+    state.focus = 0x81;
+    ptz_osd_menu(&osd, &state, "10.0.0.7");
+    CHECK(ptz_osd_draw(&osd, &frame, 1) == 0);
+    CHECK(cell_pixel(sprite, 3, 0)[0] == 0x5a);
+    // "128" to "129": only the last digit.
+    CHECK(cell_pixel(sprite, 4, 15)[0] == 0x5a);
+    CHECK(cell_pixel(sprite, 4, 17)[0] != 0x5a);
+    ptz_image_free(&frame);
+    ptz_osd_free(&osd);
+}
+
+// Each scale has its own sprite, each brought up to date on its own, and the least recently drawn one goes first.
+static void test_scales(void) {
+    ptz_osd osd;
+    ptz_osd_init(&osd);
+    ptz_osd_set_text(&osd, 1, 2, "PTZ 42", 0);
+    ptz_osd_set_text(&osd, 3, 0, "CURSOR", 1);
+    ptz_image frames[PTZ_OSD_SPRITES + 2];
+    memset(frames, 0, sizeof(frames));
+    for (int scale = 1; scale <= PTZ_OSD_SPRITES; scale++) {
+        alloc_frame(&frames[scale], scale);
+        CHECK(ptz_osd_draw(&osd, &frames[scale], 1) == 0);
+    }
+    for (int scale = 1; scale <= PTZ_OSD_SPRITES; scale++) {
+        ptz_osd_sprite *sprite = sprite_with_scale(&osd, scale);
+        CHECK(sprite != NULL);
+        if (sprite == NULL) {
+            continue;
+        }
+        CHECK(sprite->image.width == PTZ_OSD_COLUMNS * PTZ_OSD_CELL_WIDTH * scale);
+        CHECK(sprite->image.height == PTZ_OSD_ROWS * PTZ_OSD_CELL_HEIGHT * scale);
+    }
+
+    // A change drawn at scale 1 still shows up at scale 2 the next time that's drawn.
+    ptz_osd_set_text(&osd, 5, 4, "AB", 0);
+    CHECK(ptz_osd_draw(&osd, &frames[1], 1) == 0);
+    CHECK(memcmp(sprite_with_scale(&osd, 2)->cells, osd.cells, sizeof(osd.cells)) != 0);
+    CHECK(ptz_osd_draw(&osd, &frames[2], 1) == 0);
+    CHECK(memcmp(sprite_with_scale(&osd, 2)->cells, osd.cells, sizeof(osd.cells)) == 0);
+
+    // Every scale is the scale 1 sprite with each pixel repeated.
+    ptz_osd_sprite *one = sprite_with_scale(&osd, 1);
+    for (int scale = 2; scale <= PTZ_OSD_SPRITES; scale++) {
+        CHECK(ptz_osd_draw(&osd, &frames[scale], 1) == 0);
+        ptz_osd_sprite *sprite = sprite_with_scale(&osd, scale);
+        int differences = 0;
+        for (int y = 0; y < sprite->image.height; y++) {
+            const uint8_t *big = ptz_image_row(&sprite->image, y);
+            const uint8_t *small = ptz_image_row(&one->image, y / scale);
+            for (int x = 0; x < sprite->image.width; x++) {
+                differences += memcmp(big + x * 4, small + (x / scale) * 4, 4) != 0;
+            }
+        }
+        CHECK(differences == 0);
+    }
+
+    // A fifth scale takes the slot of the one drawn longest ago, which is 1 now.
+    alloc_frame(&frames[PTZ_OSD_SPRITES + 1], PTZ_OSD_SPRITES + 1);
+    CHECK(ptz_osd_draw(&osd, &frames[PTZ_OSD_SPRITES + 1], 1) == 0);
+    CHECK(sprite_with_scale(&osd, PTZ_OSD_SPRITES + 1) != NULL);
+    CHECK(sprite_with_scale(&osd, 1) == NULL);
+    for (int scale = 2; scale <= PTZ_OSD_SPRITES; scale++) {
+        CHECK(sprite_with_scale(&osd, scale) != NULL);
+    }
+    for (int i = 0; i < PTZ_OSD_SPRITES + 2; i++) {
+        ptz_image_free(&frames[i]);
+    }
+    ptz_osd_free(&osd);
+}
+
+int main(void) {
+    test_blend();
+    test_menu_redraw();
+    test_scales();
+    return ptz_test_result();
+}
@@ -0,0 +1,90 @@
+//
+//  ptz_profile_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_profile.h"
+#include "ptz_test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static void write_file(const char *path, const char *text) {
+    FILE *file = fopen(path, "w");
+    fputs(text, file);
+    fclose(file);
+}
+
+static void test_sim(void) {
+    ptz_profile profile;
+    CHECK(ptz_profile_find(&profile, NULL) == 0);
+    CHECK(strcmp(profile.name, "sim") == 0);
+    // `speed` units a 100ms step, as the app has always moved.
+    for (int speed = 1; speed <= PTZ_PROFILE_PAN_SPEEDS; speed++) {
+        CHECK(ptz_profile_pan_step(&profile, speed, 100000000) == speed);
+    }
+    for (int speed = 1; speed <= PTZ_PROFILE_TILT_SPEEDS; speed++) {
+        CHECK(ptz_profile_tilt_step(&profile, speed, 100000000) == speed);
+    }
+    CHECK(ptz_profile_tilt_step(&profile, 0x18, 100000000) == PTZ_PROFILE_TILT_SPEEDS);
+    uint64_t rng = ptz_profile_rng(&profile);
+    CHECK(ptz_profile_ack_ns(&profile, 1, &rng) == 0);
+    CHECK(ptz_profile_completion_ns(&profile, 1, &rng) == 0);
+}
+
+static void test_file(void) {
+    write_file("ptz_profile_tests.profile",
+               "# A test camera\n"
+               "base = sony\n"
+               "quirks = strict_recall, fx_off_reply\n"
+               "seed = 7\n"
+               "pan_speeds = 2 200\n"
+               "ack = fixed 5\n"
+               "ack.0x947 = uniform 10 20\n"
+               "completion.20 = normal 50 0\n");
+    ptz_profile profile;
+    CHECK(ptz_profile_find(&profile, "ptz_profile_tests.profile") == 0);
+    CHECK(strcmp(profile.name, "ptz_profile_tests.profile") == 0);
+    CHECK(profile.quirks == (PTZ_QUIRK_STRICT_RECALL | PTZ_QUIRK_FX_OFF_REPLY));
+    CHECK(profile.stepMs == 50);
+    CHECK(profile.seed == 7);
+    CHECK(ptz_profile_pan_step(&profile, 1, 50000000) < ptz_profile_pan_step(&profile, 0x18, 50000000));
+
+    uint64_t rng = ptz_profile_rng(&profile);
+    CHECK(ptz_profile_ack_ns(&profile, 1, &rng) == 5000000);
+    for (int i = 0; i < 1000; i++) {
+        uint64_t delay = ptz_profile_ack_ns(&profile, 0x947, &rng);
+        CHECK(delay >= 10000000 && delay <= 20000000);
+    }
+    CHECK(ptz_profile_completion_ns(&profile, 20, &rng) == 50000000);
+
+    // The same seed, the same delays.
+    ptz_profile sony;
+    CHECK(ptz_profile_builtin(&sony, "sony") == 0);
+    uint64_t a = 3, b = 3;
+    for (int i = 0; i < 100; i++) {
+        CHECK(ptz_profile_completion_ns(&sony, 1, &a) == ptz_profile_completion_ns(&sony, 1, &b));
+    }
+    remove("ptz_profile_tests.profile");
+}
+
+static void test_errors(void) {
+    ptz_profile profile;
+    write_file("ptz_profile_tests.profile", "name = late\nbase = sony\n");
+    CHECK(ptz_profile_load(&profile, "ptz_profile_tests.profile") == -1);
+    write_file("ptz_profile_tests.profile", "ack = gaussian 3\n");
+    CHECK(ptz_profile_load(&profile, "ptz_profile_tests.profile") == -1);
+    write_file("ptz_profile_tests.profile", "pan_speeds = 1 2 3\n");
+    CHECK(ptz_profile_load(&profile, "ptz_profile_tests.profile") == -1);
+    remove("ptz_profile_tests.profile");
+    CHECK(ptz_profile_find(&profile, "nonesuch") == -1);
+}
+
+int main(void) {
+    test_sim();
+    test_file();
+    test_errors();
+    return ptz_test_result();
+}
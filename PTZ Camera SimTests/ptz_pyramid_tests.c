@@ -0,0 +1,196 @@
+//
+//  ptz_pyramid_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The pyramid cache file: a written pyramid maps back identical, and anything that isn't exactly what
+//  was written for this key (another key, a short file, a damaged header) is turned away.
+//
+
+#include "ptz_pyramid.h"
+#include "ptz_test.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PATH "ptz_pyramid_tests.cache"
+#define KEY 0x0123456789abcdefULL
+
+// Where ptz_pyramid.c's header keeps things; the tests damage the file through these.
+#define HEADER_LEVEL_COUNT 12
+#define HEADER_LEVELS 32
+#define HEADER_LEVEL_SIZE 24
+
+static void fill_noise(ptz_image *image, int width, int height) {
+    CHECK(ptz_image_alloc(image, width, height) == 0);
+    uint32_t seed = 2463534242u;
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = ptz_image_row(image, y);
+        for (int x = 0; x < width * 4; x++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            row[x] = (uint8_t)seed;
+        }
+    }
+}
+
+static int same_levels(const ptz_pyramid *a, const ptz_pyramid *b) {
+    if (a->levelCount != b->levelCount) {
+        return 0;
+    }
+    for (int i = 0; i < a->levelCount; i++) {
+        const ptz_image *la = &a->levels[i], *lb = &b->levels[i];
+        if (la->width != lb->width || la->height != lb->height || la->stride != lb->stride) {
+            return 0;
+        }
+        for (int y = 0; y < la->height; y++) {
+            if (memcmp(ptz_image_row(la, y), ptz_image_row(lb, y), (size_t)la->width * 4) != 0) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static int is_empty(const ptz_pyramid *pyramid) {
+    return pyramid->levelCount == 0 && pyramid->block == NULL && !pyramid->mapped;
+}
+
+static void poke(off_t offset, uint32_t value) {
+    int fd = open(PATH, O_WRONLY);
+    CHECK(fd >= 0);
+    CHECK(pwrite(fd, &value, sizeof(value), offset) == sizeof(value));
+    close(fd);
+}
+
+static void poke64(off_t offset, uint64_t value) {
+    int fd = open(PATH, O_WRONLY);
+    CHECK(fd >= 0);
+    CHECK(pwrite(fd, &value, sizeof(value), offset) == sizeof(value));
+    close(fd);
+}
+
+static void test_round_trip(const ptz_pyramid *built) {
+    unlink(PATH);
+    ptz_pyramid mapped;
+    // No cache yet.
+    CHECK(ptz_pyramid_map(&mapped, PATH, KEY) == -1);
+    CHECK(is_empty(&mapped));
+
+    CHECK(ptz_pyramid_write(built, PATH, KEY) == 0);
+    char tempPath[256];
+    snprintf(tempPath, sizeof(tempPath), "%s.%d.tmp", PATH, (int)getpid());
+    CHECK(access(tempPath, F_OK) == -1);
+    struct stat info;
+    CHECK(stat(PATH, &info) == 0 && (size_t)info.st_size == built->blockSize);
+
+    CHECK(ptz_pyramid_map(&mapped, PATH, KEY) == 0);
+    CHECK(mapped.mapped);
+    CHECK(same_levels(built, &mapped));
+    // Page-aligned levels, straight out of the mapping.
+    for (int i = 0; i < mapped.levelCount; i++) {
+        CHECK(((uintptr_t)mapped.levels[i].pixels & 4095) == 0);
+    }
+
+    // A mapped pyramid can be written again, as another key.
+    CHECK(ptz_pyramid_write(&mapped, PATH ".2", KEY + 1) == 0);
+    ptz_pyramid again;
+    CHECK(ptz_pyramid_map(&again, PATH ".2", KEY + 1) == 0);
+    CHECK(same_levels(built, &again));
+    ptz_pyramid_free(&again);
+    ptz_pyramid_free(&mapped);
+    CHECK(is_empty(&mapped));
+    unlink(PATH ".2");
+}
+
+static void test_wrong_key(const ptz_pyramid *built) {
+    CHECK(ptz_pyramid_write(built, PATH, KEY) == 0);
+    ptz_pyramid mapped;
+    CHECK(ptz_pyramid_map(&mapped, PATH, KEY ^ 1) == -1);
+    CHECK(is_empty(&mapped));
+    CHECK(ptz_pyramid_map(&mapped, PATH, 0) == -1);
+    CHECK(is_empty(&mapped));
+}
+
+static void test_truncated(const ptz_pyramid *built) {
+    ptz_pyramid mapped;
+    // A page short, a byte short, and too short for a header at all.
+    const off_t sizes[] = { (off_t)built->blockSize - 4096, (off_t)built->blockSize - 1, 100, 0 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        CHECK(ptz_pyramid_write(built, PATH, KEY) == 0);
+        CHECK(truncate(PATH, sizes[i]) == 0);
+        CHECK(ptz_pyramid_map(&mapped, PATH, KEY) == -1);
+        CHECK(is_empty(&mapped));
+    }
+    // And one with junk on the end is no better.
+    CHECK(ptz_pyramid_write(built, PATH, KEY) == 0);
+    CHECK(truncate(PATH, (off_t)built->blockSize + 4096) == 0);
+    CHECK(ptz_pyramid_map(&mapped, PATH, KEY) == -1);
+}
+
+static void test_bad_header(const ptz_pyramid *built) {
+    const off_t level1 = HEADER_LEVELS + HEADER_LEVEL_SIZE;
+    const ptz_image *l1 = &built->levels[1];
+    const struct {
+        off_t offset;
+        uint32_t value;
+    } damage[] = {
+        { 0, 0x4f4f4f4f },                                      // Magic.
+        { 8, 0x04030201 },                                      // Other byte order.
+        { HEADER_LEVEL_COUNT, 0 },
+        { HEADER_LEVEL_COUNT, PTZ_PYRAMID_MAX_LEVELS + 1 },
+        { level1 + 0, 0 },                                      // Width.
+        { level1 + 4, 0 },                                      // Height.
+        { level1 + 8, (uint32_t)l1->width * 4 - 16 },           // Stride too short for a row.
+        { level1 + 8, (uint32_t)l1->stride + 4 },               // Stride not a multiple of 16.
+        { level1 + 4, 1u << 30 },                               // Rows past the end of the file.
+    };
+    ptz_pyramid mapped;
+    for (size_t i = 0; i < sizeof(damage) / sizeof(damage[0]); i++) {
+        CHECK(ptz_pyramid_write(built, PATH, KEY) == 0);
+        poke(damage[i].offset, damage[i].value);
+        if (ptz_pyramid_map(&mapped, PATH, KEY) != -1) {
+            fprintf(stderr, "damage %zu was accepted\n", i);
+            CHECK(!"damaged header rejected");
+            ptz_pyramid_free(&mapped);
+        }
+        CHECK(is_empty(&mapped));
+    }
+    // Level offsets: unaligned, inside the header page, and past the end.
+    const uint64_t offsets[] = { 4096 * 2 + 64, 0, (uint64_t)built->blockSize + 4096 };
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        CHECK(ptz_pyramid_write(built, PATH, KEY) == 0);
+        poke64(level1 + 16, offsets[i]);
+        CHECK(ptz_pyramid_map(&mapped, PATH, KEY) == -1);
+        CHECK(is_empty(&mapped));
+    }
+    // The recorded size has to be the file's.
+    CHECK(ptz_pyramid_write(built, PATH, KEY) == 0);
+    poke64(24, (uint64_t)built->blockSize - 4096);
+    CHECK(ptz_pyramid_map(&mapped, PATH, KEY) == -1);
+}
+
+int main(void) {
+    ptz_image base = { 0 };
+    // Odd sizes, so the levels round up.
+    fill_noise(&base, 517, 301);
+    ptz_pyramid built;
+    CHECK(ptz_pyramid_build(&built, &base) == 0);
+    ptz_image_free(&base);
+    CHECK(built.levelCount == 3);
+
+    test_round_trip(&built);
+    test_wrong_key(&built);
+    test_truncated(&built);
+    test_bad_header(&built);
+
+    ptz_pyramid_free(&built);
+    unlink(PATH);
+    return ptz_test_result();
+}
@@ -0,0 +1,293 @@
+//
+//  ptz_render_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  ptz_render against a plain floating-point bilinear resampler: the fixed-point weights and the
+//  rounding between passes are allowed to cost a couple of levels, no more.
+//
+
+#include "ptz_render.h"
+#include "ptz_pyramid.h"
+#include "ptz_test.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Two 8-bit weights and three roundings.
+#define PTZ_RENDER_TOLERANCE 2
+
+static uint32_t random_state = 0x2545F491;
+
+static uint32_t next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+// Noise, the hardest thing to resample, over a gradient so a misplaced row or column shows up too.
+static void fill_test_image(ptz_image *image, int width, int height) {
+    CHECK(ptz_image_alloc(image, width, height) == 0);
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = ptz_image_row(image, y);
+        for (int x = 0; x < width; x++) {
+            uint32_t noise = next_random();
+            row[x * 4 + 0] = (uint8_t)(x * 255 / width / 2 + (noise & 0x7f));
+            row[x * 4 + 1] = (uint8_t)(y * 255 / height / 2 + ((noise >> 8) & 0x7f));
+            row[x * 4 + 2] = (uint8_t)(noise >> 16);
+            row[x * 4 + 3] = 0xff;
+        }
+    }
+}
+
+static double clamp_coordinate(double v, int size) {
+    return v < 0 ? 0 : v > size - 1 ? size - 1 : v;
+}
+
+// Pixel centers map to pixel centers; outside the source the edge pixels carry on.
+static double reference_sample(const ptz_image *src, double sx, double sy, int channel) {
+    sx = clamp_coordinate(sx, src->width);
+    sy = clamp_coordinate(sy, src->height);
+    int x0 = (int)sx, y0 = (int)sy;
+    int x1 = x0 + 1 < src->width ? x0 + 1 : x0;
+    int y1 = y0 + 1 < src->height ? y0 + 1 : y0;
+    double fx = sx - x0, fy = sy - y0;
+    const uint8_t *r0 = ptz_image_row(src, y0), *r1 = ptz_image_row(src, y1);
+    double top = r0[x0 * 4 + channel] * (1 - fx) + r0[x1 * 4 + channel] * fx;
+    double bottom = r1[x0 * 4 + channel] * (1 - fx) + r1[x1 * 4 + channel] * fx;
+    return top * (1 - fy) + bottom * fy;
+}
+
+// The largest difference from the reference, in levels.
+static int compare_to_reference(const ptz_image *src, const ptz_viewport *viewport, const ptz_image *dst) {
+    double scaleX = viewport->width / dst->width;
+    double scaleY = viewport->height / dst->height;
+    int worst = 0;
+    for (int y = 0; y < dst->height; y++) {
+        const uint8_t *row = ptz_image_row(dst, y);
+        double sy = (y + 0.5) * scaleY + viewport->y - 0.5;
+        for (int x = 0; x < dst->width; x++) {
+            double sx = (x + 0.5) * scaleX + viewport->x - 0.5;
+            for (int c = 0; c < 3; c++) {
+                int expected = (int)lround(reference_sample(src, sx, sy, c));
+                int difference = abs(row[x * 4 + c] - expected);
+                if (difference > worst) {
+                    worst = difference;
+                }
+            }
+        }
+    }
+    return worst;
+}
+
+static int max_difference(const ptz_image *a, const ptz_image *b) {
+    int worst = 0;
+    for (int y = 0; y < a->height; y++) {
+        const uint8_t *ra = ptz_image_row(a, y), *rb = ptz_image_row(b, y);
+        for (int i = 0; i < a->width * 4; i++) {
+            int difference = abs(ra[i] - rb[i]);
+            if (difference > worst) {
+                worst = difference;
+            }
+        }
+    }
+    return worst;
+}
+
+static void default_state(ptz_camera_state *state) {
+    memset(state, 0, sizeof(*state));
+    state->focus = 0x30;
+}
+
+static void test_viewport_for_state(void) {
+    ptz_camera_state state;
+    default_state(&state);
+    ptz_viewport viewport;
+
+    // Centered and as wide as the widest zoom allows; a 4:3 source letterboxed to 16:9.
+    ptz_viewport_for_state(&state, 1600, 1200, 640, 360, &viewport);
+    CHECK(fabsf(viewport.width - 1600 / PTZ_MIN_MAGNIFICATION) < 0.01f);
+    CHECK(fabsf(viewport.height - 900 / PTZ_MIN_MAGNIFICATION) < 0.01f);
+    CHECK(fabsf(viewport.x - (1600 - viewport.width) / 2) < 0.01f);
+    CHECK(fabsf(viewport.y - (1200 - viewport.height) / 2) < 0.01f);
+
+    // All the way in, the whole magnification range.
+    state.zoom = PTZ_ZOOM_MAX;
+    ptz_viewport_for_state(&state, 1600, 1200, 640, 360, &viewport);
+    CHECK(fabsf(viewport.width - 1600 / PTZ_MAX_MAGNIFICATION) < 0.01f);
+
+    // Full left and full up put the view in the top left corner; past the end stops stays there.
+    state.pan = PTZ_PT_MIN;
+    state.tilt = PTZ_PT_MAX;
+    ptz_viewport_for_state(&state, 1600, 1200, 640, 360, &viewport);
+    CHECK(viewport.x == 0 && viewport.y == 0);
+    state.pan = PTZ_PT_MIN * 2;
+    state.tilt = PTZ_PT_MAX * 2;
+    ptz_viewport_for_state(&state, 1600, 1200, 640, 360, &viewport);
+    CHECK(viewport.x == 0 && viewport.y == 0);
+
+    // Full right and full down, the bottom right.
+    state.pan = PTZ_PT_MAX;
+    state.tilt = PTZ_PT_MIN;
+    ptz_viewport_for_state(&state, 1600, 1200, 640, 360, &viewport);
+    CHECK(fabsf(viewport.x + viewport.width - 1600) < 0.01f);
+    CHECK(fabsf(viewport.y + viewport.height - 1200) < 0.01f);
+}
+
+static void test_render_viewport(void) {
+    ptz_image src = { 0 }, dst = { 0 };
+    fill_test_image(&src, 333, 201);
+    ptz_renderer renderer;
+    ptz_renderer_init(&renderer);
+
+    const struct {
+        ptz_viewport viewport;
+        int width, height;
+    } cases[] = {
+        { { 0, 0, 333, 201 }, 333, 201 },           // 1:1
+        { { 10.25f, 7.5f, 60.3f, 33.9f }, 160, 90 },  // Enlarging, off the pixel grid.
+        { { 3.7f, 1.2f, 320.0f, 180.0f }, 97, 55 },   // Shrinking.
+        { { 100, 50, 150, 40 }, 75, 80 },            // Shrinking across, enlarging down.
+        { { -4, -3, 340, 206 }, 123, 77 },           // Hanging over every edge.
+        { { 320, 190, 13, 11 }, 37, 29 },            // Right in the bottom corner.
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        CHECK(ptz_image_alloc(&dst, cases[i].width, cases[i].height) == 0);
+        CHECK(ptz_render_viewport(&renderer, &src, &cases[i].viewport, &dst) == 0);
+        int difference = compare_to_reference(&src, &cases[i].viewport, &dst);
+        if (difference > PTZ_RENDER_TOLERANCE) {
+            fprintf(stderr, "viewport %zu is off by %d\n", i, difference);
+        }
+        CHECK(difference <= PTZ_RENDER_TOLERANCE);
+    }
+
+    // ptz_render_frame is the same thing with the viewport from the state.
+    ptz_camera_state state;
+    default_state(&state);
+    state.pan = 0x40;
+    state.tilt = -0x30;
+    state.zoom = 0x20;
+    ptz_viewport viewport;
+    CHECK(ptz_image_alloc(&dst, 128, 72) == 0);
+    ptz_viewport_for_state(&state, src.width, src.height, dst.width, dst.height, &viewport);
+    CHECK(ptz_render_frame(&renderer, &src, &state, &dst) == 0);
+    CHECK(compare_to_reference(&src, &viewport, &dst) <= PTZ_RENDER_TOLERANCE);
+
+    ptz_renderer_destroy(&renderer);
+    ptz_image_free(&dst);
+    ptz_image_free(&src);
+}
+
+// A scrolled frame looks like a full render of where the view is now.
+static void test_render_scroll(void) {
+    ptz_image src = { 0 }, frame = { 0 }, full = { 0 };
+    fill_test_image(&src, 640, 360);
+    ptz_renderer renderer;
+    ptz_renderer_init(&renderer);
+    CHECK(ptz_image_alloc(&frame, 160, 90) == 0);
+    CHECK(ptz_image_alloc(&full, 160, 90) == 0);
+
+    ptz_viewport viewport = { 200, 100, 240, 135 };
+    ptz_scroll_position position;
+    memset(&position, 0, sizeof(position));
+    CHECK(ptz_render_scroll(&renderer, &src, &viewport, NULL, &position, &frame) == 0);
+
+    // Whole output pixels at a time, so the copy lines up exactly: right and up, then left and down.
+    const float pixel = viewport.width / frame.width;
+    const int moves[][2] = { { 3, -2 }, { -7, 5 }, { 0, 1 } };
+    for (size_t i = 0; i < sizeof(moves) / sizeof(moves[0]); i++) {
+        viewport.x += moves[i][0] * pixel;
+        viewport.y += moves[i][1] * pixel;
+        CHECK(ptz_render_scroll(&renderer, &src, &viewport, &frame, &position, &frame) == 1);
+        CHECK(ptz_render_viewport(&renderer, &src, &viewport, &full) == 0);
+        CHECK(max_difference(&frame, &full) <= 1);
+    }
+
+    // Zooming can't scroll.
+    viewport.width *= 0.9f;
+    viewport.height *= 0.9f;
+    CHECK(ptz_render_scroll(&renderer, &src, &viewport, &frame, &position, &frame) == 0);
+    CHECK(ptz_render_viewport(&renderer, &src, &viewport, &full) == 0);
+    CHECK(max_difference(&frame, &full) == 0);
+
+    ptz_renderer_destroy(&renderer);
+    ptz_image_free(&full);
+    ptz_image_free(&frame);
+    ptz_image_free(&src);
+}
+
+// Each output size gets the smallest level that's no more than 2x down from it, whatever the window shows.
+static void test_pyramid_viewport(void) {
+    ptz_image base = { 0 }, dst = { 0 }, expected = { 0 };
+    fill_test_image(&base, 1280, 720);
+    ptz_pyramid pyramid;
+    memset(&pyramid, 0, sizeof(pyramid));
+    CHECK(ptz_pyramid_build(&pyramid, &base) == 0);
+    ptz_renderer renderer;
+    ptz_renderer_init(&renderer);
+    ptz_camera_state state;
+    default_state(&state);
+    state.pan = 0x30;
+
+    const struct {
+        uint32_t zoom;
+        int width, height;
+    } cases[] = {
+        { 0, 1280, 720 },       // A full-size snapshot of a wide shot needs the sensor.
+        { 0, 320, 180 },        // A thumbnail of the same shot doesn't.
+        { 0, 96, 54 },
+        { 0x80, 320, 180 },     // Zoomed in, a thumbnail is back to sensor pixels.
+    };
+    int levels[sizeof(cases) / sizeof(cases[0])];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        state.zoom = cases[i].zoom;
+        ptz_viewport full, viewport;
+        ptz_viewport_for_state(&state, base.width, base.height, cases[i].width, cases[i].height, &full);
+        int level = ptz_pyramid_viewport_for_state(&pyramid, &state, cases[i].width, cases[i].height, &viewport);
+        levels[i] = level;
+        CHECK(level >= 0 && level < pyramid.levelCount);
+        if (level < 0) {
+            continue;
+        }
+        const ptz_image *src = &pyramid.levels[level];
+        float scale = viewport.width / cases[i].width;
+        CHECK(scale <= 2.0f);
+        CHECK(level == 0 || scale >= 1.0f);
+        // The same part of the scene, in that level's pixels.
+        CHECK(fabsf(viewport.x / src->width - full.x / base.width) < 1e-4f);
+        CHECK(fabsf(viewport.width / src->width - full.width / base.width) < 1e-4f);
+
+        CHECK(ptz_image_alloc(&dst, cases[i].width, cases[i].height) == 0);
+        CHECK(ptz_image_alloc(&expected, cases[i].width, cases[i].height) == 0);
+        CHECK(ptz_render_pyramid_frame(&renderer, &pyramid, &state, &dst) == 0);
+        CHECK(ptz_render_viewport(&renderer, src, &viewport, &expected) == 0);
+        CHECK(max_difference(&dst, &expected) == 0);
+    }
+    CHECK(levels[0] == 0);
+    CHECK(levels[1] > 0);
+    CHECK(levels[2] > levels[1]);
+    CHECK(levels[3] == 0);
+
+    ptz_pyramid empty;
+    memset(&empty, 0, sizeof(empty));
+    ptz_viewport viewport;
+    CHECK(ptz_pyramid_viewport_for_state(&empty, &state, 320, 180, &viewport) == -1);
+
+    ptz_renderer_destroy(&renderer);
+    ptz_pyramid_free(&pyramid);
+    ptz_image_free(&expected);
+    ptz_image_free(&dst);
+    ptz_image_free(&base);
+}
+
+int main(void) {
+    test_viewport_for_state();
+    test_render_viewport();
+    test_render_scroll();
+    test_pyramid_viewport();
+    return ptz_test_result();
+}
@@ -0,0 +1,177 @@
+//
+//  ptz_scene_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The scene registry with two cameras acquiring at once: one load between them, one shared pyramid,
+//  and a failed load that leaves nothing behind so the next acquire tries again.
+//
+
+#include "ptz_scene.h"
+#include "ptz_test.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct loader_state {
+    ptz_scene_registry *registry;
+    int calls;                  // Atomically, through the registry lock.
+    int fail;
+    int waitForSecond;          // Hold the load until another acquire is waiting on it.
+} loader_state;
+
+static int scene_refs(ptz_scene_registry *registry, uint64_t key) {
+    int refs = 0;
+    pthread_mutex_lock(&registry->lock);
+    for (ptz_scene *scene = registry->scenes; scene != NULL; scene = scene->next) {
+        if (scene->key == key) {
+            refs = scene->refs;
+        }
+    }
+    pthread_mutex_unlock(&registry->lock);
+    return refs;
+}
+
+static int load(ptz_pyramid *pyramid, uint64_t key, void *context) {
+    loader_state *state = context;
+    pthread_mutex_lock(&state->registry->lock);
+    state->calls++;
+    pthread_mutex_unlock(&state->registry->lock);
+    if (state->waitForSecond) {
+        // The other camera has its reference once it's in acquire; it then has to wait for this load.
+        for (int i = 0; i < 5000 && scene_refs(state->registry, key) < 2; i++) {
+            struct timespec delay = { 0, 1000000 };
+            nanosleep(&delay, NULL);
+        }
+        CHECK(scene_refs(state->registry, key) == 2);
+    }
+    if (state->fail) {
+        return -1;
+    }
+    ptz_image base = { 0 };
+    if (ptz_image_alloc(&base, 128, 96) < 0) {
+        return -1;
+    }
+    memset(base.pixels, (int)(key & 0xff), (size_t)base.stride * base.height);
+    int result = ptz_pyramid_build(pyramid, &base);
+    ptz_image_free(&base);
+    return result;
+}
+
+static int load_nothing(ptz_pyramid *pyramid, uint64_t key, void *context) {
+    (void)pyramid;
+    (void)key;
+    (void)context;
+    return 0;
+}
+
+typedef struct camera {
+    ptz_scene_registry *registry;
+    loader_state *loader;
+    uint64_t key;
+    ptz_scene *scene;
+} camera;
+
+static void *acquire(void *context) {
+    camera *c = context;
+    c->scene = ptz_scene_acquire(c->registry, c->key, load, c->loader);
+    return NULL;
+}
+
+// Acquires `key` on two threads at once, the first one doing the load.
+static void acquire_twice(ptz_scene_registry *registry, loader_state *loader, uint64_t key, camera cameras[2]) {
+    for (int i = 0; i < 2; i++) {
+        cameras[i].registry = registry;
+        cameras[i].loader = loader;
+        cameras[i].key = key;
+        cameras[i].scene = NULL;
+    }
+    loader->waitForSecond = 1;
+    pthread_t threads[2];
+    pthread_create(&threads[0], NULL, acquire, &cameras[0]);
+    // Second only once the first has the scene listed and is loading it.
+    for (int i = 0; i < 5000 && scene_refs(registry, key) < 1; i++) {
+        struct timespec delay = { 0, 1000000 };
+        nanosleep(&delay, NULL);
+    }
+    pthread_create(&threads[1], NULL, acquire, &cameras[1]);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+    loader->waitForSecond = 0;
+}
+
+static void test_shared_load(void) {
+    ptz_scene_registry registry;
+    ptz_scene_registry_init(&registry);
+    loader_state loader = { &registry, 0, 0, 0 };
+    camera cameras[2];
+    acquire_twice(&registry, &loader, 0x42, cameras);
+    CHECK(loader.calls == 1);
+    CHECK(cameras[0].scene != NULL);
+    CHECK(cameras[0].scene == cameras[1].scene);
+    if (cameras[0].scene == NULL || cameras[0].scene != cameras[1].scene) {
+        return;
+    }
+    ptz_scene *scene = cameras[0].scene;
+    CHECK(scene->pyramid.levelCount > 0);
+    CHECK(ptz_image_row(&scene->pyramid.levels[0], 0)[0] == 0x42);
+    CHECK(scene->refs == 2);
+    CHECK(registry.count == 1);
+
+    // A later camera gets it without a load, and a different image is a different scene.
+    ptz_scene *third = ptz_scene_acquire(&registry, 0x42, load, &loader);
+    CHECK(third == scene);
+    CHECK(loader.calls == 1);
+    ptz_scene *other = ptz_scene_acquire(&registry, 0x43, load, &loader);
+    CHECK(other != NULL && other != scene);
+    CHECK(loader.calls == 2);
+    CHECK(registry.count == 2);
+
+    // The pyramid lasts until the last camera lets go.
+    ptz_scene_release(third);
+    ptz_scene_release(cameras[0].scene);
+    CHECK(registry.count == 2);
+    CHECK(scene_refs(&registry, 0x42) == 1);
+    ptz_scene_release(cameras[1].scene);
+    CHECK(registry.count == 1);
+    CHECK(scene_refs(&registry, 0x42) == 0);
+    ptz_scene_release(other);
+    ptz_scene_release(NULL);
+    CHECK(registry.count == 0 && registry.scenes == NULL);
+    ptz_scene_registry_destroy(&registry);
+}
+
+static void test_failed_load(void) {
+    ptz_scene_registry registry;
+    ptz_scene_registry_init(&registry);
+    loader_state loader = { &registry, 0, 1, 0 };
+    camera cameras[2];
+    // Both the loader and the camera waiting on it get nothing, and nothing is left in the registry.
+    acquire_twice(&registry, &loader, 0x42, cameras);
+    CHECK(loader.calls == 1);
+    CHECK(cameras[0].scene == NULL && cameras[1].scene == NULL);
+    CHECK(registry.count == 0 && registry.scenes == NULL);
+
+    // The next acquire tries again, and can succeed.
+    loader.fail = 0;
+    ptz_scene *scene = ptz_scene_acquire(&registry, 0x42, load, &loader);
+    CHECK(loader.calls == 2);
+    CHECK(scene != NULL && scene->pyramid.levelCount > 0);
+    ptz_scene_release(scene);
+    CHECK(registry.count == 0);
+
+    // A loader that claims success without a pyramid is a failure too.
+    CHECK(ptz_scene_acquire(&registry, 0x44, load_nothing, NULL) == NULL);
+    CHECK(registry.count == 0);
+    ptz_scene_registry_destroy(&registry);
+}
+
+int main(void) {
+    alarm(30);
+    test_shared_load();
+    test_failed_load();
+    return ptz_test_result();
+}
@@ -0,0 +1,649 @@
+//
+//  ptz_server_tests.cpp
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  ptzd's server over real loopback sockets, with the test playing controller on the same thread.
+//
+
+#include "ptz_server.hpp"
+#include "ptz_test.h"
+
+#include <csignal>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int connect_to(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr *)&address, sizeof(address)) == -1) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+template <class M>
+static void send_message(int fd, const M &message) {
+    auto data = jr_visca::encode(message, 0, 1);
+    CHECK(write(fd, data.data(), data.size()) == (ssize_t)data.size());
+}
+
+// Runs the server until `fd` has had `length` bytes, or for `wait` if that's longer, and returns them as hex.
+static std::string replies(ptz::server &server, int fd, std::size_t length,
+                           ptz::clock::duration wait = std::chrono::seconds(5)) {
+    std::string out;
+    std::size_t received = 0;
+    auto deadline = ptz::clock::now() + wait;
+    while (ptz::clock::now() < deadline && received < length) {
+        server.poll_once(std::chrono::milliseconds(5));
+        uint8_t buffer[256];
+        ssize_t count;
+        while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t i = 0; i < count; i++) {
+                char hex[4];
+                snprintf(hex, sizeof(hex), "%02x ", buffer[i]);
+                out += hex;
+            }
+            received += count;
+        }
+    }
+    return out;
+}
+
+struct received_frame {
+    ptz::clock::time_point time;
+    std::vector<uint8_t> bytes;
+};
+
+// Runs the server for `wait`, and returns every frame `fd` got in that time, with when it got it.
+static std::vector<received_frame> frames(ptz::server &server, int fd, ptz::clock::duration wait) {
+    std::vector<received_frame> out;
+    std::vector<uint8_t> partial;
+    auto deadline = ptz::clock::now() + wait;
+    while (ptz::clock::now() < deadline) {
+        server.poll_once(std::chrono::milliseconds(1));
+        uint8_t buffer[256];
+        ssize_t count;
+        while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t i = 0; i < count; i++) {
+                partial.push_back(buffer[i]);
+                if (buffer[i] == 0xff) {
+                    out.push_back({ptz::clock::now(), partial});
+                    partial.clear();
+                }
+            }
+        }
+    }
+    return out;
+}
+
+static bool is_notification(const received_frame &f, uint8_t group) {
+    return f.bytes.size() == 13 && f.bytes[0] == 0x90 && f.bytes[1] == 0x07 && f.bytes[2] == 0x7f && f.bytes[3] == group;
+}
+
+// The two positions a notification carries.
+static std::pair<int16_t, int16_t> notified(const received_frame &f) {
+    std::span<const uint8_t> body = std::span<const uint8_t>(f.bytes).subspan(1, 11);
+    if (auto n = jr_visca::decode<jr_visca::pan_tilt_notify>(body)) {
+        return {n->first, n->second};
+    }
+    auto n = jr_visca::decode<jr_visca::lens_notify>(body);
+    return {n->first, n->second};
+}
+
+static void test_commands(ptz::server &server) {
+    int fd = connect_to(server.port(0));
+    CHECK(fd != -1);
+    send_message(fd, jr_visca::pan_tilt_position_inq{});
+    CHECK(replies(server, fd, 11) == "90 50 00 00 00 00 00 00 00 00 ff ");
+    CHECK(server.connections() == 1);
+
+    send_message(fd, jr_visca::absolute_pan_tilt{0x18, 0x14, 0x40, -0x20});
+    CHECK(replies(server, fd, 6) == "90 41 ff 90 51 ff ");
+    CHECK(ptz_fleet_position(server.fleet(), 0, PTZ_FLEET_PAN) == 0x40);
+    CHECK(ptz_fleet_position(server.fleet(), 0, PTZ_FLEET_TILT) == -0x20);
+    CHECK(ptz_fleet_position(server.fleet(), 1, PTZ_FLEET_PAN) == 0);
+
+    // A second controller on the same camera sees the same head.
+    int other = connect_to(server.port(0));
+    send_message(other, jr_visca::pan_tilt_position_inq{});
+    CHECK(replies(server, other, 11) == "90 50 00 00 04 00 0f 0f 0e 00 ff ");
+    CHECK(server.connections() == 2);
+
+    // Address Set: the camera takes 1 and passes on the next free address.
+    const uint8_t addressSet[] = {0x88, 0x30, 0x01, 0xff};
+    CHECK(write(fd, addressSet, sizeof(addressSet)) == (ssize_t)sizeof(addressSet));
+    CHECK(replies(server, fd, 4) == "88 30 02 ff ");
+
+    close(other);
+    close(fd);
+    replies(server, -1, 1, std::chrono::milliseconds(50));
+    CHECK(server.connections() == 0);
+}
+
+// Camera 1 is a PTZOptics: strict about empty presets, and slow to answer.
+static void test_profiles(ptz::server &server) {
+    int fd = connect_to(server.port(1));
+    auto start = ptz::clock::now();
+    send_message(fd, jr_visca::memory{7, JR_VISCA_MEMORY_MODE_RECALL});
+    CHECK(replies(server, fd, 3) == "90 41 ff ");
+    CHECK(ptz::clock::now() - start >= std::chrono::milliseconds(1));
+    CHECK(replies(server, fd, 1, std::chrono::milliseconds(200)) == "");
+
+    int sim = connect_to(server.port(2));
+    send_message(sim, jr_visca::memory{7, JR_VISCA_MEMORY_MODE_RECALL});
+    CHECK(replies(server, sim, 6) == "90 41 ff 90 51 ff ");
+    close(sim);
+    close(fd);
+}
+
+// Camera 3 tells its subscriber where it is as it moves, no faster than asked, ending where it stopped.
+static void test_notifications(ptz::server &server) {
+    int fd = connect_to(server.port(3));
+    send_message(fd, jr_visca::notify_subscribe{10});
+    auto subscribed = frames(server, fd, std::chrono::milliseconds(150));
+    CHECK(subscribed.size() == 4);
+    if (subscribed.size() == 4) {
+        CHECK(subscribed[0].bytes == std::vector<uint8_t>({0x90, 0x41, 0xff}));
+        CHECK(subscribed[1].bytes == std::vector<uint8_t>({0x90, 0x51, 0xff}));
+        // Where it is now, without having to ask.
+        CHECK(is_notification(subscribed[2], 0x01));
+        CHECK(notified(subscribed[2]) == (std::pair<int16_t, int16_t>{0, 0}));
+        CHECK(is_notification(subscribed[3], 0x02));
+    }
+
+    // Speed 1 is a unit a tick, so this takes 60 ticks, 600ms: about 6 notifications at 10 a second.
+    send_message(fd, jr_visca::absolute_pan_tilt{1, 1, 60, 0});
+    auto start = ptz::clock::now();
+    auto moving = frames(server, fd, std::chrono::milliseconds(900));
+    std::vector<received_frame> panTilt;
+    ptz::clock::time_point completed = {};
+    for (const received_frame &f : moving) {
+        CHECK(!is_notification(f, 0x02));
+        if (is_notification(f, 0x01)) {
+            panTilt.push_back(f);
+        } else if (f.bytes == std::vector<uint8_t>({0x90, 0x51, 0xff})) {
+            completed = f.time;
+        }
+    }
+    CHECK(completed != ptz::clock::time_point{});
+    auto took = std::chrono::duration_cast<std::chrono::milliseconds>(completed - start).count();
+    CHECK(!panTilt.empty());
+    CHECK((long long)panTilt.size() <= took / 100 + 2);
+    CHECK(panTilt.size() >= 4);
+    for (std::size_t i = 1; i < panTilt.size(); i++) {
+        // Each carries the position at the time, and they're spaced out however fast the camera ticks.
+        CHECK(notified(panTilt[i]).first > notified(panTilt[i - 1]).first);
+        CHECK(panTilt[i].time - panTilt[i - 1].time >= std::chrono::milliseconds(60));
+    }
+    // The last is where it stopped, even though it stopped between notifications.
+    if (!panTilt.empty()) {
+        CHECK(notified(panTilt.back()) == (std::pair<int16_t, int16_t>{60, 0}));
+    }
+
+    // 00 stops them.
+    send_message(fd, jr_visca::notify_subscribe{0});
+    CHECK(replies(server, fd, 6) == "90 41 ff 90 51 ff ");
+    send_message(fd, jr_visca::absolute_pan_tilt{0x18, 0x14, 0, 0});
+    CHECK(replies(server, fd, 6) == "90 41 ff 90 51 ff ");
+    CHECK(ptz_fleet_position(server.fleet(), 3, PTZ_FLEET_PAN) == 0);
+    CHECK(replies(server, fd, 1, std::chrono::milliseconds(150)) == "");
+    close(fd);
+}
+
+static int collect(const ptz_telemetry_row *row, void *context) {
+    static_cast<std::vector<ptz_telemetry_row> *>(context)->push_back(*row);
+    return 0;
+}
+
+// Every step of a move and a recall, with what started each.
+static void test_telemetry(const ptz_config &base) {
+    ptz_config config = base;
+    config.cameras = 2;
+    config.overrideCount = 0;
+    snprintf(config.telemetry, sizeof(config.telemetry), "ptz_server_tests.telemetry");
+    remove(config.telemetry);
+    ptz::server server(config);
+    CHECK(server.start() == 0);
+    int fd = connect_to(server.port(1));
+    send_message(fd, jr_visca::absolute_pan_tilt{0x18, 0x14, 0x40, 0});
+    CHECK(replies(server, fd, 6) == "90 41 ff 90 51 ff ");
+    send_message(fd, jr_visca::memory{3, JR_VISCA_MEMORY_MODE_SET});
+    CHECK(replies(server, fd, 6) == "90 41 ff 90 51 ff ");
+    send_message(fd, jr_visca::home{});
+    CHECK(replies(server, fd, 6) == "90 41 ff 90 51 ff ");
+    send_message(fd, jr_visca::memory{3, JR_VISCA_MEMORY_MODE_RECALL});
+    CHECK(replies(server, fd, 6) == "90 41 ff 90 51 ff ");
+    close(fd);
+    server.flush_telemetry();
+
+    std::vector<ptz_telemetry_row> rows;
+    CHECK(ptz_telemetry_read(config.telemetry, 0, UINT64_MAX, collect, &rows) == 0);
+    CHECK(rows.size() > 3);
+    for (const ptz_telemetry_row &row : rows) {
+        CHECK(row.camera == 1);
+    }
+    if (rows.size() > 3) {
+        CHECK(rows.front().command == JR_VISCA_MESSAGE_ABSOLUTE_PAN_TILT);
+        CHECK(rows.front().slot == PTZ_TELEMETRY_NO_SLOT);
+        CHECK(rows.back().command == JR_VISCA_MESSAGE_MEMORY);
+        CHECK(rows.back().slot == 3);
+        CHECK(rows.back().pan == 0x40);
+        for (std::size_t i = 1; i < rows.size(); i++) {
+            CHECK(rows[i].time > rows[i - 1].time);
+        }
+    }
+    remove(config.telemetry);
+}
+
+// A tick of 4096 cameras all moving, with and without recording: the tick only queues its rows, so
+// recording should cost it a small part of what it already takes.
+static void test_telemetry_overhead() {
+    const int cameras = 4096, ticks = 200;
+    ptz_fleet fleet;
+    CHECK(ptz_fleet_init(&fleet, cameras) == 0);
+    ptz::engine engine(&fleet, std::chrono::milliseconds(10));
+    ptz_telemetry_recorder recorder;
+    const char *path = "ptz_server_tests_overhead.telemetry";
+    remove(path);
+    CHECK(ptz_telemetry_recorder_open(&recorder, path, 64 << 20) == 0);
+    for (int camera = 0; camera < cameras; camera++) {
+        ptz_fleet_jog(&fleet, camera, PTZ_FLEET_PAN, 1, 1);
+        ptz_fleet_jog(&fleet, camera, PTZ_FLEET_TILT, 1, 1);
+    }
+    // Alternating, so both see the same machine. The tick thread's own CPU time, so the recorder's thread
+    // taking the CPU from it on a single core isn't counted as the tick's.
+    auto now = ptz::clock::now();
+    double total[2] = {0, 0};
+    for (int tick = 0; tick < ticks; tick++) {
+        int recording = tick & 1;
+        engine.set_telemetry(recording ? &recorder : nullptr);
+        now += engine.tick();
+        timespec start, end;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+        engine.run(now);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+        total[recording] += (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+        CHECK(fleet.changedCount == cameras);
+    }
+    engine.set_telemetry(nullptr);
+    ptz_telemetry_recorder_close(&recorder);
+    CHECK(recorder.dropped == 0);
+    printf("a tick of %d cameras: %.1f us, %.1f us recording\n", cameras, total[0] / (ticks / 2),
+           total[1] / (ticks / 2));
+    remove(path);
+    ptz_fleet_free(&fleet);
+}
+
+#pragma mark Sessions
+
+// One session on a camera of its own, its connection a socketpair, with the test handing it batches directly.
+struct harness {
+    ptz_fleet fleet;
+    std::unique_ptr<ptz::engine> engine;
+    int fds[2];             // The session's end and the controller's.
+    std::unique_ptr<ptz::session> session;
+
+    explicit harness(const ptz::registry &handlers) {
+        CHECK(ptz_fleet_init(&fleet, 1) == 0);
+        engine = std::make_unique<ptz::engine>(&fleet, std::chrono::milliseconds(10));
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        session = std::make_unique<ptz::session>(*engine, handlers, jr_socket{fds[0], nullptr}, 0);
+    }
+    ~harness() {
+        session.reset();
+        engine.reset();
+        ptz_fleet_free(&fleet);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    // Everything the session has sent so far, as hex.
+    std::string replies() {
+        std::string out;
+        uint8_t buffer[256];
+        ssize_t count;
+        while ((count = read(fds[1], buffer, sizeof(buffer))) > 0) {
+            for (ssize_t i = 0; i < count; i++) {
+                char hex[4];
+                snprintf(hex, sizeof(hex), "%02x ", buffer[i]);
+                out += hex;
+            }
+        }
+        return out;
+    }
+};
+
+template <class M>
+static void append(std::vector<uint8_t> &batch, const M &message) {
+    auto data = jr_visca::encode(message, 0, 1);
+    batch.insert(batch.end(), data.begin(), data.end());
+}
+
+static std::string repeat(const std::string &s, int count) {
+    std::string out;
+    for (int i = 0; i < count; i++) {
+        out += s;
+    }
+    return out;
+}
+
+static const std::string ack_completion = "90 41 ff 90 51 ff ";
+static const std::string position = "90 50 00 00 00 00 00 00 00 00 ff ";
+
+// What the recording handlers were called for, in order.
+static std::vector<std::string> ran;
+
+static ptz::command record_drive(ptz::session &s, jr_visca::pan_tilt_drive m) {
+    ran.push_back("drive " + std::to_string(m.panSpeed));
+    s.ack_completion();
+    co_return;
+}
+
+static ptz::command record_zoom(ptz::session &s, jr_visca::zoom_tele_variable m) {
+    ran.push_back("zoom " + std::to_string(m.value));
+    s.ack_completion();
+    co_return;
+}
+
+static ptz::command record_address_set(ptz::session &s, jr_visca::camera_number m) {
+    ran.push_back("address set");
+    s.send(jr_visca::camera_number{(uint8_t)(m.cameraNum + 1)});
+    co_return;
+}
+
+static ptz::command record_inquiry(ptz::session &s, jr_visca::pan_tilt_position_inq) {
+    ran.push_back("inquiry");
+    s.send(jr_visca::pan_tilt_position_response{0, 0});
+    co_return;
+}
+
+static const ptz::registry &recording_handlers() {
+    static const ptz::registry handlers = [] {
+        ptz::registry r;
+        r.on<jr_visca::pan_tilt_drive>(record_drive);
+        r.on<jr_visca::zoom_tele_variable>(record_zoom);
+        r.on<jr_visca::camera_number>(record_address_set);
+        r.on<jr_visca::pan_tilt_position_inq>(record_inquiry);
+        return r;
+    }();
+    return handlers;
+}
+
+// Drives in one write: the newest of each group runs, the rest just answer, in order, and an Address Set
+// keeps the drives on either side of it apart.
+static void test_coalescing() {
+    harness h(recording_handlers());
+    std::vector<uint8_t> batch;
+    const uint8_t right = JR_VISCA_PAN_DIRECTION_RIGHT, up = JR_VISCA_TILT_DIRECTION_UP;
+    append(batch, jr_visca::pan_tilt_drive{1, 1, right, up});
+    append(batch, jr_visca::pan_tilt_position_inq{});
+    append(batch, jr_visca::pan_tilt_drive{2, 1, right, up});
+    append(batch, jr_visca::zoom_tele_variable{1});
+    const uint8_t addressSet[] = {0x88, 0x30, 0x01, 0xff};
+    batch.insert(batch.end(), addressSet, addressSet + sizeof(addressSet));
+    append(batch, jr_visca::pan_tilt_drive{3, 1, right, up});
+    append(batch, jr_visca::zoom_tele_variable{2});
+    append(batch, jr_visca::pan_tilt_drive{4, 1, right, up});
+    append(batch, jr_visca::pan_tilt_position_inq{});
+    append(batch, jr_visca::zoom_tele_variable{3});
+    ran.clear();
+    CHECK(h.session->receive(batch) == 0);
+    CHECK((ran == std::vector<std::string>{"inquiry", "drive 2", "zoom 1", "address set", "drive 4", "inquiry", "zoom 3"}));
+    CHECK(h.replies() == ack_completion + position + repeat(ack_completion, 2) + "88 30 02 ff " +
+                         repeat(ack_completion, 3) + position + ack_completion);
+    CHECK(h.session->stats(ptz::lane::normal).run == 10);
+    CHECK(h.session->in_flight() == 0);
+
+    // A joystick's worth in one write: only the last runs, and every one is answered.
+    batch.clear();
+    for (int speed = 1; speed <= 100; speed++) {
+        append(batch, jr_visca::pan_tilt_drive{(uint8_t)(speed % 0x18 + 1), 1, right, up});
+    }
+    ran.clear();
+    CHECK(h.session->receive(batch) == 0);
+    CHECK(ran == std::vector<std::string>{"drive " + std::to_string(100 % 0x18 + 1)});
+    CHECK(h.replies() == repeat(ack_completion, 100));
+
+    // Split across two writes they're two batches, and the last of each runs.
+    std::vector<uint8_t> first(batch.begin(), batch.begin() + 16 * 9 + 4);
+    std::vector<uint8_t> second(batch.begin() + 16 * 9 + 4, batch.end());
+    ran.clear();
+    CHECK(h.session->receive(first) == 0);
+    CHECK(h.session->receive(second) == 0);
+    CHECK(ran.size() == 2);
+    if (ran.size() == 2) {
+        CHECK(ran[0] == "drive " + std::to_string(16 % 0x18 + 1));
+    }
+    CHECK(h.replies() == repeat(ack_completion, 100));
+}
+
+// What the camera sends for `message`, as hex.
+template <class M>
+static std::string reply_hex(const M &message) {
+    std::string out;
+    for (uint8_t byte : jr_visca::encode(message, 1, 0)) {
+        char hex[4];
+        snprintf(hex, sizeof(hex), "%02x ", byte);
+        out += hex;
+    }
+    return out;
+}
+
+static const std::string cancelled = "90 61 04 ff ";
+static const std::string buffer_full = "90 61 03 ff ";
+
+// A Stop behind a flood of inquiries is answered before any of them, and stops the camera before they look.
+static void test_express() {
+    harness h(ptz::default_handlers());
+    std::vector<uint8_t> batch;
+    append(batch, jr_visca::pan_tilt_drive{0x18, 0x14, JR_VISCA_PAN_DIRECTION_RIGHT, JR_VISCA_TILT_DIRECTION_UP});
+    CHECK(h.session->receive(batch) == 0);
+    CHECK(h.replies() == ack_completion);
+    auto now = ptz::clock::now();
+    for (int tick = 0; tick < 3; tick++) {
+        now += h.engine->tick();
+        h.engine->run(now);
+    }
+    CHECK(ptz_fleet_position(&h.fleet, 0, PTZ_FLEET_PAN) > 0);
+
+    batch.clear();
+    for (int i = 0; i < 50; i++) {
+        append(batch, jr_visca::pan_tilt_position_inq{});
+    }
+    append(batch, jr_visca::pan_tilt_drive{0x18, 0x14, JR_VISCA_PAN_DIRECTION_STOP, JR_VISCA_TILT_DIRECTION_STOP});
+    CHECK(h.session->receive(batch) == 0);
+    int16_t pan = (int16_t)ptz_fleet_position(&h.fleet, 0, PTZ_FLEET_PAN);
+    int16_t tilt = (int16_t)ptz_fleet_position(&h.fleet, 0, PTZ_FLEET_TILT);
+    CHECK(h.replies() == ack_completion + repeat(reply_hex(jr_visca::pan_tilt_position_response{pan, tilt}), 50));
+    for (int tick = 0; tick < 3; tick++) {
+        now += h.engine->tick();
+        h.engine->run(now);
+    }
+    CHECK(ptz_fleet_position(&h.fleet, 0, PTZ_FLEET_PAN) == pan);
+    CHECK(h.session->stats(ptz::lane::express).run == 1);
+    CHECK(h.session->stats(ptz::lane::normal).run == 51);
+    CHECK(h.session->stats(ptz::lane::normal).overtaken == 0);
+}
+
+// A move a later Cancel overtakes in the same batch never starts, and says it was cancelled; one already
+// running is cancelled where it is.
+static void test_cancel() {
+    harness h(ptz::default_handlers());
+    std::vector<uint8_t> batch;
+    append(batch, jr_visca::absolute_pan_tilt{0x18, 0x14, 0x100, 0x80});
+    append(batch, jr_visca::cancel{1});
+    CHECK(h.session->receive(batch) == 0);
+    // The Cancel first, with nothing running to answer for it; then the move.
+    CHECK(h.replies() == "90 41 ff " + cancelled + "90 41 ff " + cancelled);
+    CHECK(ptz_fleet_position(&h.fleet, 0, PTZ_FLEET_PAN) == 0);
+    CHECK(h.session->in_flight() == 0);
+    CHECK(h.session->stats(ptz::lane::normal).overtaken == 1);
+    CHECK(h.session->stats(ptz::lane::normal).run == 0);
+
+    // Overtaken drives have nothing left to do, and complete.
+    batch.clear();
+    append(batch, jr_visca::zoom_tele_variable{3});
+    append(batch, jr_visca::clear{});
+    CHECK(h.session->receive(batch) == 0);
+    CHECK(h.replies() == "90 51 ff " + ack_completion);
+    CHECK(h.session->stats(ptz::lane::normal).overtaken == 2);
+
+    batch.clear();
+    append(batch, jr_visca::absolute_pan_tilt{0x18, 0x14, 0x100, 0x80});
+    CHECK(h.session->receive(batch) == 0);
+    CHECK(h.replies() == "90 41 ff ");
+    CHECK(h.session->in_flight() == 1);
+    auto now = ptz::clock::now() + h.engine->tick();
+    h.engine->run(now);
+    int32_t stopped = ptz_fleet_position(&h.fleet, 0, PTZ_FLEET_PAN);
+    CHECK(stopped > 0 && stopped < 0x100);
+
+    batch.clear();
+    append(batch, jr_visca::cancel{1});
+    CHECK(h.session->receive(batch) == 0);
+    CHECK(h.replies() == "90 41 ff ");
+    h.engine->run(now);
+    CHECK(h.replies() == cancelled);
+    CHECK(h.session->in_flight() == 0);
+    h.engine->run(now + 10 * h.engine->tick());
+    CHECK(ptz_fleet_position(&h.fleet, 0, PTZ_FLEET_PAN) == stopped);
+    CHECK(h.session->stats(ptz::lane::express).run == 3);
+}
+
+// Past 16 express frames in a batch, or 64 commands running, the rest are turned away.
+static void test_limits() {
+    harness h(ptz::default_handlers());
+    std::vector<uint8_t> batch;
+    for (int i = 0; i < 20; i++) {
+        append(batch, jr_visca::cancel{1});
+    }
+    CHECK(h.session->receive(batch) == 0);
+    CHECK(h.replies() == repeat("90 41 ff " + cancelled, 16) + repeat(buffer_full, 4));
+    CHECK(h.session->stats(ptz::lane::express).run == 16);
+    CHECK(h.session->stats(ptz::lane::express).rejected == 4);
+
+    // Moves wait for the camera to get there, so each one is still running when the next comes in.
+    batch.clear();
+    for (int i = 0; i < 70; i++) {
+        append(batch, jr_visca::absolute_pan_tilt{0x18, 0x14, (int16_t)(i + 1), 0});
+    }
+    CHECK(h.session->receive(batch) == 0);
+    CHECK(h.replies() == repeat("90 41 ff ", 64) + repeat(buffer_full, 6));
+    CHECK(h.session->in_flight() == 64);
+    CHECK(h.session->stats(ptz::lane::normal).run == 64);
+    CHECK(h.session->stats(ptz::lane::normal).rejected == 6);
+
+    // They all finish once it arrives, at the last one that ran, and there's room again.
+    auto now = ptz::clock::now();
+    for (int tick = 0; tick < 100 && h.session->in_flight(); tick++) {
+        now += h.engine->tick();
+        h.engine->run(now);
+    }
+    CHECK(h.session->in_flight() == 0);
+    CHECK(ptz_fleet_position(&h.fleet, 0, PTZ_FLEET_PAN) == 64);
+    CHECK(h.replies() == repeat("90 51 ff ", 64));
+    batch.clear();
+    append(batch, jr_visca::pan_tilt_position_inq{});
+    CHECK(h.session->receive(batch) == 0);
+    CHECK(h.replies() == reply_hex(jr_visca::pan_tilt_position_response{64, 0}));
+    CHECK(h.session->stats(ptz::lane::normal).rejected == 6);
+    CHECK(h.session->stats(ptz::lane::express).overtaken == 0);
+}
+
+// Picture settings start at PTZCamera's power-on values and read back what was set. Inquiries about what
+// isn't modelled get an error rather than an empty Completion.
+static void test_picture() {
+    harness h(ptz::default_handlers());
+    auto ask = [&](const std::vector<uint8_t> &frame) {
+        CHECK(h.session->receive(frame) == 0);
+        return h.replies();
+    };
+    auto ask_for = [&](const auto &message) {
+        std::vector<uint8_t> batch;
+        append(batch, message);
+        return ask(batch);
+    };
+    CHECK(ask_for(jr_visca::brightness_inq{}) == "90 50 00 00 00 07 ff ");
+    CHECK(ask_for(jr_visca::shutter_pos_inq{}) == "90 50 00 0a ff ");
+    CHECK(ask_for(jr_visca::focus_af_mode_inq{}) == "90 50 02 ff ");
+    CHECK(ask_for(jr_visca::picture_effect_inq{}) == "90 50 02 ff ");
+    CHECK(ask_for(jr_visca::menu_mode_inq{}) == "90 50 03 ff ");
+
+    CHECK(ask_for(jr_visca::brightness{0x0c}) == ack_completion);
+    CHECK(ask_for(jr_visca::brightness_inq{}) == "90 50 00 00 00 0c ff ");
+    CHECK(ask_for(jr_visca::focus_manual{}) == ack_completion);
+    CHECK(ask_for(jr_visca::focus_af_mode_inq{}) == "90 50 03 ff ");
+    CHECK(ask_for(jr_visca::lr_reverse{JR_VISCA_ON}) == ack_completion);
+    CHECK(ask_for(jr_visca::lr_reverse_inq{}) == "90 50 02 ff ");
+    CHECK(ask_for(jr_visca::picture_flip_inq{}) == "90 50 03 ff ");
+    CHECK(ask_for(jr_visca::picture_effect{JR_VISCA_PICTURE_FX_MODE_BW}) == ack_completion);
+    CHECK(ask_for(jr_visca::picture_effect_inq{}) == "90 50 04 ff ");
+    // Kept on the engine, for the camera the session is addressing.
+    CHECK(h.engine->picture_of(0).brightness == 0x0c);
+
+    // Known but not modelled: not executable. Not VISCA we know (CAM_PowerInq): a syntax error.
+    CHECK(ask_for(jr_visca::flicker_mode_inq{}) == "90 60 41 ff ");
+    CHECK(ask({ 0x81, 0x09, 0x04, 0x00, 0xff }) == "90 60 02 ff ");
+    // A command for something not modelled is still acked and ignored.
+    CHECK(ask_for(jr_visca::flicker_mode{0x01}) == ack_completion);
+}
+
+int main() {
+    signal(SIGPIPE, SIG_IGN);
+    ptz_config config;
+    ptz_config_defaults(&config);
+    config.cameras = 64;
+    config.port = 0;
+    config.tickMs = 10;
+    config.overrideCount = 1;
+    config.overrides[0].camera = 1;
+    snprintf(config.overrides[0].profile, sizeof(config.overrides[0].profile), "ptzoptics");
+
+    auto start = ptz::clock::now();
+    ptz::server server(config);
+    CHECK(server.start() == 0);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(ptz::clock::now() - start);
+    printf("%d cameras listening in %lld us\n", server.cameras(), (long long)elapsed.count());
+    for (int camera = 1; camera < server.cameras(); camera++) {
+        CHECK(server.port(camera) != server.port(camera - 1));
+    }
+
+    test_commands(server);
+    test_profiles(server);
+    test_notifications(server);
+    test_telemetry(config);
+    test_telemetry_overhead();
+    test_coalescing();
+    test_express();
+    test_cancel();
+    test_limits();
+    test_picture();
+
+    // Nobody else can have a port the server has.
+    ptz_config taken = config;
+    taken.cameras = 1;
+    taken.port = server.port(5);
+    ptz::server second(taken);
+    CHECK(second.start() == -1);
+
+    return ptz_test_result();
+}
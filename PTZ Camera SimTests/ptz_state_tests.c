@@ -0,0 +1,145 @@
+//
+//  ptz_state_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The state feed the way PTZCamera drives it: any number of marks in a tick, one publish at the end,
+//  and every subscriber seeing the same single delta.
+//
+
+#include "ptz_state.h"
+#include "ptz_test.h"
+
+#include <string.h>
+
+typedef struct recorder {
+    int deltas;
+    ptz_state_delta last;
+    ptz_state_feed *feed;       // Set to mark from inside the callback.
+    uint32_t markFromCallback;
+} recorder;
+
+static void record(const ptz_state_delta *delta, void *context) {
+    recorder *r = context;
+    r->deltas++;
+    r->last = *delta;
+    if (r->feed != NULL && r->markFromCallback) {
+        ptz_state_feed_mark(r->feed, r->markFromCallback);
+        r->markFromCallback = 0;
+    }
+}
+
+// Several writes in one tick come out as one delta with every bit they set.
+static void test_coalescing(void) {
+    ptz_state_feed feed;
+    ptz_state_feed_init(&feed);
+    recorder a = { 0 };
+    CHECK(ptz_state_feed_subscribe(&feed, record, &a) >= 0);
+
+    ptz_camera_state state;
+    memset(&state, 0, sizeof(state));
+    // Only the first mark of a tick asks for a publish.
+    CHECK(ptz_state_feed_mark(&feed, PTZ_STATE_PAN) == 1);
+    state.pan = 10;
+    CHECK(ptz_state_feed_mark(&feed, PTZ_STATE_PAN) == 0);
+    state.pan = 20;
+    CHECK(ptz_state_feed_mark(&feed, PTZ_STATE_ZOOM | PTZ_STATE_FOCUS) == 0);
+    state.zoom = 5;
+    CHECK(ptz_state_feed_mark(&feed, PTZ_STATE_HUE) == 0);
+    state.hue = 3;
+    CHECK(a.deltas == 0);
+
+    CHECK(ptz_state_feed_publish(&feed, &state) == 1);
+    CHECK(a.deltas == 1);
+    CHECK(a.last.dirty == (PTZ_STATE_PAN | PTZ_STATE_ZOOM | PTZ_STATE_FOCUS | PTZ_STATE_HUE));
+    CHECK(a.last.sequence == 1);
+    // The latest values, not the ones at the first mark.
+    CHECK(a.last.state.pan == 20 && a.last.state.zoom == 5 && a.last.state.hue == 3);
+
+    // Nothing since: nothing to publish.
+    CHECK(ptz_state_feed_publish(&feed, &state) == 0);
+    CHECK(a.deltas == 1);
+    // A mark of nothing doesn't count.
+    CHECK(ptz_state_feed_mark(&feed, 0) == 0);
+    CHECK(ptz_state_feed_publish(&feed, &state) == 0);
+
+    // The next tick starts clean.
+    CHECK(ptz_state_feed_mark(&feed, PTZ_STATE_TILT) == 1);
+    CHECK(ptz_state_feed_publish(&feed, &state) == 1);
+    CHECK(a.last.dirty == PTZ_STATE_TILT);
+    CHECK(a.last.sequence == 2);
+}
+
+static void test_subscribers(void) {
+    ptz_state_feed feed;
+    ptz_state_feed_init(&feed);
+    recorder a = { 0 }, b = { 0 }, c = { 0 };
+    int tokenA = ptz_state_feed_subscribe(&feed, record, &a);
+    int tokenB = ptz_state_feed_subscribe(&feed, record, &b);
+    int tokenC = ptz_state_feed_subscribe(&feed, record, &c);
+    CHECK(tokenA >= 0 && tokenB >= 0 && tokenC >= 0);
+    CHECK(tokenA != tokenB && tokenB != tokenC && tokenA != tokenC);
+
+    ptz_camera_state state;
+    memset(&state, 0, sizeof(state));
+    state.tilt = -7;
+    ptz_state_feed_mark(&feed, PTZ_STATE_TILT | PTZ_STATE_MENU_ITEM);
+    ptz_state_feed_publish(&feed, &state);
+    // Everyone gets the same delta.
+    CHECK(a.deltas == 1 && b.deltas == 1 && c.deltas == 1);
+    CHECK(memcmp(&a.last, &b.last, sizeof(a.last)) == 0);
+    CHECK(memcmp(&a.last, &c.last, sizeof(a.last)) == 0);
+    CHECK(a.last.state.tilt == -7);
+
+    // Gone subscribers hear nothing more, and get their context back to release.
+    CHECK(ptz_state_feed_unsubscribe(&feed, tokenB) == &b);
+    ptz_state_feed_mark(&feed, PTZ_STATE_PAN);
+    ptz_state_feed_publish(&feed, &state);
+    CHECK(a.deltas == 2 && b.deltas == 1 && c.deltas == 2);
+    CHECK(ptz_state_feed_unsubscribe(&feed, tokenB) == NULL);
+    CHECK(ptz_state_feed_unsubscribe(&feed, -1) == NULL);
+    CHECK(ptz_state_feed_unsubscribe(&feed, PTZ_STATE_MAX_SUBSCRIBERS) == NULL);
+
+    // Its slot can be taken again, and the feed has a limit.
+    CHECK(ptz_state_feed_subscribe(&feed, record, &b) == tokenB);
+    recorder extra = { 0 };
+    int taken = 3;
+    while (ptz_state_feed_subscribe(&feed, record, &extra) >= 0) {
+        taken++;
+    }
+    CHECK(taken == PTZ_STATE_MAX_SUBSCRIBERS);
+
+    // A subscriber that writes state during a publish starts the next delta rather than extending this one.
+    a.feed = &feed;
+    a.markFromCallback = PTZ_STATE_AUTOFOCUS;
+    ptz_state_feed_mark(&feed, PTZ_STATE_FOCUS);
+    ptz_state_feed_publish(&feed, &state);
+    CHECK(c.last.dirty == PTZ_STATE_FOCUS);
+    CHECK(ptz_state_feed_publish(&feed, &state) == 1);
+    CHECK(c.last.dirty == PTZ_STATE_AUTOFOCUS);
+}
+
+// The render key follows what the picture shows and nothing else.
+static void test_render_key(void) {
+    ptz_camera_state a, b;
+    memset(&a, 0, sizeof(a));
+    b = a;
+    CHECK(ptz_state_render_key(&a) == ptz_state_render_key(&b));
+    b.awbSens = 3;
+    b.presetSpeed = 9;
+    b.menuItem = 2;
+    CHECK(ptz_state_render_key(&a) == ptz_state_render_key(&b));
+    a.menuVisible = b.menuVisible = 1;
+    CHECK(ptz_state_render_key(&a) != ptz_state_render_key(&b));
+    b = a;
+    b.pan = 1;
+    CHECK(ptz_state_render_key(&a) != ptz_state_render_key(&b));
+}
+
+int main(void) {
+    test_coalescing();
+    test_subscribers();
+    test_render_key();
+    return ptz_test_result();
+}
@@ -0,0 +1,349 @@
+//
+//  ptz_stream_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  The stream with a stub renderer and encoder, watched over MJPEG on loopback: an unchanged camera repeats
+//  its last frame instead of rendering again, a slow encoder costs frames rather than holding up the renderer,
+//  the multipart framing, and stopping with a client still attached. And Y4M conversion against BT.601 in floating
+//  point, at sizes with odd edges.
+//
+
+#include "ptz_http.h"
+#include "ptz_stream.h"
+#include "ptz_test.h"
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// A small stream at a high rate, so the test doesn't spend long waiting for ticks.
+#define WIDTH 64
+#define HEIGHT 36
+#define FPS 100
+
+static atomic_int renders;
+static atomic_int encodeDelay;      // Microseconds each encode takes.
+static atomic_int panEveryFrame;    // The render moves the camera, so every tick has something new.
+
+// The frame carries the pan in its first pixel, which the encoder writes out.
+static int stub_render(const ptz_camera_state *state, ptz_image *frame, const ptz_image *previous, void *context) {
+    ptz_stream *stream = context;
+    atomic_fetch_add(&renders, 1);
+    frame->pixels[0] = (uint8_t)state->pan;
+    if (atomic_load(&panEveryFrame)) {
+        ptz_camera_state next = *state;
+        next.pan++;
+        ptz_stream_set_state(stream, &next);
+    }
+    return 0;
+}
+
+static int stub_encode(const ptz_image *frame, uint8_t **data, size_t *size, void *context) {
+    int delay = atomic_load(&encodeDelay);
+    if (delay) {
+        usleep((useconds_t)delay);
+    }
+    char text[32];
+    int length = snprintf(text, sizeof(text), "pan %d", frame->pixels[0]);
+    *data = malloc((size_t)length);
+    if (*data == NULL) {
+        return -1;
+    }
+    memcpy(*data, text, (size_t)length);
+    *size = (size_t)length;
+    return 0;
+}
+
+static ptz_stream_stats stats_of(ptz_stream *stream) {
+    pthread_mutex_lock(&stream->lock);
+    ptz_stream_stats stats = stream->stats;
+    pthread_mutex_unlock(&stream->lock);
+    return stats;
+}
+
+static void set_pan(ptz_stream *stream, int pan) {
+    ptz_camera_state state = { 0 };
+    state.pan = pan;
+    ptz_stream_set_state(stream, &state);
+}
+
+#pragma mark - MJPEG client
+
+static int read_exactly(int fd, void *data, size_t length) {
+    uint8_t *p = data;
+    while (length > 0) {
+        ssize_t received = recv(fd, p, length, 0);
+        if (received <= 0) {
+            return -1;
+        }
+        p += received;
+        length -= (size_t)received;
+    }
+    return 0;
+}
+
+// Up to and including the next blank line. Returns 0, or -1 if the connection closed first.
+static int read_headers(int fd, char *headers, size_t size) {
+    size_t used = 0;
+    while (used < 4 || memcmp(headers + used - 4, "\r\n\r\n", 4) != 0) {
+        if (used == size - 1 || read_exactly(fd, headers + used, 1) < 0) {
+            return -1;
+        }
+        used++;
+    }
+    headers[used] = '\0';
+    return 0;
+}
+
+static int connect_stream(const ptz_http_server *server) {
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    struct sockaddr_in address = { 0 };
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server->port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    const char *request = "GET /stream.mjpg HTTP/1.1\r\n\r\n";
+    CHECK(ptz_http_send(fd, request, strlen(request)) == 0);
+    char headers[512];
+    CHECK(read_headers(fd, headers, sizeof(headers)) == 0);
+    CHECK(strncmp(headers, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    CHECK(strstr(headers, "Content-Type: multipart/x-mixed-replace; boundary=ptzframe\r\n") != NULL);
+    CHECK(strstr(headers, "Connection: close\r\n") != NULL);
+    // No length: the stream goes on until one side hangs up.
+    CHECK(strstr(headers, "Content-Length") == NULL);
+    return fd;
+}
+
+// One part: the boundary, its headers, exactly Content-Length bytes of JPEG and the CRLF after them.
+static int read_part(int fd, char *body, size_t size) {
+    char headers[256];
+    if (read_headers(fd, headers, sizeof(headers)) < 0) {
+        return -1;
+    }
+    CHECK(strncmp(headers, "--ptzframe\r\nContent-Type: image/jpeg\r\nContent-Length: ", 54) == 0);
+    size_t length = (size_t)atol(headers + 54);
+    CHECK(length > 0 && length < size);
+    char crlf[2];
+    if (length >= size || read_exactly(fd, body, length) < 0 || read_exactly(fd, crlf, 2) < 0) {
+        return -1;
+    }
+    body[length] = '\0';
+    CHECK(memcmp(crlf, "\r\n", 2) == 0);
+    return 0;
+}
+
+#pragma mark - Tests
+
+static void test_repeat(ptz_stream *stream, ptz_http_server *server) {
+    set_pan(stream, 10);
+    int fd = connect_stream(server);
+    char body[64];
+    // A tick before the first frame is out may render it again, so give it a few to settle.
+    for (int i = 0; i < 3; i++) {
+        CHECK(read_part(fd, body, sizeof(body)) == 0);
+        CHECK(strcmp(body, "pan 10") == 0);
+    }
+
+    // Nothing changes, so every tick sends the same frame again without rendering or encoding it.
+    ptz_stream_stats before = stats_of(stream);
+    int rendered = atomic_load(&renders);
+    for (int i = 0; i < 20; i++) {
+        CHECK(read_part(fd, body, sizeof(body)) == 0);
+        CHECK(strcmp(body, "pan 10") == 0);
+    }
+    ptz_stream_stats after = stats_of(stream);
+    CHECK(atomic_load(&renders) == rendered);
+    CHECK(after.rendered == before.rendered && after.encoded == before.encoded);
+    CHECK(after.repeated >= before.repeated + 19);
+
+    // A pan is rendered, and then repeats too.
+    set_pan(stream, 11);
+    do {
+        CHECK(read_part(fd, body, sizeof(body)) == 0);
+    } while (strcmp(body, "pan 10") == 0);
+    CHECK(strcmp(body, "pan 11") == 0);
+    for (int i = 0; i < 3; i++) {
+        CHECK(read_part(fd, body, sizeof(body)) == 0);
+    }
+    rendered = atomic_load(&renders);
+    for (int i = 0; i < 10; i++) {
+        CHECK(read_part(fd, body, sizeof(body)) == 0);
+        CHECK(strcmp(body, "pan 11") == 0);
+    }
+    CHECK(atomic_load(&renders) == rendered);
+    close(fd);
+}
+
+static void test_slow_encoder(ptz_stream *stream, ptz_http_server *server) {
+    set_pan(stream, 0);
+    int fd = connect_stream(server);
+    char body[64];
+    CHECK(read_part(fd, body, sizeof(body)) == 0);
+
+    // A new picture every tick, and an encoder that takes five ticks a frame.
+    ptz_stream_stats before = stats_of(stream);
+    atomic_store(&encodeDelay, 5 * 1000000 / FPS);
+    atomic_store(&panEveryFrame, 1);
+    set_pan(stream, 1);
+    do {
+        CHECK(read_part(fd, body, sizeof(body)) == 0);
+    } while (strcmp(body, "pan 0") == 0);
+    int last = atoi(body + 4);
+    for (int i = 0; i < 10; i++) {
+        CHECK(read_part(fd, body, sizeof(body)) == 0);
+        int pan = atoi(body + 4);
+        // Frames drop, but what gets through is newer every time.
+        CHECK(pan > last);
+        last = pan;
+    }
+    atomic_store(&panEveryFrame, 0);
+    atomic_store(&encodeDelay, 0);
+    ptz_stream_stats after = stats_of(stream);
+    CHECK(after.dropped > before.dropped);
+    CHECK(after.rendered - before.rendered > after.encoded - before.encoded);
+    close(fd);
+}
+
+// The client is still reading when the stream stops: stop lets it go, and the server closes the connection.
+static void test_stop_with_client(ptz_stream *stream, ptz_http_server *server) {
+    set_pan(stream, 40);
+    int fd = connect_stream(server);
+    char body[64];
+    CHECK(read_part(fd, body, sizeof(body)) == 0);
+    ptz_stream_stop(stream);
+    // Whatever was already on its way, and then the end.
+    while (read_part(fd, body, sizeof(body)) == 0) {
+    }
+    close(fd);
+}
+
+#pragma mark - Y4M
+
+static int max_int(int a, int b) {
+    return a > b ? a : b;
+}
+
+static uint8_t clamp_round(double value) {
+    value = floor(value + 0.5);
+    return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+// Worst difference from BT.601 studio range, converted in floating point, with each chroma sample from the
+// average of the up to 2x2 pixels it covers.
+static int y4m_error(const ptz_image *image, const uint8_t *yuv) {
+    int width = image->width;
+    int height = image->height;
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    const uint8_t *cbPlane = yuv + (size_t)width * height;
+    const uint8_t *crPlane = cbPlane + (size_t)chromaWidth * chromaHeight;
+    int worst = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const uint8_t *p = ptz_image_row(image, y) + x * 4;
+            uint8_t expected = clamp_round(16 + (65.481 * p[0] + 128.553 * p[1] + 24.966 * p[2]) / 255);
+            worst = max_int(worst, abs(yuv[y * width + x] - expected));
+        }
+    }
+    for (int cy = 0; cy < chromaHeight; cy++) {
+        for (int cx = 0; cx < chromaWidth; cx++) {
+            double r = 0, g = 0, b = 0;
+            int count = 0;
+            for (int y = cy * 2; y < cy * 2 + 2 && y < height; y++) {
+                for (int x = cx * 2; x < cx * 2 + 2 && x < width; x++) {
+                    const uint8_t *p = ptz_image_row(image, y) + x * 4;
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                    count++;
+                }
+            }
+            r /= count;
+            g /= count;
+            b /= count;
+            uint8_t cb = clamp_round(128 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255);
+            uint8_t cr = clamp_round(128 + (112.0 * r - 93.786 * g - 18.214 * b) / 255);
+            worst = max_int(worst, abs(cbPlane[cy * chromaWidth + cx] - cb));
+            worst = max_int(worst, abs(crPlane[cy * chromaWidth + cx] - cr));
+        }
+    }
+    return worst;
+}
+
+static void test_y4m(void) {
+    static const int sizes[][2] = { { 1, 1 }, { 2, 2 }, { 3, 1 }, { 1, 3 }, { 5, 3 }, { 7, 6 }, { 16, 9 }, { 33, 17 } };
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        int width = sizes[i][0], height = sizes[i][1];
+        ptz_image image = { 0 };
+        CHECK(ptz_image_alloc(&image, width, height) == 0);
+        for (int y = 0; y < height; y++) {
+            uint8_t *row = ptz_image_row(&image, y);
+            for (int x = 0; x < width * 4; x++) {
+                seed = seed * 1664525u + 1013904223u;
+                row[x] = (uint8_t)(seed >> 24);
+            }
+        }
+        // The corners too: black, white and the primaries.
+        static const uint8_t corners[][3] = { { 0, 0, 0 }, { 255, 255, 255 }, { 255, 0, 0 }, { 0, 0, 255 } };
+        memcpy(ptz_image_row(&image, 0), corners[i % 4], 3);
+        size_t size = ptz_stream_y4m_size(width, height);
+        CHECK(size == (size_t)width * height + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2));
+        // One spare byte at the end, to catch writing past the planes.
+        uint8_t *yuv = malloc(size + 1);
+        memset(yuv, 0xa5, size + 1);
+        ptz_stream_rgba_to_y4m(&image, yuv);
+        CHECK(yuv[size] == 0xa5);
+        int error = y4m_error(&image, yuv);
+        if (error > 1) {
+            fprintf(stderr, "%dx%d: off by %d\n", width, height, error);
+        }
+        CHECK(error <= 1);
+        free(yuv);
+        ptz_image_free(&image);
+    }
+    // Black and white land on the ends of studio range.
+    ptz_image image = { 0 };
+    CHECK(ptz_image_alloc(&image, 2, 2) == 0);
+    uint8_t yuv[6];
+    memset(image.pixels, 0, (size_t)image.stride * 2);
+    ptz_stream_rgba_to_y4m(&image, yuv);
+    CHECK(yuv[0] == 16 && yuv[4] == 128 && yuv[5] == 128);
+    memset(image.pixels, 255, (size_t)image.stride * 2);
+    ptz_stream_rgba_to_y4m(&image, yuv);
+    CHECK(yuv[0] == 235 && yuv[4] == 128 && yuv[5] == 128);
+    ptz_image_free(&image);
+}
+
+int main(void) {
+    alarm(30);
+    test_y4m();
+
+    ptz_stream stream;
+    if (ptz_stream_start(&stream, WIDTH, HEIGHT, FPS, stub_render, stub_encode, &stream) < 0) {
+        return 1;
+    }
+    ptz_http_server server;
+    if (ptz_http_server_start(&server, 0, PTZ_HTTP_BIND_LOOPBACK, ptz_stream_handle_request, &stream) < 0) {
+        return 1;
+    }
+    // Nobody's watching yet, so nothing is rendered.
+    usleep(50000);
+    CHECK(atomic_load(&renders) == 0);
+    test_repeat(&stream, &server);
+    test_slow_encoder(&stream, &server);
+    test_stop_with_client(&stream, &server);
+    ptz_http_server_stop(&server);
+    return ptz_test_result();
+}
@@ -0,0 +1,213 @@
+//
+//  ptz_telemetry_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+
+#include "ptz_telemetry.h"
+#include "ptz_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define PATH "ptz_telemetry_tests.telemetry"
+#define SMALLEST (4096 + 2 * PTZ_TELEMETRY_BLOCK)
+
+typedef struct collected {
+    ptz_telemetry_row *rows;
+    size_t count;
+    size_t capacity;
+} collected;
+
+static int collect(const ptz_telemetry_row *row, void *context) {
+    collected *c = context;
+    if (c->count == c->capacity) {
+        c->capacity = c->capacity ? c->capacity * 2 : 1024;
+        c->rows = realloc(c->rows, c->capacity * sizeof(*c->rows));
+    }
+    c->rows[c->count++] = *row;
+    return 0;
+}
+
+// Eight cameras, each swinging back and forth at its own speed, with a recall now and then.
+static ptz_telemetry_row sample(uint64_t i) {
+    ptz_telemetry_row row;
+    memset(&row, 0, sizeof(row));           // Rows are compared whole, padding and all.
+    int32_t camera = (int32_t)(i % 8);
+    int32_t step = (int32_t)(i / 8);
+    row.time = 1000000000ull + (i / 8) * 10000000ull;
+    row.camera = camera;
+    row.pan = ((step * (camera + 1)) % 512) - 256;
+    row.tilt = -(step % 200);
+    row.zoom = step % 0x100;
+    row.focus = camera * 3;
+    row.command = (step / 50) % 2 ? 20 : 15;
+    row.slot = (step / 50) % 3 == 2 ? camera : PTZ_TELEMETRY_NO_SLOT;
+    return row;
+}
+
+static void test_round_trip(void) {
+    remove(PATH);
+    ptz_telemetry telemetry;
+    CHECK(ptz_telemetry_open(&telemetry, PATH, 1 << 20) == 0);
+    const uint64_t count = 50000;
+    for (uint64_t i = 0; i < count; i++) {
+        ptz_telemetry_row row = sample(i);
+        ptz_telemetry_record(&telemetry, &row);
+    }
+    uint64_t blocks = telemetry.sequence;
+    ptz_telemetry_close(&telemetry);
+    // Small steps pack to a few bytes a row.
+    printf("%llu rows in %llu blocks, %.1f bytes a row\n", (unsigned long long)count, (unsigned long long)blocks,
+           (double)blocks * PTZ_TELEMETRY_BLOCK / count);
+    CHECK(blocks * PTZ_TELEMETRY_BLOCK / count < 16);
+
+    struct stat st;
+    CHECK(stat(PATH, &st) == 0 && st.st_size <= 1 << 20);
+    collected all = { 0 };
+    CHECK(ptz_telemetry_read(PATH, 0, UINT64_MAX, collect, &all) == 0);
+    CHECK(all.count == count);
+    for (uint64_t i = 0; i < all.count && i < count; i++) {
+        ptz_telemetry_row expected = sample(i);
+        if (memcmp(&all.rows[i], &expected, sizeof(expected)) != 0) {
+            CHECK(!"rows match");
+            break;
+        }
+    }
+
+    // A range.
+    collected some = { 0 };
+    uint64_t from = sample(800).time, to = sample(1599).time;
+    CHECK(ptz_telemetry_read(PATH, from, to, collect, &some) == 0);
+    CHECK(some.count == 800);
+    CHECK(some.count && memcmp(&some.rows[0], &all.rows[800], sizeof(ptz_telemetry_row)) == 0);
+    free(some.rows);
+    free(all.rows);
+}
+
+static void test_reopen(void) {
+    // The same budget carries on; the rows from last time are still there, and these come after them.
+    ptz_telemetry telemetry;
+    CHECK(ptz_telemetry_open(&telemetry, PATH, 1 << 20) == 0);
+    ptz_telemetry_row row = sample(50000);
+    ptz_telemetry_record(&telemetry, &row);
+    ptz_telemetry_close(&telemetry);
+    collected all = { 0 };
+    CHECK(ptz_telemetry_read(PATH, 0, UINT64_MAX, collect, &all) == 0);
+    CHECK(all.count == 50001);
+    CHECK(all.count && all.rows[all.count - 1].time == row.time);
+    free(all.rows);
+
+    // A different one starts over.
+    CHECK(ptz_telemetry_open(&telemetry, PATH, 2 << 20) == 0);
+    ptz_telemetry_close(&telemetry);
+    collected none = { 0 };
+    CHECK(ptz_telemetry_read(PATH, 0, UINT64_MAX, collect, &none) == 0);
+    CHECK(none.count == 0);
+    free(none.rows);
+    remove(PATH);
+}
+
+static void test_rotation(void) {
+    remove(PATH);
+    ptz_telemetry telemetry;
+    CHECK(ptz_telemetry_open(&telemetry, PATH, 4096) == -1);
+    CHECK(ptz_telemetry_open(&telemetry, PATH, SMALLEST) == 0);
+    const uint64_t count = 200000;
+    for (uint64_t i = 0; i < count; i++) {
+        ptz_telemetry_row row = sample(i);
+        ptz_telemetry_record(&telemetry, &row);
+    }
+    ptz_telemetry_close(&telemetry);
+    struct stat st;
+    CHECK(stat(PATH, &st) == 0 && st.st_size == SMALLEST);
+
+    // Only the newest two blocks are left, and they run right up to the end.
+    collected all = { 0 };
+    CHECK(ptz_telemetry_read(PATH, 0, UINT64_MAX, collect, &all) == 0);
+    CHECK(all.count > 0 && all.count < count);
+    uint64_t first = count - all.count;
+    for (uint64_t i = 0; i < all.count; i++) {
+        ptz_telemetry_row expected = sample(first + i);
+        if (memcmp(&all.rows[i], &expected, sizeof(expected)) != 0) {
+            CHECK(!"rows match");
+            break;
+        }
+    }
+    free(all.rows);
+    remove(PATH);
+}
+
+// A tick's worth at a time through the recorder's thread: what a flush waits for is all there.
+static void test_recorder(void) {
+    remove(PATH);
+    ptz_telemetry_recorder recorder;
+    CHECK(ptz_telemetry_recorder_open(&recorder, PATH, 1 << 20) == 0);
+    const uint64_t count = 40000;
+    for (uint64_t i = 0; i < count; i += 8) {
+        ptz_telemetry_row *rows = ptz_telemetry_recorder_reserve(&recorder, 8);
+        CHECK(rows != NULL);
+        if (!rows) {
+            break;
+        }
+        for (uint64_t r = 0; r < 8; r++) {
+            rows[r] = sample(i + r);
+        }
+        ptz_telemetry_recorder_commit(&recorder, 8);
+        if (i + 8 == count / 2) {
+            ptz_telemetry_recorder_flush(&recorder);
+            collected half = { 0 };
+            CHECK(ptz_telemetry_read(PATH, 0, UINT64_MAX, collect, &half) == 0);
+            CHECK(half.count == count / 2);
+            free(half.rows);
+        }
+    }
+    // More than the queue holds is turned away whole, and counted.
+    CHECK(ptz_telemetry_recorder_reserve(&recorder, PTZ_TELEMETRY_QUEUE_ROWS + 1) == NULL);
+    CHECK(recorder.dropped == PTZ_TELEMETRY_QUEUE_ROWS + 1);
+    ptz_telemetry_recorder_close(&recorder);
+
+    collected all = { 0 };
+    CHECK(ptz_telemetry_read(PATH, 0, UINT64_MAX, collect, &all) == 0);
+    CHECK(all.count == count);
+    for (uint64_t i = 0; i < all.count && i < count; i++) {
+        ptz_telemetry_row expected = sample(i);
+        if (memcmp(&all.rows[i], &expected, sizeof(expected)) != 0) {
+            CHECK(!"rows match");
+            break;
+        }
+    }
+    free(all.rows);
+    remove(PATH);
+}
+
+static void test_overhead(void) {
+    remove(PATH);
+    ptz_telemetry telemetry;
+    CHECK(ptz_telemetry_open(&telemetry, PATH, 16 << 20) == 0);
+    const uint64_t count = 1000000;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t i = 0; i < count; i++) {
+        ptz_telemetry_row row = sample(i);
+        ptz_telemetry_record(&telemetry, &row);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ptz_telemetry_close(&telemetry);
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / count;
+    printf("%.1f ns a row\n", ns);
+    remove(PATH);
+}
+
+int main(void) {
+    test_round_trip();
+    test_reopen();
+    test_rotation();
+    test_recorder();
+    test_overhead();
+    return ptz_test_result();
+}
@@ -0,0 +1,35 @@
+//
+//  ptz_test.h
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  What every test program shares: CHECK counts a failure and says where, and main ends with
+//  `return ptz_test_result();`. One test program per translation unit, so the count can be static.
+//
+
+#ifndef ptz_test_h
+#define ptz_test_h
+
+#include <stdio.h>
+
+static int failures;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+/**
+ * Reports the count, if any. Returns main's exit status: 0, or 1 if anything failed.
+ */
+static inline int ptz_test_result(void) {
+    if (failures) {
+        fprintf(stderr, "%d failed\n", failures);
+    }
+    return failures ? 1 : 0;
+}
+
+#endif /* ptz_test_h */
@@ -0,0 +1,263 @@
+//
+//  ptz_tiles_tests.c
+//  PTZ Camera SimTests
+//
+//  Created by Lee Ann Rucker on 10/18/26.
+//
+//  Tile containers: both writers read back as the pyramid they were cut from, the cache evicts the tile
+//  used longest ago, and rendering across a scene never holds more tiles than the cache was given while
+//  drawing the frames the whole pyramid does.
+//
+
+#include "ptz_tiles.h"
+#include "ptz_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PATH "ptz_tiles_tests.tiles"
+#define TILE 64
+
+static void fill_noise(ptz_image *image, int width, int height) {
+    CHECK(ptz_image_alloc(image, width, height) == 0);
+    uint32_t seed = 2463534242u;
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = ptz_image_row(image, y);
+        for (int x = 0; x < width * 4; x++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            // Smooth enough underneath that a render shows where it's looking, with noise on top.
+            row[x] = (uint8_t)((x / 4 + y) / 8 + (seed & 15));
+        }
+    }
+}
+
+// Every tile of `tiles` against the same block of `pyramid`, with zeros past the level's edge.
+static int same_as_pyramid(ptz_tiles *tiles, const ptz_pyramid *pyramid) {
+    if (tiles->levelCount != pyramid->levelCount) {
+        return 0;
+    }
+    for (int i = 0; i < pyramid->levelCount; i++) {
+        const ptz_image *level = &pyramid->levels[i];
+        if (tiles->levels[i].width != level->width || tiles->levels[i].height != level->height) {
+            return 0;
+        }
+        for (int row = 0; row < tiles->levels[i].rows; row++) {
+            for (int column = 0; column < tiles->levels[i].columns; column++) {
+                const ptz_image *tile = ptz_tiles_get(tiles, i, column, row);
+                if (tile == NULL) {
+                    return 0;
+                }
+                for (int y = 0; y < TILE; y++) {
+                    for (int x = 0; x < TILE; x++) {
+                        int lx = column * TILE + x, ly = row * TILE + y;
+                        uint32_t expected = 0, actual;
+                        if (lx < level->width && ly < level->height) {
+                            memcpy(&expected, ptz_image_row(level, ly) + lx * 4, 4);
+                        }
+                        memcpy(&actual, ptz_image_row(tile, y) + x * 4, 4);
+                        if (actual != expected) {
+                            return 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+// Stand-ins for JPEG: the payload is the tile's pixels, and every decode is counted.
+static int copy_encoder(const ptz_image *tile, uint8_t **data, size_t *size, void *context) {
+    (void)context;
+    *size = (size_t)tile->width * tile->height * 4;
+    *data = malloc(*size);
+    if (*data == NULL) {
+        return -1;
+    }
+    for (int y = 0; y < tile->height; y++) {
+        memcpy(*data + (size_t)y * tile->width * 4, ptz_image_row(tile, y), (size_t)tile->width * 4);
+    }
+    return 0;
+}
+
+static int copy_decoder(const uint8_t *data, size_t size, ptz_image *tile, void *context) {
+    if (size != (size_t)tile->width * tile->height * 4) {
+        return -1;
+    }
+    (*(int *)context)++;
+    for (int y = 0; y < tile->height; y++) {
+        memcpy(ptz_image_row(tile, y), data + (size_t)y * tile->width * 4, (size_t)tile->width * 4);
+    }
+    return 0;
+}
+
+static int cached_tiles(const ptz_tiles *tiles) {
+    int count = 0;
+    for (int i = 0; i < tiles->slotCount; i++) {
+        count += tiles->slots[i].image.pixels != NULL;
+    }
+    return count;
+}
+
+// Sizes that aren't a whole number of tiles, and odd levels further down.
+static void test_round_trip(const ptz_image *base, const ptz_pyramid *pyramid) {
+    remove(PATH);
+    ptz_tiles tiles;
+    CHECK(ptz_tiles_write(PATH, pyramid, TILE, PTZ_TILE_FORMAT_RGBA, NULL, NULL) == 0);
+    CHECK(ptz_tiles_open(&tiles, PATH, 8) == 0);
+    CHECK(tiles.format == PTZ_TILE_FORMAT_RGBA);
+    CHECK(same_as_pyramid(&tiles, pyramid));
+    CHECK(ptz_tiles_get(&tiles, 0, tiles.levels[0].columns, 0) == NULL);
+    CHECK(ptz_tiles_get(&tiles, tiles.levelCount, 0, 0) == NULL);
+    ptz_tiles_close(&tiles);
+
+    // A row at a time makes the same levels as ptz_pyramid_build, in the same layout.
+    remove(PATH);
+    ptz_tiles_writer writer;
+    CHECK(ptz_tiles_writer_open(&writer, PATH, base->width, base->height, TILE, PTZ_TILE_FORMAT_RGBA, NULL, NULL) == 0);
+    for (int y = 0; y < base->height; y++) {
+        CHECK(ptz_tiles_writer_add_row(&writer, ptz_image_row(base, y)) == 0);
+    }
+    // The strips are all it holds: tileSize rows of each level.
+    CHECK(writer.strips[0].height == TILE && writer.strips[0].width == base->width);
+    CHECK(ptz_tiles_writer_finish(&writer) == 0);
+    CHECK(ptz_tiles_open(&tiles, PATH, 8) == 0);
+    CHECK(same_as_pyramid(&tiles, pyramid));
+    ptz_tiles_close(&tiles);
+
+    // Through an encoder too.
+    remove(PATH);
+    int decodes = 0;
+    CHECK(ptz_tiles_writer_open(&writer, PATH, base->width, base->height, TILE, PTZ_TILE_FORMAT_JPEG,
+                                copy_encoder, NULL) == 0);
+    for (int y = 0; y < base->height; y++) {
+        ptz_tiles_writer_add_row(&writer, ptz_image_row(base, y));
+    }
+    CHECK(ptz_tiles_writer_finish(&writer) == 0);
+    CHECK(ptz_tiles_open(&tiles, PATH, 4) == 0);
+    CHECK(tiles.format == PTZ_TILE_FORMAT_JPEG);
+    CHECK(ptz_tiles_get(&tiles, 0, 0, 0) == NULL);          // No decoder yet.
+    ptz_tiles_set_decoder(&tiles, copy_decoder, &decodes);
+    CHECK(same_as_pyramid(&tiles, pyramid));
+    CHECK(decodes == tiles.tileCount);
+    ptz_tiles_close(&tiles);
+
+    // Stopping short leaves nothing behind.
+    remove(PATH);
+    CHECK(ptz_tiles_writer_open(&writer, PATH, base->width, base->height, TILE, PTZ_TILE_FORMAT_RGBA, NULL, NULL) == 0);
+    for (int y = 0; y < base->height / 2; y++) {
+        ptz_tiles_writer_add_row(&writer, ptz_image_row(base, y));
+    }
+    CHECK(ptz_tiles_writer_finish(&writer) == -1);
+    CHECK(access(PATH, F_OK) != 0);
+    CHECK(ptz_tiles_writer_open(&writer, PATH, base->width, base->height, 24, PTZ_TILE_FORMAT_RGBA, NULL, NULL) == -1);
+}
+
+static void test_eviction(const ptz_pyramid *pyramid) {
+    remove(PATH);
+    CHECK(ptz_tiles_write(PATH, pyramid, TILE, PTZ_TILE_FORMAT_JPEG, copy_encoder, NULL) == 0);
+    ptz_tiles tiles;
+    int decodes = 0;
+    CHECK(ptz_tiles_open(&tiles, PATH, 4) == 0);
+    ptz_tiles_set_decoder(&tiles, copy_decoder, &decodes);
+
+    // A B C D fill it; A again is a hit and makes B the oldest.
+    for (int column = 0; column < 4; column++) {
+        CHECK(ptz_tiles_get(&tiles, 0, column, 0) != NULL);
+    }
+    CHECK(decodes == 4);
+    CHECK(ptz_tiles_get(&tiles, 0, 0, 0) != NULL);
+    CHECK(decodes == 4);
+    // E takes B's slot, so B decodes again, taking C's; A, D and E are still there.
+    CHECK(ptz_tiles_get(&tiles, 0, 4, 0) != NULL);
+    CHECK(ptz_tiles_get(&tiles, 0, 1, 0) != NULL);
+    CHECK(decodes == 6);
+    CHECK(ptz_tiles_get(&tiles, 0, 0, 0) != NULL);
+    CHECK(ptz_tiles_get(&tiles, 0, 3, 0) != NULL);
+    CHECK(ptz_tiles_get(&tiles, 0, 4, 0) != NULL);
+    CHECK(decodes == 6);
+    CHECK(ptz_tiles_get(&tiles, 0, 2, 0) != NULL);
+    CHECK(decodes == 7);
+    CHECK(cached_tiles(&tiles) == 4);
+
+    // Every tile in turn, many more than fit, through a small cache: each one is still what was written.
+    int columns = tiles.levels[0].columns;
+    for (int i = 0; i < 3 * tiles.levels[0].columns * tiles.levels[0].rows; i++) {
+        int column = (i * 7) % columns, row = (i / columns) % tiles.levels[0].rows;
+        const ptz_image *tile = ptz_tiles_get(&tiles, 0, column, row);
+        CHECK(tile != NULL);
+        if (tile != NULL && column * TILE < pyramid->levels[0].width && row * TILE < pyramid->levels[0].height) {
+            CHECK(memcmp(ptz_image_row(tile, 0), ptz_image_row(&pyramid->levels[0], row * TILE) + column * TILE * 4,
+                         4) == 0);
+        }
+    }
+    CHECK(cached_tiles(&tiles) == 4);
+    ptz_tiles_close(&tiles);
+    remove(PATH);
+}
+
+// A sweep of pans and zooms through a cache of 16 tiles.
+static void test_budget(const ptz_pyramid *pyramid) {
+    remove(PATH);
+    CHECK(ptz_tiles_write(PATH, pyramid, TILE, PTZ_TILE_FORMAT_JPEG, copy_encoder, NULL) == 0);
+    ptz_tiles tiles;
+    int decodes = 0;
+    const int budget = 16;
+    CHECK(ptz_tiles_open(&tiles, PATH, budget) == 0);
+    ptz_tiles_set_decoder(&tiles, copy_decoder, &decodes);
+    ptz_renderer renderer;
+    ptz_renderer_init(&renderer);
+    ptz_image tiled = { 0 }, whole = { 0 };
+    CHECK(ptz_image_alloc(&tiled, 160, 90) == 0);
+    CHECK(ptz_image_alloc(&whole, 160, 90) == 0);
+    // The region's viewport is moved to its corner, which rounds differently in the last bit of a float.
+    int worst = 0;
+    for (uint32_t zoom = PTZ_ZOOM_MAX / 2; zoom <= PTZ_ZOOM_MAX; zoom += PTZ_ZOOM_MAX / 4) {
+        for (int32_t pan = PTZ_PT_MIN; pan <= PTZ_PT_MAX; pan += PTZ_PT_MAX / 4) {
+            ptz_camera_state state;
+            memset(&state, 0, sizeof(state));
+            state.pan = pan;
+            state.tilt = PTZ_PT_MAX / 3;
+            state.zoom = zoom;
+            CHECK(ptz_render_tiled_frame(&renderer, &tiles, &state, &tiled) == 0);
+            CHECK(ptz_render_pyramid_frame(&renderer, pyramid, &state, &whole) == 0);
+            for (int y = 0; y < tiled.height; y++) {
+                for (int x = 0; x < tiled.width * 4; x++) {
+                    int difference = abs(ptz_image_row(&tiled, y)[x] - ptz_image_row(&whole, y)[x]);
+                    worst = difference > worst ? difference : worst;
+                }
+            }
+            CHECK(cached_tiles(&tiles) <= budget);
+            // Everything under this frame fits, so drawing it again decodes nothing.
+            int before = decodes;
+            CHECK(ptz_render_tiled_frame(&renderer, &tiles, &state, &tiled) == 0);
+            CHECK(decodes == before);
+        }
+    }
+    CHECK(worst <= 1);
+    // Far more tiles were decoded over the sweep than the cache ever held.
+    CHECK(decodes > budget);
+    CHECK(cached_tiles(&tiles) <= budget);
+    ptz_image_free(&tiled);
+    ptz_image_free(&whole);
+    ptz_renderer_destroy(&renderer);
+    ptz_tiles_close(&tiles);
+    remove(PATH);
+}
+
+int main(void) {
+    ptz_image base = { 0 };
+    fill_noise(&base, 1100, 700);
+    ptz_pyramid pyramid;
+    CHECK(ptz_pyramid_build(&pyramid, &base) == 0);
+    CHECK(pyramid.levelCount > 2);
+    test_round_trip(&base, &pyramid);
+    test_eviction(&pyramid);
+    test_budget(&pyramid);
+    ptz_pyramid_free(&pyramid);
+    ptz_image_free(&base);
+    return ptz_test_result();
+}